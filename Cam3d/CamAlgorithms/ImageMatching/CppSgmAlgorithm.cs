@@ -10,6 +10,8 @@ public class CppSgmAlgorithm : DenseMatchingAlgorithm
         public int MaxParallelTasks { get; set; }
         public int MaxDisparity { get; set; }
         public int CensusMaskRadius { get; set; }
+        public MatchingCostType CostType { get; set; }
+        public int HmiLevels { get; set; }
         public double LowPenaltyCoeff { get; set; }
         public double HighPenaltyCoeff { get; set; }
         public double IntensityThreshold { get; set; }
@@ -23,29 +25,51 @@ public class CppSgmAlgorithm : DenseMatchingAlgorithm
         public override void MatchImages()
         {
             ConvertImagesToGray();
-            SgmParameters p = CreateSgmParameters();
 
-            _cppSgm = new Cam3dWrapper.SgmMatchingAlgorithm();
-            _cppSgm.Process(p);
+            // Wrappers pin managed arrays and own native objects, so they are disposed as soon as
+            // matching is done. Masked wrappers are null for grey images and go before their images
+            using(GreyScaleImageWrapper greyLeft = CreateGreyWrapper(ImageLeft))
+            using(GreyScaleImageWrapper greyRight = CreateGreyWrapper(ImageRight))
+            using(GreyMaskedImageWrapper maskedLeft = CreateMaskedWrapper(ImageLeft, greyLeft))
+            using(GreyMaskedImageWrapper maskedRight = CreateMaskedWrapper(ImageRight, greyRight))
+            using(Cam3dWrapper.SgmMatchingAlgorithm cppSgm = new Cam3dWrapper.SgmMatchingAlgorithm())
+            {
+                SgmParameters p = CreateSgmParameters(
+                    maskedLeft ?? (IWrapper)greyLeft, maskedRight ?? (IWrapper)greyRight);
 
-            MapLeft = CreateMapFromWrapper(_cppSgm.GetMapLeft());
-            MapRight = CreateMapFromWrapper(_cppSgm.GetMapRight());
+                _cppSgm = cppSgm;
+                try
+                {
+                    cppSgm.Process(p);
+                }
+                finally
+                {
+                    _cppSgm = null;
+                }
 
-            _cppSgm = null;
+                using(DisparityMapWrapper mapLeft = cppSgm.GetMapLeft())
+                using(DisparityMapWrapper mapRight = cppSgm.GetMapRight())
+                {
+                    MapLeft = CreateMapFromWrapper(mapLeft);
+                    MapRight = CreateMapFromWrapper(mapRight);
+                }
+            }
         }
 
-        private SgmParameters CreateSgmParameters()
+        private SgmParameters CreateSgmParameters(IWrapper leftImageWrapper, IWrapper rightImageWrapper)
         {
             SgmParameters p = new SgmParameters();
             p.rows = ImageLeft.RowCount;
             p.cols = ImageLeft.ColumnCount;
             p.imageType = ImageLeft is GrayScaleImage ? ImageType.Grey : ImageType.MaskedGrey;
-            p.leftImageWrapper = CreateImageWrapper(ImageLeft);
-            p.rightImageWrapper = CreateImageWrapper(ImageRight);
+            p.leftImageWrapper = leftImageWrapper;
+            p.rightImageWrapper = rightImageWrapper;
 
             p.maxParallelTasks = MaxParallelTasks;
             p.maxDisparity = MaxDisparity < 0 ? ImageLeft.ColumnCount : MaxDisparity;
             p.censusMaskRadius = CensusMaskRadius;
+            p.matchingCostType = CostType;
+            p.hmiLevels = HmiLevels;
             p.lowPenaltyCoeff = LowPenaltyCoeff;
             p.highPenaltyCoeff = HighPenaltyCoeff;
             p.intensityThreshold = IntensityThreshold;
@@ -56,20 +80,22 @@ private SgmParameters CreateSgmParameters()
             return p;
         }
 
-        private IWrapper CreateImageWrapper(IImage img)
+        private GreyScaleImageWrapper CreateGreyWrapper(IImage img)
         {
             GreyScaleImageWrapper imgGrey = new GreyScaleImageWrapper(img.RowCount, img.ColumnCount);
             imgGrey.SetMatrix(ImageToArray(img));
+            return imgGrey;
+        }
+
+        private GreyMaskedImageWrapper CreateMaskedWrapper(IImage img, GreyScaleImageWrapper imgGrey)
+        {
             if(img is GrayScaleImage)
             {
-                return imgGrey;
-            }
-            else
-            {
-                GreyMaskedImageWrapper imgMasked = new GreyMaskedImageWrapper(img.RowCount, img.ColumnCount, imgGrey);
-                imgMasked.SetMask(MaskToArray(img as MaskedImage));
-                return imgMasked;
+                return null;
             }
+            GreyMaskedImageWrapper imgMasked = new GreyMaskedImageWrapper(img.RowCount, img.ColumnCount, imgGrey);
+            imgMasked.SetMask(MaskToArray(img as MaskedImage));
+            return imgMasked;
         }
 
         private double[,] ImageToArray(IImage img)
@@ -143,8 +169,19 @@ public override void InitParameters()
         {
             base.InitParameters();
             
+            DictionaryParameter costTypeParam = new DictionaryParameter(
+                "Matching Cost", "CostType");
+            costTypeParam.ValuesMap = new Dictionary<string, object>()
+            {
+                { "Census", MatchingCostType.Census },
+                { "Hierarchical Mutual Information", MatchingCostType.HierarchicalMutualInformation }
+            };
+            Parameters.Add(costTypeParam);
+
             Parameters.Add(new IntParameter(
                 "Census Mask Radius", "CensusMaskRadius", 6, 1, 7));
+            Parameters.Add(new IntParameter(
+                "HMI Downsampled Levels", "HmiLevels", 3, 0, 5));
             Parameters.Add(new DoubleParameter(
                 "Sgm Low Penalty Coeff", "LowPenaltyCoeff", 0.02, 0.0, 1.0));     
             Parameters.Add(new DoubleParameter(
@@ -187,6 +224,8 @@ public override void UpdateParameters()
             MaxParallelTasks = IAlgorithmParameter.FindValue<int>("MaxParallelTasks", Parameters);
             MaxDisparity = IAlgorithmParameter.FindValue<int>("MaxDisparity", Parameters);
             CensusMaskRadius = IAlgorithmParameter.FindValue<int>("CensusMaskRadius", Parameters);
+            CostType = IAlgorithmParameter.FindValue<MatchingCostType>("CostType", Parameters);
+            HmiLevels = IAlgorithmParameter.FindValue<int>("HmiLevels", Parameters);
             LowPenaltyCoeff = IAlgorithmParameter.FindValue<double>("LowPenaltyCoeff", Parameters);
             HighPenaltyCoeff = IAlgorithmParameter.FindValue<double>("HighPenaltyCoeff", Parameters);
             IntensityThreshold = IAlgorithmParameter.FindValue<double>("InstenistyThreshold", Parameters);
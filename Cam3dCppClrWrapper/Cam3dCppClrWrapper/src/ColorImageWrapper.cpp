@@ -1,5 +1,9 @@
 #include "Stdafx.h"
 #include "ColorImageWrapper.h"
+#include "PlaneFileInterop.h"
+
+using System::Runtime::InteropServices::GCHandle;
+using System::Runtime::InteropServices::GCHandleType;
 
 namespace Cam3dWrapper
 {
@@ -7,40 +11,92 @@ namespace Cam3dWrapper
 		rows(rows_),
 		cols(cols_)
 	{
-		native = new cam3d::ColorImage(rows, cols);
-		matrix = gcnew cli::array<double, 3>(rows, cols, 3);
+		native = nullptr;
+		bindMatrix(gcnew cli::array<double, 3>(rows, cols, 3));
 	}
 
 	ColorImageWrapper::~ColorImageWrapper()
 	{
-		if (native != nullptr) { delete native; }
+		this->!ColorImageWrapper();
 	}
 
-	void ColorImageWrapper::Update()
+	ColorImageWrapper::!ColorImageWrapper()
 	{
-		for (int r = 0; r < rows; ++r)
+		if (native != nullptr)
 		{
-			for (int c = 0; c < cols; ++c)
-			{
-				for (int d = 0; d < 3; ++d)
-				{
-					(*native)(r, c, d) = matrix[r, c, d];
-				}
-			}
+			delete native;
+			native = nullptr;
 		}
+		if (matrixHandle.IsAllocated) { matrixHandle.Free(); }
+	}
+
+	void ColorImageWrapper::bindMatrix(cli::array<double, 3>^ matrix_)
+	{
+		if (matrix_->GetLength(0) != rows || matrix_->GetLength(1) != cols || matrix_->GetLength(2) != 3)
+		{
+			throw gcnew System::ArgumentException("Matrix must have " + rows + " rows, " + cols + " columns and 3 channels");
+		}
+
+		GCHandle handle = GCHandle::Alloc(matrix_, GCHandleType::Pinned);
+		double* data = static_cast<double*>(handle.AddrOfPinnedObject().ToPointer());
+		if (native == nullptr)
+		{
+			native = new cam3d::ColorImage(data, rows, cols, cols * 3);
+		}
+		else
+		{
+			// Same native object, as it may be referenced e.g. by masked image
+			native->getMatrix() = cam3d::ColorImage::Matrix{ cam3d::borrowed, data, rows, cols, 3, cols * 3 };
+		}
+
+		if (matrixHandle.IsAllocated) { matrixHandle.Free(); }
+		matrixHandle = handle;
+		matrix = matrix_;
+	}
+
+	void ColorImageWrapper::Update()
+	{
+		// Native image reads managed matrix directly
 	}
 
 	void ColorImageWrapper::updateNative()
 	{
-		for (int r = 0; r < rows; ++r)
+		// Native image writes managed matrix directly
+	}
+	void ColorImageWrapper::Save(System::String^ path, bool compress)
+	{
+		std::string nativePath = toNativePath(path);
+		try
+		{
+			cam3d::io::writeImage(nativePath, *native,
+				compress ? cam3d::io::Compression::ShuffledRle : cam3d::io::Compression::None);
+		}
+		catch (const std::exception& e)
 		{
-			for (int c = 0; c < cols; ++c)
+			throw toIOException(e);
+		}
+	}
+
+	ColorImageWrapper^ ColorImageWrapper::Load(System::String^ path)
+	{
+		std::string nativePath = toNativePath(path);
+		try
+		{
+			// Copied from mapped file straight into pinned matrix
+			cam3d::io::PlaneFileReader reader{ nativePath };
+			const cam3d::io::PlaneInfo& plane = reader.getPlane(cam3d::io::colorPlaneName);
+			if (plane.type != cam3d::io::ElementType::Double || plane.channels != 3)
 			{
-				for (int d = 0; d < 3; ++d)
-				{
-					matrix[r, c, d] = (*native)(r, c, d);
-				}
+				throw std::runtime_error("Plane '" + plane.name + "' has unexpected element type");
 			}
+			ColorImageWrapper^ image = gcnew ColorImageWrapper(plane.rows, plane.cols);
+			cam3d::ColorImage::Matrix& matrix = image->native->getMatrix();
+			reader.readPlane(plane, matrix.getData(), matrix.getPitch() * sizeof(double));
+			return image;
+		}
+		catch (const std::exception& e)
+		{
+			throw toIOException(e);
 		}
 	}
 }
\ No newline at end of file
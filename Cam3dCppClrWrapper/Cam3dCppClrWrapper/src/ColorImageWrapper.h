@@ -5,16 +5,19 @@
 
 namespace Cam3dWrapper
 {
+	// Managed matrix is pinned and native image borrows it, so both share pixels
+	// and nothing is copied between them
 	public ref class ColorImageWrapper : public Wrapper<cam3d::ColorImage>
 	{
 	public:
 		ColorImageWrapper(int rows, int cols);
 		~ColorImageWrapper();
+		!ColorImageWrapper();
 
+		// Matrix must be rows x cols x 3 - it is used by native image from now on
 		void SetMatrix(cli::array<double, 3>^ matrix_)
 		{
-			matrix = matrix_;
-			Update();
+			bindMatrix(matrix_);
 		}
 
 		cli::array<double, 3>^ GetMatrix()
@@ -27,11 +30,18 @@ namespace Cam3dWrapper
 		int GetRows() { return rows; }
 		int GetCols() { return cols; }
 
+		// Binary plane file. Throws IOException
+		void Save(System::String^ path, bool compress);
+		static ColorImageWrapper^ Load(System::String^ path);
+
 	internal:
 		virtual void updateNative() override;
 
 	private:
+		void bindMatrix(cli::array<double, 3>^ matrix_);
+
 		cli::array<double, 3>^ matrix;
+		System::Runtime::InteropServices::GCHandle matrixHandle;
 		int rows;
 		int cols;
 	};
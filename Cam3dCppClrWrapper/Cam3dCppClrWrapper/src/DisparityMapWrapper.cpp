@@ -1,23 +1,63 @@
 #include "Stdafx.h"
 #include "DisparityMapWrapper.h"
+#include "PlaneFileInterop.h"
+
+using System::Runtime::InteropServices::GCHandle;
+using System::Runtime::InteropServices::GCHandleType;
 
 namespace Cam3dWrapper
 {
+	static_assert(sizeof(DisparityWrapper) == sizeof(cam3d::Disparity), "DisparityWrapper must match cam3d::Disparity");
+
 	DisparityMapWrapper::DisparityMapWrapper(int rows_, int cols_) :
 		rows(rows_),
 		cols(cols_)
 	{
-		native = new cam3d::DisparityMap(rows, cols);
-		map = gcnew cli::array<DisparityWrapper^, 2>(rows, cols);
+		values = gcnew cli::array<DisparityWrapper, 2>(rows, cols);
+		valuesHandle = GCHandle::Alloc(values, GCHandleType::Pinned);
+		native = new cam3d::DisparityMap(cam3d::borrowed,
+			static_cast<cam3d::Disparity*>(valuesHandle.AddrOfPinnedObject().ToPointer()), rows, cols, cols);
+		map = nullptr;
 	}
 
 	DisparityMapWrapper::~DisparityMapWrapper()
 	{
-		delete native;
+		this->!DisparityMapWrapper();
+	}
+
+	DisparityMapWrapper::!DisparityMapWrapper()
+	{
+		if (native != nullptr)
+		{
+			delete native;
+			native = nullptr;
+		}
+		if (valuesHandle.IsAllocated) { valuesHandle.Free(); }
+	}
+
+	cli::array<DisparityWrapper^, 2>^ DisparityMapWrapper::GetDisparities()
+	{
+		if (map == nullptr)
+		{
+			map = gcnew cli::array<DisparityWrapper^, 2>(rows, cols);
+			for (int r = 0; r < rows; ++r)
+			{
+				for (int c = 0; c < cols; ++c)
+				{
+					map[r, c] = gcnew DisparityWrapper();
+				}
+			}
+		}
+		updateNative();
+		return map;
 	}
 
 	void DisparityMapWrapper::Update()
 	{
+		if (map == nullptr)
+		{
+			return; // Only values are used, native map reads them directly
+		}
 		for (int r = 0; r < rows; ++r)
 		{
 			for (int c = 0; c < cols; ++c)
@@ -29,12 +69,52 @@ namespace Cam3dWrapper
 
 	void DisparityMapWrapper::updateNative()
 	{
+		if (map == nullptr)
+		{
+			return; // Native map writes values directly
+		}
 		for (int r = 0; r < rows; ++r)
 		{
 			for (int c = 0; c < cols; ++c)
 			{
-				map[r, c] = DisparityWrapper::_fromNative((*native)(r, c));
+				DisparityWrapper::_assign(map[r, c], values[r, c]);
+			}
+		}
+	}
+	void DisparityMapWrapper::Save(System::String^ path, bool compress, bool withConfidence)
+	{
+		std::string nativePath = toNativePath(path);
+		Update();
+		try
+		{
+			cam3d::io::writeDisparityMap(nativePath, *native,
+				compress ? cam3d::io::Compression::ShuffledRle : cam3d::io::Compression::None, withConfidence);
+		}
+		catch (const std::exception& e)
+		{
+			throw toIOException(e);
+		}
+	}
+
+	DisparityMapWrapper^ DisparityMapWrapper::Load(System::String^ path)
+	{
+		std::string nativePath = toNativePath(path);
+		try
+		{
+			// Copied from mapped file straight into pinned values
+			cam3d::io::PlaneFileReader reader{ nativePath };
+			const cam3d::io::PlaneInfo& plane = reader.getPlane(cam3d::io::disparityPlaneName);
+			if (plane.type != cam3d::io::ElementType::Disparity)
+			{
+				throw std::runtime_error("Plane 'disparity' has unexpected element type");
 			}
+			DisparityMapWrapper^ map = gcnew DisparityMapWrapper(plane.rows, plane.cols);
+			reader.readPlane(plane, map->native->getData(), map->native->getPitch() * sizeof(cam3d::Disparity));
+			return map;
+		}
+		catch (const std::exception& e)
+		{
+			throw toIOException(e);
 		}
 	}
 }
\ No newline at end of file
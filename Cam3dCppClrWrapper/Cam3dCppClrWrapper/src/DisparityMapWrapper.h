@@ -6,17 +6,24 @@
 
 namespace Cam3dWrapper
 {
+	// Array of disparity values is pinned and native map borrows it, so matching writes
+	// it directly. Boxed disparities are kept only for GetDisparities() / SetDisparities()
 	public ref class DisparityMapWrapper : public Wrapper<cam3d::DisparityMap>
 	{
 	public:
 		DisparityMapWrapper(int rows, int cols);
 		~DisparityMapWrapper();
+		!DisparityMapWrapper();
 
-		cli::array<DisparityWrapper^, 2>^ GetDisparities()
+		// Shares memory with native map - no copy
+		cli::array<DisparityWrapper, 2>^ GetDisparityValues()
 		{
-			return map;
+			return values;
 		}
 
+		// Boxed copy of values, created on first call and updated in place afterwards
+		cli::array<DisparityWrapper^, 2>^ GetDisparities();
+
 		void SetDisparities(cli::array<DisparityWrapper^, 2>^ map_)
 		{
 			map = map_;
@@ -28,10 +35,16 @@ namespace Cam3dWrapper
 		int GetRows() { return rows; }
 		int GetCols() { return cols; }
 
+		// Binary plane file, optionally with float confidence plane. Throws IOException
+		void Save(System::String^ path, bool compress, bool withConfidence);
+		static DisparityMapWrapper^ Load(System::String^ path);
+
 	internal:
 		virtual void updateNative() override;
 
 	private:
+		cli::array<DisparityWrapper, 2>^ values;
+		System::Runtime::InteropServices::GCHandle valuesHandle;
 		cli::array<DisparityWrapper^, 2>^ map;
 		int rows;
 		int cols;
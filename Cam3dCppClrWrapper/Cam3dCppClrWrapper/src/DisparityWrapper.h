@@ -11,6 +11,8 @@ namespace Cam3dWrapper
 		Occluded = cam3d::Disparity::Occluded
 	};
 
+	// Layout matches cam3d::Disparity, so that native disparity map may borrow array of these
+	[System::Runtime::InteropServices::StructLayout(System::Runtime::InteropServices::LayoutKind::Sequential)]
 	public value struct DisparityWrapper
 	{
 	public:
@@ -34,6 +36,16 @@ namespace Cam3dWrapper
 			return dw;
 		}
 
+		// Overwrites boxed disparity in place
+		static void _assign(DisparityWrapper^ dw, DisparityWrapper d)
+		{
+			dw->dx = d.dx;
+			dw->flags = d.flags;
+			dw->subDx = d.subDx;
+			dw->cost = d.cost;
+			dw->confidence = d.confidence;
+		}
+
 		static cam3d::Disparity _toNative(DisparityWrapper^ d)
 		{
 			return cam3d::Disparity{
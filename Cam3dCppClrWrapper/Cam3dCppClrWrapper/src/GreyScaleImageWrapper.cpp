@@ -1,5 +1,9 @@
 #include "Stdafx.h"
 #include "GreyScaleImageWrapper.h"
+#include "PlaneFileInterop.h"
+
+using System::Runtime::InteropServices::GCHandle;
+using System::Runtime::InteropServices::GCHandleType;
 
 namespace Cam3dWrapper
 {
@@ -7,34 +11,92 @@ namespace Cam3dWrapper
 		rows(rows_),
 		cols(cols_)
 	{
-		native = new cam3d::GreyScaleImage(rows, cols);
-		matrix = gcnew cli::array<double, 2>(rows, cols);
+		native = nullptr;
+		bindMatrix(gcnew cli::array<double, 2>(rows, cols));
 	}
 
 	GreyScaleImageWrapper::~GreyScaleImageWrapper()
 	{
-		if (native != nullptr) { delete native; }
+		this->!GreyScaleImageWrapper();
 	}
 
-	void GreyScaleImageWrapper::Update()
+	GreyScaleImageWrapper::!GreyScaleImageWrapper()
 	{
-		for (int r = 0; r < rows; ++r)
+		if (native != nullptr)
 		{
-			for (int c = 0; c < cols; ++c)
-			{
-				(*native)(r, c) = matrix[r, c];
-			}
+			delete native;
+			native = nullptr;
 		}
+		if (matrixHandle.IsAllocated) { matrixHandle.Free(); }
+	}
+
+	void GreyScaleImageWrapper::bindMatrix(cli::array<double, 2>^ matrix_)
+	{
+		if (matrix_->GetLength(0) != rows || matrix_->GetLength(1) != cols)
+		{
+			throw gcnew System::ArgumentException("Matrix must have " + rows + " rows and " + cols + " columns");
+		}
+
+		GCHandle handle = GCHandle::Alloc(matrix_, GCHandleType::Pinned);
+		double* data = static_cast<double*>(handle.AddrOfPinnedObject().ToPointer());
+		if (native == nullptr)
+		{
+			native = new cam3d::GreyScaleImage(data, rows, cols, cols);
+		}
+		else
+		{
+			// Same native object, as it may be referenced e.g. by masked image
+			native->getMatrix() = cam3d::GreyScaleImage::Matrix{ cam3d::borrowed, data, rows, cols, cols };
+		}
+
+		if (matrixHandle.IsAllocated) { matrixHandle.Free(); }
+		matrixHandle = handle;
+		matrix = matrix_;
+	}
+
+	void GreyScaleImageWrapper::Update()
+	{
+		// Native image reads managed matrix directly
 	}
 
 	void GreyScaleImageWrapper::updateNative()
 	{
-		for (int r = 0; r < rows; ++r)
+		// Native image writes managed matrix directly
+	}
+	void GreyScaleImageWrapper::Save(System::String^ path, bool compress)
+	{
+		std::string nativePath = toNativePath(path);
+		try
+		{
+			cam3d::io::writeImage(nativePath, *native,
+				compress ? cam3d::io::Compression::ShuffledRle : cam3d::io::Compression::None);
+		}
+		catch (const std::exception& e)
 		{
-			for (int c = 0; c < cols; ++c)
+			throw toIOException(e);
+		}
+	}
+
+	GreyScaleImageWrapper^ GreyScaleImageWrapper::Load(System::String^ path)
+	{
+		std::string nativePath = toNativePath(path);
+		try
+		{
+			// Copied from mapped file straight into pinned matrix
+			cam3d::io::PlaneFileReader reader{ nativePath };
+			const cam3d::io::PlaneInfo& plane = reader.getPlane(cam3d::io::greyPlaneName);
+			if (plane.type != cam3d::io::ElementType::Double || plane.channels != 1)
 			{
-				matrix[r, c] = (*native)(r, c);
+				throw std::runtime_error("Plane '" + plane.name + "' has unexpected element type");
 			}
+			GreyScaleImageWrapper^ image = gcnew GreyScaleImageWrapper(plane.rows, plane.cols);
+			cam3d::GreyScaleImage::Matrix& matrix = image->native->getMatrix();
+			reader.readPlane(plane, matrix.getData(), matrix.getPitch() * sizeof(double));
+			return image;
+		}
+		catch (const std::exception& e)
+		{
+			throw toIOException(e);
 		}
 	}
 }
\ No newline at end of file
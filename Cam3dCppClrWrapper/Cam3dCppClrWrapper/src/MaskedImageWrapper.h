@@ -23,7 +23,17 @@ namespace Cam3dWrapper
 
 		~MaskedImageWrapper()
 		{
-			delete native;
+			this->!MaskedImageWrapper();
+		}
+
+		// Mask is owned by native object, image is only referenced
+		!MaskedImageWrapper()
+		{
+			if (native != nullptr)
+			{
+				delete native;
+				native = nullptr;
+			}
 		}
 
 		Wrapper<ImageT>^ GetImage()
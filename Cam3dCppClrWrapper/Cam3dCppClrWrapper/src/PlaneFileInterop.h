@@ -0,0 +1,21 @@
+#pragma once
+
+#include <CamCommon\PlaneFile.hpp>
+#include <msclr\marshal_cppstd.h>
+#include <exception>
+#include <string>
+
+namespace Cam3dWrapper
+{
+	// Helpers of Save() / Load() of wrappers, which use binary plane files (CamCommon/PlaneFile.hpp)
+	inline std::string toNativePath(System::String^ path)
+	{
+		if (path == nullptr) { throw gcnew System::ArgumentNullException("path"); }
+		return msclr::interop::marshal_as<std::string>(path);
+	}
+
+	inline System::IO::IOException^ toIOException(const std::exception& e)
+	{
+		return gcnew System::IO::IOException(gcnew System::String(e.what()));
+	}
+}
\ No newline at end of file
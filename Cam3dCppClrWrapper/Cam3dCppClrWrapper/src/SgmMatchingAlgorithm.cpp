@@ -75,6 +75,8 @@ namespace Cam3dWrapper
 		p.maxParallelTasks = this->maxParallelTasks;
 		p.maxDisparity = this->maxDisparity;
 		p.censusMaskRadius = this->censusMaskRadius;
+		p.matchingCostType = (cam3d::MatchingCostType)this->matchingCostType;
+		p.hmiLevels = this->hmiLevels;
 		p.lowPenaltyCoeff = this->lowPenaltyCoeff;
 		p.highPenaltyCoeff = this->highPenaltyCoeff;
 		p.intensityThreshold = this->intensityThreshold;
@@ -16,6 +16,12 @@ namespace Cam3dWrapper
 		MaskedColor = (int)cam3d::ImageType::MaskedColor,
 	};
 
+	public enum class MatchingCostType : int
+	{
+		Census = (int)cam3d::MatchingCostType::Census,
+		HierarchicalMutualInformation = (int)cam3d::MatchingCostType::HierarchicalMutualInformation,
+	};
+
 	public enum class DisparityCostMethod : int
 	{
 		DistanceToMean = (int)cam3d::CostMethod::DistanceToMean,
@@ -44,6 +50,8 @@ namespace Cam3dWrapper
 		double highPenaltyCoeff;
 		double intensityThreshold;
 		int censusMaskRadius;
+		MatchingCostType matchingCostType;
+		int hmiLevels;
 
 		DisparityCostMethod disparityCostMethod;
 		DisparityMeanMethod disparityMeanMethod;
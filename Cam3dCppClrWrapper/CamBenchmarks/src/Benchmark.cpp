@@ -0,0 +1,159 @@
+#include "Benchmark.hpp"
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <iomanip>
+#include <ostream>
+#include <thread>
+
+namespace cam3d
+{
+namespace benchmarks
+{
+    namespace
+    {
+        using Clock = std::chrono::steady_clock;
+
+        double runCalls(const std::function<void()>& fun, long long calls)
+        {
+            Clock::time_point start = Clock::now();
+            for(long long i = 0; i < calls; ++i)
+            {
+                fun();
+            }
+            return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        }
+
+        double runCalls(const std::function<void()>& setup, const std::function<void()>& fun, long long calls)
+        {
+            double ns = 0.0;
+            for(long long i = 0; i < calls; ++i)
+            {
+                setup();
+                Clock::time_point start = Clock::now();
+                fun();
+                ns += std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            }
+            return ns;
+        }
+    }
+
+    std::string escapeJson(const std::string& text)
+    {
+        std::string escaped;
+        for(char c : text)
+        {
+            if(c == '"' || c == '\\') { escaped += '\\'; }
+            escaped += c;
+        }
+        return escaped;
+    }
+
+    std::string getCompilerName()
+    {
+#if defined(__clang__)
+        return "clang " __clang_version__;
+#elif defined(__GNUC__)
+        return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+        return "msvc " + std::to_string(_MSC_VER);
+#else
+        return "unknown";
+#endif
+    }
+
+    std::string getUtcDate()
+    {
+        std::time_t now = std::time(nullptr);
+        char date[32];
+        std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+        return date;
+    }
+
+    void BenchmarkRunner::measure(const std::string& name, BenchmarkParams params, double itemsPerCall, std::function<void()> fun)
+    {
+        measureCalls(name, std::move(params), itemsPerCall, [&fun](long long calls) { return runCalls(fun, calls); });
+    }
+
+    void BenchmarkRunner::measure(const std::string& name, BenchmarkParams params, double itemsPerCall,
+        std::function<void()> setup, std::function<void()> fun)
+    {
+        measureCalls(name, std::move(params), itemsPerCall, [&setup, &fun](long long calls) { return runCalls(setup, fun, calls); });
+    }
+
+    void BenchmarkRunner::measureCalls(const std::string& name, BenchmarkParams params, double itemsPerCall,
+        const std::function<double(long long)>& runCalls)
+    {
+        if(!isEnabled(name))
+        {
+            return;
+        }
+
+        // Warm up and calibrate number of calls in one round
+        double oneCallNs = std::max(1.0, runCalls(1));
+        double roundNs = config.minTimeMs * 1e6 / std::max(1, config.rounds);
+        long long calls = std::max(1LL, static_cast<long long>(roundNs / oneCallNs));
+        double calibratedNs = runCalls(calls);
+        calls = std::max(1LL, static_cast<long long>(calls * roundNs / std::max(1.0, calibratedNs)));
+
+        std::vector<double> perCallNs;
+        for(int round = 0; round < std::max(1, config.rounds); ++round)
+        {
+            perCallNs.push_back(runCalls(calls) / calls);
+        }
+        std::sort(perCallNs.begin(), perCallNs.end());
+
+        results.push_back(BenchmarkResult{
+            name, std::move(params), calls * static_cast<long long>(perCallNs.size()),
+            perCallNs[perCallNs.size() / 2], perCallNs.front(), itemsPerCall
+        });
+    }
+
+    void BenchmarkRunner::writeJson(std::ostream& stream) const
+    {
+        stream << std::setprecision(10);
+        stream << "{\n  \"context\": {\n";
+        stream << "    \"date\": \"" << getUtcDate() << "\",\n";
+        stream << "    \"tag\": \"" << escapeJson(config.tag) << "\",\n";
+        stream << "    \"compiler\": \"" << escapeJson(getCompilerName()) << "\",\n";
+        stream << "    \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n";
+        stream << "    \"rows\": " << config.rows << ",\n";
+        stream << "    \"cols\": " << config.cols << "\n";
+        stream << "  },\n  \"benchmarks\": [\n";
+        for(std::size_t i = 0; i < results.size(); ++i)
+        {
+            const BenchmarkResult& r = results[i];
+            stream << "    {\"name\": \"" << escapeJson(r.name) << "\", \"params\": {";
+            for(std::size_t p = 0; p < r.params.size(); ++p)
+            {
+                stream << (p > 0 ? ", " : "") << "\"" << escapeJson(r.params[p].first) << "\": \""
+                    << escapeJson(r.params[p].second) << "\"";
+            }
+            stream << "}, \"iterations\": " << r.iterations
+                << ", \"median_ns\": " << r.medianNs
+                << ", \"min_ns\": " << r.minNs
+                << ", \"items_per_call\": " << r.itemsPerCall
+                << ", \"ns_per_item\": " << r.medianNs / r.itemsPerCall
+                << ", \"items_per_second\": " << r.itemsPerCall * 1e9 / r.medianNs
+                << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        stream << "  ]\n}\n";
+    }
+
+    void BenchmarkRunner::writeSummary(std::ostream& stream) const
+    {
+        for(const BenchmarkResult& r : results)
+        {
+            std::string params;
+            for(const auto& p : r.params)
+            {
+                params += " " + p.first + "=" + p.second;
+            }
+            stream << std::left << std::setw(28) << r.name << std::setw(36) << params
+                << std::right << std::fixed << std::setprecision(1)
+                << std::setw(14) << r.medianNs << " ns"
+                << std::setw(12) << std::setprecision(3) << r.medianNs / r.itemsPerCall << " ns/item\n";
+        }
+    }
+}
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cam3d
+{
+namespace benchmarks
+{
+    struct BenchmarkConfig
+    {
+        int rows = 480;
+        int cols = 640;
+        std::vector<int> disparities{ 64, 128, 256 };
+        std::vector<int> radii{ 1, 2, 3, 4, 5, 6, 7 };
+        int threads = 0; // 0 means one per hardware thread
+        double minTimeMs = 200.0;
+        int rounds = 5;
+        std::string filter;
+        std::string tag;
+        std::string outputPath;
+    };
+
+    using BenchmarkParams = std::vector<std::pair<std::string, std::string>>;
+
+    struct BenchmarkResult
+    {
+        std::string name;
+        BenchmarkParams params;
+        long long iterations;
+        double medianNs;   // Per one call of measured function
+        double minNs;
+        double itemsPerCall;
+    };
+
+    // Prevents compiler from removing computation of 'value'
+    template<typename T>
+    inline void doNotOptimize(const T& value)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "r,m"(value) : "memory");
+#else
+        static volatile const void* sink;
+        sink = &value;
+#endif
+    }
+
+    class BenchmarkRunner
+    {
+        const BenchmarkConfig& config;
+        std::vector<BenchmarkResult> results;
+
+    public:
+        BenchmarkRunner(const BenchmarkConfig& config_) : config{ config_ } { }
+
+        const BenchmarkConfig& getConfig() const { return config; }
+        const std::vector<BenchmarkResult>& getResults() const { return results; }
+
+        bool isEnabled(const std::string& name) const
+        {
+            return config.filter.empty() || name.find(config.filter) != std::string::npos;
+        }
+
+        // Calls 'fun' repeatedly: number of calls per round is calibrated so that all
+        // rounds take about 'minTimeMs'. Reports median and minimum time of one call.
+        // 'itemsPerCall' is used to compute throughput (pixels, words, tasks...)
+        void measure(const std::string& name, BenchmarkParams params, double itemsPerCall, std::function<void()> fun);
+        // As above, but 'setup' is called before each call of 'fun' and is not timed, e.g. to restore
+        // input which 'fun' modifies. Calls are timed one by one, so 'fun' should take well over a microsecond
+        void measure(const std::string& name, BenchmarkParams params, double itemsPerCall,
+            std::function<void()> setup, std::function<void()> fun);
+
+        void writeJson(std::ostream& stream) const;
+        void writeSummary(std::ostream& stream) const;
+
+    private:
+        // 'runCalls(n)' makes n calls and returns their time in ns
+        void measureCalls(const std::string& name, BenchmarkParams params, double itemsPerCall,
+            const std::function<double(long long)>& runCalls);
+    };
+
+    std::string escapeJson(const std::string& text);
+    std::string getCompilerName();
+    std::string getUtcDate();
+
+    void runCommonBenchmarks(BenchmarkRunner& runner);
+    void runMatchingBenchmarks(BenchmarkRunner& runner);
+    void runRefinementBenchmarks(BenchmarkRunner& runner);
+    void runRectificationBenchmarks(BenchmarkRunner& runner);
+    void runTriangulationBenchmarks(BenchmarkRunner& runner);
+}
+}
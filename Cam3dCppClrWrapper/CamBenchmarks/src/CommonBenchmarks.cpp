@@ -0,0 +1,327 @@
+#include "Benchmark.hpp"
+#include <CamCommon/BitWord.hpp>
+#include <CamCommon/FrameArena.hpp>
+#include <CamCommon/ParallelFor.hpp>
+#include <CamCommon/PerPixelFunction.hpp>
+#include <CamCommon/PlaneFile.hpp>
+#include <CamCommon/TaskQueue.hpp>
+#include <CamCommon/ThreadPool.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace cam3d
+{
+namespace benchmarks
+{
+    namespace
+    {
+        constexpr int hammingWordsCount = 4096;
+
+        template<typename BitWordT>
+        void benchmarkHamming(BenchmarkRunner& runner, const std::string& wordType)
+        {
+            std::mt19937_64 generator{ 7 };
+            std::vector<BitWordT> words(hammingWordsCount + 1);
+            for(BitWordT& word : words)
+            {
+                for(std::size_t i = 0; i < BitWordT::lengthInWords; ++i)
+                {
+                    word.bytes[i] = static_cast<typename BitWordT::uint_t>(generator());
+                }
+            }
+
+            runner.measure("BitWord.Hamming", { { "word", wordType }, { "length", std::to_string(BitWordT::lengthInWords) } },
+                hammingWordsCount, [&words]()
+            {
+                std::size_t sum = 0;
+                for(int i = 0; i < hammingWordsCount; ++i)
+                {
+                    sum += words[i].getHammingDistance(words[i + 1]);
+                }
+                doNotOptimize(sum);
+            });
+        }
+
+        template<std::size_t length, std::size_t maxLength>
+        struct Hamming32Benchmarks
+        {
+            static void run(BenchmarkRunner& runner)
+            {
+                benchmarkHamming<BitWord32<length>>(runner, "BitWord32");
+                Hamming32Benchmarks<length + 1, maxLength>::run(runner);
+            }
+        };
+
+        template<std::size_t maxLength>
+        struct Hamming32Benchmarks<maxLength, maxLength>
+        {
+            static void run(BenchmarkRunner&) { }
+        };
+
+        template<std::size_t length, std::size_t maxLength>
+        struct Hamming64Benchmarks
+        {
+            static void run(BenchmarkRunner& runner)
+            {
+                benchmarkHamming<BitWord64<length>>(runner, "BitWord64");
+                Hamming64Benchmarks<length + 1, maxLength>::run(runner);
+            }
+        };
+
+        template<std::size_t maxLength>
+        struct Hamming64Benchmarks<maxLength, maxLength>
+        {
+            static void run(BenchmarkRunner&) { }
+        };
+
+        void benchmarkTaskQueue(BenchmarkRunner& runner)
+        {
+            const BenchmarkConfig& config = runner.getConfig();
+            std::size_t threads = config.threads > 0 ?
+                static_cast<std::size_t>(config.threads) : std::max(1u, std::thread::hardware_concurrency());
+            ThreadPool pool{ threads };
+
+            for(int tasksCount : { 16, 256 })
+            {
+                for(bool usePool : { false, true })
+                {
+                    BenchmarkParams params{ { "tasks", std::to_string(tasksCount) },
+                        { "threads", std::to_string(threads) }, { "executor", usePool ? "pool" : "shared" } };
+
+                    runner.measure("StaticTaskQueue.Independent", params, tasksCount, [&pool, tasksCount, threads, usePool]()
+                    {
+                        StaticTaskQueue queue{ threads, usePool ? &pool : nullptr };
+                        for(int i = 0; i < tasksCount; ++i)
+                        {
+                            queue.addTask(Task{ static_cast<TaskId>(i), []() { } }, {});
+                        }
+                        queue.run();
+                    });
+
+                    runner.measure("StaticTaskQueue.Chain", params, tasksCount, [&pool, tasksCount, threads, usePool]()
+                    {
+                        StaticTaskQueue queue{ threads, usePool ? &pool : nullptr };
+                        queue.addTask(Task{ 0, []() { } }, {});
+                        for(int i = 1; i < tasksCount; ++i)
+                        {
+                            queue.addTask(Task{ static_cast<TaskId>(i), []() { } }, { static_cast<TaskId>(i - 1) });
+                        }
+                        queue.run();
+                    });
+
+                    TaskGraph chain;
+                    chain.addTask(Task{ 0, []() { } }, {});
+                    for(int i = 1; i < tasksCount; ++i)
+                    {
+                        chain.addTask(Task{ static_cast<TaskId>(i), []() { } }, { static_cast<TaskId>(i - 1) });
+                    }
+                    chain.compile();
+                    runner.measure("TaskGraph.ChainReused", params, tasksCount, [&pool, &chain, threads, usePool]()
+                    {
+                        chain.run(threads, usePool ? &pool : nullptr);
+                    });
+                }
+            }
+        }
+
+        void benchmarkPerPixelFunction(BenchmarkRunner& runner)
+        {
+            const BenchmarkConfig& config = runner.getConfig();
+            int rows = config.rows, cols = config.cols;
+            std::vector<int> output(rows * cols);
+            BenchmarkParams params{ { "rows", std::to_string(rows) }, { "cols", std::to_string(cols) } };
+
+            runner.measure("PerPixelFunction.Run", params, rows * cols, [&output, rows, cols]()
+            {
+                PerPixelFunction::run([&output, cols](int y, int x) { output[y * cols + x] = y + x; }, rows, cols);
+                doNotOptimize(output.data());
+            });
+
+            ParallelForOptions serial;
+            serial.maxTasks = 1;
+            runner.measure("ParallelForPixels.Serial", params, rows * cols, [&output, rows, cols, &serial]()
+            {
+                parallelForPixels({ 0, 0, rows, cols }, [&output, cols](int y, int x) { output[y * cols + x] = y + x; }, serial);
+                doNotOptimize(output.data());
+            });
+
+            ParallelForOptions parallel;
+            parallel.maxTasks = config.threads;
+            for(ParallelPartition partition : { ParallelPartition::RowBlocks, ParallelPartition::Tiles })
+            {
+                parallel.partition = partition;
+                BenchmarkParams parallelParams = params;
+                parallelParams.push_back({ "partition", partition == ParallelPartition::RowBlocks ? "rows" : "tiles" });
+                parallelParams.push_back({ "threads", std::to_string(config.threads) });
+                runner.measure("ParallelForPixels.Parallel", parallelParams, rows * cols, [&output, rows, cols, &parallel]()
+                {
+                    parallelForPixels({ 0, 0, rows, cols }, [&output, cols](int y, int x) { output[y * cols + x] = y + x; }, parallel);
+                    doNotOptimize(output.data());
+                });
+            }
+
+            // Baseline: same work without std::function call per pixel
+            runner.measure("PerPixelFunction.RawLoop", params, rows * cols, [&output, rows, cols]()
+            {
+                for(int y = 0; y < rows; ++y)
+                {
+                    for(int x = 0; x < cols; ++x)
+                    {
+                        output[y * cols + x] = y + x;
+                    }
+                }
+                doNotOptimize(output.data());
+            });
+        }
+
+        // Per-frame temporaries of SGM: border path with costs of last step, as many as for 640x480 image
+        struct PathLike
+        {
+            int header[16];
+            double* costs;
+        };
+
+        void benchmarkFrameAllocations(BenchmarkRunner& runner)
+        {
+            constexpr int objectsCount = 8 * (640 + 480);
+            constexpr int costsCount = 66;
+            BenchmarkParams params{ { "objects", std::to_string(objectsCount) }, { "costs", std::to_string(costsCount) } };
+            std::vector<PathLike*> objects(objectsCount);
+
+            runner.measure("FrameAllocations.Heap", params, objectsCount, [&objects]()
+            {
+                for(PathLike*& object : objects)
+                {
+                    object = new PathLike{};
+                    object->costs = new double[costsCount];
+                }
+                doNotOptimize(objects.data());
+                for(PathLike* object : objects)
+                {
+                    delete[] object->costs;
+                    delete object;
+                }
+            });
+
+            memory::FrameArena arena;
+            runner.measure("FrameAllocations.Arena", params, objectsCount, [&objects, &arena]()
+            {
+                for(PathLike*& object : objects)
+                {
+                    object = arena.create<PathLike>();
+                    object->costs = arena.allocateArray<double>(costsCount);
+                }
+                doNotOptimize(objects.data());
+                arena.reset();
+            });
+
+            // Same objects allocated by concurrent tasks, as path tasks of SGM share arena of frame
+            const BenchmarkConfig& config = runner.getConfig();
+            int threads = config.threads > 0 ? config.threads : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+            ThreadPool pool{ static_cast<std::size_t>(threads) };
+            ParallelForOptions options;
+            options.pool = &pool;
+            options.maxTasks = threads;
+            options.grainRows = 1;
+            BenchmarkParams parallelParams = params;
+            parallelParams.push_back({ "threads", std::to_string(threads) });
+            std::vector<std::vector<PathLike*>> taskObjects(threads, std::vector<PathLike*>((objectsCount + threads - 1) / threads));
+            int parallelCount = static_cast<int>(taskObjects[0].size()) * threads;
+
+            runner.measure("FrameAllocations.HeapParallel", parallelParams, parallelCount, [&taskObjects, &options, threads]()
+            {
+                parallelForRows(0, threads, [&taskObjects](int taskStart, int taskEnd)
+                {
+                    for(int t = taskStart; t < taskEnd; ++t)
+                    {
+                        for(PathLike*& object : taskObjects[t])
+                        {
+                            object = new PathLike{};
+                            object->costs = new double[costsCount];
+                        }
+                        doNotOptimize(taskObjects[t].data());
+                        for(PathLike* object : taskObjects[t])
+                        {
+                            delete[] object->costs;
+                            delete object;
+                        }
+                    }
+                }, options);
+            });
+
+            runner.measure("FrameAllocations.ArenaParallel", parallelParams, parallelCount, [&taskObjects, &options, &arena, threads]()
+            {
+                parallelForRows(0, threads, [&taskObjects, &arena](int taskStart, int taskEnd)
+                {
+                    for(int t = taskStart; t < taskEnd; ++t)
+                    {
+                        for(PathLike*& object : taskObjects[t])
+                        {
+                            object = arena.create<PathLike>();
+                            object->costs = arena.allocateArray<double>(costsCount);
+                        }
+                        doNotOptimize(taskObjects[t].data());
+                    }
+                }, options);
+                arena.reset();
+            });
+        }
+
+        void benchmarkPlaneFile(BenchmarkRunner& runner)
+        {
+            const BenchmarkConfig& config = runner.getConfig();
+            const int rows = config.rows;
+            const int cols = config.cols;
+            const std::string path = "PlaneFile.benchmark.tmp";
+
+            // Smooth disparities with invalid left border, as matcher writes them
+            DisparityMap map{ rows, cols };
+            for(int r = 0; r < rows; ++r)
+            {
+                for(int c = 0; c < cols; ++c)
+                {
+                    map(r, c) = c < 64 ?
+                        Disparity{ 0, Disparity::Invalid } :
+                        Disparity{ -(10 + r / 48), Disparity::Valid, -(10.0 + r / 48), 0.25, 0.9 };
+                }
+            }
+
+            for(io::Compression compression : { io::Compression::None, io::Compression::ShuffledRle })
+            {
+                BenchmarkParams params{ { "size", std::to_string(cols) + "x" + std::to_string(rows) },
+                    { "compression", compression == io::Compression::None ? "none" : "shuffled_rle" } };
+
+                runner.measure("PlaneFile.WriteDisparityMap", params, rows * cols, [&]()
+                {
+                    io::writeDisparityMap(path, map, compression);
+                });
+                runner.measure("PlaneFile.ReadDisparityMap", params, rows * cols, [&]()
+                {
+                    io::Loaded<DisparityMap> loaded = io::readDisparityMap(path);
+                    double sum = 0.0;
+                    for(int r = 0; r < rows; ++r)
+                    {
+                        sum += loaded.value(r, cols / 2).subDx;
+                    }
+                    doNotOptimize(&sum);
+                });
+            }
+            std::remove(path.c_str());
+        }
+    }
+
+    void runCommonBenchmarks(BenchmarkRunner& runner)
+    {
+        Hamming32Benchmarks<1, 9>::run(runner);
+        Hamming64Benchmarks<1, 5>::run(runner);
+        benchmarkTaskQueue(runner);
+        benchmarkPerPixelFunction(runner);
+        benchmarkFrameAllocations(runner);
+        benchmarkPlaneFile(runner);
+    }
+}
+}
@@ -0,0 +1,205 @@
+#include "Benchmark.hpp"
+#include <CamCommon/FrameArena.hpp>
+#include <CamCommon/GreyScaleImage.hpp>
+#include <CamImageMatching/CensusCostComputer.hpp>
+#include <CamImageMatching/SgmCostAggregator.hpp>
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace cam3d
+{
+namespace benchmarks
+{
+    namespace
+    {
+        using CensusRadius3 = CensusCostComputer32<GreyScaleImage, 3>;
+        using Aggregator = SgmCostAggregator<GreyScaleImage, CensusRadius3>;
+
+        // Random-dot pair with constant disparity
+        struct ImagePair
+        {
+            GreyScaleImage left;
+            GreyScaleImage right;
+
+            ImagePair(int rows, int cols, int disparity) :
+                left{ rows, cols },
+                right{ rows, cols }
+            {
+                std::mt19937 generator{ 11 };
+                std::uniform_real_distribution<double> intensity{ 0.0, 1.0 };
+                for(int y = 0; y < rows; ++y)
+                {
+                    for(int x = 0; x < cols; ++x)
+                    {
+                        right(y, x) = intensity(generator);
+                    }
+                    for(int x = 0; x < cols; ++x)
+                    {
+                        left(y, x) = x >= disparity ? right(y, x - disparity) : intensity(generator);
+                    }
+                }
+            }
+        };
+
+        SgmParameters createParameters(int rows, int cols, int maxDisparity)
+        {
+            SgmParameters params{};
+            params.rows = rows;
+            params.cols = cols;
+            params.imageType = ImageType::Grey;
+            params.isLeftImageBase = true;
+            params.maxParallelTasks = 1;
+            params.maxDisparity = maxDisparity;
+            params.lowPenaltyCoeff = 0.02;
+            params.highPenaltyCoeff = 0.04;
+            params.intensityThreshold = 0.1;
+            params.censusMaskRadius = 3;
+            params.matchingCostType = MatchingCostType::Census;
+            params.hmiLevels = 0;
+            params.disparityMeanMethod = MeanMethod::SimpleAverage;
+            params.disparityCostMethod = CostMethod::DistanceToMean;
+            params.diparityPathLengthThreshold = 3;
+            params.costMethodPower = 2.0;
+            return params;
+        }
+
+        template<int radius, int maxRadiusPlusOne>
+        struct CensusBenchmarks
+        {
+            static void run(BenchmarkRunner& runner, ImagePair& images)
+            {
+                const BenchmarkConfig& config = runner.getConfig();
+                if(std::find(config.radii.begin(), config.radii.end(), radius) != config.radii.end())
+                {
+                    int rows = images.left.getRowCount(), cols = images.left.getColumnCount();
+                    memory::FrameArena arena;
+                    CensusCostComputer32<GreyScaleImage, radius> census{ rows, cols, arena, ThreadPool::getShared() };
+                    census.setMaskWidth(radius);
+                    census.setMaskHeight(radius);
+
+                    runner.measure("Census.Transform",
+                        { { "radius", std::to_string(radius) }, { "rows", std::to_string(rows) }, { "cols", std::to_string(cols) } },
+                        rows * cols, [&census, &images]()
+                    {
+                        census.init(images.left, images.right);
+                    });
+                }
+                CensusBenchmarks<radius + 1, maxRadiusPlusOne>::run(runner, images);
+            }
+        };
+
+        template<int maxRadiusPlusOne>
+        struct CensusBenchmarks<maxRadiusPlusOne, maxRadiusPlusOne>
+        {
+            static void run(BenchmarkRunner&, ImagePair&) { }
+        };
+
+        void benchmarkPathStep(BenchmarkRunner& runner, ImagePair& images, int maxDisparity)
+        {
+            int rows = images.left.getRowCount(), cols = images.left.getColumnCount();
+            int dispRange = std::min(maxDisparity, cols - 2);
+            SgmParameters params = createParameters(rows, cols, maxDisparity);
+            DisparityMap map{ rows, cols };
+            memory::FrameArena arena;
+            std::unique_ptr<Aggregator> sgm{ new Aggregator{ params, true, images.left, images.right, map, arena, ThreadPool::getShared() } };
+            sgm->initLocalCosts();
+            sgm->initPaths();
+
+            // Last step of horizontal path in the middle row: full disparity range is available
+            SgmPath_PosX path;
+            path.imageHeight = rows;
+            path.imageWidth = cols;
+            path.length = cols;
+            path.startPixel = Point2{ rows / 2, 0 };
+            path.currentIndex = cols - 1;
+            path.currentPixel = Point2{ rows / 2, cols - 1 };
+            path.previousPixel = Point2{ rows / 2, cols - 2 };
+            std::vector<double> lastStepCosts(cols + 1, 0.0);
+            std::vector<double> stepCosts(cols + 1, 0.0);
+            path.lastStepCosts = lastStepCosts.data();
+            path.lastStepCostsCount = cols + 1;
+
+            runner.measure("Sgm.PathStep", { { "disparities", std::to_string(dispRange) } },
+                dispRange, [&sgm, &path, &stepCosts, dispRange]()
+            {
+                sgm->findCostForEachDisparityInStep(&path, PathDirection::PosX, dispRange, stepCosts.data());
+            });
+        }
+
+        void benchmarkFinalizeForPixel(BenchmarkRunner& runner, ImagePair& images, int maxDisparity)
+        {
+            constexpr int pixelsCount = 1024;
+            int rows = images.left.getRowCount(), cols = images.left.getColumnCount();
+            DisparityMap map{ rows, cols };
+            memory::FrameArena arena;
+            CensusRadius3 census{ rows, cols, arena, ThreadPool::getShared() };
+            census.setMaskWidth(3);
+            census.setMaskHeight(3);
+            census.init(images.left, images.right);
+
+            std::mt19937 generator{ 13 };
+            std::uniform_int_distribution<int> disparity{ -maxDisparity / 2, 0 };
+            // Path lengths above threshold, so that weighted mean is always defined
+            std::uniform_int_distribution<int> length{ 4, cols };
+            std::vector<DisparityForPixel> disparities(pixelsCount * pathsCount);
+            for(DisparityForPixel& d : disparities)
+            {
+                d = DisparityForPixel{ disparity(generator), length(generator), 1.0, 1.0 };
+            }
+
+            for(MeanMethod mean : { MeanMethod::SimpleAverage, MeanMethod::WeightedAverageWithPathLength })
+            {
+                for(CostMethod cost : { CostMethod::DistanceToMean, CostMethod::DistanceSquredToMean })
+                {
+                    Aggregator::DisparityComputer dispComp{ rows, cols, map, images.left, images.right, census };
+                    dispComp.setMeanMethod(mean);
+                    dispComp.setCostMethod(cost);
+                    dispComp.setCostMethodPower(2.0);
+                    dispComp.setPathLengthTreshold(3.0);
+
+                    BenchmarkParams params{
+                        { "mean", mean == MeanMethod::SimpleAverage ? "simple" : "weighted_path" },
+                        { "cost", cost == CostMethod::DistanceToMean ? "distance" : "distance_squared" },
+                        { "disparities", std::to_string(maxDisparity) } };
+
+                    runner.measure("Sgm.FinalizeForPixel", params, pixelsCount, [&dispComp, &disparities, maxDisparity, rows, cols]()
+                    {
+                        for(int p = 0; p < pixelsCount; ++p)
+                        {
+                            for(int i = 0; i < pathsCount; ++i)
+                            {
+                                dispComp.storeDisparity(disparities[p * pathsCount + i]);
+                            }
+                            // Keep matched pixel inside image for any mean disparity
+                            dispComp.finalizeForPixel(Point2{ p % rows, cols - 1 - (p % (cols - maxDisparity)) });
+                        }
+                    });
+                }
+            }
+        }
+    }
+
+    void runMatchingBenchmarks(BenchmarkRunner& runner)
+    {
+        const BenchmarkConfig& config = runner.getConfig();
+        int maxConfigDisparity = *std::max_element(config.disparities.begin(), config.disparities.end());
+        ImagePair images{ config.rows, config.cols, std::min(maxConfigDisparity / 2, config.cols / 4) };
+
+        CensusBenchmarks<1, 8>::run(runner, images);
+        for(int maxDisparity : config.disparities)
+        {
+            if(maxDisparity >= config.cols - 2)
+            {
+                continue;
+            }
+            if(runner.isEnabled("Sgm.PathStep"))
+            {
+                benchmarkPathStep(runner, images, maxDisparity);
+            }
+            benchmarkFinalizeForPixel(runner, images, maxDisparity);
+        }
+    }
+}
+}
@@ -0,0 +1,172 @@
+#include "Benchmark.hpp"
+#include <CamRectification/RemapCache.hpp>
+#include <CamCommon/ThreadPool.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+namespace cam3d
+{
+namespace benchmarks
+{
+    namespace
+    {
+        Homography createRectification()
+        {
+            Homography h;
+            h.h[0][0] = 0.998; h.h[0][1] = 0.012; h.h[0][2] = -6.5;
+            h.h[1][0] = -0.011; h.h[1][1] = 1.003; h.h[1][2] = 4.25;
+            h.h[2][0] = 1.5e-6; h.h[2][1] = -2.0e-6; h.h[2][2] = 1.0;
+            return h;
+        }
+
+        // Transforms every pixel of every frame, as managed ImageTransformer does
+        void remapPerPixel(const IImageTransformation& transformation, const GreyScaleImage& source, MaskedImage<GreyScaleImage>& destination)
+        {
+            int rows = source.getRowCount(), cols = source.getColumnCount();
+            for(int r = 0; r < destination.getRowCount(); ++r)
+            {
+                for(int c = 0; c < destination.getColumnCount(); ++c)
+                {
+                    Vector2f p = transformation.transformPointBackwards(Vector2f{ c + 0.5, r + 0.5 });
+                    bool mapped = p.x >= 0.0 && p.x < cols && p.y >= 0.0 && p.y < rows;
+                    destination.setMaskAt(r, c, mapped);
+                    if(!mapped)
+                    {
+                        destination(r, c) = 0.0;
+                        continue;
+                    }
+                    double u = std::min(std::max(p.x - 0.5, 0.0), cols - 1.0);
+                    double v = std::min(std::max(p.y - 0.5, 0.0), rows - 1.0);
+                    int x = std::min(static_cast<int>(u), cols - 2), y = std::min(static_cast<int>(v), rows - 2);
+                    double fx = u - x, fy = v - y;
+                    double top = source(y, x) + (source(y, x + 1) - source(y, x)) * fx;
+                    double bottom = source(y + 1, x) + (source(y + 1, x + 1) - source(y + 1, x)) * fx;
+                    destination(r, c) = top + (bottom - top) * fy;
+                }
+            }
+        }
+    }
+
+    void runRectificationBenchmarks(BenchmarkRunner& runner)
+    {
+        if(!runner.isEnabled("Rectification.BuildTable") && !runner.isEnabled("Rectification.PerPixelTransform")
+            && !runner.isEnabled("Rectification.Remap") && !runner.isEnabled("Rectification.UndistortRectify")
+            && !runner.isEnabled("Rectification.LoadCachedTable"))
+        {
+            return;
+        }
+
+        const BenchmarkConfig& config = runner.getConfig();
+        const int rows = config.rows;
+        const int cols = config.cols;
+        int threads = config.threads > 0 ? config.threads : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        ThreadPool pool{ static_cast<std::size_t>(threads) };
+        ParallelForOptions options;
+        options.pool = &pool;
+        options.maxTasks = threads;
+
+        RectificationTransformation rectification{ createRectification() };
+        Rational3RDModel distortionModel{ 1e-4, 1.2e-4, 1e-9, cols * 0.5, rows * 0.5 };
+        RadialDistortionTransformation undistortion{ distortionModel };
+        UndistortRectifyTransformation undistortRectify{ distortionModel, createRectification() };
+
+        GreyScaleImage grey{ rows, cols };
+        ColorImage color{ rows, cols };
+        Array2d<std::uint8_t> bytes{ rows, cols };
+        for(int r = 0; r < rows; ++r)
+        {
+            for(int c = 0; c < cols; ++c)
+            {
+                double value = 0.5 + 0.25 * std::sin(r * 0.05) + 0.25 * std::cos(c * 0.03);
+                grey(r, c) = value;
+                color(r, c, 0) = value;
+                color(r, c, 1) = 1.0 - value;
+                color(r, c, 2) = value * 0.5;
+                bytes(r, c) = static_cast<std::uint8_t>(value * 255.0);
+            }
+        }
+
+        std::string size = std::to_string(cols) + "x" + std::to_string(rows);
+        struct Mapping { const char* name; const IImageTransformation* transformation; };
+        for(Mapping mapping : { Mapping{ "homography", &rectification }, Mapping{ "distortion", &undistortion },
+            Mapping{ "undistort+rectify", &undistortRectify } })
+        {
+            BenchmarkParams params{ { "size", size }, { "mapping", mapping.name }, { "threads", std::to_string(threads) } };
+            runner.measure("Rectification.BuildTable", params, rows * cols, [&]()
+            {
+                RemapTable table{ *mapping.transformation, rows, cols, rows, cols, Vector2f{}, options };
+                doNotOptimize(table.getSourceX()(rows / 2, cols / 2));
+            });
+        }
+
+        // Remapping of frames - table is built once for rig
+        RemapTable table{ rectification, rows, cols, rows, cols, Vector2f{}, options };
+        GreyScaleImage greyOut{ rows, cols };
+        MaskedImage<GreyScaleImage> greyMasked{ greyOut };
+        ColorImage colorOut{ rows, cols };
+        MaskedImage<ColorImage> colorMasked{ colorOut };
+        Array2d<std::uint8_t> bytesOut{ rows, cols };
+        Array2d<char> mask{ rows, cols };
+
+        runner.measure("Rectification.PerPixelTransform", BenchmarkParams{ { "size", size }, { "image", "grey" } }, rows * cols, [&]()
+        {
+            remapPerPixel(rectification, grey, greyMasked);
+            doNotOptimize(greyOut(rows / 2, cols / 2));
+        });
+        runner.measure("Rectification.Remap", BenchmarkParams{ { "size", size }, { "image", "grey" }, { "threads", std::to_string(threads) } },
+            rows * cols, [&]()
+        {
+            remap(grey, greyMasked, table, options);
+            doNotOptimize(greyOut(rows / 2, cols / 2));
+        });
+        runner.measure("Rectification.Remap", BenchmarkParams{ { "size", size }, { "image", "color" }, { "threads", std::to_string(threads) } },
+            rows * cols, [&]()
+        {
+            remap(color, colorMasked, table, options);
+            doNotOptimize(colorOut(rows / 2, cols / 2, 1));
+        });
+        runner.measure("Rectification.Remap", BenchmarkParams{ { "size", size }, { "image", "uint8" }, { "threads", std::to_string(threads) } },
+            rows * cols, [&]()
+        {
+            remap(bytes, bytesOut, &mask, table, options);
+            doNotOptimize(bytesOut(rows / 2, cols / 2));
+        });
+
+        // Separate undistortion and rectification passes against one pass of combined table
+        RemapTable undistortionTable{ undistortion, rows, cols, rows, cols, Vector2f{}, options };
+        RemapTable combinedTable{ undistortRectify, rows, cols, rows, cols, Vector2f{}, options };
+        GreyScaleImage undistorted{ rows, cols };
+        MaskedImage<GreyScaleImage> undistortedMasked{ undistorted };
+        runner.measure("Rectification.UndistortRectify", BenchmarkParams{ { "size", size }, { "passes", "2" },
+            { "threads", std::to_string(threads) } }, rows * cols, [&]()
+        {
+            remap(grey, undistortedMasked, undistortionTable, options);
+            remap(undistorted, greyMasked, table, options);
+            doNotOptimize(greyOut(rows / 2, cols / 2));
+        });
+        runner.measure("Rectification.UndistortRectify", BenchmarkParams{ { "size", size }, { "passes", "1" },
+            { "threads", std::to_string(threads) } }, rows * cols, [&]()
+        {
+            remap(grey, greyMasked, combinedTable, options);
+            doNotOptimize(greyOut(rows / 2, cols / 2));
+        });
+
+        // Start of worker with valid cache: file is mapped and table validated, not built
+        if(runner.isEnabled("Rectification.LoadCachedTable"))
+        {
+            const std::string cachePath = "CamBenchmarks.remap";
+            Homography h = createRectification();
+            std::uint64_t key = getRemapCacheKey(distortionModel, h, rows, cols, rows, cols, Vector2f{});
+            writeRemapTable(cachePath, combinedTable, key);
+            runner.measure("Rectification.LoadCachedTable", BenchmarkParams{ { "size", size } }, rows * cols, [&]()
+            {
+                io::Loaded<RemapTable> loaded = getUndistortRectifyTable(cachePath, distortionModel, h, rows, cols, rows, cols);
+                doNotOptimize(loaded.value.getSourceX()(rows / 2, cols / 2));
+            });
+            std::remove(cachePath.c_str());
+        }
+    }
+}
+}
@@ -0,0 +1,271 @@
+#include "Benchmark.hpp"
+#include <CamDisparityRefinement/AnisotropicDiffusion.hpp>
+#include <CamDisparityRefinement/DisparityRefinementPipeline.hpp>
+#include <CamDisparityRefinement/HoleFillingRefiner.hpp>
+#include <CamDisparityRefinement/MedianFilterRefiner.hpp>
+#include <CamDisparityRefinement/PeakRemovalRefiner.hpp>
+#include <CamDisparityRefinement/RowRefiners.hpp>
+#include <CamDisparityRefinement/SegmentPlaneRefiner.hpp>
+#include <CamCommon/ThreadPool.hpp>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace cam3d
+{
+namespace benchmarks
+{
+    namespace
+    {
+        // Piecewise smooth disparities with noise and some invalid and low-confidence ones,
+        // right map consistent with left one
+        void fillMaps(DisparityMap& left, DisparityMap& right)
+        {
+            std::mt19937 generator{ 11 };
+            std::uniform_real_distribution<double> noise{ -0.4, 0.4 };
+            std::uniform_real_distribution<double> confidence{ 0.0, 1.0 };
+            int rows = left.getRowCount(), cols = left.getColumnCount();
+            for(int r = 0; r < rows; ++r)
+            {
+                for(int c = 0; c < cols; ++c)
+                {
+                    double subDx = -(20.0 + ((r / 64 + c / 96) % 5) * 4.0) + noise(generator);
+                    bool valid = c >= 48 && confidence(generator) > 0.03;
+                    left(r, c) = Disparity{ static_cast<int>(std::lround(subDx)), valid ? Disparity::Valid : Disparity::Invalid,
+                        subDx, 0.1, confidence(generator) };
+                    right(r, c) = Disparity{ 0, Disparity::Invalid };
+                }
+            }
+            for(int r = 0; r < rows; ++r)
+            {
+                for(int c = 0; c < cols; ++c)
+                {
+                    const Disparity& d = left(r, c);
+                    int x = c + d.dx;
+                    if(d.flags == Disparity::Valid && x >= 0 && x < cols)
+                    {
+                        right(r, x) = Disparity{ -d.dx, Disparity::Valid, -d.subDx, d.cost, d.confidence };
+                    }
+                }
+            }
+        }
+
+        // Chain of refiners as in managed DisparityRefinement, added to 'pipeline' one by one
+        void addChain(DisparityRefinementPipeline& pipeline, int stage)
+        {
+            switch(stage)
+            {
+            case 0: pipeline.add<LimitRangeRefiner>().maxDisparity = 64; break;
+            case 1: pipeline.add<InvalidateLowConfidenceRefiner>().confidenceThreshold = 0.1; break;
+            case 2: pipeline.add<MedianFilterRefiner>(); break;
+            case 3: pipeline.add<PeakRemovalRefiner>().minSegmentSize = 50; break;
+            case 4: pipeline.add<CrossCheckRefiner>(); break;
+            }
+        }
+        constexpr int chainLength = 5;
+        // Stages of chain which pipeline fuses into one pass: limit range, low confidence, cross check
+        const std::array<int, 3> rowLocalStages{ { 0, 1, 4 } };
+
+        void benchmarkRefinementPipeline(BenchmarkRunner& runner)
+        {
+            const BenchmarkConfig& config = runner.getConfig();
+            const int rows = config.rows;
+            const int cols = config.cols;
+
+            DisparityMap sourceLeft{ rows, cols }, sourceRight{ rows, cols };
+            fillMaps(sourceLeft, sourceRight);
+            DisparityMap left{ rows, cols }, right{ rows, cols };
+
+            int threads = config.threads > 0 ? config.threads : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+            ThreadPool pool{ static_cast<std::size_t>(threads) };
+            ParallelForOptions options;
+            options.pool = &pool;
+            options.maxTasks = threads;
+
+            DisparityRefinementPipeline fused{ options };
+            std::vector<std::unique_ptr<DisparityRefinementPipeline>> separate;
+            for(int stage = 0; stage < chainLength; ++stage)
+            {
+                addChain(fused, stage);
+                separate.emplace_back(new DisparityRefinementPipeline{ options });
+                addChain(*separate.back(), stage);
+            }
+
+            BenchmarkParams params{ { "size", std::to_string(cols) + "x" + std::to_string(rows) },
+                { "stages", std::to_string(chainLength) }, { "threads", std::to_string(threads) } };
+
+            // Copies of source maps are included in both, as managed refiners clone map
+            runner.measure("Refinement.Fused", params, rows * cols, [&]()
+            {
+                left = sourceLeft;
+                right = sourceRight;
+                fused.refine(left, &right);
+                doNotOptimize(left(rows / 2, cols / 2).subDx);
+            });
+            runner.measure("Refinement.SeparatePasses", params, rows * cols, [&]()
+            {
+                left = sourceLeft;
+                right = sourceRight;
+                for(auto& pipeline : separate)
+                {
+                    pipeline->refine(left, &right);
+                }
+                doNotOptimize(left(rows / 2, cols / 2).subDx);
+            });
+
+            // Only stages which are fused (row-local ones): in the whole chain median filter and copies
+            // of maps take most of the time and hide what fusing saves. Maps are restored before each
+            // call outside of measured time, as stages invalidate most of them
+            DisparityRefinementPipeline fusedRowLocal{ options };
+            std::vector<std::unique_ptr<DisparityRefinementPipeline>> separateRowLocal;
+            for(int stage : rowLocalStages)
+            {
+                addChain(fusedRowLocal, stage);
+                separateRowLocal.emplace_back(new DisparityRefinementPipeline{ options });
+                addChain(*separateRowLocal.back(), stage);
+            }
+            BenchmarkParams rowLocalParams{ { "size", std::to_string(cols) + "x" + std::to_string(rows) },
+                { "stages", std::to_string(rowLocalStages.size()) }, { "threads", std::to_string(threads) } };
+            auto restoreMaps = [&]()
+            {
+                left = sourceLeft;
+                right = sourceRight;
+            };
+
+            runner.measure("Refinement.FusedRowLocal", rowLocalParams, rows * cols, restoreMaps, [&]()
+            {
+                fusedRowLocal.refine(left, &right);
+                doNotOptimize(left(rows / 2, cols / 2).subDx);
+            });
+            runner.measure("Refinement.SeparateRowLocal", rowLocalParams, rows * cols, restoreMaps, [&]()
+            {
+                for(auto& pipeline : separateRowLocal)
+                {
+                    pipeline->refine(left, &right);
+                }
+                doNotOptimize(left(rows / 2, cols / 2).subDx);
+            });
+
+            PeakRemovalRefiner peakRemoval;
+            peakRemoval.minSegmentSize = 50;
+            peakRemoval.interpolateInvalidated = true;
+            BenchmarkParams peakParams{ { "size", std::to_string(cols) + "x" + std::to_string(rows) },
+                { "min_segment", std::to_string(peakRemoval.minSegmentSize) }, { "threads", std::to_string(threads) } };
+            runner.measure("Refinement.PeakRemoval", peakParams, rows * cols, [&]()
+            {
+                left = sourceLeft;
+                peakRemoval.refineMap(left, options);
+                doNotOptimize(left(rows / 2, cols / 2).subDx);
+            });
+
+            SegmentPlaneRefiner segmentPlanes;
+            BenchmarkParams segmentParams{ { "size", std::to_string(cols) + "x" + std::to_string(rows) },
+                { "min_segment", std::to_string(segmentPlanes.minSegmentSize) },
+                { "fit_iterations", std::to_string(segmentPlanes.fitIterations) }, { "threads", std::to_string(threads) } };
+            runner.measure("Refinement.SegmentPlanes", segmentParams, rows * cols, [&]()
+            {
+                left = sourceLeft;
+                segmentPlanes.refineMap(left, options);
+                doNotOptimize(left(rows / 2, cols / 2).subDx);
+            });
+
+            // Guide with edges where disparity changes
+            GreyScaleImage guide{ rows, cols };
+            for(int r = 0; r < rows; ++r)
+            {
+                for(int c = 0; c < cols; ++c)
+                {
+                    guide(r, c) = ((r / 64 + c / 96) % 5) * 0.2;
+                }
+            }
+            struct FillMode { const char* name; bool weighted; const GreyScaleImage* guide; };
+            for(FillMode mode : { FillMode{ "scanline", false, nullptr }, FillMode{ "weighted", true, nullptr },
+                FillMode{ "guided", true, &guide } })
+            {
+                HoleFillingRefiner holeFilling;
+                holeFilling.weightedFill = mode.weighted;
+                BenchmarkParams fillParams{ { "size", std::to_string(cols) + "x" + std::to_string(rows) },
+                    { "mode", mode.name }, { "threads", std::to_string(threads) } };
+                runner.measure("Refinement.HoleFilling", fillParams, rows * cols, [&]()
+                {
+                    left = sourceLeft;
+                    holeFilling.refineMap(left, mode.guide, options);
+                    doNotOptimize(left(rows / 2, cols / 2).subDx);
+                });
+            }
+        }
+
+        // Full-frame sweep per iteration (one iteration per tile, whole rows) against tiles
+        // running several iterations while they are in cache
+        void benchmarkAnisotropicDiffusion(BenchmarkRunner& runner)
+        {
+            const BenchmarkConfig& config = runner.getConfig();
+            const int rows = config.rows;
+            const int cols = config.cols;
+            constexpr int iterations = 16;
+            int threads = config.threads > 0 ? config.threads : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+            ThreadPool pool{ static_cast<std::size_t>(threads) };
+            ParallelForOptions options;
+            options.pool = &pool;
+            options.maxTasks = threads;
+
+            std::mt19937 generator{ 13 };
+            std::uniform_real_distribution<float> noise{ -4.0f, 4.0f };
+            Array2d<float> source{ rows, cols };
+            for(int r = 0; r < rows; ++r)
+            {
+                for(int c = 0; c < cols; ++c)
+                {
+                    source(r, c) = static_cast<float>(((r / 90 + c / 120) % 4) * 40) + noise(generator);
+                }
+            }
+            Array2d<float> plane{ rows, cols };
+
+            struct Layout { int tileRows; int tileCols; int iterationsPerTile; };
+            for(Layout layout : { Layout{ 16, cols, 1 }, Layout{ 64, 256, 4 }, Layout{ 64, 256, 8 } })
+            {
+                for(DiffusionKernel kernel : { DiffusionKernel::Exponential, DiffusionKernel::Rational })
+                {
+                    AnisotropicDiffusionParams params;
+                    params.iterations = iterations;
+                    params.kernelCoeff = 8.0f;
+                    params.kernel = kernel;
+                    params.tileRows = layout.tileRows;
+                    params.tileCols = layout.tileCols;
+                    params.iterationsPerTile = layout.iterationsPerTile;
+
+                    BenchmarkParams benchmarkParams{ { "size", std::to_string(cols) + "x" + std::to_string(rows) },
+                        { "iterations", std::to_string(iterations) },
+                        { "kernel", kernel == DiffusionKernel::Exponential ? "exponential" : "rational" },
+                        { "tile", std::to_string(layout.tileCols) + "x" + std::to_string(layout.tileRows) },
+                        { "per_tile", std::to_string(layout.iterationsPerTile) }, { "threads", std::to_string(threads) } };
+                    runner.measure("Refinement.AnisotropicDiffusion", benchmarkParams, static_cast<double>(rows) * cols * iterations, [&]()
+                    {
+                        plane = source;
+                        anisotropicDiffusion(plane, nullptr, nullptr, params, options);
+                        doNotOptimize(plane(rows / 2, cols / 2));
+                    });
+                }
+            }
+        }
+    }
+
+    void runRefinementBenchmarks(BenchmarkRunner& runner)
+    {
+        if(runner.isEnabled("Refinement.Fused") || runner.isEnabled("Refinement.SeparatePasses")
+            || runner.isEnabled("Refinement.FusedRowLocal") || runner.isEnabled("Refinement.SeparateRowLocal") || runner.isEnabled("Refinement.PeakRemoval")
+            || runner.isEnabled("Refinement.SegmentPlanes") || runner.isEnabled("Refinement.HoleFilling"))
+        {
+            benchmarkRefinementPipeline(runner);
+        }
+        if(runner.isEnabled("Refinement.AnisotropicDiffusion"))
+        {
+            benchmarkAnisotropicDiffusion(runner);
+        }
+    }
+}
+}
@@ -0,0 +1,412 @@
+#include "ScalingBenchmark.hpp"
+#include "Benchmark.hpp"
+#include <CamCommon/FrameArena.hpp>
+#include <CamCommon/MemoryAccounting.hpp>
+#include <CamCommon/Profiler.hpp>
+#include <CamCommon/ThreadPool.hpp>
+#include <CamImageMatching/SgmMemory.hpp>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__linux__)
+#include <sys/resource.h>
+#endif
+
+namespace cam3d
+{
+namespace benchmarks
+{
+    namespace
+    {
+        // Peak resident set is reset before each run when OS allows it (Linux), otherwise
+        // reported value is peak of whole process so far
+        void resetPeakRss()
+        {
+#if defined(__linux__)
+            std::ofstream clearRefs{ "/proc/self/clear_refs" };
+            clearRefs << "5";
+#endif
+        }
+
+        double getPeakRssMb()
+        {
+#if defined(_WIN32)
+            PROCESS_MEMORY_COUNTERS counters;
+            GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+            return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+#elif defined(__linux__)
+            std::ifstream status{ "/proc/self/status" };
+            std::string line;
+            while(std::getline(status, line))
+            {
+                if(line.compare(0, 6, "VmHWM:") == 0)
+                {
+                    return std::stod(line.substr(6)) / 1024.0;
+                }
+            }
+            rusage usage;
+            getrusage(RUSAGE_SELF, &usage);
+            return usage.ru_maxrss / 1024.0;
+#else
+            return 0.0;
+#endif
+        }
+
+        const char* toString(MatchingCostType cost)
+        {
+            return cost == MatchingCostType::Census ? "census" : "hmi";
+        }
+
+        const char* toString(SceneTexture texture)
+        {
+            return texture == SceneTexture::RandomDot ? "random_dot" : "textured";
+        }
+
+        SgmParameters createParameters(const Resolution& resolution, int maxDisparity, int threads,
+            MatchingCostType cost, int censusRadius)
+        {
+            SgmParameters params{};
+            params.rows = resolution.rows;
+            params.cols = resolution.cols;
+            params.imageType = ImageType::Grey;
+            params.isLeftImageBase = true;
+            params.maxParallelTasks = threads;
+            params.maxDisparity = maxDisparity;
+            params.lowPenaltyCoeff = 0.02;
+            params.highPenaltyCoeff = 0.04;
+            params.intensityThreshold = 0.1;
+            params.censusMaskRadius = censusRadius;
+            params.matchingCostType = cost;
+            params.hmiLevels = 3;
+            params.disparityMeanMethod = MeanMethod::SimpleAverage;
+            params.disparityCostMethod = CostMethod::DistanceToMean;
+            params.diparityPathLengthThreshold = 3;
+            params.costMethodPower = 2.0;
+            return params;
+        }
+
+        ScalingResult runOne(const ScalingConfig& config, SyntheticStereoPair& pair, const Resolution& resolution,
+            int maxDisparity, int threads, MatchingCostType cost, int censusRadius, SceneTexture texture)
+        {
+            SgmParameters params = createParameters(resolution, maxDisparity, threads, cost, censusRadius);
+            ThreadPool pool{ static_cast<std::size_t>(threads) };
+            DisparityMap mapLeft{ resolution.rows, resolution.cols };
+            DisparityMap mapRight{ resolution.rows, resolution.cols };
+
+            SgmExecutionPlan plan{ SgmExecutionStrategy::WholeImage, resolution.rows, 0, estimateSgmMemory(params).total, true };
+            if(config.budgetBytes > 0)
+            {
+                plan = planSgmExecution(params, config.budgetBytes);
+            }
+
+            // Kept across repeats as by video pipeline: from second frame on, temporaries come from its blocks
+            memory::FrameArena arena;
+            std::vector<double> times;
+            double peakRssMb = 0.0;
+            std::size_t accountedPeak = 0;
+            for(int i = 0; i < std::max(1, config.repeats); ++i)
+            {
+                resetPeakRss();
+                memory::resetPeak();
+                auto start = std::chrono::steady_clock::now();
+                std::unique_ptr<ISgmCostAggregator> sgm{ config.budgetBytes > 0 ?
+                    createSgmWithinBudget(params, mapLeft, mapRight, &pair.left, &pair.right, config.budgetBytes, &pool) :
+                    createSgm(params, mapLeft, mapRight, &pair.left, &pair.right, &pool, &arena) };
+                sgm->computeMatchingCosts();
+                times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+                sgm.reset();
+                arena.reset();
+                peakRssMb = std::max(peakRssMb, getPeakRssMb());
+                accountedPeak = std::max(accountedPeak, memory::getPeakBytes());
+            }
+            std::sort(times.begin(), times.end());
+
+            ScalingResult result;
+            result.resolution = resolution;
+            result.maxDisparity = maxDisparity;
+            result.threads = threads;
+            result.cost = cost;
+            result.censusRadius = censusRadius;
+            result.texture = texture;
+            result.msPerFrame = times[times.size() / 2];
+            result.mpixDisparitiesPerSecond = 1e-6 * resolution.rows * resolution.cols * maxDisparity / (result.msPerFrame * 1e-3);
+            result.peakRssMb = peakRssMb;
+            result.estimatedMb = plan.peakBytes / (1024.0 * 1024.0);
+            result.accountedPeakMb = accountedPeak / (1024.0 * 1024.0);
+            result.bandRows = plan.bandRows;
+            result.accuracy = evaluateDisparity(mapLeft, pair.groundTruth, config.badThreshold, censusRadius);
+            return result;
+        }
+
+        std::vector<std::string> split(const std::string& text)
+        {
+            std::vector<std::string> items;
+            std::stringstream stream{ text };
+            std::string item;
+            while(std::getline(stream, item, ','))
+            {
+                items.push_back(item);
+            }
+            if(items.empty())
+            {
+                throw std::invalid_argument("Empty list: " + text);
+            }
+            return items;
+        }
+
+        std::vector<int> parseIntList(const std::string& text)
+        {
+            std::vector<int> values;
+            for(const std::string& item : split(text))
+            {
+                values.push_back(std::stoi(item));
+            }
+            return values;
+        }
+
+        Resolution parseResolution(const std::string& text)
+        {
+            static const Resolution presets[] = {
+                { "vga", 480, 640 }, { "hd", 720, 1280 }, { "fullhd", 1080, 1920 }, { "4k", 2160, 3840 }, { "8k", 4320, 7680 }
+            };
+            for(const Resolution& preset : presets)
+            {
+                if(preset.name == text)
+                {
+                    return preset;
+                }
+            }
+            std::size_t separator = text.find('x');
+            if(separator == std::string::npos)
+            {
+                throw std::invalid_argument("Resolution must be preset name or WIDTHxHEIGHT: " + text);
+            }
+            return Resolution{ text, std::stoi(text.substr(separator + 1)), std::stoi(text.substr(0, separator)) };
+        }
+
+        void printUsage()
+        {
+            std::cerr <<
+                "Usage: CamBenchmarks scaling [options]\n"
+                "  --resolutions A,B,.. vga, hd, fullhd, 4k, 8k or WIDTHxHEIGHT (default vga)\n"
+                "  --disparities A,B,.. disparity ranges (default 64)\n"
+                "  --threads A,B,..     thread counts (default 1)\n"
+                "  --costs A,B,..       census, hmi (default census)\n"
+                "  --radii A,B,..       census radii (default 3)\n"
+                "  --textures A,B,..    random_dot, textured (default both)\n"
+                "  --objects N          slanted objects in front of background (default 4)\n"
+                "  --noise SIGMA        image noise, intensities are in [0, 1] (default 0.01)\n"
+                "  --repeats N          runs of each configuration, median is reported (default 3)\n"
+                "  --bad-threshold T    disparity error counted as bad pixel (default 1)\n"
+                "  --tag TEXT           label stored in results context\n"
+                "  --out PATH           write JSON to PATH instead of stdout\n"
+                "  --trace PATH         write Chrome trace of all runs (build with CAM3D_ENABLE_TRACING)\n"
+                "  --budget-mb N        match within memory budget, in bands of rows if needed\n";
+        }
+
+        ScalingConfig parseArguments(int argc, char** argv)
+        {
+            ScalingConfig config;
+            for(int i = 1; i < argc; ++i)
+            {
+                std::string arg = argv[i];
+                if(arg == "--help" || arg == "-h")
+                {
+                    printUsage();
+                    std::exit(0);
+                }
+                if(i + 1 >= argc)
+                {
+                    throw std::invalid_argument("Missing value for " + arg);
+                }
+                std::string value = argv[++i];
+
+                if(arg == "--resolutions")
+                {
+                    config.resolutions.clear();
+                    for(const std::string& item : split(value)) { config.resolutions.push_back(parseResolution(item)); }
+                }
+                else if(arg == "--costs")
+                {
+                    config.costs.clear();
+                    for(const std::string& item : split(value))
+                    {
+                        if(item == "census") { config.costs.push_back(MatchingCostType::Census); }
+                        else if(item == "hmi") { config.costs.push_back(MatchingCostType::HierarchicalMutualInformation); }
+                        else { throw std::invalid_argument("Unknown cost " + item); }
+                    }
+                }
+                else if(arg == "--textures")
+                {
+                    config.textures.clear();
+                    for(const std::string& item : split(value))
+                    {
+                        if(item == "random_dot") { config.textures.push_back(SceneTexture::RandomDot); }
+                        else if(item == "textured") { config.textures.push_back(SceneTexture::Textured); }
+                        else { throw std::invalid_argument("Unknown texture " + item); }
+                    }
+                }
+                else if(arg == "--disparities") { config.disparities = parseIntList(value); }
+                else if(arg == "--threads") { config.threads = parseIntList(value); }
+                else if(arg == "--radii") { config.radii = parseIntList(value); }
+                else if(arg == "--objects") { config.objectsCount = std::stoi(value); }
+                else if(arg == "--noise") { config.noiseSigma = std::stod(value); }
+                else if(arg == "--repeats") { config.repeats = std::stoi(value); }
+                else if(arg == "--bad-threshold") { config.badThreshold = std::stod(value); }
+                else if(arg == "--tag") { config.tag = value; }
+                else if(arg == "--out") { config.outputPath = value; }
+                else if(arg == "--trace") { config.tracePath = value; }
+                else if(arg == "--budget-mb") { config.budgetBytes = static_cast<std::size_t>(std::stod(value) * 1024 * 1024); }
+                else { throw std::invalid_argument("Unknown option " + arg); }
+            }
+            return config;
+        }
+    }
+
+    std::vector<ScalingResult> runScalingBenchmark(const ScalingConfig& config, std::ostream& progress)
+    {
+        std::vector<ScalingResult> results;
+        for(const Resolution& resolution : config.resolutions)
+        {
+            for(int maxDisparity : config.disparities)
+            {
+                if(maxDisparity >= resolution.cols / 2)
+                {
+                    continue;
+                }
+                for(SceneTexture texture : config.textures)
+                {
+                    SceneConfig scene{ resolution.rows, resolution.cols, maxDisparity, texture,
+                        config.objectsCount, config.noiseSigma, 17u };
+                    SyntheticStereoPair pair = generateStereoPair(scene);
+
+                    for(MatchingCostType cost : config.costs)
+                    {
+                        // Census radius does not change HMI matching
+                        std::vector<int> radii = cost == MatchingCostType::Census ?
+                            config.radii : std::vector<int>{ config.radii.front() };
+                        for(int radius : radii)
+                        {
+                            for(int threads : config.threads)
+                            {
+                                results.push_back(runOne(config, pair, resolution, maxDisparity, threads, cost, radius, texture));
+                                const ScalingResult& r = results.back();
+                                progress << std::left << std::setw(8) << resolution.name
+                                    << " D=" << std::setw(4) << maxDisparity << " " << std::setw(10) << toString(texture)
+                                    << " " << std::setw(6) << toString(cost) << " r=" << radius
+                                    << " threads=" << std::setw(3) << threads << std::right << std::fixed
+                                    << std::setprecision(1) << std::setw(10) << r.msPerFrame << " ms"
+                                    << std::setw(9) << r.mpixDisparitiesPerSecond << " MPix*D/s"
+                                    << std::setw(9) << r.peakRssMb << " MB"
+                                    << std::setw(9) << r.accountedPeakMb << "/" << r.estimatedMb << " MB est"
+                                    << std::setprecision(2) << std::setw(7) << 100.0 * r.accuracy.badPixelRate << "% bad\n";
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        return results;
+    }
+
+    void writeScalingJson(std::ostream& stream, const ScalingConfig& config, const std::vector<ScalingResult>& results)
+    {
+        stream << std::setprecision(10);
+        stream << "{\n  \"context\": {\n";
+        stream << "    \"date\": \"" << getUtcDate() << "\",\n";
+        stream << "    \"tag\": \"" << escapeJson(config.tag) << "\",\n";
+        stream << "    \"compiler\": \"" << escapeJson(getCompilerName()) << "\",\n";
+        stream << "    \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n";
+        stream << "    \"objects\": " << config.objectsCount << ",\n";
+        stream << "    \"noise_sigma\": " << config.noiseSigma << ",\n";
+        stream << "    \"bad_threshold\": " << config.badThreshold << "\n";
+        stream << "  },\n  \"runs\": [\n";
+        for(std::size_t i = 0; i < results.size(); ++i)
+        {
+            const ScalingResult& r = results[i];
+            stream << "    {\"resolution\": \"" << escapeJson(r.resolution.name) << "\""
+                << ", \"rows\": " << r.resolution.rows
+                << ", \"cols\": " << r.resolution.cols
+                << ", \"max_disparity\": " << r.maxDisparity
+                << ", \"texture\": \"" << toString(r.texture) << "\""
+                << ", \"cost\": \"" << toString(r.cost) << "\""
+                << ", \"census_radius\": " << r.censusRadius
+                << ", \"threads\": " << r.threads
+                << ", \"ms_per_frame\": " << r.msPerFrame
+                << ", \"mpix_disparities_per_second\": " << r.mpixDisparitiesPerSecond
+                << ", \"peak_rss_mb\": " << r.peakRssMb
+                << ", \"accounted_peak_mb\": " << r.accountedPeakMb
+                << ", \"estimated_mb\": " << r.estimatedMb
+                << ", \"band_rows\": " << r.bandRows
+                << ", \"bad_pixel_rate\": " << r.accuracy.badPixelRate
+                << ", \"invalid_rate\": " << r.accuracy.invalidRate
+                << ", \"mean_abs_error\": " << r.accuracy.meanAbsoluteError
+                << ", \"evaluated_pixels\": " << r.accuracy.evaluatedPixels
+                << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        stream << "  ]\n}\n";
+    }
+
+    int scalingMain(int argc, char** argv)
+    {
+        ScalingConfig config;
+        try
+        {
+            config = parseArguments(argc, argv);
+        }
+        catch(const std::exception& e)
+        {
+            std::cerr << e.what() << "\n";
+            printUsage();
+            return 1;
+        }
+
+        if(!config.tracePath.empty() && !profiling::Tracer::isEnabled())
+        {
+            std::cerr << "Tracing is compiled out, rebuild with CAM3D_ENABLE_TRACING to get trace events\n";
+        }
+
+        std::vector<ScalingResult> results;
+        try
+        {
+            results = runScalingBenchmark(config, std::cerr);
+        }
+        catch(const std::runtime_error& e)
+        {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
+        if(!config.tracePath.empty())
+        {
+            std::ofstream trace{ config.tracePath };
+            profiling::Tracer::exportChromeTrace(trace);
+        }
+        if(config.outputPath.empty())
+        {
+            writeScalingJson(std::cout, config, results);
+        }
+        else
+        {
+            std::ofstream file{ config.outputPath };
+            if(!file)
+            {
+                std::cerr << "Cannot open " << config.outputPath << "\n";
+                return 1;
+            }
+            writeScalingJson(file, config, results);
+        }
+        return 0;
+    }
+}
+}
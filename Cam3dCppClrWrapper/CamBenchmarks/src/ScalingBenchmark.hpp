@@ -0,0 +1,63 @@
+#pragma once
+
+#include "SyntheticStereo.hpp"
+#include <CamImageMatching/SgmCommon.hpp>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace cam3d
+{
+namespace benchmarks
+{
+    struct Resolution
+    {
+        std::string name;
+        int rows;
+        int cols;
+    };
+
+    struct ScalingConfig
+    {
+        std::vector<Resolution> resolutions{ { "vga", 480, 640 } };
+        std::vector<int> disparities{ 64 };
+        std::vector<int> threads{ 1 };
+        std::vector<MatchingCostType> costs{ MatchingCostType::Census };
+        std::vector<int> radii{ 3 };
+        std::vector<SceneTexture> textures{ SceneTexture::RandomDot, SceneTexture::Textured };
+        int objectsCount = 4;
+        double noiseSigma = 0.01;
+        int repeats = 3;
+        double badThreshold = 1.0;
+        std::string tag;
+        std::string outputPath;
+        std::string tracePath; // Chrome trace of all runs, needs build with CAM3D_ENABLE_TRACING
+        std::size_t budgetBytes = 0; // If not 0, matching uses createSgmWithinBudget()
+    };
+
+    struct ScalingResult
+    {
+        Resolution resolution;
+        int maxDisparity;
+        int threads;
+        MatchingCostType cost;
+        int censusRadius;
+        SceneTexture texture;
+        double msPerFrame;        // Median over repeats, createSgm() + computeMatchingCosts()
+        double mpixDisparitiesPerSecond;
+        double peakRssMb;         // Includes input images and output maps
+        double estimatedMb;       // estimateSgmMemory() or peak of plan within budget
+        double accountedPeakMb;   // memory::getPeakBytes() during run, includes input images and output maps
+        int bandRows;             // Rows of one band if matched in bands, otherwise all rows
+        AccuracyResult accuracy;  // Of left disparity map
+    };
+
+    // Runs createSgm() on synthetic pairs for all combinations of 'config' parameters
+    std::vector<ScalingResult> runScalingBenchmark(const ScalingConfig& config, std::ostream& progress);
+
+    void writeScalingJson(std::ostream& stream, const ScalingConfig& config, const std::vector<ScalingResult>& results);
+
+    // Entry of 'CamBenchmarks scaling [options]'
+    int scalingMain(int argc, char** argv);
+}
+}
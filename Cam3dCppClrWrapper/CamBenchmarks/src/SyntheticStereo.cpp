@@ -0,0 +1,226 @@
+#include "SyntheticStereo.hpp"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace cam3d
+{
+namespace benchmarks
+{
+    namespace
+    {
+        // Planar surface seen in left image: d(y, x) = a + b * x + c * y,
+        // covering rectangle [top, bottom) x [leftCol, rightCol) of left image
+        struct Surface
+        {
+            double a;
+            double b;
+            double c;
+            double top;
+            double bottom;
+            double leftCol;
+            double rightCol;
+            std::uint32_t textureSeed;
+
+            double disparityAt(double y, double x) const { return a + b * x + c * y; }
+
+            bool covers(double y, double x) const
+            {
+                return y >= top && y < bottom && x >= leftCol && x < rightCol;
+            }
+
+            // Left image column which projects onto right image column 'xr'
+            double leftColumnFor(double y, double xr) const { return (xr + a + c * y) / (1.0 - b); }
+        };
+
+        std::uint32_t hash(std::int32_t x, std::int32_t y, std::uint32_t seed)
+        {
+            std::uint32_t h = seed ^ (static_cast<std::uint32_t>(x) * 0x27d4eb2dU) ^ (static_cast<std::uint32_t>(y) * 0x165667b1U);
+            h ^= h >> 15;
+            h *= 0x2c1b3c6dU;
+            h ^= h >> 12;
+            h *= 0x297a2d39U;
+            h ^= h >> 15;
+            return h;
+        }
+
+        double latticeValue(std::int32_t x, std::int32_t y, std::uint32_t seed)
+        {
+            return (hash(x, y, seed) & 0xFFFF) / 65535.0;
+        }
+
+        // Bilinearly interpolated lattice noise, lattice spacing is 'scale' pixels
+        double valueNoise(double y, double x, double scale, std::uint32_t seed)
+        {
+            double u = x / scale, v = y / scale;
+            double fu = std::floor(u), fv = std::floor(v);
+            std::int32_t iu = static_cast<std::int32_t>(fu), iv = static_cast<std::int32_t>(fv);
+            double tu = u - fu, tv = v - fv;
+            double top = latticeValue(iu, iv, seed) * (1.0 - tu) + latticeValue(iu + 1, iv, seed) * tu;
+            double bottom = latticeValue(iu, iv + 1, seed) * (1.0 - tu) + latticeValue(iu + 1, iv + 1, seed) * tu;
+            return top * (1.0 - tv) + bottom * tv;
+        }
+
+        // Texture is attached to surface: it is sampled at left image coordinates of surface point
+        double textureAt(SceneTexture texture, const Surface& surface, double y, double xl)
+        {
+            if(texture == SceneTexture::RandomDot)
+            {
+                return valueNoise(y, xl, 1.0, surface.textureSeed);
+            }
+            return 0.5 * valueNoise(y, xl, 8.0, surface.textureSeed) +
+                0.3 * valueNoise(y, xl, 4.0, surface.textureSeed + 1) +
+                0.2 * valueNoise(y, xl, 2.0, surface.textureSeed + 2);
+        }
+
+        std::vector<Surface> createSurfaces(const SceneConfig& config, std::mt19937& generator)
+        {
+            double D = config.maxDisparity;
+            std::vector<Surface> surfaces;
+
+            // Background: slanted plane in range [0.15D, 0.45D]
+            surfaces.push_back(Surface{
+                0.15 * D, 0.2 * D / config.cols, 0.1 * D / config.rows,
+                0.0, static_cast<double>(config.rows), -1e9, 1e9, static_cast<std::uint32_t>(generator()) });
+
+            std::uniform_real_distribution<double> unit{ 0.0, 1.0 };
+            for(int i = 0; i < config.objectsCount; ++i)
+            {
+                double width = config.cols * (0.125 + 0.2 * unit(generator));
+                double height = config.rows * (0.125 + 0.2 * unit(generator));
+                double left = (config.cols - width) * unit(generator);
+                double top = (config.rows - height) * unit(generator);
+                // Disparity at center in [0.5D, 0.8D], change across object at most 0.1D
+                double slopeX = (unit(generator) - 0.5) * 0.2 * D / width;
+                double slopeY = (unit(generator) - 0.5) * 0.2 * D / height;
+                double center = D * (0.5 + 0.3 * unit(generator));
+                double a = center - slopeX * (left + width * 0.5) - slopeY * (top + height * 0.5);
+                surfaces.push_back(Surface{ a, slopeX, slopeY, top, top + height, left, left + width, static_cast<std::uint32_t>(generator()) });
+            }
+            return surfaces;
+        }
+
+        // Returns index of closest surface visible at left image pixel
+        int findVisibleInLeft(const std::vector<Surface>& surfaces, double y, double x)
+        {
+            int best = 0;
+            double bestDisparity = surfaces[0].disparityAt(y, x);
+            for(int i = 1; i < static_cast<int>(surfaces.size()); ++i)
+            {
+                if(surfaces[i].covers(y, x) && surfaces[i].disparityAt(y, x) > bestDisparity)
+                {
+                    best = i;
+                    bestDisparity = surfaces[i].disparityAt(y, x);
+                }
+            }
+            return best;
+        }
+
+        // Returns index of closest surface visible at right image pixel and its left image column
+        int findVisibleInRight(const std::vector<Surface>& surfaces, double y, double xr, double& xl)
+        {
+            int best = 0;
+            xl = surfaces[0].leftColumnFor(y, xr);
+            double bestDisparity = surfaces[0].disparityAt(y, xl);
+            for(int i = 1; i < static_cast<int>(surfaces.size()); ++i)
+            {
+                double x = surfaces[i].leftColumnFor(y, xr);
+                if(surfaces[i].covers(y, x) && surfaces[i].disparityAt(y, x) > bestDisparity)
+                {
+                    best = i;
+                    xl = x;
+                    bestDisparity = surfaces[i].disparityAt(y, x);
+                }
+            }
+            return best;
+        }
+    }
+
+    SyntheticStereoPair generateStereoPair(const SceneConfig& config)
+    {
+        std::mt19937 generator{ config.seed };
+        std::vector<Surface> surfaces = createSurfaces(config, generator);
+        SyntheticStereoPair pair{ config.rows, config.cols };
+        std::normal_distribution<double> noise{ 0.0, config.noiseSigma };
+
+        for(int y = 0; y < config.rows; ++y)
+        {
+            for(int x = 0; x < config.cols; ++x)
+            {
+                int surface = findVisibleInLeft(surfaces, y, x);
+                double d = surfaces[surface].disparityAt(y, x);
+                pair.left(y, x) = textureAt(config.texture, surfaces[surface], y, x);
+
+                double xl;
+                double xr = x - d;
+                bool isVisibleInRight = xr >= 0.0 && findVisibleInRight(surfaces, y, xr, xl) == surface;
+                pair.groundTruth(y, x) = Disparity{ -static_cast<int>(std::round(d)),
+                    isVisibleInRight ? Disparity::Valid : Disparity::Occluded, -d, 0.0, 1.0 };
+            }
+            for(int x = 0; x < config.cols; ++x)
+            {
+                double xl;
+                int surface = findVisibleInRight(surfaces, y, x, xl);
+                pair.right(y, x) = textureAt(config.texture, surfaces[surface], y, xl);
+            }
+        }
+
+        if(config.noiseSigma > 0.0)
+        {
+            for(GreyScaleImage* image : { &pair.left, &pair.right })
+            {
+                for(int y = 0; y < config.rows; ++y)
+                {
+                    for(int x = 0; x < config.cols; ++x)
+                    {
+                        (*image)(y, x) = std::min(1.0, std::max(0.0, (*image)(y, x) + noise(generator)));
+                    }
+                }
+            }
+        }
+        return pair;
+    }
+
+    AccuracyResult evaluateDisparity(const DisparityMap& computed, const DisparityMap& groundTruth,
+        double badThreshold, int border)
+    {
+        int rows = groundTruth.getRowCount(), cols = groundTruth.getColumnCount();
+        int evaluated = 0, bad = 0, invalid = 0, valid = 0;
+        double errorSum = 0.0;
+        for(int y = border; y < rows - border; ++y)
+        {
+            for(int x = border; x < cols - border; ++x)
+            {
+                Disparity gt = groundTruth(y, x);
+                if(gt.flags != Disparity::Valid)
+                {
+                    continue;
+                }
+                ++evaluated;
+                Disparity d = computed(y, x);
+                if(d.flags != Disparity::Valid)
+                {
+                    ++invalid;
+                    ++bad;
+                    continue;
+                }
+                double error = std::abs(d.dx - gt.subDx);
+                errorSum += error;
+                ++valid;
+                if(error > badThreshold)
+                {
+                    ++bad;
+                }
+            }
+        }
+
+        AccuracyResult result;
+        result.evaluatedPixels = evaluated;
+        result.badPixelRate = evaluated > 0 ? static_cast<double>(bad) / evaluated : 0.0;
+        result.invalidRate = evaluated > 0 ? static_cast<double>(invalid) / evaluated : 0.0;
+        result.meanAbsoluteError = valid > 0 ? errorSum / valid : 0.0;
+        return result;
+    }
+}
+}
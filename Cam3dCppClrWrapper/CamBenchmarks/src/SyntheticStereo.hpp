@@ -0,0 +1,58 @@
+#pragma once
+
+#include <CamCommon/GreyScaleImage.hpp>
+#include <CamCommon/DisparityMap.hpp>
+#include <cstdint>
+
+namespace cam3d
+{
+namespace benchmarks
+{
+    enum class SceneTexture
+    {
+        RandomDot, // Independent intensity for each pixel - easy to match
+        Textured,  // Smooth multi-scale texture - weak texture areas
+    };
+
+    struct SceneConfig
+    {
+        int rows;
+        int cols;
+        int maxDisparity;
+        SceneTexture texture;
+        int objectsCount;    // Slanted rectangles in front of slanted background
+        double noiseSigma;   // Gaussian noise added to both images
+        std::uint32_t seed;
+    };
+
+    // Rectified pair with known disparity of left image.
+    // Ground truth follows matcher convention: matched.x = base.x + dx, so dx <= 0.
+    // Pixels not visible in right image are marked Occluded.
+    struct SyntheticStereoPair
+    {
+        GreyScaleImage left;
+        GreyScaleImage right;
+        DisparityMap groundTruth;
+
+        SyntheticStereoPair(int rows, int cols) :
+            left{ rows, cols },
+            right{ rows, cols },
+            groundTruth{ rows, cols }
+        { }
+    };
+
+    SyntheticStereoPair generateStereoPair(const SceneConfig& config);
+
+    struct AccuracyResult
+    {
+        double badPixelRate;     // Non-occluded pixels with |dx - gt| > threshold or without disparity
+        double invalidRate;      // Non-occluded pixels without disparity
+        double meanAbsoluteError; // Over valid non-occluded pixels
+        int evaluatedPixels;
+    };
+
+    // Compares only pixels with distance at least 'border' from image edges
+    AccuracyResult evaluateDisparity(const DisparityMap& computed, const DisparityMap& groundTruth,
+        double badThreshold, int border);
+}
+}
@@ -0,0 +1,258 @@
+#include "Benchmark.hpp"
+#include <CamTriangulation/DenseTriangulation.hpp>
+#include <CamTriangulation/OptimalTriangulation.hpp>
+#include <CamTriangulation/PointCloudFile.hpp>
+#include <CamCommon/ThreadPool.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace cam3d
+{
+namespace benchmarks
+{
+    namespace
+    {
+        RectifiedStereoParameters createParameters(int rows, int cols)
+        {
+            return RectifiedStereoParameters{ 1400.0, 0.12, cols * 0.5, rows * 0.5, cols * 0.5 - 8.0 };
+        }
+
+        // Slanted planes with noise, ~10% invalid pixels in bands and at random
+        void fillMap(DisparityMap& map)
+        {
+            std::mt19937 generator{ 17 };
+            std::uniform_real_distribution<double> uniform{ 0.0, 1.0 };
+            int rows = map.getRowCount(), cols = map.getColumnCount();
+            for(int r = 0; r < rows; ++r)
+            {
+                for(int c = 0; c < cols; ++c)
+                {
+                    double subDx = -(24.0 + ((r / 128 + c / 160) % 6) * 10.0 + c * 0.01) + (uniform(generator) - 0.5) * 0.8;
+                    bool valid = c >= 64 && uniform(generator) > 0.05;
+                    map(r, c) = Disparity{ static_cast<int>(std::lround(subDx)), valid ? Disparity::Valid : Disparity::Invalid,
+                        subDx, 0.1, uniform(generator) };
+                }
+            }
+        }
+
+        struct Point
+        {
+            double x, y, z;
+        };
+
+        // As managed TriangulationLink with TwoPointsTriangulation in Rectified mode: each valid
+        // pixel is triangulated on its own and point is appended to list
+        void triangulatePerPoint(const DisparityMap& map, const RectifiedStereoParameters& p, std::vector<Point>& points)
+        {
+            points.clear();
+            for(int r = 0; r < map.getRowCount(); ++r)
+            {
+                for(int c = 0; c < map.getColumnCount(); ++c)
+                {
+                    const Disparity& d = map(r, c);
+                    if(d.flags != Disparity::Valid) { continue; }
+                    double z = -p.focalLength * p.baseline / (d.subDx + p.principalX - p.principalXRight);
+                    points.push_back(Point{ z * (c - p.principalX) / p.focalLength, -z * (r - p.principalY) / p.focalLength, z });
+                }
+            }
+        }
+
+        // P = K[R|t] with R rotating by 'yaw' about y axis
+        CameraMatrix createCamera(double focalLength, double principalX, double principalY, double yaw, double tx, double tz)
+        {
+            double c = std::cos(yaw), s = std::sin(yaw);
+            double rt[3][4] = { { c, 0.0, s, tx }, { 0.0, 1.0, 0.0, 0.0 }, { -s, 0.0, c, tz } };
+            double k[3][3] = { { focalLength, 0.0, principalX }, { 0.0, focalLength, principalY }, { 0.0, 0.0, 1.0 } };
+            CameraMatrix camera;
+            for(int i = 0; i < 3; ++i)
+            {
+                for(int j = 0; j < 4; ++j)
+                {
+                    camera.p[i][j] = k[i][0] * rt[0][j] + k[i][1] * rt[1][j] + k[i][2] * rt[2][j];
+                }
+            }
+            return camera;
+        }
+
+        Vector2f project(const CameraMatrix& camera, double x, double y, double z)
+        {
+            const double (&p)[3][4] = camera.p;
+            double w = p[2][0] * x + p[2][1] * y + p[2][2] * z + p[2][3];
+            return Vector2f{ (p[0][0] * x + p[0][1] * y + p[0][2] * z + p[0][3]) / w,
+                (p[1][0] * x + p[1][1] * y + p[1][2] * z + p[1][3]) / w };
+        }
+
+        // Points of random scene in front of both cameras, projected with ~0.5 pixel noise
+        void createMatches(const CameraMatrix& left, const CameraMatrix& right, int count,
+            std::vector<Vector2f>& leftPoints, std::vector<Vector2f>& rightPoints)
+        {
+            std::mt19937 generator{ 23 };
+            std::uniform_real_distribution<double> uniform{ -1.0, 1.0 };
+            std::normal_distribution<double> noise{ 0.0, 0.5 };
+            leftPoints.resize(count);
+            rightPoints.resize(count);
+            for(int i = 0; i < count; ++i)
+            {
+                double z = 3.0 + 1.5 * uniform(generator);
+                double x = 0.4 * z * uniform(generator), y = 0.3 * z * uniform(generator);
+                Vector2f l = project(left, x, y, z), r = project(right, x, y, z);
+                leftPoints[i] = Vector2f{ l.x + noise(generator), l.y + noise(generator) };
+                rightPoints[i] = Vector2f{ r.x + noise(generator), r.y + noise(generator) };
+            }
+        }
+
+        void runOptimalTriangulationBenchmarks(BenchmarkRunner& runner, const ParallelForOptions& options, int threads)
+        {
+            constexpr int count = 20000;
+            CameraMatrix left = createCamera(1400.0, 960.0, 540.0, 0.0, 0.0, 0.0);
+            CameraMatrix right = createCamera(1400.0, 960.0, 540.0, -0.06, -0.25, 0.02);
+            std::vector<Vector2f> leftPoints, rightPoints;
+            createMatches(left, right, count, leftPoints, rightPoints);
+
+            OptimalTriangulator triangulator{ left, right };
+            std::vector<TriangulatedPoint> points(count);
+            runner.measure("Triangulation.Optimal", BenchmarkParams{ { "points", std::to_string(count) },
+                { "threads", std::to_string(threads) } }, count, [&]()
+            {
+                triangulator.triangulate(leftPoints.data(), rightPoints.data(), count, points.data(), options);
+                doNotOptimize(points.back().z);
+            });
+        }
+
+        // As managed export: text line per point, formatted one at a time
+        void writeTextPly(const std::string& path, const DensePointCloud& cloud)
+        {
+            std::FILE* file = std::fopen(path.c_str(), "w");
+            std::fprintf(file, "ply\nformat ascii 1.0\nelement vertex %d\nproperty float x\nproperty float y\nproperty float z\n"
+                "property uchar red\nproperty uchar green\nproperty uchar blue\nend_header\n", cloud.pointCount);
+            for(int r = 0; r < cloud.getRowCount(); ++r)
+            {
+                for(int c = 0; c < cloud.getColumnCount(); ++c)
+                {
+                    if(cloud.mask(r, c) == 0) { continue; }
+                    std::fprintf(file, "%f %f %f %d %d %d\n", cloud.x(r, c), cloud.y(r, c), cloud.z(r, c),
+                        static_cast<int>(cloud.red(r, c) * 255.0f + 0.5f), static_cast<int>(cloud.green(r, c) * 255.0f + 0.5f),
+                        static_cast<int>(cloud.blue(r, c) * 255.0f + 0.5f));
+                }
+            }
+            std::fclose(file);
+        }
+
+        void runPointCloudFileBenchmarks(BenchmarkRunner& runner, const DenseTriangulator& triangulator,
+            const DisparityMap& map, const ColorImage& color, const ParallelForOptions& options, const std::string& size)
+        {
+            const std::string path = "PointCloud.benchmark.tmp";
+            DensePointCloud cloud;
+            triangulator.triangulate(map, &color, cloud, options);
+            int pixels = map.getRowCount() * map.getColumnCount();
+
+            runner.measure("Triangulation.WriteCloud", BenchmarkParams{ { "size", size }, { "format", "text" } }, pixels, [&]()
+            {
+                writeTextPly(path, cloud);
+            });
+            for(PointCloudFormat format : { PointCloudFormat::Ply, PointCloudFormat::Planes })
+            {
+                BenchmarkParams params{ { "size", size }, { "format", format == PointCloudFormat::Ply ? "ply" : "planes" } };
+                runner.measure("Triangulation.WriteCloud", params, pixels, [&]()
+                {
+                    writePointCloud(path, cloud, format);
+                });
+            }
+
+            // Frame of pipeline tail: triangulated and written in same call, or handed to writer thread
+            BenchmarkParams syncParams{ { "size", size }, { "format", "ply" }, { "writer", "sync" } };
+            runner.measure("Triangulation.TriangulateAndWrite", syncParams, pixels, [&]()
+            {
+                triangulator.triangulate(map, &color, cloud, options);
+                writePointCloudPly(path, cloud);
+            });
+            PointCloudWriter writer;
+            BenchmarkParams asyncParams{ { "size", size }, { "format", "ply" }, { "writer", "background" } };
+            runner.measure("Triangulation.TriangulateAndWrite", asyncParams, pixels, [&]()
+            {
+                DensePointCloud frame = writer.acquire();
+                triangulator.triangulate(map, &color, frame, options);
+                writer.submit(std::move(frame), path, PointCloudFormat::Ply);
+            });
+            writer.flush();
+            std::remove(path.c_str());
+        }
+    }
+
+    void runTriangulationBenchmarks(BenchmarkRunner& runner)
+    {
+        bool fileBenchmarks = runner.isEnabled("Triangulation.WriteCloud") || runner.isEnabled("Triangulation.TriangulateAndWrite");
+        if(!runner.isEnabled("Triangulation.Dense") && !runner.isEnabled("Triangulation.PerPoint") &&
+            !runner.isEnabled("Triangulation.Optimal") && !fileBenchmarks)
+        {
+            return;
+        }
+
+        const BenchmarkConfig& config = runner.getConfig();
+        const int rows = config.rows;
+        const int cols = config.cols;
+        int threads = config.threads > 0 ? config.threads : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        ThreadPool pool{ static_cast<std::size_t>(threads) };
+        ParallelForOptions options;
+        options.pool = &pool;
+        options.maxTasks = threads;
+
+        if(runner.isEnabled("Triangulation.Optimal"))
+        {
+            runOptimalTriangulationBenchmarks(runner, options, threads);
+        }
+        if(!runner.isEnabled("Triangulation.Dense") && !runner.isEnabled("Triangulation.PerPoint") && !fileBenchmarks)
+        {
+            return;
+        }
+
+        DisparityMap map{ rows, cols };
+        fillMap(map);
+        ColorImage color{ rows, cols };
+        for(int r = 0; r < rows; ++r)
+        {
+            for(int c = 0; c < cols; ++c)
+            {
+                color(r, c, 0) = (r % 256) / 255.0;
+                color(r, c, 1) = (c % 256) / 255.0;
+                color(r, c, 2) = 0.5;
+            }
+        }
+
+        RectifiedStereoParameters parameters = createParameters(rows, cols);
+        std::string size = std::to_string(cols) + "x" + std::to_string(rows);
+
+        std::vector<Point> points;
+        runner.measure("Triangulation.PerPoint", BenchmarkParams{ { "size", size } }, rows * cols, [&]()
+        {
+            triangulatePerPoint(map, parameters, points);
+            doNotOptimize(points.back().z);
+        });
+
+        DenseTriangulator triangulator{ parameters, 128 };
+        DensePointCloud cloud;
+        struct Variant { const char* depth; bool subpixel; bool withColor; };
+        for(Variant variant : { Variant{ "subpixel", true, false }, Variant{ "table", false, false }, Variant{ "subpixel", true, true } })
+        {
+            triangulator.useSubpixel = variant.subpixel;
+            BenchmarkParams params{ { "size", size }, { "depth", variant.depth }, { "color", variant.withColor ? "yes" : "no" },
+                { "threads", std::to_string(threads) } };
+            runner.measure("Triangulation.Dense", params, rows * cols, [&]()
+            {
+                triangulator.triangulate(map, variant.withColor ? &color : nullptr, cloud, options);
+                doNotOptimize(cloud.pointCount);
+            });
+        }
+
+        if(fileBenchmarks)
+        {
+            triangulator.useSubpixel = true;
+            runPointCloudFileBenchmarks(runner, triangulator, map, color, options, size);
+        }
+    }
+}
+}
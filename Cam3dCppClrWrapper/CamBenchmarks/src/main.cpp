@@ -0,0 +1,121 @@
+#include "Benchmark.hpp"
+#include "ScalingBenchmark.hpp"
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace cam3d::benchmarks;
+
+namespace
+{
+    std::vector<int> parseIntList(const std::string& text)
+    {
+        std::vector<int> values;
+        std::stringstream stream{ text };
+        std::string item;
+        while(std::getline(stream, item, ','))
+        {
+            values.push_back(std::stoi(item));
+        }
+        if(values.empty())
+        {
+            throw std::invalid_argument("Empty list: " + text);
+        }
+        return values;
+    }
+
+    void printUsage()
+    {
+        std::cerr <<
+            "Usage: CamBenchmarks [options]\n"
+            "       CamBenchmarks scaling [options] - end-to-end matching on synthetic scenes, see 'scaling --help'\n"
+            "  --rows N             image rows (default 480)\n"
+            "  --cols N             image columns (default 640)\n"
+            "  --disparities A,B,.. disparity ranges (default 64,128,256)\n"
+            "  --radii A,B,..       census radii, 1..7 (default all)\n"
+            "  --threads N          threads for task queue benchmarks (default: hardware)\n"
+            "  --min-time-ms T      minimum time of one benchmark (default 200)\n"
+            "  --rounds N           measured rounds, median is reported (default 5)\n"
+            "  --filter TEXT        run only benchmarks which name contains TEXT\n"
+            "  --tag TEXT           label stored in results context\n"
+            "  --out PATH           write JSON to PATH instead of stdout\n";
+    }
+
+    BenchmarkConfig parseArguments(int argc, char** argv)
+    {
+        BenchmarkConfig config;
+        for(int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            if(arg == "--help" || arg == "-h")
+            {
+                printUsage();
+                std::exit(0);
+            }
+            if(i + 1 >= argc)
+            {
+                throw std::invalid_argument("Missing value for " + arg);
+            }
+            std::string value = argv[++i];
+
+            if(arg == "--rows") { config.rows = std::stoi(value); }
+            else if(arg == "--cols") { config.cols = std::stoi(value); }
+            else if(arg == "--disparities") { config.disparities = parseIntList(value); }
+            else if(arg == "--radii") { config.radii = parseIntList(value); }
+            else if(arg == "--threads") { config.threads = std::stoi(value); }
+            else if(arg == "--min-time-ms") { config.minTimeMs = std::stod(value); }
+            else if(arg == "--rounds") { config.rounds = std::stoi(value); }
+            else if(arg == "--filter") { config.filter = value; }
+            else if(arg == "--tag") { config.tag = value; }
+            else if(arg == "--out") { config.outputPath = value; }
+            else { throw std::invalid_argument("Unknown option " + arg); }
+        }
+        return config;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if(argc > 1 && std::string{ argv[1] } == "scaling")
+    {
+        return scalingMain(argc - 1, argv + 1);
+    }
+
+    BenchmarkConfig config;
+    try
+    {
+        config = parseArguments(argc, argv);
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << e.what() << "\n";
+        printUsage();
+        return 1;
+    }
+
+    BenchmarkRunner runner{ config };
+    runCommonBenchmarks(runner);
+    runMatchingBenchmarks(runner);
+    runRefinementBenchmarks(runner);
+    runRectificationBenchmarks(runner);
+    runTriangulationBenchmarks(runner);
+
+    runner.writeSummary(std::cerr);
+    if(config.outputPath.empty())
+    {
+        runner.writeJson(std::cout);
+    }
+    else
+    {
+        std::ofstream file{ config.outputPath };
+        if(!file)
+        {
+            std::cerr << "Cannot open " << config.outputPath << "\n";
+            return 1;
+        }
+        runner.writeJson(file);
+    }
+    return 0;
+}
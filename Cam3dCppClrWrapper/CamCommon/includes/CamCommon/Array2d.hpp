@@ -2,25 +2,148 @@
 
 #include "PreReqs.hpp"
 #include "Vector2.hpp"
-#include <vector>
+#include "MemoryAccounting.hpp"
+#include "ArrayStorage.hpp"
 #include <algorithm>
+#include <type_traits>
 
 namespace cam3d
 {
+// Non-owning view of 2d array with row pitch - e.g. region of interest of Array2d.
+// Shares buffer of its parent, which must outlive the view
 template<typename T>
+class Array2dView
+{
+    T* origin;
+    int rows;
+    int cols;
+    int pitch;
+
+public:
+    Array2dView(T* origin_, int rows_, int cols_, int pitch_) :
+        origin{origin_}, rows{rows_}, cols{cols_}, pitch{pitch_}
+    { }
+
+    // View of non-const elements may be used as view of const ones
+    template<typename U, typename = typename std::enable_if<std::is_same<const U, T>::value && !std::is_const<U>::value>::type>
+    Array2dView(const Array2dView<U>& other) :
+        origin{other.getData()}, rows{other.getRowCount()}, cols{other.getColumnCount()}, pitch{other.getPitch()}
+    { }
+
+    T& operator()(const int r, const int c) const { return origin[r * pitch + c]; }
+    T& operator()(const Vector2i& pos) const { return origin[pos.y * pitch + pos.x]; }
+
+    int getRowCount() const { return rows; }
+    int getColumnCount() const { return cols; }
+    int getPitch() const { return pitch; }
+    int size() const { return rows * cols; }
+
+    T* getData() const { return origin; }
+    T* getRow(const int r) const { return origin + r * pitch; }
+
+    Array2dView roi(int startRow, int startCol, int roiRows, int roiCols) const
+    {
+        return {origin + startRow * pitch + startCol, roiRows, roiCols, pitch};
+    }
+
+    void fill(const T& value) const
+    {
+        for(int r = 0; r < rows; ++r)
+        {
+            std::fill(getRow(r), getRow(r) + cols, value);
+        }
+    }
+
+    detail::StridedIterator<T> begin() const { return {origin, cols, pitch}; }
+    detail::StridedIterator<T> end() const { return {origin + rows * pitch, cols, pitch}; }
+};
+
+// Owning 2d array: [row][col]. Buffer is aligned to memory::alignment, rows may be
+// padded (row pitch) and surrounded by border of 'padding' elements (see ArrayLayout).
+// With default layout elements are contiguous. Per-frame arrays may pass
+// memory::ArenaAllocator (CamCommon/FrameArena.hpp) as 'Allocator'.
+// Array may also borrow caller's buffer (see Borrowed) - copy of such array owns its elements.
+template<typename T, typename Allocator = memory::AccountingAllocator<T>>
 class Array2d
 {
 protected:
     int rows;
     int cols;
+    int pitch;
+    int padding;
 
-    int getIdx(const int r, const int c) const { return r * cols + c; }
-    std::vector<T> data;
+    int getIdx(const int r, const int c) const { return r * pitch + c; }
+    detail::ArrayBuffer<T, Allocator> buffer;
+    T* data; // Element (0, 0)
 
 public:
-    Array2d(int rows_, int cols_) : rows{rows_}, cols{cols_}
+    Array2d(int rows_, int cols_, const Allocator& allocator = Allocator()) :
+        Array2d(rows_, cols_, ArrayLayout{}, allocator)
+    { }
+
+    Array2d(int rows_, int cols_, Uninitialized, const Allocator& allocator = Allocator()) :
+        Array2d(rows_, cols_, uninitializedLayout(), allocator)
+    { }
+
+    Array2d(int rows_, int cols_, const ArrayLayout& layout, const Allocator& allocator = Allocator()) :
+        rows{rows_},
+        cols{cols_},
+        pitch{getPitchFor(cols_, layout)},
+        padding{std::max(0, layout.padding)},
+        buffer{static_cast<std::size_t>(pitch) * (rows_ + 2 * padding), layout.initialize, allocator},
+        data{buffer.get() + padding * pitch + getLeftPaddingFor(layout)}
+    { }
+
+    // 'external' is element (0, 0), 'pitch_' elements are between starts of consecutive rows
+    Array2d(Borrowed, T* external, int rows_, int cols_, int pitch_, const Allocator& allocator = Allocator()) :
+        rows{rows_},
+        cols{cols_},
+        pitch{pitch_},
+        padding{0},
+        buffer{allocator},
+        data{external}
+    { }
+
+    Array2d(Borrowed, const Array2dView<T>& view, const Allocator& allocator = Allocator()) :
+        Array2d(borrowed, view.getData(), view.getRowCount(), view.getColumnCount(), view.getPitch(), allocator)
+    { }
+
+    Array2d(const Array2d& other) :
+        rows{other.rows}, cols{other.cols},
+        pitch{other.isBorrowed() ? other.cols : other.pitch},
+        padding{other.padding},
+        buffer{other.isBorrowed() ?
+            detail::ArrayBuffer<T, Allocator>{static_cast<std::size_t>(other.rows) * other.cols, true, other.buffer.getAllocator()} :
+            other.buffer},
+        data{other.isBorrowed() ? buffer.get() : buffer.get() + (other.data - other.buffer.get())}
+    {
+        if(other.isBorrowed())
+        {
+            for(int r = 0; r < rows; ++r)
+            {
+                std::copy(other.getRow(r), other.getRow(r) + cols, getRow(r));
+            }
+        }
+    }
+
+    Array2d(Array2d&& other) :
+        rows{other.rows}, cols{other.cols}, pitch{other.pitch}, padding{other.padding},
+        buffer{std::move(other.buffer)},
+        data{other.data}
+    {
+        other.rows = other.cols = 0;
+        other.data = nullptr;
+    }
+
+    Array2d& operator=(Array2d other)
     {
-        data.resize(size());
+        std::swap(rows, other.rows);
+        std::swap(cols, other.cols);
+        std::swap(pitch, other.pitch);
+        std::swap(padding, other.padding);
+        std::swap(buffer, other.buffer);
+        std::swap(data, other.data);
+        return *this;
     }
 
     T& operator()(const int r, const int c) { return data[getIdx(r, c)]; }
@@ -33,6 +156,30 @@ public:
     int getColumnCount() const { return cols; }
     int size() const { return rows * cols; }
 
+    // Elements between starts of consecutive rows
+    int getPitch() const { return pitch; }
+    int getPadding() const { return padding; }
+    bool isContiguous() const { return pitch == cols; }
+    // Elements are owned by caller
+    bool isBorrowed() const { return buffer.get() == nullptr && data != nullptr; }
+
+    T* getData() { return data; }
+    const T* getData() const { return data; }
+    T* getRow(const int r) { return data + r * pitch; }
+    const T* getRow(const int r) const { return data + r * pitch; }
+
+    Array2dView<T> view() { return {data, rows, cols, pitch}; }
+    Array2dView<const T> view() const { return {data, rows, cols, pitch}; }
+    // Region may extend into padding
+    Array2dView<T> roi(int startRow, int startCol, int roiRows, int roiCols)
+    {
+        return view().roi(startRow, startCol, roiRows, roiCols);
+    }
+    Array2dView<const T> roi(int startRow, int startCol, int roiRows, int roiCols) const
+    {
+        return view().roi(startRow, startCol, roiRows, roiCols);
+    }
+
     void clear()
     {
         fill(T{});
@@ -40,20 +187,31 @@ public:
 
     void fill(const T& value)
     {
-        for(int i = 0, s = size(); i < s; ++ i)
-        {
-            data[i] = value;
-        }
+        view().fill(value);
+    }
+
+    detail::StridedIterator<T> begin() { return view().begin(); }
+    detail::StridedIterator<T> end() { return view().end(); }
+    detail::StridedIterator<const T> begin() const { return view().begin(); }
+    detail::StridedIterator<const T> end() const { return view().end(); }
+
+private:
+    // Left padding is rounded, so that element 0 of each row is aligned as well
+    static int getLeftPaddingFor(const ArrayLayout& layout)
+    {
+        return detail::alignedElementCount<T>(std::max(0, layout.padding), layout.alignRows);
     }
 
-    auto begin() -> decltype(data.begin())
+    static int getPitchFor(int cols, const ArrayLayout& layout)
     {
-        return data.begin();
+        return detail::alignedElementCount<T>(getLeftPaddingFor(layout) + cols + std::max(0, layout.padding), layout.alignRows);
     }
 
-    auto end() -> decltype(data.end())
+    static ArrayLayout uninitializedLayout()
     {
-        return data.begin();
+        ArrayLayout layout;
+        layout.initialize = false;
+        return layout;
     }
 };
 }
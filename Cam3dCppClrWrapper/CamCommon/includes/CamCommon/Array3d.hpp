@@ -2,29 +2,156 @@
 
 #include "PreReqs.hpp"
 #include "Vector2.hpp"
-#include <vector>
-#include <cstring>
+#include "MemoryAccounting.hpp"
+#include "ArrayStorage.hpp"
+#include <algorithm>
+#include <type_traits>
 
 namespace cam3d
 {
-    // Represent static 3d array: [row][col][dim]
+    // Non-owning view of 3d array: [row][col][dim] with row pitch - e.g. region of interest
+    // of Array3d. Shares buffer of its parent, which must outlive the view
     template<typename T>
+    class Array3dView
+    {
+        T* origin;
+        int rows;
+        int cols;
+        int dim;
+        int pitch;
+
+    public:
+        Array3dView(T* origin_, int rows_, int cols_, int dim_, int pitch_) :
+            origin{origin_}, rows{rows_}, cols{cols_}, dim{dim_}, pitch{pitch_}
+        { }
+
+        // View of non-const elements may be used as view of const ones
+        template<typename U, typename = typename std::enable_if<std::is_same<const U, T>::value && !std::is_const<U>::value>::type>
+        Array3dView(const Array3dView<U>& other) :
+            origin{other.getData()}, rows{other.getRowCount()}, cols{other.getColumnCount()},
+            dim{other.getDimCount()}, pitch{other.getPitch()}
+        { }
+
+        T& operator()(const int r, const int c, const int d) const { return origin[r * pitch + c * dim + d]; }
+        T& operator()(const Point2 p, const int d) const { return origin[p.y * pitch + p.x * dim + d]; }
+
+        int getRowCount() const { return rows; }
+        int getColumnCount() const { return cols; }
+        int getDimCount() const { return dim; }
+        int getPitch() const { return pitch; }
+
+        T* getData() const { return origin; }
+        T* getRow(const int r) const { return origin + r * pitch; }
+
+        Array3dView roi(int startRow, int startCol, int roiRows, int roiCols) const
+        {
+            return {origin + startRow * pitch + startCol * dim, roiRows, roiCols, dim, pitch};
+        }
+
+        void fill(const T& value) const
+        {
+            for(int r = 0; r < rows; ++r)
+            {
+                std::fill(getRow(r), getRow(r) + cols * dim, value);
+            }
+        }
+
+        // Iterates over all elements of all pixels
+        detail::StridedIterator<T> begin() const { return {origin, cols * dim, pitch}; }
+        detail::StridedIterator<T> end() const { return {origin + rows * pitch, cols * dim, pitch}; }
+    };
+
+    // Represent static 3d array: [row][col][dim]. Buffer is aligned to memory::alignment,
+    // rows may be padded (row pitch) and surrounded by border of 'padding' pixels (see ArrayLayout).
+    // With default layout elements are contiguous. Per-frame arrays may pass
+    // memory::ArenaAllocator (CamCommon/FrameArena.hpp) as 'Allocator'.
+    // Array may also borrow caller's buffer (see Borrowed) - copy of such array owns its elements.
+    template<typename T, typename Allocator = memory::AccountingAllocator<T>>
     class Array3d
     {
     protected:
         int rows;
         int cols;
         int dim;
+        int pitch;
+        int padding;
 
     private:
-        int getSize() const { return rows * cols * dim; }
-        int getIdx(const int r, const int c, const int d) const { return (r * cols + c) * dim + d; }
-        std::vector<T> data;
+        int getIdx(const int r, const int c, const int d) const { return r * pitch + c * dim + d; }
+        detail::ArrayBuffer<T, Allocator> buffer;
+        T* data; // Element (0, 0, 0)
 
     public:
-        Array3d(int rows_, int cols_, int dim_) : rows{rows_}, cols{cols_}, dim{dim_}
+        Array3d(int rows_, int cols_, int dim_, const Allocator& allocator = Allocator()) :
+            Array3d(rows_, cols_, dim_, ArrayLayout{}, allocator)
+        { }
+
+        Array3d(int rows_, int cols_, int dim_, Uninitialized, const Allocator& allocator = Allocator()) :
+            Array3d(rows_, cols_, dim_, uninitializedLayout(), allocator)
+        { }
+
+        Array3d(int rows_, int cols_, int dim_, const ArrayLayout& layout, const Allocator& allocator = Allocator()) :
+            rows{rows_},
+            cols{cols_},
+            dim{dim_},
+            pitch{getPitchFor(cols_, dim_, layout)},
+            padding{std::max(0, layout.padding)},
+            buffer{static_cast<std::size_t>(pitch) * (rows_ + 2 * padding), layout.initialize, allocator},
+            data{buffer.get() + padding * pitch + getLeftPaddingFor(dim_, layout)}
+        { }
+
+        // 'external' is element (0, 0, 0), 'pitch_' elements are between starts of consecutive rows
+        Array3d(Borrowed, T* external, int rows_, int cols_, int dim_, int pitch_, const Allocator& allocator = Allocator()) :
+            rows{rows_},
+            cols{cols_},
+            dim{dim_},
+            pitch{pitch_},
+            padding{0},
+            buffer{allocator},
+            data{external}
+        { }
+
+        Array3d(Borrowed, const Array3dView<T>& view, const Allocator& allocator = Allocator()) :
+            Array3d(borrowed, view.getData(), view.getRowCount(), view.getColumnCount(), view.getDimCount(), view.getPitch(), allocator)
+        { }
+
+        Array3d(const Array3d& other) :
+            rows{other.rows}, cols{other.cols}, dim{other.dim},
+            pitch{other.isBorrowed() ? other.cols * other.dim : other.pitch},
+            padding{other.padding},
+            buffer{other.isBorrowed() ?
+                detail::ArrayBuffer<T, Allocator>{static_cast<std::size_t>(other.rows) * other.cols * other.dim, true, other.buffer.getAllocator()} :
+                other.buffer},
+            data{other.isBorrowed() ? buffer.get() : buffer.get() + (other.data - other.buffer.get())}
+        {
+            if(other.isBorrowed())
+            {
+                for(int r = 0; r < rows; ++r)
+                {
+                    std::copy(other.getRow(r), other.getRow(r) + cols * dim, getRow(r));
+                }
+            }
+        }
+
+        Array3d(Array3d&& other) :
+            rows{other.rows}, cols{other.cols}, dim{other.dim}, pitch{other.pitch}, padding{other.padding},
+            buffer{std::move(other.buffer)},
+            data{other.data}
         {
-            data.resize(getSize());
+            other.rows = other.cols = 0;
+            other.data = nullptr;
+        }
+
+        Array3d& operator=(Array3d other)
+        {
+            std::swap(rows, other.rows);
+            std::swap(cols, other.cols);
+            std::swap(dim, other.dim);
+            std::swap(pitch, other.pitch);
+            std::swap(padding, other.padding);
+            std::swap(buffer, other.buffer);
+            std::swap(data, other.data);
+            return *this;
         }
 
         T& operator()(const int r, const int c, const int d)
@@ -52,24 +179,65 @@ namespace cam3d
         // Fills array with given value
         void fill(const T& value)
         {
-            for(int i = 0, size = getSize(); i < size; ++i)
-            {
-                data[i] = value;
-            }
+            view().fill(value);
         }
 
         int getRowCount() const { return rows; }
         int getColumnCount() const { return cols; }
         int getDimCount() const { return dim; }
 
-        auto begin() -> decltype(data.begin())
+        // Elements between starts of consecutive rows
+        int getPitch() const { return pitch; }
+        int getPadding() const { return padding; }
+        bool isContiguous() const { return pitch == cols * dim; }
+        // Elements are owned by caller
+        bool isBorrowed() const { return buffer.get() == nullptr && data != nullptr; }
+
+        T* getData() { return data; }
+        const T* getData() const { return data; }
+        T* getRow(const int r) { return data + r * pitch; }
+        const T* getRow(const int r) const { return data + r * pitch; }
+
+        Array3dView<T> view() { return {data, rows, cols, dim, pitch}; }
+        Array3dView<const T> view() const { return {data, rows, cols, dim, pitch}; }
+        // Region may extend into padding
+        Array3dView<T> roi(int startRow, int startCol, int roiRows, int roiCols)
+        {
+            return view().roi(startRow, startCol, roiRows, roiCols);
+        }
+        Array3dView<const T> roi(int startRow, int startCol, int roiRows, int roiCols) const
+        {
+            return view().roi(startRow, startCol, roiRows, roiCols);
+        }
+
+        detail::StridedIterator<T> begin() { return view().begin(); }
+        detail::StridedIterator<T> end() { return view().end(); }
+        detail::StridedIterator<const T> begin() const { return view().begin(); }
+        detail::StridedIterator<const T> end() const { return view().end(); }
+
+    private:
+        // Left padding is whole pixels, rounded so that first pixel of each row is aligned if possible
+        static int getLeftPaddingFor(int dim, const ArrayLayout& layout)
+        {
+            int leftPadding = std::max(0, layout.padding) * dim;
+            while(layout.alignRows && leftPadding != detail::alignedElementCount<T>(leftPadding, true) && dim > 0)
+            {
+                leftPadding += dim;
+            }
+            return leftPadding;
+        }
+
+        static int getPitchFor(int cols, int dim, const ArrayLayout& layout)
         {
-            return data.begin();
+            return detail::alignedElementCount<T>(
+                getLeftPaddingFor(dim, layout) + (cols + std::max(0, layout.padding)) * dim, layout.alignRows);
         }
 
-        auto end() -> decltype(data.end())
+        static ArrayLayout uninitializedLayout()
         {
-            return data.begin();
+            ArrayLayout layout;
+            layout.initialize = false;
+            return layout;
         }
     };
 }
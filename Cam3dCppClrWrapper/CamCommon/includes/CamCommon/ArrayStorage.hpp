@@ -0,0 +1,184 @@
+#pragma once
+
+#include "MemoryAccounting.hpp"
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace cam3d
+{
+// Tag for constructors which leave elements default-initialized
+// (that is uninitialized for arithmetic types and pointers)
+struct Uninitialized { };
+constexpr Uninitialized uninitialized{};
+
+// Tag for constructors which wrap caller's memory (with any row pitch) instead of
+// allocating it. Such array neither owns nor copies elements; memory must outlive it
+struct Borrowed { };
+constexpr Borrowed borrowed{};
+
+// Layout of Array2d / Array3d buffer
+struct ArrayLayout
+{
+    int padding = 0;        // Elements around array on each side, addressable with indices -padding..-1 and beyond size
+    bool alignRows = false; // Row pitch is multiple of memory::alignment and first element of each row is aligned
+    bool initialize = true; // Value-initialize elements (including padding)
+};
+
+namespace detail
+{
+// Number of elements from 'count' rounded up, so that they take multiple of memory::alignment bytes
+template<typename T>
+int alignedElementCount(int count, bool align)
+{
+    if(!align || memory::alignment % sizeof(T) != 0)
+    {
+        return count;
+    }
+    const int perLine = static_cast<int>(memory::alignment / sizeof(T));
+    return (count + perLine - 1) / perLine * perLine;
+}
+
+// Owning buffer of elements allocated with 'Allocator' (which may be stateful,
+// e.g. memory::ArenaAllocator). Unlike std::vector it may leave elements default-initialized
+template<typename T, typename Allocator>
+class ArrayBuffer
+{
+    using Traits = std::allocator_traits<Allocator>;
+
+    Allocator allocator;
+    T* buffer;
+    std::size_t count;
+
+public:
+    explicit ArrayBuffer(const Allocator& allocator_ = Allocator()) : allocator{allocator_}, buffer{nullptr}, count{0} { }
+
+    ArrayBuffer(std::size_t count_, bool initialize, const Allocator& allocator_ = Allocator()) :
+        allocator{allocator_}, buffer{nullptr}, count{0}
+    {
+        T* p = count_ > 0 ? Traits::allocate(allocator, count_) : nullptr;
+        std::size_t constructed = 0;
+        try
+        {
+            for(; constructed < count_; ++constructed)
+            {
+                if(initialize) { ::new(static_cast<void*>(p + constructed)) T(); }
+                else { ::new(static_cast<void*>(p + constructed)) T; }
+            }
+        }
+        catch(...)
+        {
+            release(p, constructed, count_);
+            throw;
+        }
+        buffer = p;
+        count = count_;
+    }
+
+    ArrayBuffer(const ArrayBuffer& other) :
+        allocator{Traits::select_on_container_copy_construction(other.allocator)}, buffer{nullptr}, count{0}
+    {
+        T* p = other.count > 0 ? Traits::allocate(allocator, other.count) : nullptr;
+        try
+        {
+            std::uninitialized_copy(other.buffer, other.buffer + other.count, p);
+        }
+        catch(...)
+        {
+            if(p != nullptr) { Traits::deallocate(allocator, p, other.count); }
+            throw;
+        }
+        buffer = p;
+        count = other.count;
+    }
+
+    ArrayBuffer(ArrayBuffer&& other) : allocator{other.allocator}, buffer{other.buffer}, count{other.count}
+    {
+        other.buffer = nullptr;
+        other.count = 0;
+    }
+
+    ArrayBuffer& operator=(ArrayBuffer other)
+    {
+        std::swap(allocator, other.allocator);
+        std::swap(buffer, other.buffer);
+        std::swap(count, other.count);
+        return *this;
+    }
+
+    ~ArrayBuffer()
+    {
+        release(buffer, count, count);
+    }
+
+    T* get() const { return buffer; }
+    std::size_t size() const { return count; }
+    const Allocator& getAllocator() const { return allocator; }
+
+private:
+    void release(T* p, std::size_t constructed, std::size_t allocated)
+    {
+        if(p == nullptr)
+        {
+            return;
+        }
+        for(std::size_t i = 0; i < constructed; ++i)
+        {
+            p[i].~T();
+        }
+        Traits::deallocate(allocator, p, allocated);
+    }
+};
+
+// Iterates row-major over 'cols' elements in each row, skipping rest of 'pitch'
+template<typename T>
+class StridedIterator
+{
+    T* current;
+    int col;
+    int cols;
+    int pitch;
+
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = typename std::remove_const<T>::type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = T*;
+    using reference = T&;
+
+    StridedIterator(T* current_, int cols_, int pitch_) :
+        current{current_}, col{0}, cols{cols_}, pitch{pitch_}
+    { }
+
+    T& operator*() const { return *current; }
+    T* operator->() const { return current; }
+
+    StridedIterator& operator++()
+    {
+        if(++col == cols)
+        {
+            col = 0;
+            current += pitch - cols + 1;
+        }
+        else
+        {
+            ++current;
+        }
+        return *this;
+    }
+
+    StridedIterator operator++(int)
+    {
+        StridedIterator previous = *this;
+        ++(*this);
+        return previous;
+    }
+
+    bool operator==(const StridedIterator& other) const { return current == other.current; }
+    bool operator!=(const StridedIterator& other) const { return current != other.current; }
+};
+}
+}
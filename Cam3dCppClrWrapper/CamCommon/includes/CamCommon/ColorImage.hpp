@@ -17,6 +17,17 @@ namespace cam3d
 			imageMatrix{ rows, cols, 3 }
 		{ }
 
+		// Wraps caller's buffer of interleaved channels with 'pitch' elements per row,
+		// without owning or copying it
+		ColorImage(double* data, int rows, int cols, int pitch) :
+			imageMatrix{ borrowed, data, rows, cols, 3, pitch }
+		{ }
+
+		// Wraps region of other image or array
+		explicit ColorImage(const Array3dView<double>& view) :
+			imageMatrix{ borrowed, view }
+		{ }
+
         double operator()(int y, int x) const { return imageMatrix(y, x, 0); }
         double& operator()(int y, int x) { return imageMatrix(y, x, 0); }
         double operator()(int y, int x, int channel) const { return imageMatrix(y, x, channel); }
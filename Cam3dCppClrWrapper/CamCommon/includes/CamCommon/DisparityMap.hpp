@@ -5,5 +5,6 @@
 
 namespace cam3d
 {
+	// May wrap caller's buffer: DisparityMap{ borrowed, data, rows, cols, pitch }
 	using DisparityMap = Array2d<Disparity>;
 }
\ No newline at end of file
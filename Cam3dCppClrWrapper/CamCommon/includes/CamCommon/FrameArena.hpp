@@ -0,0 +1,121 @@
+#pragma once
+
+#include "MemoryAccounting.hpp"
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace cam3d
+{
+namespace memory
+{
+struct FrameArenaOptions
+{
+    std::size_t blockBytes = std::size_t{4} << 20; // First block and minimal size of next ones
+    bool hugePages = false; // Ask OS for huge pages (MAP_HUGETLB / transparent huge pages, MEM_LARGE_PAGES), falls back to regular ones
+};
+
+// Monotonic arena for temporaries of one frame: paths, path costs, per-frame arrays.
+// Allocation bumps offset in current block with compare-and-swap, so concurrent tasks
+// do not serialize on it; lock is taken only to move to next block. Nothing is freed separately. reset() drops
+// all allocations at once and keeps blocks, so that next frame allocates nothing from heap.
+// Objects in arena are never destroyed - they must be trivially destructible.
+// Blocks are recorded in memory accounting as they are reserved.
+class FrameArena
+{
+public:
+    explicit FrameArena(const FrameArenaOptions& options = FrameArenaOptions{});
+    ~FrameArena();
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // Thread-safe. 'align' must be power of 2, at most memory::alignment. Throws std::bad_alloc
+    void* allocate(std::size_t bytes, std::size_t align = alignof(std::max_align_t));
+
+    // Uninitialized, aligned to memory::alignment
+    template<typename T>
+    T* allocateArray(std::size_t count)
+    {
+        return static_cast<T*>(allocate(count * sizeof(T), alignment));
+    }
+
+    template<typename T, typename... Args>
+    T* create(Args&&... args)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "Objects in FrameArena are never destroyed");
+        return ::new(allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // Invalidates all allocations; must not run concurrently with allocate().
+    // Constant time, unless last frame overflowed into more blocks - then they
+    // are merged into one, so that following frames fit in single block.
+    void reset();
+    // Invalidates all allocations and returns blocks to OS
+    void release();
+
+    std::size_t getUsedBytes() const;     // Since last reset, including alignment
+    std::size_t getReservedBytes() const; // All blocks
+    // True if any block got huge pages (explicitly or as transparent huge pages)
+    bool usesHugePages() const;
+
+private:
+    struct Block
+    {
+        char* memory;
+        std::size_t size;
+        bool mapped;    // From mmap / VirtualAlloc instead of allocateAligned()
+        bool hugePages;
+        std::atomic<std::size_t> offset;
+    };
+
+    // Bumps offset of 'block', nullptr if allocation does not fit in it
+    static void* tryAllocate(Block& block, std::size_t bytes, std::size_t align);
+    std::unique_ptr<Block> allocateBlock(std::size_t minBytes);
+    void freeBlock(const Block& block);
+    void freeBlocks();
+
+    FrameArenaOptions options;
+    mutable std::mutex mutex; // Guards blocks list, not bumps in current block
+    std::vector<std::unique_ptr<Block>> blocks; // Pointers stay valid when list grows
+    std::atomic<Block*> currentBlock; // Allocated from, null if there are no blocks
+    std::size_t current;      // Index of 'currentBlock'
+    std::size_t passedBytes;  // Sizes of blocks before current one, including their unused rest
+    std::size_t reservedBytes;
+};
+
+// Allocator of containers which live for one frame, e.g. Array2d<T, ArenaAllocator<T>>.
+// deallocate() does nothing - memory is reclaimed by FrameArena::reset()
+template<typename T>
+class ArenaAllocator
+{
+    FrameArena* arena;
+
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(FrameArena& arena_) : arena{&arena_} { }
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena{other.getArena()} { }
+
+    T* allocate(std::size_t n)
+    {
+        return arena->allocateArray<T>(n);
+    }
+
+    void deallocate(T*, std::size_t) { }
+
+    FrameArena* getArena() const { return arena; }
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena == other.getArena(); }
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.getArena(); }
+};
+}
+}
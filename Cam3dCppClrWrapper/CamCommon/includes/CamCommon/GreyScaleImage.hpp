@@ -17,6 +17,16 @@ public:
 		imageMatrix{rows, cols}
 	{ }
 
+	// Wraps caller's buffer with 'pitch' elements per row, without owning or copying it
+	GreyScaleImage(double* data, int rows, int cols, int pitch) :
+		imageMatrix{borrowed, data, rows, cols, pitch}
+	{ }
+
+	// Wraps region of other image or array
+	explicit GreyScaleImage(const Array2dView<double>& view) :
+		imageMatrix{borrowed, view}
+	{ }
+
     double operator()(int y, int x) const { return imageMatrix(y,x); }
     double& operator()(int y, int x) { return imageMatrix(y,x); }
     double operator()(int y, int x, int channel) const { return imageMatrix(y,x); }
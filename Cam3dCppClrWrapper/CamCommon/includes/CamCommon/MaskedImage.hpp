@@ -24,6 +24,12 @@ public:
         mask.fill(false);
     }
 
+    // Borrows 'mask_' (non-zero where image has value) without copying it
+    MaskedImage(Image& image_, const Array2dView<char>& mask_) :
+        image(image_),
+        mask{ borrowed, mask_ }
+    { }
+
     double operator()(int y, int x) const { return image(y, x); }
     double& operator()(int y, int x) { return image(y, x); }
     double operator()(int y, int x, int channel) const { return image(y, x, channel); }
@@ -36,6 +42,9 @@ public:
     bool haveValueAt(int y, int x) { return static_cast<bool>(mask(y, x)); }
     void setMaskAt(int y, int x, bool value) { mask(y, x) = static_cast<char>(value); }
 
+    Array2d<char>& getMask() { return mask; }
+    const Array2d<char>& getMask() const { return mask; }
+
     Matrix& getMatrix() { return image.getMatrix(); }
     const Matrix& getMatrix() const { return image.getMatrix(); }
 };
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+namespace cam3d
+{
+namespace memory
+{
+// Alignment of buffers allocated by AccountingAllocator - one cache line,
+// enough for any SIMD load
+constexpr std::size_t alignment = 64;
+
+void* allocateAligned(std::size_t bytes);
+void deallocateAligned(void* p);
+
+// Process-wide counters of memory allocated through AccountingAllocator.
+// Counters are atomic and kept in MemoryAccounting.cpp, so that this header
+// may be included also by C++/CLI code.
+void recordAllocation(std::size_t bytes);
+void recordDeallocation(std::size_t bytes);
+
+std::size_t getCurrentBytes();
+std::size_t getPeakBytes();
+// Sets peak to current usage, so that high-water mark of next operation may be read
+void resetPeak();
+
+// Allocator for large buffers (arrays, images, path costs) which records
+// allocated bytes and aligns them to 'alignment'. Overhead is a few atomic
+// operations per allocation.
+template<typename T>
+class AccountingAllocator
+{
+public:
+    using value_type = T;
+
+    AccountingAllocator() = default;
+    template<typename U>
+    AccountingAllocator(const AccountingAllocator<U>&) { }
+
+    T* allocate(std::size_t n)
+    {
+        T* p = static_cast<T*>(allocateAligned(n * sizeof(T)));
+        recordAllocation(n * sizeof(T));
+        return p;
+    }
+
+    void deallocate(T* p, std::size_t n)
+    {
+        recordDeallocation(n * sizeof(T));
+        deallocateAligned(p);
+    }
+
+    template<typename U>
+    bool operator==(const AccountingAllocator<U>&) const { return true; }
+    template<typename U>
+    bool operator!=(const AccountingAllocator<U>&) const { return false; }
+};
+}
+}
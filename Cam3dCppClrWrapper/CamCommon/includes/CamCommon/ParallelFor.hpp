@@ -0,0 +1,250 @@
+#pragma once
+
+#include "PerPixelFunction.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+
+namespace cam3d
+{
+	// Parallel loops taking any callable, so that loop body is inlined instead of
+	// called through std::function for each pixel. Range is split into blocks which
+	// are claimed dynamically by calling thread and pool workers. Calling thread
+	// blocks until all blocks are done; first exception thrown by body is rethrown.
+
+	enum class ParallelPartition
+	{
+		RowBlocks, // Blocks of whole rows, 'grainRows' high
+		Tiles,     // Tiles of 'tileRows' x 'tileCols' - for bodies reading 2d neighbourhood
+	};
+
+	struct ParallelForOptions
+	{
+		ThreadPool* pool = nullptr; // If null, ThreadPool::getShared() is used
+		int maxTasks = 0;           // Threads working at once, including calling one. 0 means pool threads + 1
+		int grainRows = 0;          // Rows in one block. 0 means tuned from measured time of first row
+		ParallelPartition partition = ParallelPartition::RowBlocks;
+		int tileRows = 64;
+		int tileCols = 256;
+	};
+
+	namespace detail
+	{
+		// Blocks shorter than this are dominated by scheduling (~1us per block)
+		constexpr double minBlockNs = 20000.0;
+		// Blocks per thread, so that uneven rows are balanced
+		constexpr int blocksPerThread = 4;
+
+		class ParallelForState
+		{
+			using BlockInvoker = void(*)(void* body, int block);
+
+			void* body;
+			BlockInvoker invoke;
+			int blocksCount;
+			std::atomic<int> nextBlock;
+			std::atomic<int> doneBlocks;
+			std::atomic_bool failed;
+			std::mutex mutex;
+			std::condition_variable allDone;
+			std::exception_ptr error;
+
+		public:
+			ParallelForState(void* body, BlockInvoker invoke, int blocksCount) :
+				body{ body }, invoke{ invoke }, blocksCount{ blocksCount },
+				nextBlock{ 0 }, doneBlocks{ 0 }, failed{ false }
+			{ }
+
+			// Body is accessed only for claimed blocks, so late helpers never touch it
+			// after calling thread returned
+			void work()
+			{
+				for (int block = nextBlock.fetch_add(1); block < blocksCount; block = nextBlock.fetch_add(1))
+				{
+					if (!failed)
+					{
+						try
+						{
+							invoke(body, block);
+						}
+						catch (...)
+						{
+							std::lock_guard<std::mutex> lock(mutex);
+							if (error == nullptr) { error = std::current_exception(); }
+							failed = true;
+						}
+					}
+					if (doneBlocks.fetch_add(1) + 1 == blocksCount)
+					{
+						std::lock_guard<std::mutex> lock(mutex);
+						allDone.notify_all();
+					}
+				}
+			}
+
+			// All blocks are claimed when calling thread gets here, so it just waits
+			void wait()
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				allDone.wait(lock, [this]() { return doneBlocks.load() == blocksCount; });
+				if (error != nullptr)
+				{
+					std::rethrow_exception(error);
+				}
+			}
+		};
+
+		inline ThreadPool& getPool(const ParallelForOptions& options)
+		{
+			return options.pool != nullptr ? *options.pool : ThreadPool::getShared();
+		}
+
+		inline int getMaxTasks(const ParallelForOptions& options)
+		{
+			return options.maxTasks > 0 ? options.maxTasks : static_cast<int>(getPool(options).getThreadsCount()) + 1;
+		}
+
+		template<typename BlockFun>
+		void runBlocks(int blocksCount, BlockFun& runBlock, const ParallelForOptions& options)
+		{
+			int helpers = std::min(blocksCount, getMaxTasks(options)) - 1;
+			if (helpers <= 0)
+			{
+				for (int block = 0; block < blocksCount; ++block)
+				{
+					runBlock(block);
+				}
+				return;
+			}
+
+			auto state = std::make_shared<ParallelForState>(&runBlock,
+				[](void* body, int block) { (*static_cast<BlockFun*>(body))(block); }, blocksCount);
+			ThreadPool& pool = getPool(options);
+			for (int i = 0; i < helpers; ++i)
+			{
+				pool.post([state]() { state->work(); });
+			}
+			state->work();
+			state->wait();
+		}
+
+		// Highest of: grain giving blocks of at least minBlockNs and grain giving
+		// blocksPerThread blocks for each thread
+		inline int tuneGrainRows(double rowNs, int rows, int tasks)
+		{
+			double costGrain = minBlockNs / std::max(rowNs, 1.0);
+			int minGrain = static_cast<int>(std::min(costGrain, static_cast<double>(rows))) + 1;
+			int balanceGrain = rows / (tasks * blocksPerThread);
+			return std::max(1, std::max(minGrain, balanceGrain));
+		}
+	}
+
+	// Calls 'fun(rowStart, rowEnd)' for blocks of rows covering [startRow, endRow)
+	template<typename RowsFun>
+	void parallelForRows(int startRow, int endRow, RowsFun&& fun, const ParallelForOptions& options = {})
+	{
+		int grain = options.grainRows;
+		if (grain <= 0 && endRow > startRow)
+		{
+			auto start = std::chrono::steady_clock::now();
+			fun(startRow, startRow + 1);
+			double rowNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+			++startRow;
+			grain = detail::tuneGrainRows(rowNs, endRow - startRow, detail::getMaxTasks(options));
+		}
+		if (endRow <= startRow)
+		{
+			return;
+		}
+
+		int blocksCount = (endRow - startRow + grain - 1) / grain;
+		auto runBlock = [&fun, startRow, endRow, grain](int block)
+		{
+			int blockStart = startRow + block * grain;
+			fun(blockStart, std::min(endRow, blockStart + grain));
+		};
+		detail::runBlocks(blocksCount, runBlock, options);
+	}
+
+	// Calls 'fun(row, col)' for each pixel of 'rect', partitioned as in 'options'
+	template<typename PixelFun>
+	void parallelForPixels(PerPixelFunction::Rect rect, PixelFun&& fun, const ParallelForOptions& options = {})
+	{
+		if (rect.endRow <= rect.startRow || rect.endCol <= rect.startCol)
+		{
+			return;
+		}
+
+		if (options.partition == ParallelPartition::RowBlocks)
+		{
+			parallelForRows(rect.startRow, rect.endRow, [&fun, rect](int rowStart, int rowEnd)
+			{
+				for (int y = rowStart; y < rowEnd; ++y)
+				{
+					for (int x = rect.startCol; x < rect.endCol; ++x)
+					{
+						fun(y, x);
+					}
+				}
+			}, options);
+			return;
+		}
+
+		int tileRows = std::max(1, options.tileRows);
+		int tileCols = std::max(1, options.tileCols);
+		int tilesInRow = (rect.endCol - rect.startCol + tileCols - 1) / tileCols;
+		int tilesInCol = (rect.endRow - rect.startRow + tileRows - 1) / tileRows;
+		auto runTile = [&fun, rect, tileRows, tileCols, tilesInRow](int tile)
+		{
+			int startRow = rect.startRow + (tile / tilesInRow) * tileRows;
+			int startCol = rect.startCol + (tile % tilesInRow) * tileCols;
+			int endRow = std::min(rect.endRow, startRow + tileRows);
+			int endCol = std::min(rect.endCol, startCol + tileCols);
+			for (int y = startRow; y < endRow; ++y)
+			{
+				for (int x = startCol; x < endCol; ++x)
+				{
+					fun(y, x);
+				}
+			}
+		};
+		detail::runBlocks(tilesInRow * tilesInCol, runTile, options);
+	}
+
+	// Calls 'fun(row, col)' for pixels closer than 'borderWidth' / 'borderHeight' to image border
+	template<typename PixelFun>
+	void forBorderPixels(int borderWidth, int borderHeight, int rows, int cols, PixelFun&& fun)
+	{
+		// 1) Top border
+		for (int y = 0; y < std::min(borderHeight, rows); ++y)
+			for (int x = 0; x < cols; ++x)
+				fun(y, x);
+		// 2) Right border
+		for (int y = borderHeight; y < rows - borderHeight; ++y)
+			for (int x = std::max(borderWidth, cols - borderWidth); x < cols; ++x)
+				fun(y, x);
+		// 3) Bottom border
+		for (int y = std::max(borderHeight, rows - borderHeight); y < rows; ++y)
+			for (int x = 0; x < cols; ++x)
+				fun(y, x);
+		// 4) Left border
+		for (int y = borderHeight; y < rows - borderHeight; ++y)
+			for (int x = 0; x < std::min(borderWidth, cols); ++x)
+				fun(y, x);
+	}
+
+	// As PerPixelFunction::runWithBorder(), but 'mainFun' is run in parallel.
+	// Border is small, so 'borderFun' runs on calling thread
+	template<typename MainFun, typename BorderFun>
+	void parallelForPixelsWithBorder(MainFun&& mainFun, BorderFun&& borderFun,
+		int borderWidth, int borderHeight, int rows, int cols, const ParallelForOptions& options = {})
+	{
+		parallelForPixels({ borderHeight, borderWidth, rows - borderHeight, cols - borderWidth }, mainFun, options);
+		forBorderPixels(borderWidth, borderHeight, rows, cols, borderFun);
+	}
+}
@@ -5,6 +5,8 @@
 
 namespace cam3d
 {
+	// Per pixel loops calling std::function. For hot loops prefer templated
+	// parallelForPixels() / parallelForRows() from ParallelFor.hpp
 	struct PerPixelFunction
 	{
 		using FunctionType = std::function<void(int pixRow, int pixCol)>;
@@ -21,7 +23,8 @@ namespace cam3d
 
 		static void runForRect(FunctionType mainFun, Rect rect);
 
-		// Exectues funcs in parallel tasks - each task computes 'rowsInTask' rows
+		// Exectues funcs in parallel tasks - each task computes 'rowsInTask' rows.
+		// Tasks keep copies of functions, so they may outlive the call
 		static std::vector<Task> getParallelTasks(FunctionType mainFun, int rows, int cols, int rowsInTask, TaskId startId);
 
 		static std::vector<Task> getParallelTasksForRect(FunctionType mainFun, Rect rect, int rowsInTask, TaskId startId);
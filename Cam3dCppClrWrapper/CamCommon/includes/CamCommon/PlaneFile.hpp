@@ -0,0 +1,164 @@
+#pragma once
+
+#include "Array2d.hpp"
+#include "ColorImage.hpp"
+#include "DisparityMap.hpp"
+#include "GreyScaleImage.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cam3d
+{
+namespace io
+{
+// Binary file of named 2d planes, e.g. image, disparity records, confidence.
+// Layout (native little-endian): file header, table of plane headers, plane data.
+// Uncompressed plane starts at multiple of memory::alignment and its rows are padded
+// to it, so that mapped file is used in place as aligned array of borrowing container.
+// Compressed planes are decoded on read.
+enum class ElementType : std::uint32_t
+{
+    UInt8 = 1,
+    Float = 2,
+    Double = 3,
+    Disparity = 4, // cam3d::Disparity records
+    Int16 = 5,
+};
+
+enum class Compression : std::uint32_t
+{
+    None = 0,
+    // Bytes of elements in row are grouped by significance, then run-length encoded (PackBits).
+    // Cheap, pays off on masks, invalid regions and smooth planes; planes can not be mapped
+    ShuffledRle = 1,
+};
+
+std::size_t getElementSize(ElementType type);
+
+struct PlaneInfo
+{
+    std::string name;
+    ElementType type;
+    Compression compression;
+    int rows;
+    int cols;
+    int channels;               // Interleaved elements per pixel
+    std::uint64_t pitchBytes;   // Between rows of uncompressed plane
+    std::uint64_t offset;       // Of plane data in file
+    std::uint64_t storedBytes;
+
+    std::size_t getRowBytes() const { return static_cast<std::size_t>(cols) * channels * getElementSize(type); }
+};
+
+// Read-only file mapped with copy-on-write pages: mapped arrays may be modified
+// in memory, but file is never changed
+class MappedFile
+{
+    void* data;
+    std::size_t size;
+#if defined(_WIN32)
+    void* fileHandle;
+    void* mappingHandle;
+#endif
+
+public:
+    explicit MappedFile(const std::string& path); // Throws std::runtime_error
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    char* getData() const { return static_cast<char*>(data); }
+    std::size_t getSize() const { return size; }
+};
+
+// Streams planes to file row by row, so that memory used does not depend on plane size.
+// Plane table is written by close() - file is not valid before.
+class PlaneFileWriter
+{
+    std::FILE* file;
+    std::string path;
+    std::vector<PlaneInfo> planes;
+    std::size_t maxPlanes;
+    std::uint64_t position;
+    std::vector<char> rowBuffer;
+
+public:
+    PlaneFileWriter(const std::string& path, std::size_t maxPlanes); // Throws std::runtime_error
+    ~PlaneFileWriter();          // Closes file if close() was not called, ignoring errors
+
+    PlaneFileWriter(const PlaneFileWriter&) = delete;
+    PlaneFileWriter& operator=(const PlaneFileWriter&) = delete;
+
+    // Returns row 'r' of plane; pointer must be valid until next call
+    using RowSource = std::function<const void*(int r)>;
+
+    // 'data' is first element of first row, 'pitchBytes' are between rows
+    void writePlane(const std::string& name, ElementType type, int rows, int cols, int channels,
+        const void* data, std::size_t pitchBytes, Compression compression = Compression::None);
+    // For planes computed row by row, e.g. derived from other one
+    void writePlane(const std::string& name, ElementType type, int rows, int cols, int channels,
+        const RowSource& source, Compression compression = Compression::None);
+    void close();
+
+private:
+    void write(const void* bytes, std::size_t count);
+    void writeZeros(std::size_t count);
+};
+
+// Maps file and reads its plane table
+class PlaneFileReader
+{
+    std::shared_ptr<MappedFile> file;
+    std::vector<PlaneInfo> planes;
+
+public:
+    explicit PlaneFileReader(const std::string& path); // Throws std::runtime_error if file is not valid
+
+    const std::vector<PlaneInfo>& getPlanes() const { return planes; }
+    const PlaneInfo* findPlane(const std::string& name) const;
+    const PlaneInfo& getPlane(const std::string& name) const; // Throws std::runtime_error if missing
+
+    // Plane in mapped file, valid while file is kept (getFile()). nullptr if plane is compressed
+    void* getMappedData(const PlaneInfo& plane) const;
+    // Copies or decodes plane into caller's buffer of plane size
+    void readPlane(const PlaneInfo& plane, void* destination, std::size_t destinationPitchBytes) const;
+
+    const std::shared_ptr<MappedFile>& getFile() const { return file; }
+};
+
+// Content read from file. If its planes are not compressed, 'value' borrows mapped pages
+// and 'file' keeps them mapped - 'value' must not outlive it. Otherwise 'value' owns
+// decoded elements and 'file' is null.
+template<typename T>
+struct Loaded
+{
+    std::shared_ptr<MappedFile> file;
+    T value;
+};
+
+// Plane names used by functions below
+constexpr const char* greyPlaneName = "grey";
+constexpr const char* colorPlaneName = "color";
+constexpr const char* disparityPlaneName = "disparity";
+constexpr const char* confidencePlaneName = "confidence";
+
+void writeImage(const std::string& path, const GreyScaleImage& image, Compression compression = Compression::None);
+void writeImage(const std::string& path, const ColorImage& image, Compression compression = Compression::None);
+// With 'withConfidence', confidence of records (0 where not valid) is stored also as float
+// plane, for readers which need nothing else
+void writeDisparityMap(const std::string& path, const DisparityMap& map,
+    Compression compression = Compression::None, bool withConfidence = false);
+
+Loaded<GreyScaleImage> readGreyScaleImage(const std::string& path);
+Loaded<ColorImage> readColorImage(const std::string& path);
+Loaded<DisparityMap> readDisparityMap(const std::string& path);
+// Confidence plane, or confidence of disparity records if file has no such plane
+Loaded<Array2d<float>> readConfidence(const std::string& path);
+}
+}
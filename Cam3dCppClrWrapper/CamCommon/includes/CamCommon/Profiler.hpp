@@ -3,6 +3,25 @@
 #include <chrono>
 #include <string>
 #include <iostream>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Tracing of hot paths. Scopes are recorded only when built with CAM3D_ENABLE_TRACING,
+// otherwise macros expand to nothing. Names and argument names must be string literals.
+#if defined(CAM3D_ENABLE_TRACING)
+#define CAM3D_TRACE_CONCAT_IMPL(a, b) a##b
+#define CAM3D_TRACE_CONCAT(a, b) CAM3D_TRACE_CONCAT_IMPL(a, b)
+#define CAM3D_TRACE_SCOPE(name) \
+    ::cam3d::profiling::TraceScope CAM3D_TRACE_CONCAT(traceScope, __LINE__){ name }
+#define CAM3D_TRACE_SCOPE_ARG(name, argName, argValue) \
+    ::cam3d::profiling::TraceScope CAM3D_TRACE_CONCAT(traceScope, __LINE__){ name, argName, static_cast<std::int64_t>(argValue) }
+#define CAM3D_TRACE_THREAD_NAME(name) ::cam3d::profiling::Tracer::setThreadName(name)
+#else
+#define CAM3D_TRACE_SCOPE(name) ((void)0)
+#define CAM3D_TRACE_SCOPE_ARG(name, argName, argValue) ((void)0)
+#define CAM3D_TRACE_THREAD_NAME(name) ((void)0)
+#endif
 
 namespace cam3d
 {
@@ -56,5 +75,103 @@ namespace cam3d
                 *elapsedResult = clock.getElapsedMs();
             }
         };
+
+        struct TraceEvent
+        {
+            const char* name;
+            const char* argName; // Null if event have no argument
+            std::int64_t argValue;
+            std::uint64_t startNs;
+            std::uint64_t durationNs;
+        };
+
+        // Ring buffer of events of one thread: only owning thread writes to it,
+        // when full oldest events are overwritten
+        class TraceBuffer
+        {
+            std::vector<TraceEvent> events;
+            std::atomic<std::uint64_t> writeCount;
+
+        public:
+            const int threadIndex;
+            std::atomic<const char*> threadName;
+
+            TraceBuffer(std::size_t capacity, int threadIndex_) :
+                events(capacity),
+                writeCount{ 0 },
+                threadIndex{ threadIndex_ },
+                threadName{ nullptr }
+            { }
+
+            void push(const TraceEvent& e)
+            {
+                std::uint64_t idx = writeCount.load(std::memory_order_relaxed);
+                events[idx % events.size()] = e;
+                writeCount.store(idx + 1, std::memory_order_release);
+            }
+
+            // Returns events in recording order
+            std::vector<TraceEvent> snapshot() const;
+            void clear() { writeCount.store(0, std::memory_order_release); }
+        };
+
+        // Collects events of all threads. Buffers are kept after threads exit,
+        // so trace may be exported after thread pools are destroyed.
+        // Export/clear should be called when traced work is finished.
+        class Tracer
+        {
+        public:
+            static constexpr std::size_t eventsPerThread = 1 << 16;
+
+            static constexpr bool isEnabled()
+            {
+#if defined(CAM3D_ENABLE_TRACING)
+                return true;
+#else
+                return false;
+#endif
+            }
+
+            static std::uint64_t now()
+            {
+                return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - getEpoch()).count());
+            }
+
+            static void record(const TraceEvent& e) { getThreadBuffer().push(e); }
+            static void setThreadName(const char* name) { getThreadBuffer().threadName = name; }
+
+            // Writes Chrome trace_event JSON (chrome://tracing, Perfetto) with complete ("X") events
+            static void exportChromeTrace(std::ostream& stream);
+            static void clear();
+
+        private:
+            static TraceBuffer& getThreadBuffer();
+            static std::chrono::steady_clock::time_point getEpoch();
+        };
+
+        class TraceScope
+        {
+            const char* name;
+            const char* argName;
+            std::int64_t argValue;
+            std::uint64_t startNs;
+
+        public:
+            TraceScope(const char* name_, const char* argName_ = nullptr, std::int64_t argValue_ = 0) :
+                name{ name_ },
+                argName{ argName_ },
+                argValue{ argValue_ },
+                startNs{ Tracer::now() }
+            { }
+
+            ~TraceScope()
+            {
+                Tracer::record(TraceEvent{ name, argName, argValue, startNs, Tracer::now() - startNs });
+            }
+
+            TraceScope(const TraceScope&) = delete;
+            TraceScope& operator=(const TraceScope&) = delete;
+        };
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include "ThreadPool.hpp"
+
+namespace cam3d
+{
+using TaskId = std::size_t;
+
+struct Task
+{
+    TaskId id;
+    std::function<void()> task;
+
+	Task() {}
+	Task(TaskId id, std::function<void()> task) : id{id}, task{task} {}
+};
+
+// Tasks with dependencies, compiled once and run any number of times.
+// compile() validates ids and cycles and orders tasks by critical path: task with
+// longest chain of (estimated) cost behind it starts first when there are more
+// ready tasks than free slots. Between runs only atomic dependency counters are reset.
+// New inputs are passed to tasks through state they capture; graph must not be
+// run concurrently with itself.
+class TaskGraph
+{
+    using TaskIndex = std::size_t;
+    struct Node
+    {
+        Task task;
+        std::vector<TaskId> dependencies;
+        double cost;
+        double priority; // Cost of longest path from this task to end of graph
+        std::vector<TaskIndex> dependents; // Sorted by priority, highest first
+    };
+
+    std::vector<Node> nodes;
+    std::vector<TaskIndex> initialTasks; // Without dependencies, sorted by priority
+    std::unique_ptr<std::atomic<int>[]> dependencyCounters;
+    bool compiled;
+
+    ThreadPool* pool;
+    std::size_t maxRunningTasks;
+
+    std::mutex readyMutex;
+    std::vector<TaskIndex> readyTasks; // Heap by priority, waiting for one of 'maxRunningTasks' slots
+    std::size_t runningTasks;
+
+    std::mutex doneMutex;
+    std::condition_variable taskDone;
+    std::atomic<std::size_t> doneCount;
+    std::exception_ptr firstError;
+    std::atomic_bool failed;    // Task of current run threw
+    std::atomic_bool cancelled; // Kept over runs, so that cancel() racing with start of run() is not lost
+
+public:
+    TaskGraph();
+
+    // 'cost' is relative estimate of task duration used for ordering only
+    void addTask(Task task, const std::vector<TaskId>& dependencies, double cost = 1.0);
+    // Throws std::invalid_argument on duplicated or unknown task id or on dependency cycle.
+    // Called by run() if tasks were added since last compilation
+    void compile();
+    bool isCompiled() const { return compiled; }
+
+    // Blocks until all tasks are done, executing pending jobs of 'pool' meanwhile.
+    // If 'pool' is null, tasks run on ThreadPool::getShared(). Rethrows first exception
+    // thrown by a task, in which case remaining tasks are skipped
+    void run(std::size_t maxRunningTasks, ThreadPool* pool = nullptr);
+    // Tasks of current run which have not started yet are skipped, as are all tasks
+    // of following runs until reset()
+    void cancel() { cancelled = true; }
+    // Clears cancel(); must not be called concurrently with run()
+    void reset() { cancelled = false; }
+    bool isCancelled() const { return cancelled; }
+
+    std::size_t getTaskCount() const { return nodes.size(); }
+    std::size_t getTaskDoneCount() const { return doneCount; }
+
+private:
+    void schedule(TaskIndex idx);
+    void runTask(TaskIndex idx);
+    void execute(TaskIndex idx);
+    void waitForAll();
+    bool hasHigherPriority(TaskIndex a, TaskIndex b) const;
+};
+}
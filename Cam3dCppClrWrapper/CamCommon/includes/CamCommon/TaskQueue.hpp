@@ -3,68 +3,47 @@
 #include <vector>
 #include <initializer_list>
 #include <functional>
-#include <atomic>
-#include <future>
 #include <mutex>
-#include <map>
+#include <condition_variable>
+#include "TaskGraph.hpp"
+#include "ThreadPool.hpp"
+#include "Profiler.hpp"
 
 namespace cam3d
 {
-using TaskId = std::size_t;
-
-struct Task
-{
-    TaskId id;
-    std::function<void()> task;
-
-	Task() {}
-	Task(TaskId id, std::function<void()> task) : id{id}, task{task} {}
-};
-
+// Runs tasks with dependencies on thread pool. Finished task decrements atomic
+// counters of its dependents and posts those which became ready, so there is
+// no polling. Thread calling run() executes pending jobs of the pool while
+// waiting, so queues may be nested in tasks of the same pool.
+// Graph is compiled on first run() and reused by following runs.
 class StaticTaskQueue
 {
-    using TaskIndex = std::size_t;
-    struct Item
-    {
-        Task task;
-        TaskIndex index;
-        std::vector<TaskId> dependencies;
-        int dependencyCounter;
-    };
-
-    std::vector<std::future<TaskIndex>> runningTasks;
+    TaskGraph graph;
     std::size_t maxRunningTasks;
+    ThreadPool* pool;
 
-    std::vector<Item> allTasks;
-    std::vector<TaskIndex> readyTasks;
-    TaskIndex nextTaskIdx;
-
-    std::map<TaskId, TaskIndex> idToIndex;
-
-    using DependentOnList = std::vector<TaskIndex>;
-    std::vector<DependentOnList> dependencyGraph;
-
-    std::atomic_bool shouldEnd;
+	mutable std::mutex runningMutex;
+	std::condition_variable runFinished;
 	bool running;
 
 public:
-    StaticTaskQueue(std::size_t maxRunningTasks);
+    // If 'pool' is null, tasks run on ThreadPool::getShared()
+    StaticTaskQueue(std::size_t maxRunningTasks, ThreadPool* pool = nullptr);
+    // Cancels remaining tasks and waits for run() in progress to return
     ~StaticTaskQueue();
 
     void addTask(Task task, const std::vector<TaskId>& dependencies);
+    // Tasks which have not started yet are skipped, following runs do nothing
     void end();
+    // Blocks until all tasks are done. Rethrows first exception thrown by a task,
+    // in which case remaining tasks are skipped
     void run();
-    std::size_t getTaskCount() const { return allTasks.size(); }
-    std::size_t getTaskDoneCount() const { return nextTaskIdx; }
+    std::size_t getTaskCount() const { return graph.getTaskCount(); }
+    std::size_t getTaskDoneCount() const { return graph.getTaskDoneCount(); }
 	bool isAllDone() const;
-	bool isRunning() const { return running; }
+	bool isRunning() const;
 
 private:
-    bool isAllReadyQueued() const;
-    std::pair<TaskIndex, Task> getNextTask();
-    void runAvailableTasks();
-    void updateFinishedTasks();
-    void prepare();
-    void updateGraph(int doneIdx);
+	void setRunning(bool isRunning);
 };
 }
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <thread>
+
+namespace cam3d
+{
+// Fixed set of worker threads with work stealing. Each worker has its own deque:
+// jobs posted from a worker go to its deque and are taken back LIFO (so dependent
+// tasks run on warm caches), idle workers steal oldest jobs from other deques.
+// Jobs posted from other threads are spread over the deques round-robin.
+// May be shared by many StaticTaskQueues, so that concurrent algorithms
+// do not start more threads than there are cores.
+class ThreadPool
+{
+    struct WorkerQueue
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> jobs;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::atomic<std::size_t> queuedJobs;
+    std::atomic<std::size_t> nextQueue;
+
+    std::mutex sleepMutex;
+    std::condition_variable jobsAdded;
+    std::atomic<std::size_t> sleepingWorkers;
+    bool stopping;
+
+public:
+    // 0 threads means one per hardware thread
+    ThreadPool(std::size_t threadsCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Pool with one thread per hardware thread, created on first use
+    static ThreadPool& getShared();
+
+    void post(std::function<void()> job);
+
+    template<typename Fun>
+    auto submit(Fun fun) -> std::future<decltype(fun())>
+    {
+        using Result = decltype(fun());
+        auto job = std::make_shared<std::packaged_task<Result()>>(std::move(fun));
+        std::future<Result> result = job->get_future();
+        post([job]() { (*job)(); });
+        return result;
+    }
+
+    // Runs one queued job on calling thread, so that thread waiting for
+    // results helps instead of blocking. Returns false if no job was queued
+    bool tryRunPendingJob();
+
+    std::size_t getThreadsCount() const { return workers.size(); }
+
+private:
+    void workerLoop(std::size_t index);
+    bool tryPopJob(std::size_t ownIndex, std::function<void()>& job);
+    std::size_t getCurrentWorkerIndex() const;
+};
+}
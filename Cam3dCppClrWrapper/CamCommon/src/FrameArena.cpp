@@ -0,0 +1,243 @@
+#include "FrameArena.hpp"
+#include <algorithm>
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace cam3d
+{
+namespace memory
+{
+namespace
+{
+    constexpr std::size_t hugePageBytes = std::size_t{2} << 20;
+
+    std::size_t roundUp(std::size_t value, std::size_t multiple)
+    {
+        return (value + multiple - 1) / multiple * multiple;
+    }
+
+    // Returns nullptr if huge pages are not available at all
+    void* mapHugePages(std::size_t bytes, bool& explicitHugePages)
+    {
+#if defined(_WIN32)
+        // Needs SeLockMemoryPrivilege - without it allocation fails and regular pages are used
+        std::size_t largePage = GetLargePageMinimum();
+        if(largePage == 0 || bytes % largePage != 0)
+        {
+            return nullptr;
+        }
+        explicitHugePages = true;
+        return VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+#else
+#if defined(MAP_HUGETLB)
+        // Needs pages reserved in /proc/sys/vm/nr_hugepages
+        void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if(p != MAP_FAILED)
+        {
+            explicitHugePages = true;
+            return p;
+        }
+#endif
+        explicitHugePages = false;
+        void* q = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        return q != MAP_FAILED ? q : nullptr;
+#endif
+    }
+
+    void unmapPages(void* p, std::size_t bytes)
+    {
+#if defined(_WIN32)
+        (void)bytes;
+        VirtualFree(p, 0, MEM_RELEASE);
+#else
+        munmap(p, bytes);
+#endif
+    }
+}
+
+FrameArena::FrameArena(const FrameArenaOptions& options_) :
+    options{options_},
+    currentBlock{nullptr},
+    current{0},
+    passedBytes{0},
+    reservedBytes{0}
+{
+    options.blockBytes = std::max<std::size_t>(options.blockBytes, alignment);
+}
+
+FrameArena::~FrameArena()
+{
+    freeBlocks();
+}
+
+void* FrameArena::tryAllocate(Block& block, std::size_t bytes, std::size_t align)
+{
+    std::size_t offset = block.offset.load(std::memory_order_relaxed);
+    for(;;)
+    {
+        std::size_t start = roundUp(offset, align);
+        if(start + bytes > block.size)
+        {
+            return nullptr;
+        }
+        if(block.offset.compare_exchange_weak(offset, start + bytes, std::memory_order_relaxed))
+        {
+            return block.memory + start;
+        }
+    }
+}
+
+void* FrameArena::allocate(std::size_t bytes, std::size_t align)
+{
+    Block* block = currentBlock.load(std::memory_order_acquire);
+    if(block != nullptr)
+    {
+        if(void* p = tryAllocate(*block, bytes, align))
+        {
+            return p;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    // Other thread may have moved to next block meanwhile
+    while(current < blocks.size())
+    {
+        if(void* p = tryAllocate(*blocks[current], bytes, align))
+        {
+            return p;
+        }
+        if(current + 1 == blocks.size())
+        {
+            break;
+        }
+        // Rest of block is wasted until reset
+        passedBytes += blocks[current]->size;
+        ++current;
+        currentBlock.store(blocks[current].get(), std::memory_order_release);
+    }
+
+    // New block is published with this allocation already in it, so that
+    // concurrent bumps can not take its space first
+    std::unique_ptr<Block> added = allocateBlock(bytes);
+    added->offset.store(bytes, std::memory_order_relaxed);
+    if(!blocks.empty())
+    {
+        passedBytes += blocks[current]->size;
+    }
+    blocks.push_back(std::move(added));
+    current = blocks.size() - 1;
+    currentBlock.store(blocks[current].get(), std::memory_order_release);
+    return blocks[current]->memory;
+}
+
+void FrameArena::reset()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if(blocks.size() > 1)
+    {
+        std::size_t total = reservedBytes;
+        freeBlocks();
+        blocks.push_back(allocateBlock(total));
+    }
+    for(std::unique_ptr<Block>& block: blocks)
+    {
+        block->offset.store(0, std::memory_order_relaxed);
+    }
+    current = 0;
+    passedBytes = 0;
+    currentBlock.store(blocks.empty() ? nullptr : blocks[0].get(), std::memory_order_release);
+}
+
+void FrameArena::release()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    freeBlocks();
+    current = 0;
+    passedBytes = 0;
+    currentBlock.store(nullptr, std::memory_order_release);
+}
+
+std::size_t FrameArena::getUsedBytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return blocks.empty() ? 0 : passedBytes + blocks[current]->offset.load(std::memory_order_relaxed);
+}
+
+std::size_t FrameArena::getReservedBytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return reservedBytes;
+}
+
+bool FrameArena::usesHugePages() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::any_of(blocks.begin(), blocks.end(), [](const std::unique_ptr<Block>& b) { return b->hugePages; });
+}
+
+std::unique_ptr<FrameArena::Block> FrameArena::allocateBlock(std::size_t minBytes)
+{
+    std::unique_ptr<Block> result{new Block{}};
+    Block& block = *result;
+    block.memory = nullptr;
+    block.size = std::max(minBytes, options.blockBytes);
+    block.mapped = false;
+    block.hugePages = false;
+    block.offset.store(0, std::memory_order_relaxed);
+    if(options.hugePages)
+    {
+        std::size_t size = roundUp(block.size, hugePageBytes);
+        bool explicitHugePages = false;
+        void* p = mapHugePages(size, explicitHugePages);
+        if(p != nullptr)
+        {
+            block.memory = static_cast<char*>(p);
+            block.size = size;
+            block.mapped = true;
+            block.hugePages = explicitHugePages;
+#if defined(MADV_HUGEPAGE)
+            // Block is 2 MB multiple, so kernel may back it with transparent huge pages
+            block.hugePages = block.hugePages || madvise(p, size, MADV_HUGEPAGE) == 0;
+#endif
+        }
+    }
+    if(block.memory == nullptr)
+    {
+        block.size = roundUp(block.size, alignment);
+        block.memory = static_cast<char*>(allocateAligned(block.size));
+    }
+    recordAllocation(block.size);
+    reservedBytes += block.size;
+    return result;
+}
+
+void FrameArena::freeBlock(const Block& block)
+{
+    if(block.mapped)
+    {
+        unmapPages(block.memory, block.size);
+    }
+    else
+    {
+        deallocateAligned(block.memory);
+    }
+    recordDeallocation(block.size);
+    reservedBytes -= block.size;
+}
+
+void FrameArena::freeBlocks()
+{
+    for(const std::unique_ptr<Block>& block: blocks)
+    {
+        freeBlock(*block);
+    }
+    blocks.clear();
+}
+}
+}
@@ -0,0 +1,77 @@
+#include "MemoryAccounting.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+namespace cam3d
+{
+namespace memory
+{
+namespace
+{
+    std::atomic<std::size_t> currentBytes{0};
+    std::atomic<std::size_t> peakBytes{0};
+}
+
+void* allocateAligned(std::size_t bytes)
+{
+    if(bytes == 0)
+    {
+        bytes = alignment;
+    }
+#if defined(_WIN32)
+    void* p = _aligned_malloc(bytes, alignment);
+#else
+    void* p = nullptr;
+    if(posix_memalign(&p, alignment, bytes) != 0)
+    {
+        p = nullptr;
+    }
+#endif
+    if(p == nullptr)
+    {
+        throw std::bad_alloc{};
+    }
+    return p;
+}
+
+void deallocateAligned(void* p)
+{
+#if defined(_WIN32)
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+void recordAllocation(std::size_t bytes)
+{
+    std::size_t current = currentBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    std::size_t peak = peakBytes.load(std::memory_order_relaxed);
+    while(current > peak && !peakBytes.compare_exchange_weak(peak, current, std::memory_order_relaxed)) { }
+}
+
+void recordDeallocation(std::size_t bytes)
+{
+    currentBytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+std::size_t getCurrentBytes()
+{
+    return currentBytes.load(std::memory_order_relaxed);
+}
+
+std::size_t getPeakBytes()
+{
+    return peakBytes.load(std::memory_order_relaxed);
+}
+
+void resetPeak()
+{
+    peakBytes.store(currentBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+}
+}
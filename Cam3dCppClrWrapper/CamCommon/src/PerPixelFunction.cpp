@@ -22,15 +22,15 @@ namespace cam3d
 		for (int i = 0; i < taskCount - 1; ++i)
 		{
 			tasks[i].id = startId++;
-			tasks[i].task = [&mainFun, rowsInTask, &rect, i]()
+			tasks[i].task = [mainFun, rowsInTask, rect, i]()
 			{
-				runForRect(mainFun, { rect.startRow + rowsInTask * i, rect.startRow + rowsInTask * (i + 1), rect.startCol, rect.endCol });
+				runForRect(mainFun, { rect.startRow + rowsInTask * i, rect.startCol, rect.startRow + rowsInTask * (i + 1), rect.endCol });
 			};
 		}
 		tasks.back().id = startId;
-		tasks.back().task = [&mainFun, rowsInTask, &rect, taskCount]()
+		tasks.back().task = [mainFun, rowsInTask, rect, taskCount]()
 		{
-			runForRect(mainFun, { rect.startRow + rowsInTask * (taskCount - 1), rect.endRow, rect.startCol, rect.endCol});
+			runForRect(mainFun, { rect.startRow + rowsInTask * (taskCount - 1), rect.startCol, rect.endRow, rect.endCol});
 		};
 
 		return tasks;
@@ -38,12 +38,12 @@ namespace cam3d
 
 	void PerPixelFunction::run(FunctionType mainFun, int rows, int cols)
 	{
-		runForRect(mainFun, { 0, rows, 0, cols });
+		runForRect(mainFun, { 0, 0, rows, cols });
 	}
 
 	std::vector<Task> PerPixelFunction::getParallelTasks(FunctionType mainFun, int rows, int cols, int rowsInTask, TaskId startId)
 	{
-		return getParallelTasksForRect(mainFun, { 0, rows, 0, cols }, rowsInTask, startId);
+		return getParallelTasksForRect(mainFun, { 0, 0, rows, cols }, rowsInTask, startId);
 	}
 
 	void PerPixelFunction::runWithBorder(FunctionType mainFun, FunctionType borderFun,
@@ -81,10 +81,10 @@ namespace cam3d
 		int borderWidth, int borderHeight, int rows, int cols, int rowsInTask, TaskId startId)
 	{
 		std::vector<Task> tasks{ std::forward<std::vector<Task>>(
-			getParallelTasksForRect(mainFun, { borderHeight , rows - borderHeight, borderWidth, cols - borderWidth }, rowsInTask, startId))
+			getParallelTasksForRect(mainFun, { borderHeight, borderWidth, rows - borderHeight, cols - borderWidth }, rowsInTask, startId))
 		};
 
-		tasks.emplace_back(startId + tasks.size(), [&borderFun, borderHeight, borderWidth, rows, cols]() {
+		tasks.emplace_back(startId + tasks.size(), [borderFun, borderHeight, borderWidth, rows, cols]() {
 			// 1) Top border
 			for (int y = 0; y < borderHeight; ++y)
 				for (int x = 0; x < cols; ++x)
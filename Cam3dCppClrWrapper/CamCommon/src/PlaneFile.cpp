@@ -0,0 +1,575 @@
+#include "PlaneFile.hpp"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cam3d
+{
+namespace io
+{
+namespace
+{
+    constexpr char fileMagic[8] = {'C', 'A', 'M', '3', 'D', 'P', 'L', 'N'};
+    constexpr std::uint32_t fileVersion = 1;
+    constexpr std::uint32_t byteOrderMark = 0x01020304;
+
+    struct FileHeader
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t byteOrder;   // Reads back as byteOrderMark only with same endianness
+        std::uint32_t planeCount;
+        std::uint32_t reserved;
+        std::uint64_t planeTableOffset;
+    };
+
+    struct PlaneHeader
+    {
+        char name[32];             // Zero-terminated
+        std::uint32_t type;
+        std::uint32_t compression;
+        std::int32_t rows;
+        std::int32_t cols;
+        std::int32_t channels;
+        std::uint32_t reserved;
+        std::uint64_t pitchBytes;
+        std::uint64_t offset;
+        std::uint64_t storedBytes;
+    };
+
+    static_assert(sizeof(FileHeader) == 32, "FileHeader is stored as is");
+    static_assert(sizeof(PlaneHeader) == 80, "PlaneHeader is stored as is");
+
+    std::uint64_t roundUp(std::uint64_t value, std::uint64_t multiple)
+    {
+        return (value + multiple - 1) / multiple * multiple;
+    }
+
+    std::runtime_error fileError(const std::string& path, const std::string& message)
+    {
+        return std::runtime_error("Plane file '" + path + "': " + message);
+    }
+
+    // Byte 'b' of element 'i' goes to position b * count + i
+    void shuffle(const char* row, std::size_t count, std::size_t elementSize, char* shuffled)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            for (std::size_t b = 0; b < elementSize; ++b)
+            {
+                shuffled[b * count + i] = row[i * elementSize + b];
+            }
+        }
+    }
+
+    void unshuffle(const char* shuffled, std::size_t count, std::size_t elementSize, char* row)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            for (std::size_t b = 0; b < elementSize; ++b)
+            {
+                row[i * elementSize + b] = shuffled[b * count + i];
+            }
+        }
+    }
+
+    // PackBits: control byte n < 128 is followed by n + 1 literal bytes,
+    // n > 128 by one byte repeated 257 - n times
+    void encodeRle(const char* bytes, std::size_t count, std::vector<char>& encoded)
+    {
+        std::size_t i = 0;
+        while (i < count)
+        {
+            std::size_t run = 1;
+            while (i + run < count && run < 128 && bytes[i + run] == bytes[i]) { ++run; }
+            if (run >= 3)
+            {
+                encoded.push_back(static_cast<char>(257 - run));
+                encoded.push_back(bytes[i]);
+                i += run;
+                continue;
+            }
+
+            // Literals until next run of at least 3 bytes
+            std::size_t start = i;
+            while (i < count && i - start < 128)
+            {
+                if (i + 2 < count && bytes[i] == bytes[i + 1] && bytes[i] == bytes[i + 2]) { break; }
+                ++i;
+            }
+            encoded.push_back(static_cast<char>(i - start - 1));
+            encoded.insert(encoded.end(), bytes + start, bytes + i);
+        }
+    }
+
+    // Decodes exactly 'count' bytes, returns position after them
+    const char* decodeRle(const char* encoded, const char* end, char* bytes, std::size_t count)
+    {
+        std::size_t i = 0;
+        while (i < count)
+        {
+            if (encoded >= end) { return nullptr; }
+            unsigned char control = static_cast<unsigned char>(*encoded++);
+            if (control < 128)
+            {
+                std::size_t length = control + 1u;
+                if (length > count - i || length > static_cast<std::size_t>(end - encoded)) { return nullptr; }
+                std::memcpy(bytes + i, encoded, length);
+                encoded += length;
+                i += length;
+            }
+            else if (control > 128)
+            {
+                std::size_t length = 257u - control;
+                if (length > count - i || encoded >= end) { return nullptr; }
+                std::memset(bytes + i, *encoded++, length);
+                i += length;
+            }
+        }
+        return encoded;
+    }
+}
+
+std::size_t getElementSize(ElementType type)
+{
+    switch (type)
+    {
+    case ElementType::UInt8: return 1;
+    case ElementType::Float: return sizeof(float);
+    case ElementType::Double: return sizeof(double);
+    case ElementType::Disparity: return sizeof(Disparity);
+    case ElementType::Int16: return sizeof(std::int16_t);
+    }
+    return 0;
+}
+
+#if defined(_WIN32)
+MappedFile::MappedFile(const std::string& path) :
+    data{nullptr}, size{0}, fileHandle{INVALID_HANDLE_VALUE}, mappingHandle{nullptr}
+{
+    fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE)
+    {
+        throw fileError(path, "can not open");
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(fileHandle);
+        throw fileError(path, "empty or unreadable");
+    }
+    size = static_cast<std::size_t>(fileSize.QuadPart);
+    mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    data = mappingHandle != nullptr ? MapViewOfFile(mappingHandle, FILE_MAP_COPY, 0, 0, 0) : nullptr;
+    if (data == nullptr)
+    {
+        if (mappingHandle != nullptr) { CloseHandle(mappingHandle); }
+        CloseHandle(fileHandle);
+        throw fileError(path, "can not map");
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    UnmapViewOfFile(data);
+    CloseHandle(mappingHandle);
+    CloseHandle(fileHandle);
+}
+#else
+MappedFile::MappedFile(const std::string& path) :
+    data{nullptr}, size{0}
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw fileError(path, "can not open");
+    }
+    struct stat status;
+    if (fstat(fd, &status) != 0 || status.st_size == 0)
+    {
+        ::close(fd);
+        throw fileError(path, "empty or unreadable");
+    }
+    size = static_cast<std::size_t>(status.st_size);
+    // Private mapping: pages are shared with page cache until written to
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+    {
+        throw fileError(path, "can not map");
+    }
+    data = p;
+}
+
+MappedFile::~MappedFile()
+{
+    munmap(data, size);
+}
+#endif
+
+PlaneFileWriter::PlaneFileWriter(const std::string& path_, std::size_t maxPlanes_) :
+    file{nullptr},
+    path{path_},
+    maxPlanes{maxPlanes_},
+    position{0}
+{
+    file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr)
+    {
+        throw fileError(path, "can not create");
+    }
+    std::setvbuf(file, nullptr, _IOFBF, std::size_t{1} << 20);
+    // Header and table are rewritten by close()
+    writeZeros(static_cast<std::size_t>(roundUp(sizeof(FileHeader) + maxPlanes * sizeof(PlaneHeader), memory::alignment)));
+}
+
+PlaneFileWriter::~PlaneFileWriter()
+{
+    if (file != nullptr)
+    {
+        try { close(); }
+        catch (...) { }
+    }
+}
+
+void PlaneFileWriter::writePlane(const std::string& name, ElementType type, int rows, int cols, int channels,
+    const void* data, std::size_t pitchBytes, Compression compression)
+{
+    const char* first = static_cast<const char*>(data);
+    writePlane(name, type, rows, cols, channels, [first, pitchBytes](int r) { return first + r * pitchBytes; }, compression);
+}
+
+void PlaneFileWriter::writePlane(const std::string& name, ElementType type, int rows, int cols, int channels,
+    const RowSource& source, Compression compression)
+{
+    if (file == nullptr) { throw fileError(path, "already closed"); }
+    if (planes.size() == maxPlanes) { throw std::invalid_argument("More planes than declared for " + path); }
+    if (name.size() >= sizeof(PlaneHeader::name)) { throw std::invalid_argument("Plane name too long: " + name); }
+    if (rows < 0 || cols < 0 || channels < 1 || getElementSize(type) == 0) { throw std::invalid_argument("Invalid plane " + name); }
+
+    PlaneInfo plane{name, type, compression, rows, cols, channels, 0, 0, 0};
+    std::size_t rowBytes = plane.getRowBytes();
+
+    if (compression == Compression::None)
+    {
+        plane.pitchBytes = roundUp(rowBytes, memory::alignment);
+        plane.offset = position;
+        for (int r = 0; r < rows; ++r)
+        {
+            write(source(r), rowBytes);
+            writeZeros(static_cast<std::size_t>(plane.pitchBytes - rowBytes));
+        }
+    }
+    else
+    {
+        plane.pitchBytes = rowBytes;
+        plane.offset = position;
+        std::size_t elementSize = getElementSize(type);
+        std::size_t count = rowBytes / elementSize;
+        std::vector<char> shuffled(rowBytes);
+        for (int r = 0; r < rows; ++r)
+        {
+            shuffle(static_cast<const char*>(source(r)), count, elementSize, shuffled.data());
+            rowBuffer.clear();
+            encodeRle(shuffled.data(), rowBytes, rowBuffer);
+            write(rowBuffer.data(), rowBuffer.size());
+        }
+    }
+    plane.storedBytes = position - plane.offset;
+    // Next plane starts aligned
+    writeZeros(static_cast<std::size_t>(roundUp(position, memory::alignment) - position));
+    planes.push_back(plane);
+}
+
+void PlaneFileWriter::close()
+{
+    if (file == nullptr) { return; }
+
+    FileHeader header{};
+    std::memcpy(header.magic, fileMagic, sizeof(fileMagic));
+    header.version = fileVersion;
+    header.byteOrder = byteOrderMark;
+    header.planeCount = static_cast<std::uint32_t>(planes.size());
+    header.planeTableOffset = sizeof(FileHeader);
+
+    bool ok = std::fflush(file) == 0 && std::fseek(file, 0, SEEK_SET) == 0 &&
+        std::fwrite(&header, sizeof(header), 1, file) == 1;
+    for (const PlaneInfo& plane : planes)
+    {
+        PlaneHeader stored{};
+        std::memcpy(stored.name, plane.name.c_str(), plane.name.size());
+        stored.type = static_cast<std::uint32_t>(plane.type);
+        stored.compression = static_cast<std::uint32_t>(plane.compression);
+        stored.rows = plane.rows;
+        stored.cols = plane.cols;
+        stored.channels = plane.channels;
+        stored.pitchBytes = plane.pitchBytes;
+        stored.offset = plane.offset;
+        stored.storedBytes = plane.storedBytes;
+        ok = ok && std::fwrite(&stored, sizeof(stored), 1, file) == 1;
+    }
+    ok = std::fclose(file) == 0 && ok;
+    file = nullptr;
+    if (!ok)
+    {
+        throw fileError(path, "write failed");
+    }
+}
+
+void PlaneFileWriter::write(const void* bytes, std::size_t count)
+{
+    if (count > 0 && std::fwrite(bytes, 1, count, file) != count)
+    {
+        throw fileError(path, "write failed");
+    }
+    position += count;
+}
+
+void PlaneFileWriter::writeZeros(std::size_t count)
+{
+    static const char zeros[memory::alignment] = {};
+    while (count > 0)
+    {
+        std::size_t chunk = std::min(count, sizeof(zeros));
+        write(zeros, chunk);
+        count -= chunk;
+    }
+}
+
+PlaneFileReader::PlaneFileReader(const std::string& path) :
+    file{std::make_shared<MappedFile>(path)}
+{
+    const char* data = file->getData();
+    std::size_t size = file->getSize();
+
+    FileHeader header;
+    if (size < sizeof(header)) { throw fileError(path, "not a plane file"); }
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, fileMagic, sizeof(fileMagic)) != 0) { throw fileError(path, "not a plane file"); }
+    if (header.byteOrder != byteOrderMark) { throw fileError(path, "written with other byte order"); }
+    if (header.version != fileVersion) { throw fileError(path, "unsupported version " + std::to_string(header.version)); }
+    if (header.planeTableOffset > size || (size - header.planeTableOffset) / sizeof(PlaneHeader) < header.planeCount)
+    {
+        throw fileError(path, "truncated plane table");
+    }
+
+    for (std::uint32_t i = 0; i < header.planeCount; ++i)
+    {
+        PlaneHeader stored;
+        std::memcpy(&stored, data + header.planeTableOffset + i * sizeof(PlaneHeader), sizeof(stored));
+        stored.name[sizeof(stored.name) - 1] = '\0';
+
+        PlaneInfo plane{stored.name, static_cast<ElementType>(stored.type), static_cast<Compression>(stored.compression),
+            stored.rows, stored.cols, stored.channels, stored.pitchBytes, stored.offset, stored.storedBytes};
+        if (getElementSize(plane.type) == 0 ||
+            (plane.compression != Compression::None && plane.compression != Compression::ShuffledRle) ||
+            plane.rows < 0 || plane.cols < 0 || plane.channels < 1 ||
+            plane.pitchBytes < plane.getRowBytes() ||
+            plane.offset > size || plane.storedBytes > size - plane.offset)
+        {
+            throw fileError(path, "invalid plane '" + plane.name + "'");
+        }
+        if (plane.compression == Compression::None && plane.rows > 0 &&
+            (plane.pitchBytes / getElementSize(plane.type) > static_cast<std::uint64_t>(std::numeric_limits<int>::max()) ||
+            (plane.rows > 1 && plane.pitchBytes > plane.storedBytes) ||
+            plane.pitchBytes * (plane.rows - 1) + plane.getRowBytes() > plane.storedBytes))
+        {
+            throw fileError(path, "truncated plane '" + plane.name + "'");
+        }
+        planes.push_back(plane);
+    }
+}
+
+const PlaneInfo* PlaneFileReader::findPlane(const std::string& name) const
+{
+    auto it = std::find_if(planes.begin(), planes.end(), [&name](const PlaneInfo& p) { return p.name == name; });
+    return it != planes.end() ? &*it : nullptr;
+}
+
+const PlaneInfo& PlaneFileReader::getPlane(const std::string& name) const
+{
+    const PlaneInfo* plane = findPlane(name);
+    if (plane == nullptr)
+    {
+        throw std::runtime_error("Plane file has no plane '" + name + "'");
+    }
+    return *plane;
+}
+
+void* PlaneFileReader::getMappedData(const PlaneInfo& plane) const
+{
+    // Element alignment is required to use mapped plane as array
+    bool aligned = plane.offset % getElementSize(plane.type) == 0 && plane.pitchBytes % getElementSize(plane.type) == 0;
+    return plane.compression == Compression::None && aligned ? file->getData() + plane.offset : nullptr;
+}
+
+void PlaneFileReader::readPlane(const PlaneInfo& plane, void* destination, std::size_t destinationPitchBytes) const
+{
+    std::size_t rowBytes = plane.getRowBytes();
+    const char* source = file->getData() + plane.offset;
+    char* target = static_cast<char*>(destination);
+
+    if (plane.compression == Compression::None)
+    {
+        for (int r = 0; r < plane.rows; ++r)
+        {
+            std::memcpy(target + r * destinationPitchBytes, source + r * plane.pitchBytes, rowBytes);
+        }
+        return;
+    }
+
+    const char* end = source + plane.storedBytes;
+    std::size_t elementSize = getElementSize(plane.type);
+    std::vector<char> shuffled(rowBytes);
+    for (int r = 0; r < plane.rows; ++r)
+    {
+        source = decodeRle(source, end, shuffled.data(), rowBytes);
+        if (source == nullptr)
+        {
+            throw std::runtime_error("Plane '" + plane.name + "' is corrupted");
+        }
+        unshuffle(shuffled.data(), rowBytes / elementSize, elementSize, target + r * destinationPitchBytes);
+    }
+}
+
+namespace
+{
+    void checkPlane(const PlaneInfo& plane, ElementType type, int channels)
+    {
+        if (plane.type != type || plane.channels != channels)
+        {
+            throw std::runtime_error("Plane '" + plane.name + "' has unexpected element type");
+        }
+    }
+
+    int toPitch(const PlaneInfo& plane)
+    {
+        return static_cast<int>(plane.pitchBytes / getElementSize(plane.type));
+    }
+}
+
+void writeImage(const std::string& path, const GreyScaleImage& image, Compression compression)
+{
+    const GreyScaleImage::Matrix& m = image.getMatrix();
+    PlaneFileWriter writer{path, 1};
+    writer.writePlane(greyPlaneName, ElementType::Double, m.getRowCount(), m.getColumnCount(), 1,
+        m.getData(), m.getPitch() * sizeof(double), compression);
+    writer.close();
+}
+
+void writeImage(const std::string& path, const ColorImage& image, Compression compression)
+{
+    const ColorImage::Matrix& m = image.getMatrix();
+    PlaneFileWriter writer{path, 1};
+    writer.writePlane(colorPlaneName, ElementType::Double, m.getRowCount(), m.getColumnCount(), m.getDimCount(),
+        m.getData(), m.getPitch() * sizeof(double), compression);
+    writer.close();
+}
+
+void writeDisparityMap(const std::string& path, const DisparityMap& map, Compression compression, bool withConfidence)
+{
+    PlaneFileWriter writer{path, withConfidence ? 2u : 1u};
+    writer.writePlane(disparityPlaneName, ElementType::Disparity, map.getRowCount(), map.getColumnCount(), 1,
+        map.getData(), map.getPitch() * sizeof(Disparity), compression);
+    if (withConfidence)
+    {
+        // Computed into single row, so that it is streamed as well
+        std::vector<float> confidence(map.getColumnCount());
+        writer.writePlane(confidencePlaneName, ElementType::Float, map.getRowCount(), map.getColumnCount(), 1,
+            [&map, &confidence](int r)
+            {
+                const Disparity* row = map.getRow(r);
+                for (std::size_t c = 0; c < confidence.size(); ++c)
+                {
+                    confidence[c] = row[c].flags == Disparity::Valid ? static_cast<float>(row[c].confidence) : 0.0f;
+                }
+                return static_cast<const void*>(confidence.data());
+            }, compression);
+    }
+    writer.close();
+}
+
+Loaded<GreyScaleImage> readGreyScaleImage(const std::string& path)
+{
+    PlaneFileReader reader{path};
+    const PlaneInfo& plane = reader.getPlane(greyPlaneName);
+    checkPlane(plane, ElementType::Double, 1);
+    if (void* mapped = reader.getMappedData(plane))
+    {
+        return {reader.getFile(), GreyScaleImage{static_cast<double*>(mapped), plane.rows, plane.cols, toPitch(plane)}};
+    }
+    GreyScaleImage image{plane.rows, plane.cols};
+    reader.readPlane(plane, image.getMatrix().getData(), image.getMatrix().getPitch() * sizeof(double));
+    return {nullptr, std::move(image)};
+}
+
+Loaded<ColorImage> readColorImage(const std::string& path)
+{
+    PlaneFileReader reader{path};
+    const PlaneInfo& plane = reader.getPlane(colorPlaneName);
+    checkPlane(plane, ElementType::Double, 3);
+    if (void* mapped = reader.getMappedData(plane))
+    {
+        return {reader.getFile(), ColorImage{static_cast<double*>(mapped), plane.rows, plane.cols, toPitch(plane)}};
+    }
+    ColorImage image{plane.rows, plane.cols};
+    reader.readPlane(plane, image.getMatrix().getData(), image.getMatrix().getPitch() * sizeof(double));
+    return {nullptr, std::move(image)};
+}
+
+Loaded<DisparityMap> readDisparityMap(const std::string& path)
+{
+    PlaneFileReader reader{path};
+    const PlaneInfo& plane = reader.getPlane(disparityPlaneName);
+    checkPlane(plane, ElementType::Disparity, 1);
+    if (void* mapped = reader.getMappedData(plane))
+    {
+        return {reader.getFile(), DisparityMap{borrowed, static_cast<Disparity*>(mapped), plane.rows, plane.cols, toPitch(plane)}};
+    }
+    DisparityMap map{plane.rows, plane.cols, uninitialized};
+    reader.readPlane(plane, map.getData(), map.getPitch() * sizeof(Disparity));
+    return {nullptr, std::move(map)};
+}
+
+Loaded<Array2d<float>> readConfidence(const std::string& path)
+{
+    PlaneFileReader reader{path};
+    if (const PlaneInfo* plane = reader.findPlane(confidencePlaneName))
+    {
+        checkPlane(*plane, ElementType::Float, 1);
+        if (void* mapped = reader.getMappedData(*plane))
+        {
+            return {reader.getFile(), Array2d<float>{borrowed, static_cast<float*>(mapped), plane->rows, plane->cols, toPitch(*plane)}};
+        }
+        Array2d<float> confidence{plane->rows, plane->cols, uninitialized};
+        reader.readPlane(*plane, confidence.getData(), confidence.getPitch() * sizeof(float));
+        return {nullptr, std::move(confidence)};
+    }
+
+    Loaded<DisparityMap> map = readDisparityMap(path);
+    Array2d<float> confidence{map.value.getRowCount(), map.value.getColumnCount(), uninitialized};
+    for (int r = 0; r < confidence.getRowCount(); ++r)
+    {
+        for (int c = 0; c < confidence.getColumnCount(); ++c)
+        {
+            const Disparity& d = map.value(r, c);
+            confidence(r, c) = d.flags == Disparity::Valid ? static_cast<float>(d.confidence) : 0.0f;
+        }
+    }
+    return {nullptr, std::move(confidence)};
+}
+}
+}
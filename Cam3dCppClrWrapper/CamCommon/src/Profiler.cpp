@@ -0,0 +1,119 @@
+#include "Profiler.hpp"
+#include <memory>
+#include <mutex>
+#include <iomanip>
+
+namespace cam3d
+{
+namespace profiling
+{
+    namespace
+    {
+        struct TraceRegistry
+        {
+            std::mutex mutex;
+            std::vector<std::unique_ptr<TraceBuffer>> buffers;
+        };
+
+        TraceRegistry& getRegistry()
+        {
+            // Never destroyed, so that threads ending during static destruction may still record
+            static TraceRegistry* registry = new TraceRegistry{};
+            return *registry;
+        }
+
+        void writeEscaped(std::ostream& stream, const char* text)
+        {
+            for(; *text != '\0'; ++text)
+            {
+                if(*text == '"' || *text == '\\') { stream << '\\'; }
+                stream << *text;
+            }
+        }
+    }
+
+    std::vector<TraceEvent> TraceBuffer::snapshot() const
+    {
+        std::uint64_t count = writeCount.load(std::memory_order_acquire);
+        std::uint64_t capacity = events.size();
+        std::uint64_t first = count > capacity ? count - capacity : 0;
+
+        std::vector<TraceEvent> result;
+        result.reserve(static_cast<std::size_t>(count - first));
+        for(std::uint64_t i = first; i < count; ++i)
+        {
+            result.push_back(events[i % capacity]);
+        }
+        return result;
+    }
+
+    std::chrono::steady_clock::time_point Tracer::getEpoch()
+    {
+        static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+        return epoch;
+    }
+
+    TraceBuffer& Tracer::getThreadBuffer()
+    {
+        thread_local TraceBuffer* buffer = nullptr;
+        if(buffer == nullptr)
+        {
+            TraceRegistry& registry = getRegistry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            int index = static_cast<int>(registry.buffers.size());
+            registry.buffers.emplace_back(new TraceBuffer{ eventsPerThread, index });
+            buffer = registry.buffers.back().get();
+        }
+        return *buffer;
+    }
+
+    void Tracer::exportChromeTrace(std::ostream& stream)
+    {
+        TraceRegistry& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        stream << std::fixed << std::setprecision(3);
+        stream << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+        bool isFirst = true;
+        for(const std::unique_ptr<TraceBuffer>& buffer : registry.buffers)
+        {
+            const char* threadName = buffer->threadName.load();
+            if(threadName != nullptr)
+            {
+                stream << (isFirst ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": "
+                    << buffer->threadIndex << ", \"args\": {\"name\": \"";
+                writeEscaped(stream, threadName);
+                stream << "\"}}";
+                isFirst = false;
+            }
+
+            for(const TraceEvent& e : buffer->snapshot())
+            {
+                stream << (isFirst ? "" : ",\n") << "{\"name\": \"";
+                writeEscaped(stream, e.name);
+                stream << "\", \"cat\": \"cam3d\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->threadIndex
+                    << ", \"ts\": " << e.startNs / 1000.0 << ", \"dur\": " << e.durationNs / 1000.0;
+                if(e.argName != nullptr)
+                {
+                    stream << ", \"args\": {\"";
+                    writeEscaped(stream, e.argName);
+                    stream << "\": " << e.argValue << "}";
+                }
+                stream << "}";
+                isFirst = false;
+            }
+        }
+        stream << "\n]}\n";
+    }
+
+    void Tracer::clear()
+    {
+        TraceRegistry& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for(const std::unique_ptr<TraceBuffer>& buffer : registry.buffers)
+        {
+            buffer->clear();
+        }
+    }
+}
+}
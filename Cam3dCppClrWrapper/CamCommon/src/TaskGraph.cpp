@@ -0,0 +1,247 @@
+#include "TaskGraph.hpp"
+#include "Profiler.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+namespace cam3d
+{
+TaskGraph::TaskGraph() :
+    compiled{false},
+    pool{nullptr},
+    maxRunningTasks{1},
+    runningTasks{0},
+    doneCount{0},
+    failed{false},
+    cancelled{false}
+{ }
+
+void TaskGraph::addTask(Task task, const std::vector<TaskId>& dependencies, double cost)
+{
+    nodes.push_back({task, dependencies, cost, 0.0, {}});
+    compiled = false;
+}
+
+bool TaskGraph::hasHigherPriority(TaskIndex a, TaskIndex b) const
+{
+    // Ties keep order in which tasks were added
+    return nodes[a].priority > nodes[b].priority || (nodes[a].priority == nodes[b].priority && a < b);
+}
+
+void TaskGraph::compile()
+{
+    std::unordered_map<TaskId, TaskIndex> idToIndex;
+    for(TaskIndex idx = 0; idx < nodes.size(); ++idx)
+    {
+        nodes[idx].dependents.clear();
+        if(!idToIndex.emplace(nodes[idx].task.id, idx).second)
+        {
+            throw std::invalid_argument("Duplicated task id " + std::to_string(nodes[idx].task.id));
+        }
+    }
+
+    std::vector<int> counters(nodes.size());
+    for(TaskIndex idx = 0; idx < nodes.size(); ++idx)
+    {
+        for(TaskId dId: nodes[idx].dependencies)
+        {
+            auto dependency = idToIndex.find(dId);
+            if(dependency == idToIndex.end())
+            {
+                throw std::invalid_argument("Task " + std::to_string(nodes[idx].task.id) +
+                    " depends on unknown task " + std::to_string(dId));
+            }
+            nodes[dependency->second].dependents.push_back(idx);
+        }
+        counters[idx] = static_cast<int>(nodes[idx].dependencies.size());
+    }
+
+    // Kahn's algorithm - tasks left unvisited are on a cycle
+    std::vector<TaskIndex> order;
+    order.reserve(nodes.size());
+    for(TaskIndex idx = 0; idx < nodes.size(); ++idx)
+    {
+        if(counters[idx] == 0)
+        {
+            order.push_back(idx);
+        }
+    }
+    for(std::size_t i = 0; i < order.size(); ++i)
+    {
+        for(TaskIndex dependent: nodes[order[i]].dependents)
+        {
+            if(--counters[dependent] == 0)
+            {
+                order.push_back(dependent);
+            }
+        }
+    }
+    if(order.size() != nodes.size())
+    {
+        for(TaskIndex idx = 0; idx < nodes.size(); ++idx)
+        {
+            if(counters[idx] > 0)
+            {
+                throw std::invalid_argument("Dependency cycle through task " + std::to_string(nodes[idx].task.id));
+            }
+        }
+    }
+
+    for(auto it = order.rbegin(); it != order.rend(); ++it)
+    {
+        Node& node = nodes[*it];
+        double longestAfter = 0.0;
+        for(TaskIndex dependent: node.dependents)
+        {
+            longestAfter = std::max(longestAfter, nodes[dependent].priority);
+        }
+        node.priority = node.cost + longestAfter;
+    }
+
+    auto byPriority = [this](TaskIndex a, TaskIndex b) { return hasHigherPriority(a, b); };
+    initialTasks.clear();
+    for(TaskIndex idx = 0; idx < nodes.size(); ++idx)
+    {
+        std::sort(nodes[idx].dependents.begin(), nodes[idx].dependents.end(), byPriority);
+        if(nodes[idx].dependencies.empty())
+        {
+            initialTasks.push_back(idx);
+        }
+    }
+    std::sort(initialTasks.begin(), initialTasks.end(), byPriority);
+
+    dependencyCounters.reset(new std::atomic<int>[nodes.size()]);
+    readyTasks.reserve(nodes.size());
+    compiled = true;
+}
+
+void TaskGraph::run(std::size_t maxRunningTasks_, ThreadPool* pool_)
+{
+    CAM3D_TRACE_SCOPE("TaskGraph.Run");
+    if(!compiled)
+    {
+        compile();
+    }
+
+    pool = pool_ != nullptr ? pool_ : &ThreadPool::getShared();
+    maxRunningTasks = std::max<std::size_t>(1, maxRunningTasks_);
+    for(TaskIndex idx = 0; idx < nodes.size(); ++idx)
+    {
+        dependencyCounters[idx].store(static_cast<int>(nodes[idx].dependencies.size()), std::memory_order_relaxed);
+    }
+    readyTasks.clear();
+    runningTasks = 0;
+    doneCount = 0;
+    firstError = nullptr;
+    failed = false;
+
+    for(TaskIndex idx: initialTasks)
+    {
+        schedule(idx);
+    }
+    waitForAll();
+
+    if(firstError != nullptr)
+    {
+        std::rethrow_exception(firstError);
+    }
+}
+
+void TaskGraph::schedule(TaskIndex idx)
+{
+    {
+        std::lock_guard<std::mutex> lock(readyMutex);
+        if(runningTasks >= maxRunningTasks)
+        {
+            readyTasks.push_back(idx);
+            std::push_heap(readyTasks.begin(), readyTasks.end(),
+                [this](TaskIndex a, TaskIndex b) { return hasHigherPriority(b, a); });
+            return;
+        }
+        ++runningTasks;
+    }
+    pool->post([this, idx]() { runTask(idx); });
+}
+
+void TaskGraph::runTask(TaskIndex idx)
+{
+    execute(idx);
+
+    for(TaskIndex dependent: nodes[idx].dependents)
+    {
+        if(dependencyCounters[dependent].fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            schedule(dependent);
+        }
+    }
+
+    // Slot of this task is passed to waiting task with highest priority, if any
+    bool hasNext = false;
+    TaskIndex next = 0;
+    {
+        std::lock_guard<std::mutex> lock(readyMutex);
+        if(readyTasks.empty())
+        {
+            --runningTasks;
+        }
+        else
+        {
+            hasNext = true;
+            std::pop_heap(readyTasks.begin(), readyTasks.end(),
+                [this](TaskIndex a, TaskIndex b) { return hasHigherPriority(b, a); });
+            next = readyTasks.back();
+            readyTasks.pop_back();
+        }
+    }
+    if(hasNext)
+    {
+        pool->post([this, next]() { runTask(next); });
+    }
+
+    // Last access to this graph - run() may return as soon as lock is released
+    std::lock_guard<std::mutex> lock(doneMutex);
+    ++doneCount;
+    taskDone.notify_all();
+}
+
+void TaskGraph::execute(TaskIndex idx)
+{
+    if(failed || cancelled)
+    {
+        return;
+    }
+
+    CAM3D_TRACE_SCOPE_ARG("TaskGraph.Task", "id", nodes[idx].task.id);
+    try
+    {
+        nodes[idx].task.task();
+    }
+    catch(...)
+    {
+        std::lock_guard<std::mutex> lock(doneMutex);
+        if(firstError == nullptr)
+        {
+            firstError = std::current_exception();
+        }
+        failed = true;
+    }
+}
+
+void TaskGraph::waitForAll()
+{
+    std::size_t seenDone;
+    while((seenDone = doneCount.load()) < nodes.size())
+    {
+        if(pool->tryRunPendingJob())
+        {
+            continue;
+        }
+        // Each finished task may have posted its dependents, so check for jobs again after it
+        std::unique_lock<std::mutex> lock(doneMutex);
+        taskDone.wait(lock, [this, seenDone]() { return doneCount.load() != seenDone; });
+    }
+    // Wait until last task releases 'doneMutex'
+    std::lock_guard<std::mutex> lock(doneMutex);
+}
+}
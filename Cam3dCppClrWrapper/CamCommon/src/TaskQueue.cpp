@@ -2,120 +2,67 @@
 
 namespace cam3d
 {
-StaticTaskQueue::StaticTaskQueue(std::size_t maxRunningTasks) :
+StaticTaskQueue::StaticTaskQueue(std::size_t maxRunningTasks, ThreadPool* pool) :
     maxRunningTasks{maxRunningTasks},
-    nextTaskIdx{0},
-    shouldEnd{false},
+    pool{pool},
 	running{false}
 { }
 
 StaticTaskQueue::~StaticTaskQueue()
 {
     end();
-	while (isRunning()) { std::this_thread::yield(); } // ??
+	std::unique_lock<std::mutex> lock{ runningMutex };
+	runFinished.wait(lock, [this]() { return !running; });
 }
 
 void StaticTaskQueue::addTask(Task task, const std::vector<TaskId>& dependencies)
 {
-    idToIndex[task.id] = allTasks.size();
-    allTasks.push_back({task, allTasks.size(), dependencies, (int)dependencies.size()});
-}
-
-bool StaticTaskQueue::isAllReadyQueued() const
-{
-    return readyTasks.size() == nextTaskIdx;
+    graph.addTask(task, dependencies);
 }
 
 bool StaticTaskQueue::isAllDone() const
 {
-	return nextTaskIdx == allTasks.size() && runningTasks.empty();
-}
-
-void StaticTaskQueue::end()
-{
-    shouldEnd = true;
+	return graph.getTaskDoneCount() == graph.getTaskCount();
 }
 
-void StaticTaskQueue::run()
+bool StaticTaskQueue::isRunning() const
 {
-	running = true;
-    prepare();
-    while(!(shouldEnd || isAllDone()))
-    {
-        runAvailableTasks();
-        updateFinishedTasks();
-    }
-	running = false;
+	std::lock_guard<std::mutex> lock{ runningMutex };
+	return running;
 }
 
-std::pair<StaticTaskQueue::TaskIndex, Task> StaticTaskQueue::getNextTask()
+void StaticTaskQueue::setRunning(bool isRunning)
 {
-    nextTaskIdx++;
-    return {nextTaskIdx-1, allTasks[readyTasks[nextTaskIdx-1]].task};
+	{
+		std::lock_guard<std::mutex> lock{ runningMutex };
+		running = isRunning;
+	}
+	if (!isRunning) { runFinished.notify_all(); }
 }
 
-void StaticTaskQueue::runAvailableTasks()
+void StaticTaskQueue::end()
 {
-    while(runningTasks.size() < maxRunningTasks && !isAllReadyQueued())
-    {
-        std::pair<TaskIndex, Task> nextTask = getNextTask();
-        std::future<TaskIndex> result = std::async(std::launch::async, [nextTask]()
-        {
-            nextTask.second.task();
-            return nextTask.first;
-        });
-        runningTasks.push_back(std::move(result));
-    }
+    // Cancellation of graph is kept over runs, so end() racing with run() is not lost
+    graph.cancel();
 }
 
-void StaticTaskQueue::updateFinishedTasks()
+void StaticTaskQueue::run()
 {
-    std::vector<std::future<TaskIndex>> remainingTasks{};
-    for(std::size_t i = 0; i < runningTasks.size(); ++i)
+    if(graph.isCancelled())
     {
-        if(runningTasks[i].wait_for(std::chrono::milliseconds(1)) == std::future_status::ready)
-        {
-            int doneIdx = runningTasks[i].get();
-            updateGraph(doneIdx);
-        }
-        else
-        {
-            remainingTasks.push_back(std::move(runningTasks[i]));
-        }
+        return;
     }
-    runningTasks = std::move(remainingTasks);
-}
-
-void StaticTaskQueue::prepare()
-{
-    dependencyGraph.resize(allTasks.size());
-    for(TaskIndex idx = 0; idx < allTasks.size(); ++idx)
+	setRunning(true);
+    try
     {
-        if(allTasks[idx].dependencies.size() == 0)
-        {
-            readyTasks.push_back(idx);
-        }
-        else
-        {
-            for(TaskId dId: allTasks[idx].dependencies)
-            {
-                dependencyGraph[idToIndex[dId]].push_back(idx);
-            }
-        }
+        graph.run(maxRunningTasks, pool);
     }
-}
-
-void StaticTaskQueue::updateGraph(int doneIdx)
-{
-    DependentOnList& dependentsOnDone = dependencyGraph[readyTasks[doneIdx]];
-    for(TaskIndex idx: dependentsOnDone)
+    catch(...)
     {
-        allTasks[idx].dependencyCounter--;
-        if(allTasks[idx].dependencyCounter == 0)
-        {
-            readyTasks.push_back(idx);
-        }
+        setRunning(false);
+        throw;
     }
+	setRunning(false);
 }
 
 }
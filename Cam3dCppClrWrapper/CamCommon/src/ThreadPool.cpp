@@ -0,0 +1,151 @@
+#include "ThreadPool.hpp"
+#include "Profiler.hpp"
+#include <algorithm>
+
+namespace cam3d
+{
+namespace
+{
+    // Set for worker threads, so that jobs posted from them stay on their deques
+    thread_local const ThreadPool* currentPool = nullptr;
+    thread_local std::size_t currentWorkerIndex = 0;
+
+    constexpr std::size_t noWorker = static_cast<std::size_t>(-1);
+}
+
+ThreadPool::ThreadPool(std::size_t threadsCount) :
+    queuedJobs{0},
+    nextQueue{0},
+    sleepingWorkers{0},
+    stopping{false}
+{
+    if(threadsCount == 0)
+    {
+        threadsCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for(std::size_t i = 0; i < threadsCount; ++i)
+    {
+        queues.emplace_back(new WorkerQueue{});
+    }
+    workers.reserve(threadsCount);
+    for(std::size_t i = 0; i < threadsCount; ++i)
+    {
+        workers.emplace_back([this, i]() { workerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    jobsAdded.notify_all();
+    for(std::thread& worker: workers)
+    {
+        worker.join();
+    }
+}
+
+ThreadPool& ThreadPool::getShared()
+{
+    static ThreadPool shared{};
+    return shared;
+}
+
+void ThreadPool::post(std::function<void()> job)
+{
+    std::size_t index = getCurrentWorkerIndex();
+    if(index == noWorker)
+    {
+        index = nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+    }
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->jobs.push_back(std::move(job));
+    }
+
+    // Worker increments 'sleepingWorkers' before checking 'queuedJobs' under 'sleepMutex',
+    // so either it sees this job or it is counted here and gets notified
+    queuedJobs.fetch_add(1);
+    if(sleepingWorkers.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        jobsAdded.notify_one();
+    }
+}
+
+bool ThreadPool::tryRunPendingJob()
+{
+    std::function<void()> job;
+    std::size_t index = getCurrentWorkerIndex();
+    if(!tryPopJob(index == noWorker ? 0 : index, job))
+    {
+        return false;
+    }
+    job();
+    return true;
+}
+
+std::size_t ThreadPool::getCurrentWorkerIndex() const
+{
+    return currentPool == this ? currentWorkerIndex : noWorker;
+}
+
+bool ThreadPool::tryPopJob(std::size_t ownIndex, std::function<void()>& job)
+{
+    if(queuedJobs.load() == 0)
+    {
+        return false;
+    }
+
+    // Own deque from back (most recently posted), others from front
+    for(std::size_t i = 0; i < queues.size(); ++i)
+    {
+        WorkerQueue& queue = *queues[(ownIndex + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(!queue.jobs.empty())
+        {
+            if(i == 0)
+            {
+                job = std::move(queue.jobs.back());
+                queue.jobs.pop_back();
+            }
+            else
+            {
+                job = std::move(queue.jobs.front());
+                queue.jobs.pop_front();
+            }
+            queuedJobs.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(std::size_t index)
+{
+    CAM3D_TRACE_THREAD_NAME("ThreadPool worker");
+    currentPool = this;
+    currentWorkerIndex = index;
+    while(true)
+    {
+        std::function<void()> job;
+        if(tryPopJob(index, job))
+        {
+            job();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepingWorkers.fetch_add(1);
+        jobsAdded.wait(lock, [this]() { return stopping || queuedJobs.load() > 0; });
+        sleepingWorkers.fetch_sub(1);
+        if(stopping && queuedJobs.load() == 0)
+        {
+            return; // Stopping and all jobs are done
+        }
+    }
+}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "DisparityRefiner.hpp"
+#include <CamCommon/GreyScaleImage.hpp>
+
+namespace cam3d
+{
+	enum class DiffusionKernel
+	{
+		Exponential, // c = exp(-(grad / K)^2)
+		Rational,    // c = 1 / (1 + (grad / K)^2)
+		Constant,    // c = 1
+	};
+
+	// Perona-Malik diffusion as in managed AnisotropicDiffusionFilter:
+	//  I(t+1) = I(t) + step * sum{dir}(w_dir * c(grad_dir) * grad_dir / dist_dir^2) / sum{dir}(w_dir)
+	// where w_dir is 1 if both pixels are in mask. Border pixels are not changed.
+	// Iterations are fused in tiles: tile is read with halo of 'iterationsPerTile' pixels and
+	// that many iterations are run on it while it is in cache, then it is written out. Tiles run
+	// in parallel; rows of tile are contiguous floats, so stencil loops are vectorized.
+	struct AnisotropicDiffusionParams
+	{
+		int iterations = 10;
+		float kernelCoeff = 0.5f;
+		float stepCoeff = 0.5f;
+		DiffusionKernel kernel = DiffusionKernel::Exponential;
+		bool eightDirections = false;
+
+		int tileRows = 64;
+		int tileCols = 256;
+		int iterationsPerTile = 4;
+	};
+
+	// Filters 'plane' in place. Pixels with 0 in 'mask' are not changed and not used by
+	// neighbours, ones with 1 are used. If 'guide' is given, conduction is computed from its
+	// gradient instead of plane's. 'mask' and 'guide' may be null, else of plane size
+	void anisotropicDiffusion(Array2d<float>& plane, const Array2d<float>* mask, const Array2d<float>* guide,
+		const AnisotropicDiffusionParams& params, const ParallelForOptions& options = ParallelForOptions{});
+
+	void anisotropicDiffusion(GreyScaleImage& image, const AnisotropicDiffusionParams& params,
+		const ParallelForOptions& options = ParallelForOptions{});
+
+	// Smooths sub-pixel disparities within valid areas, as managed AnisotopicDiffusionRefiner
+	// with SmoothDisparityMap set. Conduction is computed from disparity gradient, or from
+	// guide image gradient if guide for map is set (image must outlive refinement)
+	class AnisotropicDiffusionRefiner : public WholeMapRefiner
+	{
+	public:
+		AnisotropicDiffusionParams params;
+		const GreyScaleImage* guideLeft = nullptr;
+		const GreyScaleImage* guideRight = nullptr;
+
+		std::string getName() const override { return "Anisotropic Diffusion"; }
+		void refineMaps(DisparityMap& left, DisparityMap* right, const ParallelForOptions& options) const override;
+
+		void refineMap(DisparityMap& map, const GreyScaleImage* guide, const ParallelForOptions& options) const;
+	};
+}
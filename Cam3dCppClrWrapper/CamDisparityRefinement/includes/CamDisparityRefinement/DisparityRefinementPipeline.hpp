@@ -0,0 +1,59 @@
+#pragma once
+
+#include "DisparityRefiner.hpp"
+#include <memory>
+#include <vector>
+
+namespace cam3d
+{
+	// Native counterpart of chain of managed DisparityRefinement objects. Instead of one pass
+	// over cloned map per refiner, stages are grouped into passes over rows:
+	//  - consecutive row-local stages are fused, so each row is refined by all of them
+	//    while it is in cache,
+	//  - neighbourhood stage writes rows of other buffer by row bands in parallel, and
+	//    following row-local stages refine each written row right away,
+	//  - whole-map stage runs alone, then following row-local stages in one pass.
+	// Maps are refined in place; if result ends in internal buffer, it is copied back once.
+	// Buffers are kept between calls, so refine() must not be called concurrently.
+	class DisparityRefinementPipeline
+	{
+		struct Pass
+		{
+			const NeighbourhoodRefiner* neighbourhood;
+			const WholeMapRefiner* wholeMap;
+			std::vector<const RowLocalRefiner*> rowLocal;
+		};
+
+		std::vector<std::unique_ptr<IDisparityRefiner>> refiners;
+		ParallelForOptions options;
+		DisparityMap bufferLeft;
+		DisparityMap bufferRight;
+
+	public:
+		explicit DisparityRefinementPipeline(const ParallelForOptions& options = ParallelForOptions{});
+
+		void add(std::unique_ptr<IDisparityRefiner> refiner);
+
+		// Adds default-constructed refiner and returns it, so that it may be configured
+		template<typename RefinerT>
+		RefinerT& add()
+		{
+			RefinerT* refiner = new RefinerT{};
+			add(std::unique_ptr<IDisparityRefiner>{ refiner });
+			return *refiner;
+		}
+
+		const std::vector<std::unique_ptr<IDisparityRefiner>>& getRefiners() const { return refiners; }
+
+		// 'right' may be null - then refiners which need both maps are skipped.
+		// Maps must have the same size
+		void refine(DisparityMap& left, DisparityMap* right = nullptr);
+
+		// Passes over whole map which refine() makes, not counting final copy
+		std::size_t getPassCount(bool bothMaps) const;
+
+	private:
+		std::vector<Pass> planPasses(bool bothMaps) const;
+		void runRowLocal(const Pass& pass, DisparityMap& left, DisparityMap* right, int startRow, int endRow) const;
+	};
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <CamCommon/DisparityMap.hpp>
+#include <CamCommon/ParallelFor.hpp>
+#include <string>
+
+namespace cam3d
+{
+	// Disparity is used by refiners if it has Valid flag, as in managed Disparity.IsValid()
+	inline bool isValid(const Disparity& d) { return (d.flags & Disparity::Valid) != 0; }
+
+	// How refiner accesses map, which decides how DisparityRefinementPipeline schedules it
+	enum class RefinerKind
+	{
+		RowLocal,      // Reads and writes single row of both maps - fused with neighbouring row-local stages
+		Neighbourhood, // Reads rows around written one from input map, writes to other map
+		WholeMap,      // Needs whole map, e.g. connected segments
+	};
+
+	// Stage of DisparityRefinementPipeline, also usable alone. Refiners are configured
+	// before refinement and not modified during it - their methods may run concurrently
+	class IDisparityRefiner
+	{
+	public:
+		virtual ~IDisparityRefiner() { }
+
+		virtual RefinerKind getKind() const = 0;
+		virtual std::string getName() const = 0;
+		// Whether refiner needs both maps - it is skipped if only one is refined
+		virtual bool needsBothMaps() const { return false; }
+	};
+
+	class RowLocalRefiner : public IDisparityRefiner
+	{
+	public:
+		RefinerKind getKind() const override { return RefinerKind::RowLocal; }
+
+		// Refines row 'r' in place. 'right' is row of right map or null if only one map is refined
+		virtual void refineRow(int r, Disparity* left, Disparity* right, int cols) const = 0;
+	};
+
+	class NeighbourhoodRefiner : public IDisparityRefiner
+	{
+	public:
+		RefinerKind getKind() const override { return RefinerKind::Neighbourhood; }
+
+		// Rows above and below written one which are read
+		virtual int getRadius() const = 0;
+		// Writes rows [startRow, endRow) of 'output' (same size as 'input', other buffer)
+		virtual void refineRows(const DisparityMap& input, DisparityMap& output, int startRow, int endRow) const = 0;
+	};
+
+	class WholeMapRefiner : public IDisparityRefiner
+	{
+	public:
+		RefinerKind getKind() const override { return RefinerKind::WholeMap; }
+
+		// Refines maps in place, 'right' may be null. Parallel loops use 'options'
+		virtual void refineMaps(DisparityMap& left, DisparityMap* right, const ParallelForOptions& options) const = 0;
+	};
+}
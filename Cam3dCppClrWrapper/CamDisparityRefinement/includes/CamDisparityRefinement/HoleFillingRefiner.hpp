@@ -0,0 +1,35 @@
+#pragma once
+
+#include "DisparityRefiner.hpp"
+#include <CamCommon/GreyScaleImage.hpp>
+
+namespace cam3d
+{
+	// Fills pixels which are not valid (invalid and occluded ones), instead of neighbourhood search
+	// of managed interpolation. Each hole - run of such pixels in row - is found in one scan and takes
+	// disparity of its left or right valid neighbour which is farther (smaller |subDx|), as occlusions
+	// are background hidden by foreground. Holes touching image border take their only neighbour if
+	// 'fillBorders' is set, ones wider than 'maxHoleWidth' (if not 0) are kept.
+	// With 'weightedFill', filled pixels get weighted mean of valid disparities in window of
+	// 'weightedFillRadius', using only ones not in front of scanline fill by more than
+	// 'maxDisparityDiff' and, if guide for map is set, weighted by guide similarity:
+	//  w = 1 / (1 + ((I(p) - I(q)) / colorSigma)^2)
+	// Filled pixels are valid, with zero confidence.
+	class HoleFillingRefiner : public WholeMapRefiner
+	{
+	public:
+		int maxHoleWidth = 0;
+		bool fillBorders = true;
+		bool weightedFill = false;
+		int weightedFillRadius = 3;
+		float maxDisparityDiff = 1.0f;
+		float colorSigma = 0.1f;
+		const GreyScaleImage* guideLeft = nullptr;
+		const GreyScaleImage* guideRight = nullptr;
+
+		std::string getName() const override { return "Fill holes"; }
+		void refineMaps(DisparityMap& left, DisparityMap* right, const ParallelForOptions& options) const override;
+
+		void refineMap(DisparityMap& map, const GreyScaleImage* guide, const ParallelForOptions& options) const;
+	};
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "DisparityRefiner.hpp"
+
+namespace cam3d
+{
+	// Replaces disparity with the one of median sub-pixel disparity among valid ones in
+	// (2 * radius + 1)^2 window, if at least half of window is valid. Otherwise, and on
+	// border closer than 'radius', disparity is kept
+	class MedianFilterRefiner : public NeighbourhoodRefiner
+	{
+	public:
+		int radius = 1;
+
+		std::string getName() const override { return "Median Filter"; }
+		int getRadius() const override { return radius; }
+		void refineRows(const DisparityMap& input, DisparityMap& output, int startRow, int endRow) const override;
+	};
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "DisparityRefiner.hpp"
+
+namespace cam3d
+{
+	// Removes speckles: segments of 4-connected valid disparities, with neighbours differing
+	// by at most 'maxDisparityDiff', smaller than 'minSegmentSize' are invalidated. With
+	// 'interpolateInvalidated', their pixels get mean of valid disparities around, if more than
+	// 'minValidPixelsForInterpolation' of 8 neighbours are in bigger segments.
+	// Segments are labelled with union-find (see labelSegments()), 2 ints per pixel.
+	class PeakRemovalRefiner : public WholeMapRefiner
+	{
+	public:
+		int minSegmentSize = 6;
+		double maxDisparityDiff = 2.0;
+		bool interpolateInvalidated = false;
+		int minValidPixelsForInterpolation = 3;
+
+		std::string getName() const override { return "Peaks removal"; }
+		void refineMaps(DisparityMap& left, DisparityMap* right, const ParallelForOptions& options) const override;
+
+		void refineMap(DisparityMap& map, const ParallelForOptions& options) const;
+	};
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "DisparityRefiner.hpp"
+
+namespace cam3d
+{
+	// Invalidates disparities with |dx| outside [minDisparity, maxDisparity]
+	class LimitRangeRefiner : public RowLocalRefiner
+	{
+	public:
+		int minDisparity = 1;
+		int maxDisparity = 100;
+
+		std::string getName() const override { return "Limit Disparity Range"; }
+		void refineRow(int r, Disparity* left, Disparity* right, int cols) const override;
+	};
+
+	// Invalidates disparities with confidence below threshold
+	class InvalidateLowConfidenceRefiner : public RowLocalRefiner
+	{
+	public:
+		double confidenceThreshold = 0.25;
+
+		std::string getName() const override { return "Invalidate Low Confidence"; }
+		void refineRow(int r, Disparity* left, Disparity* right, int cols) const override;
+	};
+
+	// Left-right consistency check. Maps are rectified, so matched pixel lies in the same
+	// row and rows are checked independently. As in managed CrossCheckRefiner, valid pair is
+	// far if signed sums of both integer and subpixel disparities exceed 'maxDisparityDiff' -
+	// then both pixels are invalidated - otherwise both get their mean. With 'fillUnmatched',
+	// invalid matched pixel takes negated disparity.
+	// Unlike managed one, which refines maps in place pixel by pixel, rows are checked against
+	// their state before refinement, so result does not depend on order, and pixel matched
+	// out of image is invalidated (managed one does not check bounds).
+	class CrossCheckRefiner : public RowLocalRefiner
+	{
+	public:
+		double maxDisparityDiff = 1.5;
+		bool fillUnmatched = true;
+
+		std::string getName() const override { return "Cross validation"; }
+		bool needsBothMaps() const override { return true; }
+		void refineRow(int r, Disparity* left, Disparity* right, int cols) const override;
+	};
+}
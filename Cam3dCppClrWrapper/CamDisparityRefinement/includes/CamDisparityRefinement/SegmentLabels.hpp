@@ -0,0 +1,27 @@
+#pragma once
+
+#include "DisparityRefiner.hpp"
+#include <vector>
+
+namespace cam3d
+{
+	constexpr int noSegment = -1;
+
+	// Segments of 4-connected valid disparities, with neighbours differing by at most
+	// 'maxDisparityDiff'. Label of pixel (r, c) is at r * cols + c; it is index of first pixel of its
+	// segment in raster order, so labels do not depend on how work was split, or noSegment if pixel
+	// is not valid. 'sizes' are indexed by label.
+	struct SegmentLabels
+	{
+		std::vector<int> labels;
+		std::vector<int> sizes;
+
+		bool isRoot(int i) const { return labels[i] == i; }
+		int getSize(int i) const { return labels[i] == noSegment ? 0 : sizes[labels[i]]; }
+	};
+
+	// Union-find in two passes: strips of rows are labelled in parallel, then strips are merged along
+	// boundary rows and labels are resolved in parallel. 'segments' is reused if it has buffers already
+	void labelSegments(const DisparityMap& map, double maxDisparityDiff, SegmentLabels& segments,
+		const ParallelForOptions& options = ParallelForOptions{});
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "DisparityRefiner.hpp"
+
+namespace cam3d
+{
+	// Disparity plane d = a * c + b * r + offset around segment centre (meanColumn, meanRow)
+	struct DisparityPlane
+	{
+		double a = 0.0;
+		double b = 0.0;
+		double offset = 0.0;
+		double meanColumn = 0.0;
+		double meanRow = 0.0;
+
+		double at(int r, int c) const { return offset + a * (c - meanColumn) + b * (r - meanRow); }
+	};
+
+	// Smooths disparities within segments, as managed SmoothSegmentsRefiner, but instead of
+	// iterated averaging of neighbours map is segmented once (see labelSegments()), robust plane
+	// is fitted to each segment in parallel and disparities are moved by 'smoothingCoeff' towards it.
+	// Plane is fitted with iteratively reweighted least squares and Huber weights, so pixels with
+	// residual above 'inlierThreshold' have lowered influence. Pixels with residual above
+	// 'maxResidual' are left unchanged, or invalidated with 'invalidateOutliers'. Segments smaller
+	// than 'minSegmentSize' are left unchanged.
+	class SegmentPlaneRefiner : public WholeMapRefiner
+	{
+	public:
+		double maxDisparityDiff = 1.1;
+		int minSegmentSize = 16;
+		int fitIterations = 4;
+		double inlierThreshold = 0.5;
+		double maxResidual = 2.0;
+		double smoothingCoeff = 1.0;
+		bool invalidateOutliers = false;
+
+		std::string getName() const override { return "Smooth segments"; }
+		void refineMaps(DisparityMap& left, DisparityMap* right, const ParallelForOptions& options) const override;
+
+		void refineMap(DisparityMap& map, const ParallelForOptions& options) const;
+	};
+
+	// Plane fitted to pixels at 'indices' (r * cols + c) of map; see SegmentPlaneRefiner
+	DisparityPlane fitDisparityPlane(const DisparityMap& map, const int* indices, int count,
+		int iterations, double inlierThreshold);
+}
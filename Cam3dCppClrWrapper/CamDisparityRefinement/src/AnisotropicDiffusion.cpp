@@ -0,0 +1,386 @@
+#include "AnisotropicDiffusion.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace cam3d
+{
+	namespace
+	{
+		// exp(-a) for a >= 0, relative error below 1e-5. Unlike std::exp it is inlined and
+		// vectorized: 2^t is split into 2^round(t), built in exponent bits, and polynomial of
+		// fraction. Arguments above 87 give exp(-87), still negligible as conduction
+		inline float expNegative(float a)
+		{
+			// Bits of non-negative floats compare as integers, without branch
+			std::int32_t aBits;
+			std::memcpy(&aBits, &a, sizeof(float));
+			const std::int32_t maxBits = 0x42AE0000; // 87.0f
+			aBits = aBits < maxBits ? aBits : maxBits;
+			float limited;
+			std::memcpy(&limited, &aBits, sizeof(float));
+
+			float t = limited * -1.44269504f; // -a * log2(e)
+			const float roundingShift = 12582912.0f; // 1.5 * 2^23 - adding it rounds to integer
+			float shifted = t + roundingShift;
+			float n = shifted - roundingShift;
+			float f = t - n; // In [-0.5, 0.5]
+
+			// Taylor series of 2^f
+			float p = 1.54035304e-04f;
+			p = p * f + 1.33335581e-03f;
+			p = p * f + 9.61812911e-03f;
+			p = p * f + 5.55041087e-02f;
+			p = p * f + 2.40226507e-01f;
+			p = p * f + 6.93147181e-01f;
+			p = p * f + 1.0f;
+
+			// Low bits of 'shifted' hold n
+			std::int32_t bits;
+			std::memcpy(&bits, &shifted, sizeof(float));
+			bits = (bits - 0x4B400000 + 127) << 23;
+			float scale;
+			std::memcpy(&scale, &bits, sizeof(float));
+			return p * scale;
+		}
+
+		template<DiffusionKernel kernel>
+		float getConduction(float gradSquared, float invKernelSquared);
+
+		template<>
+		float getConduction<DiffusionKernel::Exponential>(float gradSquared, float invKernelSquared)
+		{
+			return expNegative(gradSquared * invKernelSquared);
+		}
+
+		template<>
+		float getConduction<DiffusionKernel::Rational>(float gradSquared, float invKernelSquared)
+		{
+			return 1.0f / (1.0f + gradSquared * invKernelSquared);
+		}
+
+		template<>
+		float getConduction<DiffusionKernel::Constant>(float, float)
+		{
+			return 1.0f;
+		}
+
+		struct Neighbour
+		{
+			int offset;
+			float invDistanceSquared;
+		};
+
+		struct Region
+		{
+			int startRow, endRow, startCol, endCol;
+		};
+
+		// Row is processed in chunks, so that accumulators are local arrays which can not alias buffers
+		constexpr int chunkSize = 64;
+
+		// One iteration on 'region' of buffers with 'pitch'. Each direction is accumulated for
+		// chunk of row in separate loop over contiguous floats, so that loops are vectorized
+		template<DiffusionKernel kernel, int directions>
+		void iterateRegion(const float* in, const float* guide, const float* mask, float* out, int pitch,
+			Region region, const Neighbour* neighbours, float step, float invKernelSquared)
+		{
+			float sum[chunkSize];
+			float weight[chunkSize];
+
+			for (int y = region.startRow; y < region.endRow; ++y)
+			{
+				for (int chunkStart = region.startCol; chunkStart < region.endCol; chunkStart += chunkSize)
+				{
+					int count = std::min(chunkSize, region.endCol - chunkStart);
+					int start = y * pitch + chunkStart;
+					const float* value = in + start;
+					const float* guideValue = guide + start;
+					const float* valueMask = mask + start;
+					std::fill(sum, sum + count, 0.0f);
+					std::fill(weight, weight + count, 0.0f);
+
+					for (int d = 0; d < directions; ++d)
+					{
+						int offset = neighbours[d].offset;
+						float invDistanceSquared = neighbours[d].invDistanceSquared;
+						for (int x = 0; x < count; ++x)
+						{
+							float grad = value[x + offset] - value[x];
+							float guideGrad = guideValue[x + offset] - guideValue[x];
+							float w = valueMask[x] * valueMask[x + offset];
+							sum[x] += w * getConduction<kernel>(guideGrad * guideGrad, invKernelSquared) * grad * invDistanceSquared;
+							weight[x] += w;
+						}
+					}
+
+					// Mask is 0 or 1, so weight is 0 (and sum too) or at least 1 - no branch is needed
+					float* result = out + start;
+					for (int x = 0; x < count; ++x)
+					{
+						float divisor = weight[x] > 1.0f ? weight[x] : 1.0f;
+						result[x] = value[x] + step * sum[x] / divisor;
+					}
+				}
+			}
+		}
+
+		using IterateFunction = void(*)(const float*, const float*, const float*, float*, int, Region, const Neighbour*, float, float);
+
+		template<int directions>
+		IterateFunction getIterateFunction(DiffusionKernel kernel)
+		{
+			switch (kernel)
+			{
+			case DiffusionKernel::Exponential: return &iterateRegion<DiffusionKernel::Exponential, directions>;
+			case DiffusionKernel::Rational: return &iterateRegion<DiffusionKernel::Rational, directions>;
+			default: return &iterateRegion<DiffusionKernel::Constant, directions>;
+			}
+		}
+
+		struct TileBuffers
+		{
+			std::vector<float> current;
+			std::vector<float> next;
+			std::vector<float> guide;
+			std::vector<float> mask;
+		};
+
+		void copyRegion(const Array2d<float>& source, Region region, std::vector<float>& buffer)
+		{
+			int cols = region.endCol - region.startCol;
+			buffer.resize(static_cast<std::size_t>(region.endRow - region.startRow) * cols);
+			for (int y = region.startRow; y < region.endRow; ++y)
+			{
+				const float* row = source.getRow(y);
+				std::copy(row + region.startCol, row + region.endCol, buffer.begin() + (y - region.startRow) * cols);
+			}
+		}
+
+		class DiffusionRound
+		{
+			const Array2d<float>& source;
+			Array2d<float>& destination;
+			const Array2d<float>* mask;
+			const Array2d<float>* guide;
+			const AnisotropicDiffusionParams& params;
+			int iterations;
+			IterateFunction iterate;
+
+		public:
+			DiffusionRound(const Array2d<float>& source_, Array2d<float>& destination_, const Array2d<float>* mask_,
+				const Array2d<float>* guide_, const AnisotropicDiffusionParams& params_, int iterations_) :
+				source{ source_ }, destination{ destination_ }, mask{ mask_ }, guide{ guide_ },
+				params{ params_ }, iterations{ iterations_ },
+				iterate{ params_.eightDirections ? getIterateFunction<8>(params_.kernel) : getIterateFunction<4>(params_.kernel) }
+			{ }
+
+			// Runs 'iterations' on tile, reading it with halo of the same width
+			void runTile(Region tile) const
+			{
+				thread_local TileBuffers buffers;
+
+				int rows = source.getRowCount();
+				int cols = source.getColumnCount();
+				Region local{ std::max(0, tile.startRow - iterations), std::min(rows, tile.endRow + iterations),
+					std::max(0, tile.startCol - iterations), std::min(cols, tile.endCol + iterations) };
+				int pitch = local.endCol - local.startCol;
+
+				copyRegion(source, local, buffers.current);
+				buffers.next = buffers.current; // Image border is never written, so both buffers need it
+				if (mask != nullptr)
+				{
+					copyRegion(*mask, local, buffers.mask);
+				}
+				else
+				{
+					buffers.mask.assign(buffers.current.size(), 1.0f);
+				}
+				if (guide != nullptr)
+				{
+					copyRegion(*guide, local, buffers.guide);
+				}
+
+				Neighbour neighbours[8];
+				if (params.eightDirections)
+				{
+					Neighbour all[8] = { { -pitch - 1, 0.5f }, { -pitch, 1.0f }, { -pitch + 1, 0.5f }, { -1, 1.0f },
+						{ 1, 1.0f }, { pitch - 1, 0.5f }, { pitch, 1.0f }, { pitch + 1, 0.5f } };
+					std::copy(all, all + 8, neighbours);
+				}
+				else
+				{
+					Neighbour axes[4] = { { -pitch, 1.0f }, { -1, 1.0f }, { 1, 1.0f }, { pitch, 1.0f } };
+					std::copy(axes, axes + 4, neighbours);
+				}
+				float step = params.stepCoeff;
+				float invKernelSquared = 1.0f / (params.kernelCoeff * params.kernelCoeff);
+
+				float* current = buffers.current.data();
+				float* next = buffers.next.data();
+				for (int k = 1; k <= iterations; ++k)
+				{
+					// Computed region shrinks by one pixel each iteration, down to tile itself
+					int extent = iterations - k;
+					Region region{ std::max(1, tile.startRow - extent) - local.startRow, std::min(rows - 1, tile.endRow + extent) - local.startRow,
+						std::max(1, tile.startCol - extent) - local.startCol, std::min(cols - 1, tile.endCol + extent) - local.startCol };
+					iterate(current, guide != nullptr ? buffers.guide.data() : current, buffers.mask.data(), next,
+						pitch, region, neighbours, step, invKernelSquared);
+					std::swap(current, next);
+				}
+
+				for (int y = tile.startRow; y < tile.endRow; ++y)
+				{
+					const float* row = current + (y - local.startRow) * pitch - local.startCol;
+					std::copy(row + tile.startCol, row + tile.endCol, destination.getRow(y) + tile.startCol);
+				}
+			}
+		};
+
+		void checkSize(const Array2d<float>& plane, const Array2d<float>* other)
+		{
+			if (other != nullptr && (other->getRowCount() != plane.getRowCount() || other->getColumnCount() != plane.getColumnCount()))
+			{
+				throw std::invalid_argument("Mask and guide must have size of plane");
+			}
+		}
+	}
+
+	void anisotropicDiffusion(Array2d<float>& plane, const Array2d<float>* mask, const Array2d<float>* guide,
+		const AnisotropicDiffusionParams& params, const ParallelForOptions& options)
+	{
+		checkSize(plane, mask);
+		checkSize(plane, guide);
+		int rows = plane.getRowCount();
+		int cols = plane.getColumnCount();
+		if (rows < 3 || cols < 3 || params.iterations <= 0)
+		{
+			return;
+		}
+
+		int tileRows = std::max(1, params.tileRows);
+		int tileCols = std::max(1, params.tileCols);
+		int tilesInRow = (cols + tileCols - 1) / tileCols;
+		int tilesCount = tilesInRow * ((rows + tileRows - 1) / tileRows);
+		ParallelForOptions tileOptions = options;
+		tileOptions.grainRows = 1;
+
+		Array2d<float> buffer{ rows, cols, uninitialized };
+		Array2d<float>* source = &plane;
+		Array2d<float>* destination = &buffer;
+		for (int done = 0; done < params.iterations;)
+		{
+			int iterations = std::min(std::max(1, params.iterationsPerTile), params.iterations - done);
+			DiffusionRound round{ *source, *destination, mask, guide, params, iterations };
+			parallelForRows(0, tilesCount, [&](int firstTile, int endTile)
+			{
+				for (int tile = firstTile; tile < endTile; ++tile)
+				{
+					int startRow = (tile / tilesInRow) * tileRows;
+					int startCol = (tile % tilesInRow) * tileCols;
+					round.runTile(Region{ startRow, std::min(rows, startRow + tileRows), startCol, std::min(cols, startCol + tileCols) });
+				}
+			}, tileOptions);
+			std::swap(source, destination);
+			done += iterations;
+		}
+
+		if (source != &plane)
+		{
+			parallelForRows(0, rows, [&](int startRow, int endRow)
+			{
+				for (int r = startRow; r < endRow; ++r)
+				{
+					std::copy(buffer.getRow(r), buffer.getRow(r) + cols, plane.getRow(r));
+				}
+			}, options);
+		}
+	}
+
+	void anisotropicDiffusion(GreyScaleImage& image, const AnisotropicDiffusionParams& params, const ParallelForOptions& options)
+	{
+		int rows = image.getRowCount();
+		int cols = image.getColumnCount();
+		GreyScaleImage::Matrix& matrix = image.getMatrix();
+		Array2d<float> plane{ rows, cols, uninitialized };
+		parallelForRows(0, rows, [&](int startRow, int endRow)
+		{
+			for (int r = startRow; r < endRow; ++r)
+			{
+				std::copy(matrix.getRow(r), matrix.getRow(r) + cols, plane.getRow(r));
+			}
+		}, options);
+
+		anisotropicDiffusion(plane, nullptr, nullptr, params, options);
+
+		parallelForRows(0, rows, [&](int startRow, int endRow)
+		{
+			for (int r = startRow; r < endRow; ++r)
+			{
+				std::copy(plane.getRow(r), plane.getRow(r) + cols, matrix.getRow(r));
+			}
+		}, options);
+	}
+
+	void AnisotropicDiffusionRefiner::refineMaps(DisparityMap& left, DisparityMap* right, const ParallelForOptions& options) const
+	{
+		refineMap(left, guideLeft, options);
+		if (right != nullptr)
+		{
+			refineMap(*right, guideRight, options);
+		}
+	}
+
+	void AnisotropicDiffusionRefiner::refineMap(DisparityMap& map, const GreyScaleImage* guideImage, const ParallelForOptions& options) const
+	{
+		int rows = map.getRowCount();
+		int cols = map.getColumnCount();
+		if (guideImage != nullptr && (guideImage->getRowCount() != rows || guideImage->getColumnCount() != cols))
+		{
+			throw std::invalid_argument("Guide image must have size of disparity map");
+		}
+
+		Array2d<float> plane{ rows, cols, uninitialized };
+		Array2d<float> mask{ rows, cols, uninitialized };
+		Array2d<float> guide{ guideImage != nullptr ? rows : 0, guideImage != nullptr ? cols : 0, uninitialized };
+		parallelForRows(0, rows, [&](int startRow, int endRow)
+		{
+			for (int r = startRow; r < endRow; ++r)
+			{
+				const Disparity* row = map.getRow(r);
+				for (int c = 0; c < cols; ++c)
+				{
+					plane(r, c) = static_cast<float>(row[c].subDx);
+					mask(r, c) = isValid(row[c]) ? 1.0f : 0.0f;
+				}
+				if (guideImage != nullptr)
+				{
+					const double* imageRow = guideImage->getMatrix().getRow(r);
+					std::copy(imageRow, imageRow + cols, guide.getRow(r));
+				}
+			}
+		}, options);
+
+		anisotropicDiffusion(plane, &mask, guideImage != nullptr ? &guide : nullptr, params, options);
+
+		parallelForRows(0, rows, [&](int startRow, int endRow)
+		{
+			for (int r = startRow; r < endRow; ++r)
+			{
+				Disparity* row = map.getRow(r);
+				for (int c = 0; c < cols; ++c)
+				{
+					// Unchanged disparities keep double precision
+					if (isValid(row[c]) && plane(r, c) != static_cast<float>(row[c].subDx))
+					{
+						row[c].subDx = plane(r, c);
+						row[c].dx = static_cast<int>(std::lround(row[c].subDx));
+					}
+				}
+			}
+		}, options);
+	}
+}
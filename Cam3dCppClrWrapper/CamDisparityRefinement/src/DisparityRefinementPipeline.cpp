@@ -0,0 +1,149 @@
+#include "DisparityRefinementPipeline.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace cam3d
+{
+	DisparityRefinementPipeline::DisparityRefinementPipeline(const ParallelForOptions& options_) :
+		options{ options_ },
+		bufferLeft{ 0, 0 },
+		bufferRight{ 0, 0 }
+	{ }
+
+	void DisparityRefinementPipeline::add(std::unique_ptr<IDisparityRefiner> refiner)
+	{
+		if (refiner == nullptr)
+		{
+			throw std::invalid_argument("Refiner must not be null");
+		}
+		refiners.push_back(std::move(refiner));
+	}
+
+	std::vector<DisparityRefinementPipeline::Pass> DisparityRefinementPipeline::planPasses(bool bothMaps) const
+	{
+		std::vector<Pass> passes;
+		for (const auto& refiner : refiners)
+		{
+			if (refiner->needsBothMaps() && !bothMaps)
+			{
+				continue;
+			}
+
+			switch (refiner->getKind())
+			{
+			case RefinerKind::RowLocal:
+				if (passes.empty())
+				{
+					passes.push_back(Pass{ nullptr, nullptr, {} });
+				}
+				passes.back().rowLocal.push_back(static_cast<const RowLocalRefiner*>(refiner.get()));
+				break;
+			case RefinerKind::Neighbourhood:
+				passes.push_back(Pass{ static_cast<const NeighbourhoodRefiner*>(refiner.get()), nullptr, {} });
+				break;
+			case RefinerKind::WholeMap:
+				passes.push_back(Pass{ nullptr, static_cast<const WholeMapRefiner*>(refiner.get()), {} });
+				break;
+			}
+		}
+		return passes;
+	}
+
+	std::size_t DisparityRefinementPipeline::getPassCount(bool bothMaps) const
+	{
+		std::size_t count = 0;
+		for (const Pass& pass : planPasses(bothMaps))
+		{
+			// Whole-map stage followed by row-local ones makes two passes
+			count += pass.wholeMap != nullptr && !pass.rowLocal.empty() ? 2 : 1;
+		}
+		return count;
+	}
+
+	void DisparityRefinementPipeline::refine(DisparityMap& left, DisparityMap* right)
+	{
+		int rows = left.getRowCount();
+		int cols = left.getColumnCount();
+		if (right != nullptr && (right->getRowCount() != rows || right->getColumnCount() != cols))
+		{
+			throw std::invalid_argument("Disparity maps must have the same size");
+		}
+
+		std::vector<Pass> passes = planPasses(right != nullptr);
+		bool needsBuffers = std::any_of(passes.begin(), passes.end(), [](const Pass& p) { return p.neighbourhood != nullptr; });
+		if (needsBuffers && (bufferLeft.getRowCount() != rows || bufferLeft.getColumnCount() != cols))
+		{
+			bufferLeft = DisparityMap{ rows, cols, uninitialized };
+		}
+		if (needsBuffers && right != nullptr && (bufferRight.getRowCount() != rows || bufferRight.getColumnCount() != cols))
+		{
+			bufferRight = DisparityMap{ rows, cols, uninitialized };
+		}
+
+		// Current maps alternate between caller's ones and buffers
+		DisparityMap* currentLeft = &left;
+		DisparityMap* currentRight = right;
+		DisparityMap* otherLeft = &bufferLeft;
+		DisparityMap* otherRight = right != nullptr ? &bufferRight : nullptr;
+
+		for (const Pass& pass : passes)
+		{
+			if (pass.neighbourhood != nullptr)
+			{
+				parallelForRows(0, rows, [&](int startRow, int endRow)
+				{
+					pass.neighbourhood->refineRows(*currentLeft, *otherLeft, startRow, endRow);
+					if (currentRight != nullptr)
+					{
+						pass.neighbourhood->refineRows(*currentRight, *otherRight, startRow, endRow);
+					}
+					runRowLocal(pass, *otherLeft, otherRight, startRow, endRow);
+				}, options);
+				std::swap(currentLeft, otherLeft);
+				std::swap(currentRight, otherRight);
+				continue;
+			}
+
+			if (pass.wholeMap != nullptr)
+			{
+				pass.wholeMap->refineMaps(*currentLeft, currentRight, options);
+			}
+			if (!pass.rowLocal.empty())
+			{
+				parallelForRows(0, rows, [&](int startRow, int endRow)
+				{
+					runRowLocal(pass, *currentLeft, currentRight, startRow, endRow);
+				}, options);
+			}
+		}
+
+		if (currentLeft != &left)
+		{
+			parallelForRows(0, rows, [&](int startRow, int endRow)
+			{
+				for (int r = startRow; r < endRow; ++r)
+				{
+					std::copy(currentLeft->getRow(r), currentLeft->getRow(r) + cols, left.getRow(r));
+					if (right != nullptr)
+					{
+						std::copy(currentRight->getRow(r), currentRight->getRow(r) + cols, right->getRow(r));
+					}
+				}
+			}, options);
+		}
+	}
+
+	void DisparityRefinementPipeline::runRowLocal(const Pass& pass, DisparityMap& left, DisparityMap* right, int startRow, int endRow) const
+	{
+		int cols = left.getColumnCount();
+		for (int r = startRow; r < endRow; ++r)
+		{
+			Disparity* rowLeft = left.getRow(r);
+			Disparity* rowRight = right != nullptr ? right->getRow(r) : nullptr;
+			for (const RowLocalRefiner* refiner : pass.rowLocal)
+			{
+				refiner->refineRow(r, rowLeft, rowRight, cols);
+			}
+		}
+	}
+}
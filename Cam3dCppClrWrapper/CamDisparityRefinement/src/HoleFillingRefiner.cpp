@@ -0,0 +1,186 @@
+#include "HoleFillingRefiner.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+namespace cam3d
+{
+	namespace
+	{
+		void fillRun(Disparity* row, int start, int end, const Disparity& source)
+		{
+			for (int c = start; c < end; ++c)
+			{
+				row[c].dx = source.dx;
+				row[c].flags = Disparity::Valid;
+				row[c].subDx = source.subDx;
+				row[c].confidence = 0.0;
+			}
+		}
+
+		// Fills holes of row, background-preferring. Returns whether any pixel was filled
+		bool fillRow(Disparity* row, int cols, int maxHoleWidth, bool fillBorders)
+		{
+			bool filled = false;
+			int c = 0;
+			while (c < cols)
+			{
+				if (isValid(row[c])) { ++c; continue; }
+
+				int start = c;
+				while (c < cols && !isValid(row[c])) { ++c; }
+				if (maxHoleWidth > 0 && c - start > maxHoleWidth) { continue; }
+
+				const Disparity* left = start > 0 ? &row[start - 1] : nullptr;
+				const Disparity* right = c < cols ? &row[c] : nullptr;
+				const Disparity* source = nullptr;
+				if (left != nullptr && right != nullptr)
+				{
+					source = std::abs(left->subDx) <= std::abs(right->subDx) ? left : right;
+				}
+				else if (fillBorders)
+				{
+					source = left != nullptr ? left : right;
+				}
+				if (source != nullptr)
+				{
+					fillRun(row, start, c, *source);
+					filled = true;
+				}
+			}
+			return filled;
+		}
+
+		// Sums of weighted window row; loops over contiguous floats are vectorized
+		template<bool withGuide>
+		void accumulateRow(const float* values, const float* mask, const float* guide, int start, int end,
+			float limit, float guideValue, float invSigmaSquared, float& sum, float& weightSum)
+		{
+			float rowSum = 0.0f;
+			float rowWeight = 0.0f;
+			for (int x = start; x < end; ++x)
+			{
+				float v = values[x];
+				float behind = std::abs(v) <= limit ? 1.0f : 0.0f;
+				float w = mask[x] * behind;
+				if (withGuide)
+				{
+					float diff = guide[x] - guideValue;
+					w = w / (1.0f + diff * diff * invSigmaSquared);
+				}
+				rowSum += w * v;
+				rowWeight += w;
+			}
+			sum += rowSum;
+			weightSum += rowWeight;
+		}
+
+		template<bool withGuide>
+		void weightedFillRow(DisparityMap& map, const Array2d<float>& values, const Array2d<float>& mask,
+			const Array2d<float>& guide, const HoleFillingRefiner& refiner, int r)
+		{
+			int rows = map.getRowCount();
+			int cols = map.getColumnCount();
+			int radius = refiner.weightedFillRadius;
+			float invSigmaSquared = 1.0f / (refiner.colorSigma * refiner.colorSigma);
+
+			Disparity* row = map.getRow(r);
+			const float* maskRow = mask.getRow(r);
+			int top = std::max(0, r - radius);
+			int bottom = std::min(rows, r + radius + 1);
+			for (int c = 0; c < cols; ++c)
+			{
+				// Filled pixels are valid now, but were not in original mask
+				if (maskRow[c] != 0.0f || !isValid(row[c])) { continue; }
+
+				float limit = static_cast<float>(std::abs(row[c].subDx)) + refiner.maxDisparityDiff;
+				float guideValue = withGuide ? guide(r, c) : 0.0f;
+				int left = std::max(0, c - radius);
+				int right = std::min(cols, c + radius + 1);
+				float sum = 0.0f;
+				float weightSum = 0.0f;
+				for (int y = top; y < bottom; ++y)
+				{
+					accumulateRow<withGuide>(values.getRow(y), mask.getRow(y), withGuide ? guide.getRow(y) : nullptr,
+						left, right, limit, guideValue, invSigmaSquared, sum, weightSum);
+				}
+				if (weightSum > 0.0f)
+				{
+					row[c].subDx = sum / weightSum;
+					row[c].dx = static_cast<int>(std::lround(row[c].subDx));
+				}
+			}
+		}
+	}
+
+	void HoleFillingRefiner::refineMaps(DisparityMap& left, DisparityMap* right, const ParallelForOptions& options) const
+	{
+		refineMap(left, guideLeft, options);
+		if (right != nullptr)
+		{
+			refineMap(*right, guideRight, options);
+		}
+	}
+
+	void HoleFillingRefiner::refineMap(DisparityMap& map, const GreyScaleImage* guideImage, const ParallelForOptions& options) const
+	{
+		int rows = map.getRowCount();
+		int cols = map.getColumnCount();
+		if (guideImage != nullptr && (guideImage->getRowCount() != rows || guideImage->getColumnCount() != cols))
+		{
+			throw std::invalid_argument("Guide image must have size of disparity map");
+		}
+
+		if (!weightedFill)
+		{
+			parallelForRows(0, rows, [&](int startRow, int endRow)
+			{
+				for (int r = startRow; r < endRow; ++r)
+				{
+					fillRow(map.getRow(r), cols, maxHoleWidth, fillBorders);
+				}
+			}, options);
+			return;
+		}
+
+		// Weighted fill reads original valid disparities, so they are copied to planes
+		// before rows are filled; then filled pixels are independent
+		bool withGuide = guideImage != nullptr;
+		Array2d<float> values{ rows, cols, uninitialized };
+		Array2d<float> mask{ rows, cols, uninitialized };
+		Array2d<float> guide{ withGuide ? rows : 0, withGuide ? cols : 0, uninitialized };
+		std::vector<char> isRowFilled(rows, 0);
+		parallelForRows(0, rows, [&](int startRow, int endRow)
+		{
+			for (int r = startRow; r < endRow; ++r)
+			{
+				Disparity* row = map.getRow(r);
+				float* valueRow = values.getRow(r);
+				float* maskRow = mask.getRow(r);
+				for (int c = 0; c < cols; ++c)
+				{
+					bool valid = isValid(row[c]);
+					valueRow[c] = valid ? static_cast<float>(row[c].subDx) : 0.0f;
+					maskRow[c] = valid ? 1.0f : 0.0f;
+				}
+				if (withGuide)
+				{
+					const double* imageRow = guideImage->getMatrix().getRow(r);
+					std::copy(imageRow, imageRow + cols, guide.getRow(r));
+				}
+				isRowFilled[r] = fillRow(row, cols, maxHoleWidth, fillBorders) ? 1 : 0;
+			}
+		}, options);
+
+		parallelForRows(0, rows, [&](int startRow, int endRow)
+		{
+			for (int r = startRow; r < endRow; ++r)
+			{
+				if (!isRowFilled[r]) { continue; }
+				if (withGuide) { weightedFillRow<true>(map, values, mask, guide, *this, r); }
+				else { weightedFillRow<false>(map, values, mask, guide, *this, r); }
+			}
+		}, options);
+	}
+}
@@ -0,0 +1,62 @@
+#include "MedianFilterRefiner.hpp"
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace cam3d
+{
+	void MedianFilterRefiner::refineRows(const DisparityMap& input, DisparityMap& output, int startRow, int endRow) const
+	{
+		int rows = input.getRowCount();
+		int cols = input.getColumnCount();
+		int pitch = input.getPitch();
+		int windowSize = (2 * radius + 1) * (2 * radius + 1);
+		// Sub-pixel disparity and offset from center, sorted by insertion - window is small
+		std::vector<std::pair<double, int>> window(windowSize);
+
+		for (int r = startRow; r < endRow; ++r)
+		{
+			const Disparity* in = input.getRow(r);
+			Disparity* out = output.getRow(r);
+			if (r < radius || r >= rows - radius)
+			{
+				std::copy(in, in + cols, out);
+				continue;
+			}
+
+			for (int c = 0; c < cols; ++c)
+			{
+				if (c < radius || c >= cols - radius)
+				{
+					out[c] = in[c];
+					continue;
+				}
+
+				int count = 0;
+				for (int y = -radius; y <= radius; ++y)
+				{
+					const Disparity* row = in + y * pitch;
+					for (int x = c - radius; x <= c + radius; ++x)
+					{
+						if (!isValid(row[x])) { continue; }
+
+						std::pair<double, int> entry{ row[x].subDx, y * pitch + x };
+						int i = count++;
+						for (; i > 0 && window[i - 1].first > entry.first; --i)
+						{
+							window[i] = window[i - 1];
+						}
+						window[i] = entry;
+					}
+				}
+
+				if (2 * count < windowSize)
+				{
+					out[c] = in[c];
+					continue;
+				}
+				out[c] = in[window[count / 2].second];
+			}
+		}
+	}
+}
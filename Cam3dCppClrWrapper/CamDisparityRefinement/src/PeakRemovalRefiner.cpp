@@ -0,0 +1,68 @@
+#include "PeakRemovalRefiner.hpp"
+#include "SegmentLabels.hpp"
+#include <cmath>
+
+namespace cam3d
+{
+	void PeakRemovalRefiner::refineMaps(DisparityMap& left, DisparityMap* right, const ParallelForOptions& options) const
+	{
+		refineMap(left, options);
+		if (right != nullptr)
+		{
+			refineMap(*right, options);
+		}
+	}
+
+	void PeakRemovalRefiner::refineMap(DisparityMap& map, const ParallelForOptions& options) const
+	{
+		int rows = map.getRowCount();
+		int cols = map.getColumnCount();
+		if (rows == 0 || cols == 0) { return; }
+
+		SegmentLabels segments;
+		labelSegments(map, maxDisparityDiff, segments, options);
+		const std::vector<int>& labels = segments.labels;
+		const std::vector<int>& sizes = segments.sizes;
+
+		auto isRemoved = [&](int i) { return labels[i] != noSegment && sizes[labels[i]] < minSegmentSize; };
+		auto isKept = [&](int i) { return labels[i] != noSegment && sizes[labels[i]] >= minSegmentSize; };
+
+		// Interpolation reads only kept pixels, which are not modified, so rows are independent
+		parallelForRows(0, rows, [&](int startRow, int endRow)
+		{
+			for (int r = startRow; r < endRow; ++r)
+			{
+				Disparity* row = map.getRow(r);
+				for (int c = 0; c < cols; ++c)
+				{
+					int i = r * cols + c;
+					if (!isRemoved(i)) { continue; }
+
+					row[c].flags = Disparity::Invalid;
+					if (!interpolateInvalidated || r < 1 || c < 1 || r >= rows - 1 || c >= cols - 1) { continue; }
+
+					double sum = 0.0;
+					int count = 0;
+					for (int y = r - 1; y <= r + 1; ++y)
+					{
+						const Disparity* neighbours = map.getRow(y);
+						for (int x = c - 1; x <= c + 1; ++x)
+						{
+							if (isKept(y * cols + x))
+							{
+								sum += neighbours[x].subDx;
+								++count;
+							}
+						}
+					}
+					if (count > minValidPixelsForInterpolation)
+					{
+						row[c].flags = Disparity::Valid;
+						row[c].subDx = sum / count;
+						row[c].dx = static_cast<int>(std::lround(row[c].subDx));
+					}
+				}
+			}
+		}, options);
+	}
+}
@@ -0,0 +1,118 @@
+#include "RowRefiners.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+namespace cam3d
+{
+	namespace
+	{
+		void limitRow(Disparity* row, int cols, int minDisparity, int maxDisparity)
+		{
+			for (int c = 0; c < cols; ++c)
+			{
+				int dx = std::abs(row[c].dx);
+				if (dx > maxDisparity || dx < minDisparity)
+				{
+					row[c].flags = Disparity::Invalid;
+				}
+			}
+		}
+
+		void invalidateRow(Disparity* row, int cols, double threshold)
+		{
+			for (int c = 0; c < cols; ++c)
+			{
+				if (row[c].confidence < threshold)
+				{
+					row[c].flags = Disparity::Invalid;
+				}
+			}
+		}
+
+		// As CheckDisparitiesAreFar of managed CrossCheckRefiner - signed sums, far only if both exceed limit
+		bool areFar(const Disparity& d, const Disparity& m, double maxDiff)
+		{
+			return d.dx + m.dx > maxDiff && d.subDx + m.subDx > maxDiff;
+		}
+
+		// Checks 'base' row against 'matched' one (both unmodified copies), writes 'output'.
+		// Far pair invalidates matched pixel in 'matchedOutput' too
+		void crossCheckRow(const Disparity* base, const Disparity* matched,
+			Disparity* output, Disparity* matchedOutput, int cols, double maxDiff)
+		{
+			for (int c = 0; c < cols; ++c)
+			{
+				const Disparity& d = base[c];
+				if (!isValid(d)) { continue; }
+
+				int x = c + d.dx;
+				if (x < 0 || x >= cols)
+				{
+					output[c].flags = Disparity::Invalid;
+					continue;
+				}
+				const Disparity& m = matched[x];
+				if (!isValid(m)) { continue; }
+
+				if (areFar(d, m, maxDiff))
+				{
+					output[c].flags = Disparity::Invalid;
+					matchedOutput[x].flags = Disparity::Invalid;
+				}
+				else
+				{
+					double subDx = (d.subDx - m.subDx) * 0.5;
+					output[c].subDx = subDx;
+					output[c].dx = static_cast<int>(std::lround(subDx));
+				}
+			}
+		}
+
+		// Invalid pixels of 'output' matched by valid 'base' ones get their negated disparity
+		void fillUnmatchedRow(const Disparity* base, const Disparity* matched, Disparity* output, int cols)
+		{
+			for (int c = 0; c < cols; ++c)
+			{
+				const Disparity& d = base[c];
+				int x = c + d.dx;
+				if (isValid(d) && x >= 0 && x < cols && !isValid(matched[x]) && !isValid(output[x]))
+				{
+					output[x] = Disparity{ -d.dx, Disparity::Valid, -d.subDx, d.cost, d.confidence };
+				}
+			}
+		}
+	}
+
+	void LimitRangeRefiner::refineRow(int, Disparity* left, Disparity* right, int cols) const
+	{
+		limitRow(left, cols, minDisparity, maxDisparity);
+		if (right != nullptr) { limitRow(right, cols, minDisparity, maxDisparity); }
+	}
+
+	void InvalidateLowConfidenceRefiner::refineRow(int, Disparity* left, Disparity* right, int cols) const
+	{
+		invalidateRow(left, cols, confidenceThreshold);
+		if (right != nullptr) { invalidateRow(right, cols, confidenceThreshold); }
+	}
+
+	void CrossCheckRefiner::refineRow(int, Disparity* left, Disparity* right, int cols) const
+	{
+		if (right == nullptr) { return; }
+
+		// Both rows are checked against state before refinement, so result does not depend on order
+		thread_local std::vector<Disparity> leftCopy;
+		thread_local std::vector<Disparity> rightCopy;
+		leftCopy.assign(left, left + cols);
+		rightCopy.assign(right, right + cols);
+
+		crossCheckRow(leftCopy.data(), rightCopy.data(), left, right, cols, maxDisparityDiff);
+		crossCheckRow(rightCopy.data(), leftCopy.data(), right, left, cols, maxDisparityDiff);
+		if (fillUnmatched)
+		{
+			fillUnmatchedRow(leftCopy.data(), rightCopy.data(), right, cols);
+			fillUnmatchedRow(rightCopy.data(), leftCopy.data(), left, cols);
+		}
+	}
+}
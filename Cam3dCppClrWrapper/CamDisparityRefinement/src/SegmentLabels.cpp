@@ -0,0 +1,130 @@
+#include "SegmentLabels.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace cam3d
+{
+	namespace
+	{
+		// Parent of each pixel is pixel with lower or equal index, so root is first pixel of segment
+		class SegmentForest
+		{
+			std::vector<int>& parent;
+
+		public:
+			SegmentForest(std::vector<int>& parent_) : parent{ parent_ } { }
+
+			int find(int i)
+			{
+				while (parent[i] != i)
+				{
+					parent[i] = parent[parent[i]]; // Path halving
+					i = parent[i];
+				}
+				return i;
+			}
+
+			void unite(int a, int b)
+			{
+				a = find(a);
+				b = find(b);
+				if (a < b) { parent[b] = a; }
+				else if (b < a) { parent[a] = b; }
+			}
+
+			// Does not modify forest, so may run concurrently
+			int findRoot(int i) const
+			{
+				while (parent[i] != i) { i = parent[i]; }
+				return i;
+			}
+		};
+
+		bool areConnected(const Disparity& a, const Disparity& b, double maxDiff)
+		{
+			return isValid(b) && std::abs(a.subDx - b.subDx) <= maxDiff;
+		}
+
+		// Unites pixels of row 'r' with upper neighbours
+		void uniteWithUpperRow(const DisparityMap& map, SegmentForest& forest, int r, double maxDiff)
+		{
+			int cols = map.getColumnCount();
+			const Disparity* row = map.getRow(r);
+			const Disparity* upper = map.getRow(r - 1);
+			for (int c = 0; c < cols; ++c)
+			{
+				if (isValid(row[c]) && areConnected(row[c], upper[c], maxDiff))
+				{
+					forest.unite(r * cols + c, (r - 1) * cols + c);
+				}
+			}
+		}
+	}
+
+	void labelSegments(const DisparityMap& map, double maxDisparityDiff, SegmentLabels& segments, const ParallelForOptions& options)
+	{
+		int rows = map.getRowCount();
+		int cols = map.getColumnCount();
+		std::size_t count = static_cast<std::size_t>(rows) * cols;
+		// Forest is built in 'sizes', which are counted when labels are resolved
+		std::vector<int>& parent = segments.sizes;
+		std::vector<int>& labels = segments.labels;
+		parent.resize(count);
+		labels.resize(count);
+		if (count == 0) { return; }
+
+		std::vector<char> isStripStart(rows, 0);
+		SegmentForest forest{ parent };
+
+		// First pass: each strip unites pixels only within itself
+		parallelForRows(0, rows, [&](int startRow, int endRow)
+		{
+			isStripStart[startRow] = 1;
+			for (int r = startRow; r < endRow; ++r)
+			{
+				const Disparity* row = map.getRow(r);
+				for (int c = 0; c < cols; ++c)
+				{
+					int i = r * cols + c;
+					parent[i] = isValid(row[c]) ? i : noSegment;
+				}
+				for (int c = 1; c < cols; ++c)
+				{
+					if (isValid(row[c]) && areConnected(row[c], row[c - 1], maxDisparityDiff))
+					{
+						forest.unite(r * cols + c, r * cols + c - 1);
+					}
+				}
+				if (r > startRow)
+				{
+					uniteWithUpperRow(map, forest, r, maxDisparityDiff);
+				}
+			}
+		}, options);
+
+		// Merge along strip boundaries - few rows, done serially
+		for (int r = 1; r < rows; ++r)
+		{
+			if (isStripStart[r])
+			{
+				uniteWithUpperRow(map, forest, r, maxDisparityDiff);
+			}
+		}
+
+		// Second pass: labels are roots of segments
+		parallelForRows(0, rows, [&](int startRow, int endRow)
+		{
+			for (int i = startRow * cols; i < endRow * cols; ++i)
+			{
+				labels[i] = parent[i] == noSegment ? noSegment : forest.findRoot(i);
+			}
+		}, options);
+
+		std::vector<int>& sizes = segments.sizes;
+		std::fill(sizes.begin(), sizes.end(), 0);
+		for (int label : labels)
+		{
+			if (label != noSegment) { ++sizes[label]; }
+		}
+	}
+}
@@ -0,0 +1,171 @@
+#include "SegmentPlaneRefiner.hpp"
+#include "SegmentLabels.hpp"
+#include <cmath>
+#include <vector>
+
+namespace cam3d
+{
+	namespace
+	{
+		// Weighted sums of normal equations, coordinates relative to segment centre
+		struct PlaneSums
+		{
+			double w = 0.0, x = 0.0, y = 0.0, xx = 0.0, xy = 0.0, yy = 0.0, d = 0.0, xd = 0.0, yd = 0.0;
+
+			void add(double weight, double cx, double cy, double disparity)
+			{
+				w += weight;
+				x += weight * cx;
+				y += weight * cy;
+				xx += weight * cx * cx;
+				xy += weight * cx * cy;
+				yy += weight * cy * cy;
+				d += weight * disparity;
+				xd += weight * cx * disparity;
+				yd += weight * cy * disparity;
+			}
+		};
+
+		// Line d = slope * v + offset along one axis, v relative to segment centre
+		void solveLine(double w, double v, double vv, double d, double vd, double& slope, double& offset)
+		{
+			double variance = vv - v * v / w;
+			slope = variance > 1e-9 * w ? (vd - v * d / w) / variance : 0.0;
+			offset = (d - slope * v) / w;
+		}
+
+		// Solves normal equations by Cramer's rule. Segments along single row or column have singular
+		// system - then line along it is fitted
+		void solvePlane(const PlaneSums& s, DisparityPlane& plane)
+		{
+			plane.a = 0.0;
+			plane.b = 0.0;
+			if (s.w <= 0.0) { plane.offset = 0.0; return; }
+
+			double det = s.xx * (s.yy * s.w - s.y * s.y) - s.xy * (s.xy * s.w - s.y * s.x) + s.x * (s.xy * s.y - s.yy * s.x);
+			if (std::abs(det) <= 1e-9 * s.xx * s.yy * s.w)
+			{
+				if (s.xx >= s.yy) { solveLine(s.w, s.x, s.xx, s.d, s.xd, plane.a, plane.offset); }
+				else { solveLine(s.w, s.y, s.yy, s.d, s.yd, plane.b, plane.offset); }
+				return;
+			}
+			plane.a = (s.xd * (s.yy * s.w - s.y * s.y) - s.xy * (s.yd * s.w - s.y * s.d) + s.x * (s.yd * s.y - s.yy * s.d)) / det;
+			plane.b = (s.xx * (s.yd * s.w - s.y * s.d) - s.xd * (s.xy * s.w - s.y * s.x) + s.x * (s.xy * s.d - s.yd * s.x)) / det;
+			plane.offset = (s.xx * (s.yy * s.d - s.y * s.yd) - s.xy * (s.xy * s.d - s.y * s.xd) + s.x * (s.xy * s.yd - s.yy * s.xd)) / det;
+		}
+	}
+
+	DisparityPlane fitDisparityPlane(const DisparityMap& map, const int* indices, int count,
+		int iterations, double inlierThreshold)
+	{
+		DisparityPlane plane;
+		if (count <= 0) { return plane; }
+
+		int cols = map.getColumnCount();
+
+		for (int k = 0; k < count; ++k)
+		{
+			plane.meanColumn += indices[k] % cols;
+			plane.meanRow += indices[k] / cols;
+		}
+		plane.meanColumn /= count;
+		plane.meanRow /= count;
+
+		for (int iteration = 0; iteration <= iterations; ++iteration)
+		{
+			PlaneSums sums;
+			for (int k = 0; k < count; ++k)
+			{
+				int r = indices[k] / cols;
+				int c = indices[k] % cols;
+				double disparity = map.getRow(r)[c].subDx;
+				double weight = 1.0;
+				if (iteration > 0)
+				{
+					double residual = std::abs(disparity - plane.at(r, c));
+					weight = residual <= inlierThreshold ? 1.0 : inlierThreshold / residual;
+				}
+				sums.add(weight, c - plane.meanColumn, r - plane.meanRow, disparity);
+			}
+			solvePlane(sums, plane);
+		}
+		return plane;
+	}
+
+	void SegmentPlaneRefiner::refineMaps(DisparityMap& left, DisparityMap* right, const ParallelForOptions& options) const
+	{
+		refineMap(left, options);
+		if (right != nullptr)
+		{
+			refineMap(*right, options);
+		}
+	}
+
+	void SegmentPlaneRefiner::refineMap(DisparityMap& map, const ParallelForOptions& options) const
+	{
+		int rows = map.getRowCount();
+		int cols = map.getColumnCount();
+		if (rows == 0 || cols == 0) { return; }
+
+		SegmentLabels segments;
+		labelSegments(map, maxDisparityDiff, segments, options);
+		const std::vector<int>& labels = segments.labels;
+		std::vector<int>& sizes = segments.sizes;
+
+		// Pixels of fitted segments are grouped by segment (counting sort), so that each is fitted
+		// by one task. Roots are visited in raster order; their sizes are replaced by segment index
+		std::vector<int> starts{ 0 };
+		int count = rows * cols;
+		for (int i = 0; i < count; ++i)
+		{
+			if (!segments.isRoot(i)) { continue; }
+			if (sizes[i] >= minSegmentSize)
+			{
+				starts.push_back(starts.back() + sizes[i]);
+				sizes[i] = static_cast<int>(starts.size()) - 2;
+			}
+			else
+			{
+				sizes[i] = noSegment;
+			}
+		}
+		int segmentCount = static_cast<int>(starts.size()) - 1;
+		if (segmentCount == 0) { return; }
+
+		std::vector<int> pixels(starts.back());
+		std::vector<int> ends(starts.begin(), starts.end() - 1);
+		for (int i = 0; i < count; ++i)
+		{
+			int label = labels[i];
+			if (label != noSegment && sizes[label] != noSegment)
+			{
+				pixels[ends[sizes[label]]++] = i;
+			}
+		}
+
+		// Segments do not share pixels, so they are refined in place independently
+		parallelForRows(0, segmentCount, [&](int startSegment, int endSegment)
+		{
+			for (int s = startSegment; s < endSegment; ++s)
+			{
+				const int* indices = pixels.data() + starts[s];
+				int size = starts[s + 1] - starts[s];
+				DisparityPlane plane = fitDisparityPlane(map, indices, size, fitIterations, inlierThreshold);
+				for (int k = 0; k < size; ++k)
+				{
+					int r = indices[k] / cols;
+					int c = indices[k] % cols;
+					Disparity& d = map.getRow(r)[c];
+					double residual = plane.at(r, c) - d.subDx;
+					if (std::abs(residual) > maxResidual)
+					{
+						if (invalidateOutliers) { d.flags = Disparity::Invalid; }
+						continue;
+					}
+					d.subDx += smoothingCoeff * residual;
+					d.dx = static_cast<int>(std::lround(d.subDx));
+				}
+			}
+		}, options);
+	}
+}
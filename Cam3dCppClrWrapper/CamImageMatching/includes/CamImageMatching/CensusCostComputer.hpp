@@ -1,8 +1,11 @@
 #pragma once
 
 #include <CamCommon/Array2d.hpp>
-#include <CamCommon/PerPixelFunction.hpp>
+#include <CamCommon/ParallelFor.hpp>
 #include <CamCommon/BitWord.hpp>
+#include <CamCommon/FrameArena.hpp>
+#include "SgmCommon.hpp"
+#include <atomic>
 #include <cstring>
 
 namespace cam3d
@@ -13,7 +16,7 @@ class CensusCostComputer
 {
 public:
     using uint_t = typename BitWord::uint_t;
-    using BitWordMatrix = Array2d<BitWord>;
+    using BitWordMatrix = Array2d<BitWord, memory::ArenaAllocator<BitWord>>;
 
 private:
     int rows;
@@ -26,23 +29,31 @@ private:
 
     int maskWidth; // Actual width is equal to maskWidth*2 + 1
     int maskHeight; // Actual height is equal to maskHeight*2 + 1
+    int maxParallelTasks;
+    ThreadPool& pool;
 
-	Point2 currentPixel;
+	// Only for progress reporting - rows are transformed concurrently
+	std::atomic<int> currentRow;
+	std::atomic<int> currentCol;
 
 public:
-    CensusCostComputer(int rows_, int cols_) :
+    // Transform runs on 'pool_', which must outlive computer
+    CensusCostComputer(int rows_, int cols_, memory::FrameArena& arena, ThreadPool& pool_) :
         rows{rows_},
         cols{cols_},
-        censusBase{rows_, cols_},
-        censusMatched{rows_, cols_},
-		currentPixel{}
+        censusBase{rows_, cols_, uninitialized, memory::ArenaAllocator<BitWord>{arena}}, // Cleared in init()
+        censusMatched{rows_, cols_, uninitialized, memory::ArenaAllocator<BitWord>{arena}},
+        maxParallelTasks{1},
+        pool{pool_},
+		currentRow{0},
+		currentCol{0}
     {
 
     }
 
 	Point2 getCurrentPixel() const
 	{
-		return currentPixel;
+		return { currentRow.load(std::memory_order_relaxed), currentCol.load(std::memory_order_relaxed) };
 	}
 
     double getCost(Point2 pixelBase, Point2 pixelMatched)
@@ -65,12 +76,15 @@ public:
         maskLength = (2 * maskHeight + 1) * (2 * maskWidth + 1);
         maxCost = maskLength - 1;
 
-		PerPixelFunction::runWithBorder
+        ParallelForOptions options;
+        options.pool = &pool;
+        options.maxTasks = maxParallelTasks;
+		parallelForPixelsWithBorder
         (
             [this, &imageBase, &imageMatched](int y, int x) { censusTransform(y, x, imageBase, imageMatched); },
             [this, &imageBase, &imageMatched](int y, int x) { censusTransform_Border(y, x, imageBase, imageMatched); },
             maskWidth, maskHeight,
-            imageBase.getRowCount(), imageBase.getColumnCount()
+            imageBase.getRowCount(), imageBase.getColumnCount(), options
         );
     }
 
@@ -80,6 +94,13 @@ public:
     const BitWordMatrix& getCensusBase() const { return censusBase; }
     const BitWordMatrix& getCensusMatched() const { return censusMatched; }
 
+    void setParameters(const SgmParameters& params, bool /*isLeftImageBase*/)
+    {
+        setMaskWidth(params.censusMaskRadius);
+        setMaskHeight(params.censusMaskRadius);
+        maxParallelTasks = params.maxParallelTasks;
+    }
+
     int getMaskWidth() const { return maskWidth; }
     void setMaskWidth(int value) { maskWidth = value; }
     int getMaskHeight() const { return maskHeight; }
@@ -92,8 +113,8 @@ private:
         uint_t maskMatch[BitWord::lengthInWords];
         std::memset(maskBase, 0, sizeof(maskBase));
         std::memset(maskMatch, 0, sizeof(maskMatch));
-		currentPixel.x = x;
-		currentPixel.y = y;
+		currentRow.store(y, std::memory_order_relaxed);
+		currentCol.store(x, std::memory_order_relaxed);
 
         int dx, dy, maskPos = 0;
         for(dy = -maskHeight; dy <= maskHeight; ++dy)
@@ -122,8 +143,8 @@ private:
         uint_t maskMatch[BitWord::lengthInWords];
         std::memset(maskBase, 0, sizeof(maskBase));
         std::memset(maskMatch, 0, sizeof(maskMatch));
-		currentPixel.x = x;
-		currentPixel.y = y;
+		currentRow.store(y, std::memory_order_relaxed);
+		currentCol.store(x, std::memory_order_relaxed);
 
         int dx, dy, px, py, maskPos = 0;
         for(dy = -maskHeight; dy <= maskHeight; ++dy)
@@ -0,0 +1,457 @@
+#pragma once
+
+#include "SgmCommon.hpp"
+#include "SgmCostAggregator.hpp"
+#include <CamCommon/Array2d.hpp>
+#include <CamCommon/FrameArena.hpp>
+#include <CamCommon/GreyScaleImage.hpp>
+#include <CamCommon/TaskQueue.hpp>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace cam3d
+{
+// Hierarchical mutual information matching cost (Hirschmuller, 2008).
+// Intensities are quantized into 'bins' bins and cost for pair of pixels is read
+// from precomputed table: C(p, q) = -mi(I_base(p), I_matched(q)).
+// Joint entropy table is estimated from pixel correspondences given by disparity map:
+// - if prior disparity map was set, it is used directly (possibly from lower resolution)
+// - otherwise images are downsampled 'hmiLevels' times and SGM with HMI is run from
+//   coarsest level (starting with random disparities) up to half resolution
+// - or table of opposite view is transposed (initFromOppositeView())
+// Penalties are relative to getMaxCost(), which is multiple of expected cost of unrelated
+// pair of pixels rather than range of table: range depends on how peaked joint histogram is
+// and leaves penalties too weak on images with few intensity levels.
+template<typename Image>
+class HmiCostComputer
+{
+public:
+    static constexpr int maxBinsCount = 256;
+    static constexpr int minBinsCount = 16;
+    static constexpr int pixelsPerJointBin = 16; // Bins are reduced on small images so that joint histogram is not sparse
+    static constexpr int coarsestLevelIterations = 3;
+    static constexpr double penaltyReferenceFactor = 8.0;
+    // Iterations on coarsest level but last one start from random or poor correspondences,
+    // with full penalties they collapse to one disparity, so their penalties are scaled down
+    static constexpr double coarsestPenaltyScale = 0.25;
+    static constexpr int minLevelSize = 16;
+
+    using BinMatrix = Array2d<uint8_t, memory::ArenaAllocator<uint8_t>>;
+    using LevelAggregator = SgmCostAggregator<GreyScaleImage, HmiCostComputer<GreyScaleImage>>;
+
+private:
+    int rows;
+    int cols;
+    double maxCost;
+
+    BinMatrix binsBase;
+    BinMatrix binsMatched;
+    int bins;
+    std::vector<double> costTable; // [binBase * bins + binMatched]
+
+    SgmParameters params;
+    bool isLeftImageBase;
+    const DisparityMap* priorDisparity;
+    int priorScale;
+
+    Point2 currentPixel;
+    ThreadPool& pool;
+    // Temporaries of SGM run on one pyramid level, reset after each level
+    memory::FrameArena levelArena;
+
+public:
+    HmiCostComputer(int rows_, int cols_, memory::FrameArena& arena, ThreadPool& pool_) :
+        rows{rows_},
+        cols{cols_},
+        maxCost{1.0},
+        binsBase{rows_, cols_, memory::ArenaAllocator<uint8_t>{arena}},
+        binsMatched{rows_, cols_, memory::ArenaAllocator<uint8_t>{arena}},
+        bins{maxBinsCount},
+        costTable(maxBinsCount * maxBinsCount, 0.0),
+        params{},
+        isLeftImageBase{true},
+        priorDisparity{nullptr},
+        priorScale{1},
+        currentPixel{},
+        pool{pool_}
+    {
+
+    }
+
+    Point2 getCurrentPixel() const
+    {
+        return currentPixel;
+    }
+
+    double getCost(Point2 pixelBase, Point2 pixelMatched)
+    {
+        return costTable[binsBase(pixelBase.y, pixelBase.x) * bins +
+            binsMatched(pixelMatched.y, pixelMatched.x)];
+    }
+
+    double getCostOnBorder(Point2 pixelBase, Point2 pixelMatched)
+    {
+        return getCost(pixelBase, pixelMatched);
+    }
+
+    void setParameters(const SgmParameters& params_, bool isLeftImageBase_)
+    {
+        params = params_;
+        isLeftImageBase = isLeftImageBase_;
+    }
+
+    // Disparity map used to build entropy tables. 'scale' is ratio of this image size
+    // to map size. Map must outlive call to init().
+    void setPriorDisparity(const DisparityMap* map, int scale)
+    {
+        priorDisparity = map;
+        priorScale = scale;
+    }
+
+    void init(Image& imageBase, Image& imageMatched)
+    {
+        quantize(imageBase, imageMatched);
+        if(priorDisparity != nullptr)
+        {
+            buildCostTable(*priorDisparity, priorScale);
+        }
+        else
+        {
+            bootstrapFromLowerLevels(imageBase, imageMatched);
+        }
+    }
+
+    // As init(), but table is transposed table of 'opposite', initialized with same images swapped,
+    // so that pyramid is bootstrapped once for both views. Prior disparity, if set, is still used
+    void initFromOppositeView(const HmiCostComputer& opposite, Image& imageBase, Image& imageMatched)
+    {
+        if(priorDisparity != nullptr)
+        {
+            init(imageBase, imageMatched);
+            return;
+        }
+
+        // Intensity range is common for both images, so bins are same as of opposite view
+        quantize(imageBase, imageMatched);
+        for(int i = 0; i < bins; ++i)
+        {
+            for(int k = 0; k < bins; ++k)
+            {
+                costTable[i * bins + k] = opposite.costTable[k * bins + i];
+            }
+        }
+        maxCost = opposite.maxCost;
+    }
+
+    double getMaxCost() const { return maxCost; }
+    const std::vector<double>& getCostTable() const { return costTable; }
+
+private:
+    void quantize(Image& imageBase, Image& imageMatched)
+    {
+        bins = maxBinsCount;
+        while(bins > minBinsCount && static_cast<long long>(bins) * bins * pixelsPerJointBin > static_cast<long long>(rows) * cols)
+        {
+            bins /= 2;
+        }
+        costTable.assign(bins * bins, 0.0);
+
+        double minValue = imageBase(0, 0), maxValue = imageBase(0, 0);
+        for(int y = 0; y < rows; ++y)
+        {
+            for(int x = 0; x < cols; ++x)
+            {
+                minValue = std::min(minValue, std::min(imageBase(y, x), imageMatched(y, x)));
+                maxValue = std::max(maxValue, std::max(imageBase(y, x), imageMatched(y, x)));
+            }
+        }
+
+        double scale = maxValue > minValue ? (bins - 1) / (maxValue - minValue) : 0.0;
+        for(int y = 0; y < rows; ++y)
+        {
+            for(int x = 0; x < cols; ++x)
+            {
+                binsBase(y, x) = static_cast<uint8_t>((imageBase(y, x) - minValue) * scale + 0.5);
+                binsMatched(y, x) = static_cast<uint8_t>((imageMatched(y, x) - minValue) * scale + 0.5);
+            }
+        }
+    }
+
+    void bootstrapFromLowerLevels(Image& imageBase, Image& imageMatched)
+    {
+        std::vector<std::unique_ptr<GreyScaleImage>> pyramidBase;
+        std::vector<std::unique_ptr<GreyScaleImage>> pyramidMatched;
+        pyramidBase.push_back(downsample(imageBase, rows, cols));
+        pyramidMatched.push_back(downsample(imageMatched, rows, cols));
+        for(int level = 1; level < params.hmiLevels; ++level)
+        {
+            const GreyScaleImage& last = *pyramidBase.back();
+            if(last.getRowCount() / 2 < minLevelSize || last.getColumnCount() / 2 < minLevelSize)
+            {
+                break;
+            }
+            pyramidBase.push_back(downsample(*pyramidBase.back(), last.getRowCount(), last.getColumnCount()));
+            pyramidMatched.push_back(downsample(*pyramidMatched.back(), last.getRowCount(), last.getColumnCount()));
+        }
+
+        if(params.hmiLevels <= 0 || pyramidBase[0]->getRowCount() < minLevelSize || pyramidBase[0]->getColumnCount() < minLevelSize)
+        {
+            // Image too small for hierarchy: use random correspondences on full resolution
+            DisparityMap randomMap = createRandomDisparity(rows, cols, params.maxDisparity);
+            buildCostTable(randomMap, 1);
+            return;
+        }
+
+        int coarsest = static_cast<int>(pyramidBase.size()) - 1;
+        GreyScaleImage& coarsestImage = *pyramidBase[coarsest];
+        DisparityMap prior = createRandomDisparity(coarsestImage.getRowCount(), coarsestImage.getColumnCount(),
+            std::max(1, params.maxDisparity >> (coarsest + 1)));
+        int scale = 1;
+
+        for(int level = coarsest; level >= 0; --level)
+        {
+            int iterations = level == coarsest ? coarsestLevelIterations : 1;
+            for(int i = 0; i < iterations; ++i)
+            {
+                double penaltyScale = level == coarsest && i + 1 < iterations ? coarsestPenaltyScale : 1.0;
+                prior = matchLevel(*pyramidBase[level], *pyramidMatched[level], prior, scale, level + 1, penaltyScale);
+                scale = 1;
+            }
+            scale = 2;
+        }
+        levelArena.release();
+        buildCostTable(prior, 2);
+    }
+
+    DisparityMap matchLevel(GreyScaleImage& levelBase, GreyScaleImage& levelMatched,
+        const DisparityMap& prior, int scale, int levelShift, double penaltyScale)
+    {
+        SgmParameters levelParams = params;
+        levelParams.rows = levelBase.getRowCount();
+        levelParams.cols = levelBase.getColumnCount();
+        levelParams.maxDisparity = std::max(1, params.maxDisparity >> levelShift);
+        levelParams.lowPenaltyCoeff *= penaltyScale;
+        levelParams.highPenaltyCoeff *= penaltyScale;
+
+        DisparityMap result{levelParams.rows, levelParams.cols};
+        {
+            LevelAggregator sgm{levelParams, isLeftImageBase, levelBase, levelMatched, result, levelArena, pool};
+            sgm.getCostComp().setPriorDisparity(&prior, scale);
+            sgm.computeMatchingCosts();
+        }
+        // Next level (twice larger) reuses blocks of this one
+        levelArena.reset();
+        return result;
+    }
+
+    template<typename SourceImage>
+    static std::unique_ptr<GreyScaleImage> downsample(SourceImage& source, int sourceRows, int sourceCols)
+    {
+        int r = sourceRows / 2, c = sourceCols / 2;
+        std::unique_ptr<GreyScaleImage> result{new GreyScaleImage{r, c}};
+        for(int y = 0; y < r; ++y)
+        {
+            for(int x = 0; x < c; ++x)
+            {
+                (*result)(y, x) = 0.25 * (source(2 * y, 2 * x) + source(2 * y, 2 * x + 1) +
+                    source(2 * y + 1, 2 * x) + source(2 * y + 1, 2 * x + 1));
+            }
+        }
+        return result;
+    }
+
+    DisparityMap createRandomDisparity(int mapRows, int mapCols, int maxDisp)
+    {
+        std::mt19937 generator{mapRows * 7919u + mapCols};
+        DisparityMap map{mapRows, mapCols};
+        for(int y = 0; y < mapRows; ++y)
+        {
+            for(int x = 0; x < mapCols; ++x)
+            {
+                int range = std::max(0, std::min(maxDisp, isLeftImageBase ? x : mapCols - 1 - x));
+                int d = std::uniform_int_distribution<int>{0, range}(generator);
+                map(y, x) = Disparity{isLeftImageBase ? -d : d, Disparity::Valid};
+            }
+        }
+        return map;
+    }
+
+    void buildCostTable(const DisparityMap& map, int scale)
+    {
+        std::vector<double> jointHistogram(bins * bins, 0.0);
+        double n = accumulateHistogram(map, scale, jointHistogram);
+        if(n <= 0.0)
+        {
+            std::fill(costTable.begin(), costTable.end(), 0.0);
+            maxCost = 1.0;
+            return;
+        }
+
+        // P(i,k) and marginals
+        std::vector<double> pBase(bins, 0.0);
+        std::vector<double> pMatched(bins, 0.0);
+        for(int i = 0; i < bins; ++i)
+        {
+            for(int k = 0; k < bins; ++k)
+            {
+                double p = jointHistogram[i * bins + k] / n;
+                jointHistogram[i * bins + k] = p;
+                pBase[i] += p;
+                pMatched[k] += p;
+            }
+        }
+
+        // h(i,k) = -log(P(i,k) * g) * g
+        // Constant factor 1/n is omitted as it only scales costs (penalties are relative to max cost)
+        std::vector<double> hJoint = entropyFromProbability(jointHistogram, bins);
+        std::vector<double> hBase = entropyFromProbability(pBase, 1);
+        std::vector<double> hMatched = entropyFromProbability(pMatched, 1);
+
+        double minCost = 1e12;
+        for(int i = 0; i < bins; ++i)
+        {
+            for(int k = 0; k < bins; ++k)
+            {
+                double mi = hBase[i] + hMatched[k] - hJoint[i * bins + k];
+                costTable[i * bins + k] = -mi;
+                minCost = std::min(minCost, -mi);
+            }
+        }
+
+        // Expected cost of pixels drawn independently from both images
+        double unrelatedCost = 0.0;
+        for(int i = 0; i < bins; ++i)
+        {
+            for(int k = 0; k < bins; ++k)
+            {
+                double& c = costTable[i * bins + k];
+                c -= minCost;
+                unrelatedCost += pBase[i] * pMatched[k] * c;
+            }
+        }
+        maxCost = unrelatedCost > 0.0 ? penaltyReferenceFactor * unrelatedCost : 1.0;
+    }
+
+    // Accumulates joint histogram of correspondences in parallel, each task on its own histogram.
+    // Returns number of accumulated correspondences
+    double accumulateHistogram(const DisparityMap& map, int scale, std::vector<double>& jointHistogram)
+    {
+        int tasksCount = std::max(1, std::min(params.maxParallelTasks, rows));
+        int rowsInTask = (rows + tasksCount - 1) / tasksCount;
+        std::vector<std::vector<uint32_t>> partialHistograms(tasksCount);
+        std::vector<double> partialCounts(tasksCount, 0.0);
+
+        StaticTaskQueue queue{static_cast<std::size_t>(tasksCount), &pool};
+        for(int t = 0; t < tasksCount; ++t)
+        {
+            queue.addTask(Task{static_cast<TaskId>(t), [this, &map, scale, t, rowsInTask, &partialHistograms, &partialCounts]()
+            {
+                std::vector<uint32_t>& histogram = partialHistograms[t];
+                histogram.assign(bins * bins, 0u);
+                partialCounts[t] = accumulateRows(map, scale, t * rowsInTask,
+                    std::min(rows, (t + 1) * rowsInTask), histogram.data());
+            }}, {});
+        }
+        queue.run();
+
+        double n = 0.0;
+        for(int t = 0; t < tasksCount; ++t)
+        {
+            n += partialCounts[t];
+            for(int i = 0; i < bins * bins; ++i)
+            {
+                jointHistogram[i] += partialHistograms[t][i];
+            }
+        }
+        return n;
+    }
+
+    double accumulateRows(const DisparityMap& map, int scale, int startRow, int endRow, uint32_t* histogram)
+    {
+        double count = 0.0;
+        for(int y = startRow; y < endRow; ++y)
+        {
+            int my = std::min(y / scale, map.getRowCount() - 1);
+            for(int x = 0; x < cols; ++x)
+            {
+                int mx = std::min(x / scale, map.getColumnCount() - 1);
+                const Disparity d = map(my, mx);
+                if(d.flags != Disparity::Valid)
+                {
+                    continue;
+                }
+
+                int matchedX = x + static_cast<int>(std::floor(d.subDx * scale + 0.5));
+                if(matchedX >= 0 && matchedX < cols)
+                {
+                    histogram[binsBase(y, x) * bins + binsMatched(y, matchedX)] += 1u;
+                    count += 1.0;
+                }
+            }
+        }
+        return count;
+    }
+
+    // For 'cols' == 1 'probability' is treated as 1d vector, otherwise as cols x cols table
+    static std::vector<double> entropyFromProbability(const std::vector<double>& probability, int tableCols)
+    {
+        static constexpr double minProbability = 1e-7;
+        std::vector<double> entropy = gaussianSmooth(probability, tableCols);
+        for(double& e : entropy)
+        {
+            e = -std::log(std::max(e, minProbability));
+        }
+        return gaussianSmooth(entropy, tableCols);
+    }
+
+    // Separable 7x7 gaussian (sigma = 1) with zero padding
+    static std::vector<double> gaussianSmooth(const std::vector<double>& table, int tableCols)
+    {
+        static constexpr int radius = 3;
+        static constexpr double kernel[2 * radius + 1] = {
+            0.00443305, 0.05400558, 0.24203623, 0.39905028, 0.24203623, 0.05400558, 0.00443305
+        };
+
+        int tableRows = static_cast<int>(table.size()) / tableCols;
+        std::vector<double> temp(table.size(), 0.0);
+        std::vector<double> result(table.size(), 0.0);
+
+        // Rows pass (along first index)
+        for(int r = 0; r < tableRows; ++r)
+        {
+            for(int c = 0; c < tableCols; ++c)
+            {
+                double sum = 0.0;
+                for(int k = -radius; k <= radius; ++k)
+                {
+                    int rr = r + k;
+                    if(rr >= 0 && rr < tableRows) { sum += kernel[k + radius] * table[rr * tableCols + c]; }
+                }
+                temp[r * tableCols + c] = sum;
+            }
+        }
+
+        if(tableCols == 1)
+        {
+            return temp;
+        }
+
+        // Columns pass (along second index)
+        for(int r = 0; r < tableRows; ++r)
+        {
+            for(int c = 0; c < tableCols; ++c)
+            {
+                double sum = 0.0;
+                for(int k = -radius; k <= radius; ++k)
+                {
+                    int cc = c + k;
+                    if(cc >= 0 && cc < tableCols) { sum += kernel[k + radius] * temp[r * tableCols + cc]; }
+                }
+                result[r * tableCols + c] = sum;
+            }
+        }
+        return result;
+    }
+};
+}
@@ -3,34 +3,66 @@
 #include "SgmCommon.hpp"
 #include "SgmCostAggregator.hpp"
 #include "CensusCostComputer.hpp"
-#include <CamCommon\TaskQueue.hpp>
+#include <CamCommon/FrameArena.hpp>
+#include <CamCommon/TaskQueue.hpp>
+#include <CamCommon/Profiler.hpp>
+#include <type_traits>
 
 namespace cam3d
 {
+	// True if local costs of one view may be derived from other one (CostComputer::initFromOppositeView())
+	template<typename CostComputer, typename = void>
+	struct SharesCostsBetweenViews : std::false_type { };
+
+	template<typename CostComputer>
+	struct SharesCostsBetweenViews<CostComputer, decltype(void(&CostComputer::initFromOppositeView))> : std::true_type { };
+
 	template<typename SgmAggregator>
 	class ParallelSgmAlgorithm : public ISgmCostAggregator
 	{
 		using Image = typename SgmAggregator::Image;
+		ThreadPool& pool;
 		StaticTaskQueue queue;
 		DisparityMap& mapLeft;
 		DisparityMap& mapRight;
 		Image& imageLeft;
 		Image& imageRight;
 		SgmParameters params;
+		std::unique_ptr<memory::FrameArena> ownArena; // If caller did not pass one
+		memory::FrameArena& arena;
 
 		SgmAggregator sgmLeft;
 		SgmAggregator sgmRight;
 
 	public:
 		ParallelSgmAlgorithm(SgmParameters& params, DisparityMap& mapLeft, DisparityMap& mapRight,
-			Image& imageLeft, Image& imageRight) :
-				queue{ params.maxParallelTasks }, mapLeft{mapLeft}, mapRight{mapRight},
+			Image& imageLeft, Image& imageRight, ThreadPool* callerPool = nullptr, memory::FrameArena* callerArena = nullptr) :
+				pool{ callerPool != nullptr ? *callerPool : ThreadPool::getShared() },
+				queue{ static_cast<std::size_t>(params.maxParallelTasks), &pool }, mapLeft{mapLeft}, mapRight{mapRight},
 				imageLeft{imageLeft}, imageRight{imageRight}, params{params},
-				sgmLeft{ params, true, imageLeft, imageRight, mapLeft },
-				sgmRight{ params, false, imageRight, imageLeft, mapRight }
-		{ }
+				ownArena{ callerArena == nullptr ? new memory::FrameArena{} : nullptr },
+				arena{ callerArena != nullptr ? *callerArena : *ownArena },
+				sgmLeft{ params, true, imageLeft, imageRight, mapLeft, arena, pool },
+				sgmRight{ params, false, imageRight, imageLeft, mapRight, arena, pool }
+		{
+			addTasks();
+		}
 
 		void computeMatchingCosts() override
+		{
+			CAM3D_TRACE_SCOPE("ParallelSgm.ComputeMatchingCosts");
+			queue.run();
+		}
+
+		double getProgress() override
+		{
+			std::size_t count = queue.getTaskCount();
+			return count > 0 ? static_cast<double>(queue.getTaskDoneCount()) / count : 0.0;
+		}
+
+	private:
+		// Graph is built once and compiled on first run
+		void addTasks()
 		{
 			enum Tasks
 			{
@@ -43,9 +75,7 @@ namespace cam3d
 				rightPaths,
 				rightTopDown,
 				rightBottomUp,
-				rightDisp,
-				leftAll,
-				rightAll
+				rightDisp
 			};
 
 			queue.addTask(Task{ leftCensus, [this]() {
@@ -65,9 +95,11 @@ namespace cam3d
 				sgmLeft.done();
 			} }, { leftTopDown, leftBottomUp });
 
+			// Right view waits for left one if it reuses its costs
+			using SharesCosts = SharesCostsBetweenViews<typename SgmAggregator::CostComputer>;
 			queue.addTask(Task{ rightCensus, [this]() {
-				sgmRight.initLocalCosts();
-			} }, {});
+				initRightLocalCosts(SharesCosts{});
+			} }, SharesCosts::value ? std::vector<TaskId>{ leftCensus } : std::vector<TaskId>{});
 			queue.addTask(Task{ rightPaths, [this]() {
 				sgmRight.initPaths();
 			} }, { rightCensus });
@@ -81,17 +113,12 @@ namespace cam3d
 				sgmRight.findDisparities();
 				sgmRight.done();
 			} }, { rightTopDown, rightBottomUp });
-
-			/*queue.addTask(Task{ leftAll, [this]() {
-				sgmLeft.computeMatchingCosts();
-			} }, {});
-			queue.addTask(Task{ rightAll, [this]() {
-				sgmRight.computeMatchingCosts();
-			} }, {});*/
-
-			queue.run();
 		}
 
+		void initRightLocalCosts(std::true_type) { sgmRight.initLocalCostsFromOppositeView(sgmLeft); }
+		void initRightLocalCosts(std::false_type) { sgmRight.initLocalCosts(); }
+
+	public:
 		void terminate() override
 		{
 			sgmLeft.terminate();
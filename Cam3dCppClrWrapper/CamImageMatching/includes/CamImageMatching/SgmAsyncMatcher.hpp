@@ -0,0 +1,110 @@
+#pragma once
+
+#include "SgmCommon.hpp"
+#include "SgmBatchMatcher.hpp"
+#include <CamCommon/ThreadPool.hpp>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace cam3d
+{
+	enum class SgmMatchStatus
+	{
+		Queued,
+		Running,
+		Done,
+		Cancelled,
+		Failed,
+	};
+
+	// Called once submitted pair is finished, on thread which matched it (or which cancelled it
+	// while queued). 'error' is set if status is Failed
+	using SgmMatchCallback = std::function<void(StereoPair& pair, SgmMatchStatus status, std::exception_ptr error)>;
+
+	namespace detail
+	{
+		struct SgmMatchState
+		{
+			StereoPair pair;
+			SgmMatchCallback onDone;
+			std::promise<SgmMatchStatus> promise;
+			std::shared_future<SgmMatchStatus> future;
+
+			std::mutex mutex;
+			SgmMatchStatus status;
+			bool cancelled;
+			ISgmCostAggregator* sgm; // While running
+			double progress;         // When not running
+			std::string lastState;
+		};
+	}
+
+	// Submitted match. Copies share the match; handle may be dropped without waiting.
+	// Default-constructed handle has no match - all but isValid() throw std::logic_error on it
+	class SgmMatchHandle
+	{
+		std::shared_ptr<detail::SgmMatchState> state;
+
+	public:
+		SgmMatchHandle() { }
+		explicit SgmMatchHandle(std::shared_ptr<detail::SgmMatchState> state_) : state{ std::move(state_) } { }
+
+		bool isValid() const { return state != nullptr; }
+
+		// Ready after callback returned. get() yields Done or Cancelled, or rethrows error of failed match
+		std::shared_future<SgmMatchStatus> getFuture() const { return checkedState().future; }
+		SgmMatchStatus wait() const { return checkedState().future.get(); }
+
+		// Queued match is dropped, running one stops at next check. No effect on finished match
+		void cancel() const;
+
+		SgmMatchStatus getStatus() const;
+		double getProgress() const; // In [0, 1]
+		std::string getState() const;
+		const StereoPair& getPair() const { return checkedState().pair; }
+
+	private:
+		detail::SgmMatchState& checkedState() const;
+	};
+
+	// Matches submitted pairs in background, all their tasks on one shared thread pool.
+	// Up to 'maxPairsInFlight' pairs are matched at once, later submissions wait in queue
+	// (FIFO), so that caller may capture next frames and display previous ones meanwhile.
+	// As in SgmBatchMatcher, images and maps of pair are owned by caller and must be valid
+	// until its future is ready.
+	class SgmAsyncMatcher
+	{
+		ThreadPool pool;
+		std::vector<std::thread> slots;
+
+		std::mutex queueMutex;
+		std::condition_variable pairQueued;
+		std::deque<std::shared_ptr<detail::SgmMatchState>> queue;
+		std::vector<std::shared_ptr<detail::SgmMatchState>> running;
+		bool stopping;
+
+	public:
+		// 0 threads means one per hardware thread
+		SgmAsyncMatcher(std::size_t threadsCount, std::size_t maxPairsInFlight);
+		// Cancels all queued and running matches and waits for them
+		~SgmAsyncMatcher();
+
+		SgmAsyncMatcher(const SgmAsyncMatcher&) = delete;
+		SgmAsyncMatcher& operator=(const SgmAsyncMatcher&) = delete;
+
+		SgmMatchHandle submit(const StereoPair& pair, SgmMatchCallback onDone = SgmMatchCallback{});
+		void cancelAll();
+
+		std::size_t getQueuedCount();
+		std::size_t getRunningCount();
+
+	private:
+		void runSlot();
+		void match(detail::SgmMatchState& match, memory::FrameArena& arena);
+	};
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "SgmCommon.hpp"
+#include <CamCommon/ThreadPool.hpp>
+#include <atomic>
+#include <exception>
+#include <mutex>
+
+namespace cam3d
+{
+	// Single pair to match in batch. Images and maps are owned by caller
+	// and must be valid until pair is passed back to sink
+	struct StereoPair
+	{
+		std::size_t index;
+		SgmParameters parameters;
+		void* imageLeft; // Type as in parameters.imageType
+		void* imageRight;
+		DisparityMap* mapLeft;
+		DisparityMap* mapRight;
+		void* userData;
+	};
+
+	// Matches many stereo pairs with all their tasks executed on one shared thread pool.
+	// At most 'maxPairsInFlight' pairs are matched at once, so while one pair is in
+	// its serial stages (census, disparities) the others keep remaining threads busy
+	// and memory is bounded by number of pairs in flight.
+	class SgmBatchMatcher
+	{
+	public:
+		// Fills next pair to match. Returns false if there are no more pairs.
+		// Called under lock, so pairs may be loaded lazily
+		using PairSource = std::function<bool(StereoPair& pair)>;
+		// Called once pair is matched, concurrently from many threads
+		using PairSink = std::function<void(StereoPair& pair)>;
+
+	private:
+		ThreadPool pool;
+		std::size_t maxPairsInFlight;
+
+		std::mutex sourceMutex;
+		std::mutex stateMutex;
+		std::vector<ISgmCostAggregator*> pairsInFlight;
+		std::exception_ptr firstError;
+
+		std::atomic_bool shouldTerminate;
+		std::atomic<std::size_t> doneCount;
+
+	public:
+		// 0 threads means one per hardware thread
+		SgmBatchMatcher(std::size_t threadsCount, std::size_t maxPairsInFlight);
+
+		// Blocks until all pairs from source are matched or batch is terminated.
+		// Rethrows first exception thrown while matching any pair
+		void run(PairSource source, PairSink sink);
+		void terminate();
+
+		std::size_t getDoneCount() const { return doneCount; }
+		std::string getState();
+
+	private:
+		void runSlot(std::size_t slot, PairSource& source, PairSink& sink);
+		bool takeNextPair(PairSource& source, StereoPair& pair);
+		void setPairInFlight(std::size_t slot, ISgmCostAggregator* sgm);
+	};
+}
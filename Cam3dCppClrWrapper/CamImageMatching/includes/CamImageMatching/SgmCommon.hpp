@@ -23,6 +23,12 @@ namespace cam3d
         DistanceSquredToMean,
 	};
 
+	enum class MatchingCostType
+	{
+		Census,
+		HierarchicalMutualInformation,
+	};
+
 	enum class ImageType
 	{
 		Grey,
@@ -59,6 +65,8 @@ namespace cam3d
 		double highPenaltyCoeff;
         double intensityThreshold;
 		int censusMaskRadius;
+		MatchingCostType matchingCostType;
+		int hmiLevels; // Number of downsampled levels used to bootstrap HMI tables
 		MeanMethod disparityMeanMethod;
 		CostMethod disparityCostMethod;
 		double diparityPathLengthThreshold;
@@ -68,10 +76,22 @@ namespace cam3d
 	class ISgmCostAggregator
 	{
 	public:
+		virtual ~ISgmCostAggregator() { }
+
 		virtual void computeMatchingCosts() = 0;
 		virtual void terminate() = 0;
 		virtual std::string getState() = 0;
+		// Fraction of work done, in [0, 1]. Thread-safe, may be coarse
+		virtual double getProgress() { return 0.0; }
 	};
 
-	ISgmCostAggregator* createSgm(SgmParameters& parameters, DisparityMap& mapLeft, DisparityMap& mapRight, void* imageLeft, void* imageRight);
+	class ThreadPool;
+	namespace memory { class FrameArena; }
+
+	// If 'pool' is given, tasks of created algorithm are executed on it instead of on own threads.
+	// If 'arena' is given, paths and per-frame arrays are allocated from it - it must outlive
+	// the algorithm and may be reset (memory::FrameArena::reset()) after algorithm is destroyed,
+	// so that consecutive frames reuse its blocks. Otherwise algorithm owns its arena.
+	ISgmCostAggregator* createSgm(SgmParameters& parameters, DisparityMap& mapLeft, DisparityMap& mapRight,
+		void* imageLeft, void* imageRight, ThreadPool* pool = nullptr, memory::FrameArena* arena = nullptr);
 }
@@ -4,6 +4,8 @@
 #include "SgmPathsManager.hpp"
 #include "SgmPath.hpp"
 #include "SgmDisparityComputer.hpp"
+#include <CamCommon/FrameArena.hpp>
+#include <CamCommon/Profiler.hpp>
 #include <stdexcept>
 #include <atomic>
 #include <mutex>
@@ -26,7 +28,8 @@ private:
     double highPenaltyCoeff; // P2 = coeff * MaxCost
     double intensityThreshold;
     bool isLeftImageBase = true;
-    std::vector<double> thisStepCosts;
+    // Costs of step being computed, one buffer for each run direction, as both runs are concurrent
+    double* thisStepCosts[2];
     SgmPathsManager pathMgr;
 
     double P1;
@@ -46,21 +49,28 @@ private:
 	std::function<std::string()> statusPrinter;
 
 public:
-    SgmCostAggregator(SgmParameters& params, bool isLeftBase, Image& imageBase_, Image& imageMatched_, DisparityMap& map_) :
+    // Paths and per-frame arrays are allocated from 'arena' and cost computer runs its tasks on 'pool',
+    // both must outlive aggregator
+    SgmCostAggregator(SgmParameters& params, bool isLeftBase, Image& imageBase_, Image& imageMatched_, DisparityMap& map_,
+        memory::FrameArena& arena, ThreadPool& pool) :
         rows{ params.rows },
         cols{ params.cols },
         isLeftImageBase{ isLeftBase },
+        pathMgr{ params.rows, params.cols, params.maxDisparity, [this](Point2 p1, Point2 p2){ return this->getCost(p1, p2); },
+            [this](Point2 p){ return this->getDispRange(p.x); }, isLeftImageBase, arena},
 		imageBase{imageBase_},
 		imageMatched{imageMatched_},
 		map{map_},
-        pathMgr{ params.rows, params.cols, [this](Point2 p1, Point2 p2){ return this->getCost(p1, p2); },
-            [this](Point2 p){ return this->getDispRange(p.x); }, isLeftImageBase},
-        costComp{ params.rows, params.cols },
+        costComp{ params.rows, params.cols, arena, pool },
 		dispComp{ params.rows, params.cols, map_, imageBase_, imageMatched_, costComp},
 		statusPrinter{ [this]() { return std::string{"Not run"}; } }
     {
 		setParameters(params);
 		shouldTerminate = false;
+		for (double*& costs : thisStepCosts)
+		{
+			costs = arena.allocateArray<double>(std::min(cols, params.maxDisparity) + 2);
+		}
     }
 
     int getRows() const { return rows; }
@@ -104,6 +114,7 @@ public:
 
 	void initLocalCosts()
 	{
+		CAM3D_TRACE_SCOPE("Sgm.InitLocalCosts");
 		changeStatus([this]()
 		{
 			Point2 pixel = this->costComp.getCurrentPixel();
@@ -114,11 +125,21 @@ public:
 		P2 = highPenaltyCoeff * costComp.getMaxCost();
 	}
 
+	// For cost computers with initFromOppositeView(): local costs are derived from aggregator
+	// of other view, which must have its local costs initialized
+	void initLocalCostsFromOppositeView(SgmCostAggregator& opposite)
+	{
+		CAM3D_TRACE_SCOPE("Sgm.InitLocalCosts");
+		costComp.initFromOppositeView(opposite.costComp, imageBase, imageMatched);
+		P1 = lowPenaltyCoeff * costComp.getMaxCost();
+		P2 = highPenaltyCoeff * costComp.getMaxCost();
+	}
+
 	void initPaths()
 	{
+		CAM3D_TRACE_SCOPE("Sgm.InitPaths");
 		changeStatus([this]() { return std::string{ "Preparing Paths" }; });
 		pathMgr.init();
-		thisStepCosts.resize(cols + 1);
 	}
 
 	void done()
@@ -128,6 +149,7 @@ public:
 
     void findCostsTopDown()
     {
+		CAM3D_TRACE_SCOPE("Sgm.FindCostsTopDown");
 		int y, x;
 		changeStatus([this, &x, &y]() { return "Run: TopDown { " + to_string(Point2{ y, x }) + " }"; });
         for(y = 0; y < rows; ++y)
@@ -142,6 +164,7 @@ public:
 
     void findCostsBottomUp()
     {
+		CAM3D_TRACE_SCOPE("Sgm.FindCostsBottomUp");
 		int y, x;
 		changeStatus([this, &x, &y]() { return "Run: BottomUp { " + to_string(Point2{ y, x }) + " }"; });
         for(y = rows - 1; y >= 0; --y)
@@ -169,17 +192,17 @@ public:
         SgmPath* path = pathMgr.getPath(borderPixel, pathIdx);
         TEST_checkPathCorrectness(path, currentPixel);
 
-        findCostForEachDisparityInStep(path, pathIdx, maxDisp);
+        findCostForEachDisparityInStep(path, pathIdx, maxDisp, thisStepCosts[isBottomUp ? 1 : 0]);
 
-        if(isBottomUp && maxDisp > 0)
+        if(maxDisp > 0)
         {
-            alignForBottomUp(path, maxDisp, currentPixel);
+            alignForDisparityRange(path, maxDisp, currentPixel);
         }
 
         path->next();
     }
 
-    void findCostForEachDisparityInStep(SgmPath* path, int pathIdx, int maxDisp)
+    void findCostForEachDisparityInStep(SgmPath* path, int pathIdx, int maxDisp, double* stepCosts)
     {
         int bestDisp = 0;
         int bestLength = 0;
@@ -194,7 +217,7 @@ public:
 
             double cost = findCostForDisparity(
                               path->currentPixel, matched, path, d, maxDisp, bestPrevCost.disparity, bestPrevCost.cost);
-            thisStepCosts[d] = cost;
+            stepCosts[d] = cost;
 
             if(bestCost > cost)
             {
@@ -204,17 +227,23 @@ public:
             }
         }
         pathMgr.setBestPathCosts(path->currentPixel, pathIdx, {bestCost, bestDisp, bestLength});
-        std::copy(thisStepCosts.begin(), thisStepCosts.end(), path->lastStepCosts.begin());
+        // Range is empty (or -1) on first columns
+        std::copy(stepCosts, stepCosts + std::max(maxDisp, 0), path->lastStepCosts);
     }
 
-    void alignForBottomUp(SgmPath* path, int maxDisp, Point2 currentPixel)
+    void alignForDisparityRange(SgmPath* path, int maxDisp, Point2 currentPixel)
     {
         // For disparity greater than max, matched pixel may exceed image dimensions:
         // L[p, d > dmax-1] = Cost(curPix, maxXPix) + LastCost[dmax-1]
-        // We actualy need only to compute L[p, dmax] as it will be needed in next iteration
+        // We actualy need only to compute L[p, dmax] and L[p, dmax+1] as they will be needed in next iteration
+        // (disparity range may grow by one on next pixel on path and costs left from other pixels are invalid)
         int matchedX = isLeftImageBase ? 0 : cols - 1;
-        path->lastStepCosts[maxDisp] = // As LastStepCosts is of size dispRange + 1 we won't exceed max index
-                getCost(currentPixel, { currentPixel.y, matchedX }) + path->lastStepCosts[maxDisp - 1];
+        double outOfRangeCost = getCost(currentPixel, { currentPixel.y, matchedX }) + path->lastStepCosts[maxDisp - 1];
+        path->lastStepCosts[maxDisp] = outOfRangeCost; // As LastStepCosts is of size maxDisparity + 2 we won't exceed max index
+        if(maxDisp + 1 < path->lastStepCostsCount)
+        {
+            path->lastStepCosts[maxDisp + 1] = outOfRangeCost;
+        }
     }
 
     void TEST_checkPathCorrectness(SgmPath* path, Point2 currentPixel)
@@ -280,6 +309,7 @@ public:
 
     void findDisparities()
     {
+		CAM3D_TRACE_SCOPE("Sgm.FindDisparities");
 		int r, c;
 		changeStatus([this, &r, &c]() { return "Run: Disparities { " + to_string(Point2{ r, c }) + " }"; });
         for(r = 0; r < rows; ++r)
@@ -312,8 +342,7 @@ void SgmCostAggregator<ImageT, CostComputerT>::setParameters(SgmParameters& para
 	this->lowPenaltyCoeff = params.lowPenaltyCoeff;
 	this->highPenaltyCoeff = params.highPenaltyCoeff;
     this->intensityThreshold = params.intensityThreshold;
-	this->costComp.setMaskWidth(params.censusMaskRadius);
-	this->costComp.setMaskHeight(params.censusMaskRadius);
+	this->costComp.setParameters(params, isLeftImageBase);
 	this->dispComp.setCostMethod((cam3d::CostMethod)params.disparityCostMethod);
 	this->dispComp.setMeanMethod((cam3d::MeanMethod)params.disparityMeanMethod);
     this->dispComp.setCostMethodPower(params.costMethodPower);
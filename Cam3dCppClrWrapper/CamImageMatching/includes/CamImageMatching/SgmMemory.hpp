@@ -0,0 +1,48 @@
+#pragma once
+
+#include "SgmCommon.hpp"
+#include <cstddef>
+
+namespace cam3d
+{
+	// Predicted memory of matching both views with createSgm(), in bytes.
+	// Actual usage may be read with memory::getPeakBytes() (CamCommon/MemoryAccounting.hpp).
+	struct SgmMemoryEstimate
+	{
+		std::size_t pathPointers;  // Per pixel pointers to paths starting on border
+		std::size_t bestPathCosts; // Per pixel best cost of each path
+		std::size_t borderPaths;   // Paths with costs of last step
+		std::size_t matchingCosts; // Census words or HMI bins, tables and pyramid
+		std::size_t callerBuffers; // Input images and output disparity maps
+		std::size_t total;
+	};
+
+	SgmMemoryEstimate estimateSgmMemory(const SgmParameters& parameters);
+
+	enum class SgmExecutionStrategy
+	{
+		WholeImage,
+		RowBands, // Bands of rows are matched one after another and stitched
+	};
+
+	struct SgmExecutionPlan
+	{
+		SgmExecutionStrategy strategy;
+		int bandRows;    // Rows of output written by one band
+		int overlapRows; // Rows matched additionally above and below band, so that vertical paths have context
+		std::size_t peakBytes; // Predicted, including caller buffers of whole image
+		bool fitsBudget;
+	};
+
+	constexpr int sgmBandOverlapRows = 32;
+	constexpr int sgmMinBandRows = 16;
+
+	// Chooses cheapest strategy which fits 'budgetBytes'. If none fits, returns plan
+	// with smallest bands and 'fitsBudget' set to false.
+	SgmExecutionPlan planSgmExecution(const SgmParameters& parameters, std::size_t budgetBytes);
+
+	// As createSgm(), but follows planSgmExecution(). Throws std::runtime_error if matching
+	// does not fit 'budgetBytes' with any strategy.
+	ISgmCostAggregator* createSgmWithinBudget(SgmParameters& parameters, DisparityMap& mapLeft, DisparityMap& mapRight,
+		void* imageLeft, void* imageRight, std::size_t budgetBytes, ThreadPool* pool = nullptr);
+}
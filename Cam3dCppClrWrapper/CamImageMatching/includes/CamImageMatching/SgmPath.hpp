@@ -1,7 +1,6 @@
 #pragma once
 
 #include <CamCommon/Vector2.hpp>
-#include <vector>
 
 namespace cam3d
 {
@@ -34,12 +33,15 @@ public:
         return currentIndex < length - 1;
     }
 
-    std::vector<double> lastStepCosts; // Needs to be allocated externally
+    // Allocated externally, at least min(cols, maxDisparity) + 2 entries
+    double* lastStepCosts;
+    int lastStepCostsCount;
 
     virtual void init() = 0;
     virtual void next() = 0;
 
-    virtual ~SgmPath() { }
+    // Paths live in FrameArena of SgmPathsManager and are never destroyed,
+    // so they must stay trivially destructible (no virtual destructor, no owning members)
 };
 
 class SgmPath_PosX : public SgmPath
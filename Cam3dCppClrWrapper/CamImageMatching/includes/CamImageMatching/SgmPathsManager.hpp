@@ -2,6 +2,7 @@
 
 #include "SgmCommon.hpp"
 #include "SgmPath.hpp"
+#include <CamCommon/FrameArena.hpp>
 
 namespace cam3d
 {
@@ -10,9 +11,13 @@ class SgmPathsManager
 private:
 	int rows;
 	int cols;
+    int maxDisparity;
     bool isLeftImageBase;
-    Array3d<SgmPath*> paths;
-    Array3d<PathCost> bestPathsCosts;
+    // Paths, their costs and both arrays are allocated from 'arena', which must outlive manager
+    memory::FrameArena& arena;
+    Array3d<SgmPath*, memory::ArenaAllocator<SgmPath*>> paths;
+    Array3d<PathCost, memory::ArenaAllocator<PathCost>> bestPathsCosts;
+    bool borderPathsCreated;
     using BorderPixelGetter = Point2(*)(Point2, int, int);
     BorderPixelGetter borderPixelGetters[pathsCount];
     std::function<double(Point2, Point2)> getCost;
@@ -20,9 +25,8 @@ private:
 public:
     static constexpr int pathsPerRun = pathsCount / 2;
 
-    SgmPathsManager(int rows, int cols, std::function<double(Point2, Point2)> getCost,
-                    std::function<int(Point2)> getDispRange, bool isLeftImageBase);
-    ~SgmPathsManager();
+    SgmPathsManager(int rows, int cols, int maxDisparity, std::function<double(Point2, Point2)> getCost,
+                    std::function<int(Point2)> getDispRange, bool isLeftImageBase, memory::FrameArena& arena);
 
     void init();
     std::array<int, pathsPerRun> getPathIdxsForRun(RunDirection dir);
@@ -50,6 +54,8 @@ public:
 private:
     void createBorderPaths();
     void createPathsForBorderPixel(Point2 pixel);
+    template<typename PathT>
+    SgmPath* createPath();
     void initZeroStep(Point2 borderPixel);
     void findInitialCostOnPath(SgmPath* path, int pathNum);
     void initBorderPixelGetters();
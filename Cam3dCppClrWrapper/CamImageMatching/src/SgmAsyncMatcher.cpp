@@ -0,0 +1,251 @@
+#include "SgmAsyncMatcher.hpp"
+#include <CamCommon/FrameArena.hpp>
+#include <algorithm>
+#include <stdexcept>
+
+namespace cam3d
+{
+	namespace
+	{
+		// Runs callback and makes future ready. Callback's exception fails the match
+		void finishMatch(detail::SgmMatchState& match, SgmMatchStatus status, std::exception_ptr error)
+		{
+			if (match.onDone)
+			{
+				try
+				{
+					match.onDone(match.pair, status, error);
+				}
+				catch (...)
+				{
+					if (error == nullptr)
+					{
+						status = SgmMatchStatus::Failed;
+						error = std::current_exception();
+					}
+				}
+			}
+			{
+				std::lock_guard<std::mutex> lock(match.mutex);
+				match.status = status;
+				match.progress = status == SgmMatchStatus::Done ? 1.0 : match.progress;
+			}
+			if (error != nullptr) { match.promise.set_exception(error); }
+			else { match.promise.set_value(status); }
+		}
+
+		const char* getStatusName(SgmMatchStatus status)
+		{
+			switch (status)
+			{
+			case SgmMatchStatus::Queued: return "Queued";
+			case SgmMatchStatus::Running: return "Running";
+			case SgmMatchStatus::Done: return "Done";
+			case SgmMatchStatus::Cancelled: return "Cancelled";
+			default: return "Failed";
+			}
+		}
+	}
+
+	detail::SgmMatchState& SgmMatchHandle::checkedState() const
+	{
+		if (state == nullptr)
+		{
+			throw std::logic_error("SgmMatchHandle has no match - it was not returned by SgmAsyncMatcher::submit()");
+		}
+		return *state;
+	}
+
+	void SgmMatchHandle::cancel() const
+	{
+		detail::SgmMatchState& match = checkedState();
+		bool dropQueued = false;
+		{
+			std::lock_guard<std::mutex> lock(match.mutex);
+			if (match.status == SgmMatchStatus::Queued)
+			{
+				// Slot which takes it from queue will skip it
+				match.status = SgmMatchStatus::Cancelled;
+				dropQueued = true;
+			}
+			else if (match.status == SgmMatchStatus::Running)
+			{
+				match.cancelled = true;
+				if (match.sgm != nullptr) { match.sgm->terminate(); }
+			}
+		}
+		if (dropQueued)
+		{
+			finishMatch(match, SgmMatchStatus::Cancelled, nullptr);
+		}
+	}
+
+	SgmMatchStatus SgmMatchHandle::getStatus() const
+	{
+		detail::SgmMatchState& match = checkedState();
+		std::lock_guard<std::mutex> lock(match.mutex);
+		return match.status;
+	}
+
+	double SgmMatchHandle::getProgress() const
+	{
+		detail::SgmMatchState& match = checkedState();
+		std::lock_guard<std::mutex> lock(match.mutex);
+		return match.sgm != nullptr ? match.sgm->getProgress() : match.progress;
+	}
+
+	std::string SgmMatchHandle::getState() const
+	{
+		detail::SgmMatchState& match = checkedState();
+		std::lock_guard<std::mutex> lock(match.mutex);
+		if (match.sgm != nullptr)
+		{
+			return match.sgm->getState();
+		}
+		std::string name = getStatusName(match.status);
+		return match.lastState.empty() ? name : name + "; " + match.lastState;
+	}
+
+	SgmAsyncMatcher::SgmAsyncMatcher(std::size_t threadsCount, std::size_t maxPairsInFlight) :
+		pool{ threadsCount },
+		stopping{ false }
+	{
+		// Slot threads drive task queues of their pairs and execute pool jobs while waiting
+		for (std::size_t slot = 0; slot < std::max<std::size_t>(maxPairsInFlight, 1); ++slot)
+		{
+			slots.emplace_back([this]() { runSlot(); });
+		}
+	}
+
+	SgmAsyncMatcher::~SgmAsyncMatcher()
+	{
+		cancelAll();
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			stopping = true;
+		}
+		pairQueued.notify_all();
+		for (std::thread& slot : slots)
+		{
+			slot.join();
+		}
+	}
+
+	SgmMatchHandle SgmAsyncMatcher::submit(const StereoPair& pair, SgmMatchCallback onDone)
+	{
+		auto match = std::make_shared<detail::SgmMatchState>();
+		match->pair = pair;
+		match->onDone = std::move(onDone);
+		match->future = match->promise.get_future().share();
+		match->status = SgmMatchStatus::Queued;
+		match->cancelled = false;
+		match->sgm = nullptr;
+		match->progress = 0.0;
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			queue.push_back(match);
+		}
+		pairQueued.notify_one();
+		return SgmMatchHandle{ match };
+	}
+
+	void SgmAsyncMatcher::cancelAll()
+	{
+		std::vector<std::shared_ptr<detail::SgmMatchState>> matches;
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			matches.assign(queue.begin(), queue.end());
+			matches.insert(matches.end(), running.begin(), running.end());
+		}
+		for (auto& match : matches)
+		{
+			SgmMatchHandle{ match }.cancel();
+		}
+	}
+
+	std::size_t SgmAsyncMatcher::getQueuedCount()
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		return queue.size();
+	}
+
+	std::size_t SgmAsyncMatcher::getRunningCount()
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		return running.size();
+	}
+
+	void SgmAsyncMatcher::runSlot()
+	{
+		// Temporaries of pairs matched in this slot, reused from pair to pair
+		memory::FrameArena arena;
+		while (true)
+		{
+			std::shared_ptr<detail::SgmMatchState> next;
+			{
+				std::unique_lock<std::mutex> lock(queueMutex);
+				pairQueued.wait(lock, [this]() { return stopping || !queue.empty(); });
+				if (queue.empty()) { return; }
+				next = std::move(queue.front());
+				queue.pop_front();
+				running.push_back(next);
+			}
+
+			match(*next, arena);
+
+			std::lock_guard<std::mutex> lock(queueMutex);
+			running.erase(std::find(running.begin(), running.end(), next));
+		}
+	}
+
+	void SgmAsyncMatcher::match(detail::SgmMatchState& match, memory::FrameArena& arena)
+	{
+		{
+			std::lock_guard<std::mutex> lock(match.mutex);
+			if (match.status != SgmMatchStatus::Queued) { return; } // Cancelled while queued
+			match.status = SgmMatchStatus::Running;
+		}
+
+		SgmMatchStatus status = SgmMatchStatus::Done;
+		std::exception_ptr error;
+		try
+		{
+			std::unique_ptr<ISgmCostAggregator> sgm{ createSgm(match.pair.parameters,
+				*match.pair.mapLeft, *match.pair.mapRight, match.pair.imageLeft, match.pair.imageRight, &pool, &arena) };
+			{
+				std::lock_guard<std::mutex> lock(match.mutex);
+				match.sgm = sgm.get();
+				if (match.cancelled) { sgm->terminate(); }
+			}
+
+			// Detaches algorithm from handle before it is destroyed, also on exception
+			struct Detach
+			{
+				detail::SgmMatchState& match;
+				ISgmCostAggregator& sgm;
+				~Detach()
+				{
+					std::lock_guard<std::mutex> lock(match.mutex);
+					match.sgm = nullptr;
+					match.progress = sgm.getProgress();
+					match.lastState = sgm.getState();
+				}
+			} detach{ match, *sgm };
+
+			sgm->computeMatchingCosts();
+		}
+		catch (...)
+		{
+			status = SgmMatchStatus::Failed;
+			error = std::current_exception();
+		}
+		arena.reset();
+
+		if (status == SgmMatchStatus::Done)
+		{
+			std::lock_guard<std::mutex> lock(match.mutex);
+			status = match.cancelled ? SgmMatchStatus::Cancelled : SgmMatchStatus::Done;
+		}
+		finishMatch(match, status, error);
+	}
+}
@@ -0,0 +1,109 @@
+#include "SgmBatchMatcher.hpp"
+#include <CamCommon/FrameArena.hpp>
+#include <memory>
+#include <thread>
+
+namespace cam3d
+{
+	SgmBatchMatcher::SgmBatchMatcher(std::size_t threadsCount, std::size_t maxPairsInFlight_) :
+		pool{ threadsCount },
+		maxPairsInFlight{ maxPairsInFlight_ > 0 ? maxPairsInFlight_ : 1 },
+		pairsInFlight(maxPairsInFlight, nullptr),
+		shouldTerminate{ false },
+		doneCount{ 0 }
+	{ }
+
+	void SgmBatchMatcher::run(PairSource source, PairSink sink)
+	{
+		shouldTerminate = false;
+		doneCount = 0;
+		firstError = nullptr;
+
+		// Slot threads drive task queues of their pairs and execute pool jobs while waiting
+		std::vector<std::thread> slots;
+		for (std::size_t slot = 0; slot < maxPairsInFlight; ++slot)
+		{
+			slots.emplace_back([this, slot, &source, &sink]() { runSlot(slot, source, sink); });
+		}
+		for (std::thread& slot : slots)
+		{
+			slot.join();
+		}
+
+		if (firstError != nullptr)
+		{
+			std::rethrow_exception(firstError);
+		}
+	}
+
+	void SgmBatchMatcher::terminate()
+	{
+		shouldTerminate = true;
+		std::lock_guard<std::mutex> lock(stateMutex);
+		for (ISgmCostAggregator* sgm : pairsInFlight)
+		{
+			if (sgm != nullptr) { sgm->terminate(); }
+		}
+	}
+
+	std::string SgmBatchMatcher::getState()
+	{
+		std::lock_guard<std::mutex> lock(stateMutex);
+		std::string state = "Done: " + std::to_string(doneCount.load());
+		for (std::size_t slot = 0; slot < pairsInFlight.size(); ++slot)
+		{
+			if (pairsInFlight[slot] != nullptr)
+			{
+				state += "; Slot " + std::to_string(slot) + ": " + pairsInFlight[slot]->getState();
+			}
+		}
+		return state;
+	}
+
+	void SgmBatchMatcher::runSlot(std::size_t slot, PairSource& source, PairSink& sink)
+	{
+		try
+		{
+			// Temporaries of pairs matched in this slot, reused from pair to pair
+			memory::FrameArena arena;
+			StereoPair pair;
+			while (takeNextPair(source, pair))
+			{
+				std::unique_ptr<ISgmCostAggregator> sgm{ createSgm(pair.parameters,
+					*pair.mapLeft, *pair.mapRight, pair.imageLeft, pair.imageRight, &pool, &arena) };
+
+				setPairInFlight(slot, sgm.get());
+				if (shouldTerminate) { sgm->terminate(); }
+				sgm->computeMatchingCosts();
+				setPairInFlight(slot, nullptr);
+				sgm.reset();
+				arena.reset();
+
+				if (shouldTerminate) { return; }
+				sink(pair);
+				++doneCount;
+			}
+		}
+		catch (...)
+		{
+			setPairInFlight(slot, nullptr);
+			{
+				std::lock_guard<std::mutex> lock(sourceMutex);
+				if (firstError == nullptr) { firstError = std::current_exception(); }
+			}
+			terminate();
+		}
+	}
+
+	bool SgmBatchMatcher::takeNextPair(PairSource& source, StereoPair& pair)
+	{
+		std::lock_guard<std::mutex> lock(sourceMutex);
+		return !shouldTerminate && source(pair);
+	}
+
+	void SgmBatchMatcher::setPairInFlight(std::size_t slot, ISgmCostAggregator* sgm)
+	{
+		std::lock_guard<std::mutex> lock(stateMutex);
+		pairsInFlight[slot] = sgm;
+	}
+}
@@ -1,26 +1,27 @@
 #include "SgmCommon.hpp"
 #include "ParallelSgmAlgorithm.hpp"
 #include "CensusCostComputer.hpp"
-#include <CamCommon\GreyScaleImage.hpp>
-#include <CamCommon\MaskedImage.hpp>
-#include <CamCommon\ColorImage.hpp>
+#include "HmiCostComputer.hpp"
+#include <CamCommon/GreyScaleImage.hpp>
+#include <CamCommon/MaskedImage.hpp>
+#include <CamCommon/ColorImage.hpp>
 
 namespace cam3d
 {
 	template<int maskRadius, int maxRadiusPlusOne, typename ImageT>
 	struct SgmCreator
 	{
-		static cam3d::ISgmCostAggregator* create(SgmParameters& parameters, DisparityMap& mapLeft, DisparityMap& mapRight, ImageT& imageLeft, ImageT& imageRight)
+		static cam3d::ISgmCostAggregator* create(SgmParameters& parameters, DisparityMap& mapLeft, DisparityMap& mapRight, ImageT& imageLeft, ImageT& imageRight, ThreadPool* pool, memory::FrameArena* arena)
 		{
 			if (maskRadius == parameters.censusMaskRadius)
 			{
 				return new ParallelSgmAlgorithm<cam3d::SgmCostAggregator<ImageT, cam3d::CensusCostComputer32<ImageT, maskRadius>>>{
-					parameters, mapLeft, mapRight, imageLeft, imageRight
+					parameters, mapLeft, mapRight, imageLeft, imageRight, pool, arena
 				};
 			}
 			else
 			{
-				return SgmCreator<maskRadius + 1, maxRadiusPlusOne, ImageT>::create(parameters, mapLeft, mapRight, imageLeft, imageRight);
+				return SgmCreator<maskRadius + 1, maxRadiusPlusOne, ImageT>::create(parameters, mapLeft, mapRight, imageLeft, imageRight, pool, arena);
 			}
 		}
 	};
@@ -28,24 +29,36 @@ namespace cam3d
 	template<int rmax, typename ImageT>
 	struct SgmCreator<rmax, rmax, ImageT>
 	{
-		static cam3d::ISgmCostAggregator* create(SgmParameters& parameters, DisparityMap& mapLeft, DisparityMap& mapRight, ImageT& imageLeft, ImageT& imageRight)
+		static cam3d::ISgmCostAggregator* create(SgmParameters&, DisparityMap&, DisparityMap&, ImageT&, ImageT&, ThreadPool*, memory::FrameArena*)
 		{
 			throw std::invalid_argument(std::string("Census mask radius must be in range [1, ") + std::to_string(rmax - 1) + "].");
 		}
 	};
 
-	ISgmCostAggregator* createSgm(SgmParameters& parameters, DisparityMap& mapLeft, DisparityMap& mapRight, void* imageLeft, void* imageRight)
+	template<typename ImageT>
+	cam3d::ISgmCostAggregator* createSgmForImage(SgmParameters& parameters, DisparityMap& mapLeft, DisparityMap& mapRight, ImageT& imageLeft, ImageT& imageRight, ThreadPool* pool, memory::FrameArena* arena)
+	{
+		if (parameters.matchingCostType == MatchingCostType::HierarchicalMutualInformation)
+		{
+			return new ParallelSgmAlgorithm<cam3d::SgmCostAggregator<ImageT, cam3d::HmiCostComputer<ImageT>>>{
+				parameters, mapLeft, mapRight, imageLeft, imageRight, pool, arena
+			};
+		}
+		return SgmCreator<1, 8, ImageT>::create(parameters, mapLeft, mapRight, imageLeft, imageRight, pool, arena);
+	}
+
+	ISgmCostAggregator* createSgm(SgmParameters& parameters, DisparityMap& mapLeft, DisparityMap& mapRight, void* imageLeft, void* imageRight, ThreadPool* pool, memory::FrameArena* arena)
 	{
 		parameters.censusMaskRadius = parameters.censusMaskRadius > 7 ? 7 : parameters.censusMaskRadius;
 		cam3d::ISgmCostAggregator* sgm = nullptr;
 		if (parameters.imageType == ImageType::Grey)
 		{
-			sgm = SgmCreator<1, 8, cam3d::GreyScaleImage>::create(parameters, mapLeft, mapRight, *reinterpret_cast<GreyScaleImage*>(imageLeft), *reinterpret_cast<GreyScaleImage*>(imageRight));
+			sgm = createSgmForImage<cam3d::GreyScaleImage>(parameters, mapLeft, mapRight, *reinterpret_cast<GreyScaleImage*>(imageLeft), *reinterpret_cast<GreyScaleImage*>(imageRight), pool, arena);
 		}
 		else if (parameters.imageType == ImageType::MaskedGrey)
 		{
 			using MaskedImage = cam3d::MaskedImage<cam3d::GreyScaleImage>;
-			sgm = SgmCreator<1, 8, MaskedImage>::create(parameters, mapLeft, mapRight, *reinterpret_cast<MaskedImage*>(imageLeft), *reinterpret_cast<MaskedImage*>(imageRight));
+			sgm = createSgmForImage<MaskedImage>(parameters, mapLeft, mapRight, *reinterpret_cast<MaskedImage*>(imageLeft), *reinterpret_cast<MaskedImage*>(imageRight), pool, arena);
 		}
 		else
 		{
@@ -0,0 +1,303 @@
+#include "SgmMemory.hpp"
+#include "SgmPath.hpp"
+#include "HmiCostComputer.hpp"
+#include <CamCommon/FrameArena.hpp>
+#include <CamCommon/GreyScaleImage.hpp>
+#include <CamCommon/MaskedImage.hpp>
+#include <CamCommon/Profiler.hpp>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+namespace cam3d
+{
+	namespace
+	{
+		std::size_t censusWordBytes(int radius)
+		{
+			radius = std::max(1, std::min(7, radius));
+			int maskLength = (2 * radius + 1) * (2 * radius + 1);
+			return sizeof(uint32_t) * static_cast<std::size_t>(maskLength / 32 + 1);
+		}
+
+		// Memory of one view without caller buffers
+		SgmMemoryEstimate estimateView(int rows, int cols, int maxDisparity, const SgmParameters& params, bool withHmiBootstrap)
+		{
+			std::size_t pixels = static_cast<std::size_t>(rows) * cols;
+			SgmMemoryEstimate e{};
+			e.pathPointers = pixels * pathsCount * sizeof(SgmPath*);
+			e.bestPathCosts = pixels * pathsCount * sizeof(PathCost);
+
+			// PosX, NegX start on left/right column, PosY, NegY on top/bottom row, diagonals on two edges each
+			std::size_t pathsOnBorder = 2 * static_cast<std::size_t>(rows) + 2 * cols + 4 * static_cast<std::size_t>(rows + cols - 1);
+			std::size_t costsPerPath = static_cast<std::size_t>(std::min(cols, maxDisparity) + 2);
+			// Paths and their costs are packed in FrameArena, costs aligned to memory::alignment
+			std::size_t costsBytes = (costsPerPath * sizeof(double) + memory::alignment - 1) / memory::alignment * memory::alignment;
+			e.borderPaths = pathsOnBorder * (sizeof(SgmPath_PosX) + costsBytes);
+
+			if(params.matchingCostType == MatchingCostType::Census)
+			{
+				e.matchingCosts = 2 * pixels * censusWordBytes(params.censusMaskRadius);
+			}
+			else
+			{
+				using Hmi = HmiCostComputer<GreyScaleImage>;
+				std::size_t tableBytes = Hmi::maxBinsCount * Hmi::maxBinsCount * sizeof(double);
+				std::size_t tasks = static_cast<std::size_t>(std::max(1, std::min(params.maxParallelTasks, rows)));
+				e.matchingCosts = 2 * pixels * sizeof(uint8_t) + tableBytes +
+					tasks * Hmi::maxBinsCount * Hmi::maxBinsCount * sizeof(uint32_t) + 4 * tableBytes; // Partial histograms and entropy temporaries
+
+				int halfRows = rows / 2, halfCols = cols / 2;
+				if(withHmiBootstrap && params.hmiLevels > 0 && halfRows >= Hmi::minLevelSize && halfCols >= Hmi::minLevelSize)
+				{
+					// Pyramid of both images is kept while levels are matched one by one,
+					// largest is half resolution level with prior and result maps
+					std::size_t pyramid = 0;
+					for(int level = 1, r = halfRows, c = halfCols; level <= params.hmiLevels &&
+						r >= Hmi::minLevelSize && c >= Hmi::minLevelSize; ++level, r /= 2, c /= 2)
+					{
+						pyramid += 2 * static_cast<std::size_t>(r) * c * sizeof(double);
+					}
+					SgmMemoryEstimate level = estimateView(halfRows, halfCols, std::max(1, maxDisparity / 2), params, false);
+					std::size_t halfPixels = static_cast<std::size_t>(halfRows) * halfCols;
+					e.matchingCosts += pyramid + level.total + 2 * halfPixels * sizeof(Disparity);
+				}
+				else
+				{
+					e.matchingCosts += pixels * sizeof(Disparity); // Random disparity map
+				}
+			}
+
+			e.total = e.pathPointers + e.bestPathCosts + e.borderPaths + e.matchingCosts;
+			return e;
+		}
+
+		std::size_t imagesBytes(int rows, int cols, ImageType imageType)
+		{
+			std::size_t pixels = static_cast<std::size_t>(rows) * cols;
+			return 2 * (pixels * sizeof(double) + (imageType == ImageType::MaskedGrey ? pixels * sizeof(char) : 0));
+		}
+
+		std::size_t callerBuffersBytes(int rows, int cols, ImageType imageType)
+		{
+			return imagesBytes(rows, cols, imageType) + 2 * static_cast<std::size_t>(rows) * cols * sizeof(Disparity);
+		}
+
+		std::size_t estimateBandPeak(const SgmParameters& params, int bandRows, int overlapRows)
+		{
+			SgmParameters bandParams = params;
+			bandParams.rows = std::min(params.rows, bandRows + 2 * overlapRows);
+			// Band maps exist next to caller buffers of whole image, band images are views of them
+			return estimateSgmMemory(bandParams).total - imagesBytes(bandParams.rows, bandParams.cols, bandParams.imageType) +
+				callerBuffersBytes(params.rows, params.cols, params.imageType);
+		}
+
+		// Band of rows of source image, borrowed without copying
+		template<typename ImageT>
+		struct ImageBand;
+
+		template<>
+		struct ImageBand<GreyScaleImage>
+		{
+			GreyScaleImage image;
+
+			ImageBand(GreyScaleImage& source, int startRow, int rows) :
+				image{ source.getMatrix().roi(startRow, 0, rows, source.getColumnCount()) }
+			{ }
+
+			void* get() { return &image; }
+		};
+
+		template<>
+		struct ImageBand<MaskedImage<GreyScaleImage>>
+		{
+			GreyScaleImage image;
+			MaskedImage<GreyScaleImage> masked;
+
+			ImageBand(MaskedImage<GreyScaleImage>& source, int startRow, int rows) :
+				image{ source.getMatrix().roi(startRow, 0, rows, source.getColumnCount()) },
+				masked{ image, source.getMask().roi(startRow, 0, rows, source.getColumnCount()) }
+			{ }
+
+			void* get() { return &masked; }
+		};
+
+		// Matches image in bands of rows, each band with its own createSgm() algorithm,
+		// so that only memory of one band is allocated at once. Bands share one arena,
+		// reset after each band
+		template<typename ImageT>
+		class SgmRowBandsAlgorithm : public ISgmCostAggregator
+		{
+			SgmParameters params;
+			DisparityMap& mapLeft;
+			DisparityMap& mapRight;
+			ImageT& imageLeft;
+			ImageT& imageRight;
+			SgmExecutionPlan plan;
+			ThreadPool* pool;
+			memory::FrameArena arena;
+
+			std::mutex currentMutex;
+			std::unique_ptr<ISgmCostAggregator> current;
+			int currentBand;
+			int bandsCount;
+			std::atomic_bool shouldTerminate;
+
+		public:
+			SgmRowBandsAlgorithm(SgmParameters& params, DisparityMap& mapLeft, DisparityMap& mapRight,
+				ImageT& imageLeft, ImageT& imageRight, SgmExecutionPlan plan, ThreadPool* pool) :
+				params{ params }, mapLeft{ mapLeft }, mapRight{ mapRight },
+				imageLeft{ imageLeft }, imageRight{ imageRight }, plan{ plan }, pool{ pool },
+				currentBand{ 0 },
+				bandsCount{ (params.rows + plan.bandRows - 1) / plan.bandRows }
+			{
+				shouldTerminate = false;
+			}
+
+			void computeMatchingCosts() override
+			{
+				for (int band = 0; band < bandsCount && !shouldTerminate; ++band)
+				{
+					CAM3D_TRACE_SCOPE_ARG("SgmRowBands.Band", "band", band);
+					int outputStart = band * plan.bandRows;
+					int outputEnd = std::min(params.rows, outputStart + plan.bandRows);
+					int start = std::max(0, outputStart - plan.overlapRows);
+					int end = std::min(params.rows, outputEnd + plan.overlapRows);
+
+					SgmParameters bandParams = params;
+					bandParams.rows = end - start;
+					ImageBand<ImageT> bandLeft{ imageLeft, start, bandParams.rows };
+					ImageBand<ImageT> bandRight{ imageRight, start, bandParams.rows };
+					DisparityMap bandMapLeft{ bandParams.rows, params.cols };
+					DisparityMap bandMapRight{ bandParams.rows, params.cols };
+
+					ISgmCostAggregator* sgm = createSgm(bandParams, bandMapLeft, bandMapRight, bandLeft.get(), bandRight.get(), pool, &arena);
+					{
+						std::lock_guard<std::mutex> lock(currentMutex);
+						current.reset(sgm);
+						currentBand = band;
+					}
+					if (!shouldTerminate)
+					{
+						sgm->computeMatchingCosts();
+					}
+					{
+						std::lock_guard<std::mutex> lock(currentMutex);
+						current.reset();
+					}
+					arena.reset();
+
+					for (int y = outputStart; y < outputEnd; ++y)
+					{
+						for (int x = 0; x < params.cols; ++x)
+						{
+							mapLeft(y, x) = bandMapLeft(y - start, x);
+							mapRight(y, x) = bandMapRight(y - start, x);
+						}
+					}
+				}
+			}
+
+			void terminate() override
+			{
+				shouldTerminate = true;
+				std::lock_guard<std::mutex> lock(currentMutex);
+				if (current != nullptr)
+				{
+					current->terminate();
+				}
+			}
+
+			double getProgress() override
+			{
+				std::lock_guard<std::mutex> lock(currentMutex);
+				double bandProgress = current != nullptr ? current->getProgress() : 0.0;
+				return (currentBand + bandProgress) / bandsCount;
+			}
+
+			std::string getState() override
+			{
+				std::lock_guard<std::mutex> lock(currentMutex);
+				std::string band = "Band " + std::to_string(currentBand + 1) + "/" + std::to_string(bandsCount);
+				return current != nullptr ? band + ": " + current->getState() : band;
+			}
+		};
+	}
+
+	SgmMemoryEstimate estimateSgmMemory(const SgmParameters& parameters)
+	{
+		// Left and right views are matched concurrently and are alive together.
+		// Only left view bootstraps HMI, right one transposes its table
+		SgmMemoryEstimate view = estimateView(parameters.rows, parameters.cols, parameters.maxDisparity, parameters, true);
+		SgmMemoryEstimate rightView = estimateView(parameters.rows, parameters.cols, parameters.maxDisparity, parameters, false);
+		SgmMemoryEstimate e{};
+		e.pathPointers = 2 * view.pathPointers;
+		e.bestPathCosts = 2 * view.bestPathCosts;
+		e.borderPaths = 2 * view.borderPaths;
+		e.matchingCosts = view.matchingCosts + rightView.matchingCosts;
+		e.callerBuffers = callerBuffersBytes(parameters.rows, parameters.cols, parameters.imageType);
+		e.total = view.total + rightView.total + e.callerBuffers;
+		return e;
+	}
+
+	SgmExecutionPlan planSgmExecution(const SgmParameters& parameters, std::size_t budgetBytes)
+	{
+		std::size_t wholeImage = estimateSgmMemory(parameters).total;
+		int minBandRows = std::min(parameters.rows, sgmMinBandRows);
+		if (wholeImage <= budgetBytes || parameters.rows <= minBandRows + 2 * sgmBandOverlapRows)
+		{
+			return SgmExecutionPlan{ SgmExecutionStrategy::WholeImage, parameters.rows, 0, wholeImage, wholeImage <= budgetBytes };
+		}
+
+		// Peak grows with band height: find highest band which fits
+		int low = minBandRows, high = parameters.rows;
+		if (estimateBandPeak(parameters, low, sgmBandOverlapRows) > budgetBytes)
+		{
+			return SgmExecutionPlan{ SgmExecutionStrategy::RowBands, low, sgmBandOverlapRows,
+				estimateBandPeak(parameters, low, sgmBandOverlapRows), false };
+		}
+		while (low < high)
+		{
+			int middle = (low + high + 1) / 2;
+			if (estimateBandPeak(parameters, middle, sgmBandOverlapRows) <= budgetBytes)
+			{
+				low = middle;
+			}
+			else
+			{
+				high = middle - 1;
+			}
+		}
+		return SgmExecutionPlan{ SgmExecutionStrategy::RowBands, low, sgmBandOverlapRows,
+			estimateBandPeak(parameters, low, sgmBandOverlapRows), true };
+	}
+
+	ISgmCostAggregator* createSgmWithinBudget(SgmParameters& parameters, DisparityMap& mapLeft, DisparityMap& mapRight,
+		void* imageLeft, void* imageRight, std::size_t budgetBytes, ThreadPool* pool)
+	{
+		SgmExecutionPlan plan = planSgmExecution(parameters, budgetBytes);
+		if (!plan.fitsBudget)
+		{
+			throw std::runtime_error("SGM needs at least " + std::to_string(plan.peakBytes / (1024 * 1024)) +
+				" MB, budget is " + std::to_string(budgetBytes / (1024 * 1024)) + " MB");
+		}
+		if (plan.strategy == SgmExecutionStrategy::WholeImage)
+		{
+			return createSgm(parameters, mapLeft, mapRight, imageLeft, imageRight, pool);
+		}
+
+		if (parameters.imageType == ImageType::Grey)
+		{
+			return new SgmRowBandsAlgorithm<GreyScaleImage>{ parameters, mapLeft, mapRight,
+				*reinterpret_cast<GreyScaleImage*>(imageLeft), *reinterpret_cast<GreyScaleImage*>(imageRight), plan, pool };
+		}
+		else if (parameters.imageType == ImageType::MaskedGrey)
+		{
+			using MaskedImage = cam3d::MaskedImage<cam3d::GreyScaleImage>;
+			return new SgmRowBandsAlgorithm<MaskedImage>{ parameters, mapLeft, mapRight,
+				*reinterpret_cast<MaskedImage*>(imageLeft), *reinterpret_cast<MaskedImage*>(imageRight), plan, pool };
+		}
+		throw std::invalid_argument("Only GrayScaleImage or masked GreyScaleImage supported");
+	}
+}
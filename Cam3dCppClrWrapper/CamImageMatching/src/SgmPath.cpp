@@ -123,6 +123,8 @@ namespace cam3d
 					return std::conditional<getAbs(moveX) == 2, X2, Y2>::type::getPixel(pixel, rows, cols);
 				}
 
+				// Border pixels of two-step moves (X2 returns origin, Y2 assumes path is bounded by y) are not
+				// used: SgmPathsManager creates only paths of one-step moves
 				struct X2
 				{
 					static Point2 getPixel(Point2 pixel, int rows, int cols)
@@ -136,13 +138,8 @@ namespace cam3d
 					static Point2 getPixel(Point2 pixel, int rows, int cols)
 					{
 						// Move xy,x,xy,x
-						// check if is bounded by x (compare lengths of opposite move)
-						if (length_helper::getLength2(10000, rows, cols, pixel) >=
-							length_helper::getLength2(10000, rows, cols, pixel))
-						{
-							int d = getMoveLimit1<moveY / 2, moveX / 2>(pixel, rows, cols);
-							return Point2{ pixel.y + d * (-moveY) / 4, pixel.x + d * (-moveX) };
-						}
+						int d = getMoveLimit1<moveY / 2, moveX / 2>(pixel, rows, cols);
+						return Point2{ pixel.y + d * (-moveY) / 4, pixel.x + d * (-moveX) };
 					}
 				};
 			};
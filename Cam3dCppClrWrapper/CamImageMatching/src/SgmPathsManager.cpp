@@ -1,5 +1,3 @@
-#pragma once
-
 #include "SgmPathsManager.hpp"
 namespace cam3d
 {
@@ -34,23 +32,21 @@ std::array<int, SgmPathsManager::pathsPerRun> pathsInRun_LeftBottomUp = {
 };
 }
 
-SgmPathsManager::SgmPathsManager(int rows_, int cols_, std::function<double(Point2, Point2)> getCost_,
-                std::function<int(Point2)> getDispRange_, bool isLeftImageBase_) :
+SgmPathsManager::SgmPathsManager(int rows_, int cols_, int maxDisparity_, std::function<double(Point2, Point2)> getCost_,
+                std::function<int(Point2)> getDispRange_, bool isLeftImageBase_, memory::FrameArena& arena_) :
     rows{ rows_ },
     cols{ cols_ },
+    maxDisparity{ maxDisparity_ },
     isLeftImageBase(isLeftImageBase_),
-    paths{rows_, cols_, pathsCount},
-    bestPathsCosts{rows_, cols_, pathsCount},
+    arena{ arena_ },
+    paths{rows_, cols_, pathsCount, uninitialized, memory::ArenaAllocator<SgmPath*>{arena_}}, // Filled in init()
+    bestPathsCosts{rows_, cols_, pathsCount, memory::ArenaAllocator<PathCost>{arena_}},
+    borderPathsCreated{ false },
     getCost{ getCost_ },
     getDispRange{getDispRange_}
 {
 }
 
-SgmPathsManager::~SgmPathsManager()
-{
-    std::for_each(paths.begin(), paths.end(), [](SgmPath* p) { delete p; });
-}
-
 void SgmPathsManager::SgmPathsManager::init()
 {
     createBorderPaths();
@@ -67,60 +63,80 @@ std::array<int, SgmPathsManager::pathsPerRun> SgmPathsManager::getPathIdxsForRun
 
 void SgmPathsManager::createBorderPaths()
 {
-    paths.fill(0);
+    // Paths are created once and reused if algorithm is run again
+    if(!borderPathsCreated)
+    {
+        paths.fill(nullptr);
+        for(int x = 0; x < cols; ++x)
+        {
+            createPathsForBorderPixel({0, x});
+            createPathsForBorderPixel({rows - 1, x});
+        }
+        for(int y = 1; y < rows; ++y)
+        {
+            createPathsForBorderPixel({y, 0});
+            createPathsForBorderPixel({y, cols - 1});
+        }
+        borderPathsCreated = true;
+    }
+
     for(int x = 0; x < cols; ++x)
     {
-        createPathsForBorderPixel({0, x});
         initZeroStep({0, x});
-
-        createPathsForBorderPixel({rows - 1, x});
         initZeroStep({rows - 1, x});
     }
-
     for(int y = 1; y < rows; ++y)
     {
-        createPathsForBorderPixel({y, 0});
         initZeroStep({y, 0});
-
-        createPathsForBorderPixel({y, cols - 1});
         initZeroStep({y, cols - 1});
     }
 }
 
+template<typename PathT>
+SgmPath* SgmPathsManager::createPath()
+{
+    SgmPath* path = arena.create<PathT>();
+    // Disparity range on path never exceeds maxDisparity, plus 2 entries for costs out of range
+    path->lastStepCostsCount = std::min(cols, maxDisparity) + 2;
+    path->lastStepCosts = arena.allocateArray<double>(path->lastStepCostsCount);
+    return path;
+}
+
 void SgmPathsManager::createPathsForBorderPixel(Point2 pixel)
 {
     // Create only those paths which can start on pixel (y,x)
-    if(pixel.x == 0)
+    // (pixel is visited twice if image has one row - then paths already exist)
+    if(pixel.x == 0 && paths(pixel, PathDirection::PosX) == nullptr)
     {
-        paths(pixel, PathDirection::PosX) = new SgmPath_PosX{};
+        paths(pixel, PathDirection::PosX) = createPath<SgmPath_PosX>();
     }
-    if(pixel.x == cols - 1)
+    if(pixel.x == cols - 1 && paths(pixel, PathDirection::NegX) == nullptr)
     {
-        paths(pixel, PathDirection::NegX) = new SgmPath_NegX{};
+        paths(pixel, PathDirection::NegX) = createPath<SgmPath_NegX>();
     }
-    if(pixel.y == 0)
+    if(pixel.y == 0 && paths(pixel, PathDirection::PosY) == nullptr)
     {
-        paths(pixel, PathDirection::PosY) = new SgmPath_PosY{};
+        paths(pixel, PathDirection::PosY) = createPath<SgmPath_PosY>();
     }
-    if(pixel.y == rows - 1)
+    if(pixel.y == rows - 1 && paths(pixel, PathDirection::NegY) == nullptr)
     {
-        paths(pixel, PathDirection::NegY) = new SgmPath_NegY{};
+        paths(pixel, PathDirection::NegY) = createPath<SgmPath_NegY>();
     }
-    if(pixel.x == 0 || pixel.y == 0)
+    if((pixel.x == 0 || pixel.y == 0) && paths(pixel, PathDirection::PosX_PosY) == nullptr)
     {
-        paths(pixel, PathDirection::PosX_PosY) = new SgmPath_PosX_PosY{};
+        paths(pixel, PathDirection::PosX_PosY) = createPath<SgmPath_PosX_PosY>();
     }
-    if(pixel.x == cols - 1 || pixel.y == 0)
+    if((pixel.x == cols - 1 || pixel.y == 0) && paths(pixel, PathDirection::NegX_PosY) == nullptr)
     {
-        paths(pixel, PathDirection::NegX_PosY) = new SgmPath_NegX_PosY{};
+        paths(pixel, PathDirection::NegX_PosY) = createPath<SgmPath_NegX_PosY>();
     }
-    if(pixel.x == 0 || pixel.y == rows - 1)
+    if((pixel.x == 0 || pixel.y == rows - 1) && paths(pixel, PathDirection::PosX_NegY) == nullptr)
     {
-        paths(pixel, PathDirection::PosX_NegY) = new SgmPath_PosX_NegY{};
+        paths(pixel, PathDirection::PosX_NegY) = createPath<SgmPath_PosX_NegY>();
     }
-    if(pixel.x == cols - 1 || pixel.y == rows - 1)
+    if((pixel.x == cols - 1 || pixel.y == rows - 1) && paths(pixel, PathDirection::NegX_NegY) == nullptr)
     {
-        paths(pixel, PathDirection::NegX_NegY) = new SgmPath_NegX_NegY{};
+        paths(pixel, PathDirection::NegX_NegY) = createPath<SgmPath_NegX_NegY>();
     }
 }
 
@@ -135,7 +151,8 @@ void SgmPathsManager::initZeroStep(Point2 borderPixel)
             path->imageWidth = cols;
             path->startPixel = borderPixel;
             path->length = rows + cols;
-            path->lastStepCosts.resize(cols + 1); // Need cols + 1 for convinent bottom-up run
+            // Entries beyond disparity range of first pixels are read before they are computed
+            std::fill(path->lastStepCosts, path->lastStepCosts + path->lastStepCostsCount, 0.0);
             path->init();
 
             findInitialCostOnPath(path, i);
@@ -0,0 +1,163 @@
+#ifndef CAM3D_NATIVE_API_H
+#define CAM3D_NATIVE_API_H
+
+/*
+ * Flat C interface of native stereo matcher (createSgm() of CamImageMatching),
+ * usable from any FFI. Images and outputs are caller's buffers described by
+ * pointer, size and row stride in bytes - nothing is copied on the way in, and
+ * disparity records are written in place.
+ *
+ * All functions are thread-safe. One session matches one pair at a time;
+ * cam3d_session_cancel() and cam3d_session_get_progress() may be called from
+ * other threads while cam3d_match() runs.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#if defined(CAM3D_NATIVE_API_EXPORTS)
+#define CAM3D_API __declspec(dllexport)
+#else
+#define CAM3D_API __declspec(dllimport)
+#endif
+#else
+#define CAM3D_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Incremented on incompatible change of any function or structure */
+#define CAM3D_API_VERSION 1
+
+typedef enum cam3d_status
+{
+    CAM3D_OK = 0,
+    CAM3D_ERROR_INVALID_ARGUMENT = 1,
+    CAM3D_ERROR_OUT_OF_MEMORY = 2,
+    CAM3D_ERROR_CANCELLED = 3,
+    CAM3D_ERROR_BUSY = 4,     /* Session is already matching */
+    CAM3D_ERROR_INTERNAL = 5
+} cam3d_status;
+
+typedef enum cam3d_cost
+{
+    CAM3D_COST_CENSUS = 0,
+    CAM3D_COST_HMI = 1        /* Hierarchical mutual information */
+} cam3d_cost;
+
+typedef enum cam3d_mean_method
+{
+    CAM3D_MEAN_SIMPLE = 0,
+    CAM3D_MEAN_WEIGHTED_PATH_LENGTH = 1
+} cam3d_mean_method;
+
+typedef enum cam3d_cost_method
+{
+    CAM3D_COST_DISTANCE_TO_MEAN = 0,
+    CAM3D_COST_DISTANCE_SQUARED_TO_MEAN = 1
+} cam3d_cost_method;
+
+/* Disparity flags, as in cam3d_disparity::flags */
+#define CAM3D_DISPARITY_INVALID 0
+#define CAM3D_DISPARITY_VALID 1
+#define CAM3D_DISPARITY_OCCLUDED 2
+
+typedef struct cam3d_match_params
+{
+    int32_t max_disparity;
+    int32_t cost;                 /* cam3d_cost */
+    int32_t census_radius;        /* 1..7, larger is clamped to 7 */
+    int32_t hmi_levels;
+    double low_penalty;           /* P1 = low_penalty * max cost */
+    double high_penalty;          /* P2 = high_penalty * max cost */
+    double intensity_threshold;
+    int32_t mean_method;          /* cam3d_mean_method */
+    int32_t cost_method;          /* cam3d_cost_method */
+    double path_length_threshold;
+    double cost_method_power;
+    int32_t max_parallel_tasks;   /* Tasks of one match running at once; 0 (default) means one per
+                                     worker thread of session */
+    int32_t reserved;
+} cam3d_match_params;
+
+/* Grey image of doubles; 'mask' (non-zero where pixel is valid) is optional */
+typedef struct cam3d_image
+{
+    const double* data;
+    int32_t rows;
+    int32_t cols;
+    int64_t stride;               /* Bytes between rows, multiple of sizeof(double) */
+    const uint8_t* mask;
+    int64_t mask_stride;
+} cam3d_image;
+
+/* Same layout as cam3d::Disparity */
+typedef struct cam3d_disparity
+{
+    int32_t dx;                   /* Integer disparity, signed */
+    int32_t flags;                /* CAM3D_DISPARITY_* */
+    double sub_dx;
+    double cost;
+    double confidence;
+} cam3d_disparity;
+
+/*
+ * Outputs for both views; every member may be null. Records are written in place
+ * by matcher; planes are filled from records of left view after matching.
+ * Strides are in bytes and must be multiples of element size.
+ */
+typedef struct cam3d_output
+{
+    cam3d_disparity* left;
+    int64_t left_stride;
+    cam3d_disparity* right;
+    int64_t right_stride;
+    float* disparity;             /* Sub-pixel disparity of left view, NaN where not valid */
+    int64_t disparity_stride;
+    float* confidence;            /* Confidence of left view, 0 where not valid */
+    int64_t confidence_stride;
+} cam3d_output;
+
+typedef struct cam3d_session cam3d_session;
+
+CAM3D_API int32_t cam3d_get_api_version(void);
+
+/* Parameters used by matcher benchmarks - a reasonable start */
+CAM3D_API void cam3d_default_match_params(cam3d_match_params* params);
+
+/* 'threads' worker threads; 0 means one per hardware thread */
+CAM3D_API cam3d_status cam3d_session_create(int32_t threads, cam3d_session** session);
+CAM3D_API void cam3d_session_destroy(cam3d_session* session);
+
+/*
+ * Matches 'left' and 'right' (same size, masked both or none) and blocks until done.
+ * Returns CAM3D_ERROR_CANCELLED if cam3d_session_cancel() was called meanwhile -
+ * outputs are then incomplete.
+ */
+CAM3D_API cam3d_status cam3d_match(cam3d_session* session, const cam3d_match_params* params,
+    const cam3d_image* left, const cam3d_image* right, const cam3d_output* output);
+
+/* Stops running match; no effect if session is idle */
+CAM3D_API void cam3d_session_cancel(cam3d_session* session);
+
+/*
+ * Progress of running or last match: 'fraction' in [0, 1] and, if 'state' is not null,
+ * description truncated to 'state_size' bytes including terminating zero
+ */
+CAM3D_API cam3d_status cam3d_session_get_progress(cam3d_session* session, double* fraction,
+    char* state, size_t state_size);
+
+/*
+ * Copies message of last error in this session (empty if last match succeeded),
+ * truncated to 'message_size' bytes including terminating zero
+ */
+CAM3D_API cam3d_status cam3d_session_get_last_error(cam3d_session* session, char* message, size_t message_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
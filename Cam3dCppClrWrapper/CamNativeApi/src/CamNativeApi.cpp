@@ -0,0 +1,392 @@
+#include "CamNativeApi.h"
+#include <CamImageMatching/SgmCommon.hpp>
+#include <CamCommon/GreyScaleImage.hpp>
+#include <CamCommon/MaskedImage.hpp>
+#include <CamCommon/ThreadPool.hpp>
+#include <CamCommon/FrameArena.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+// Records are written by matcher directly into caller's buffers
+static_assert(sizeof(cam3d_disparity) == sizeof(cam3d::Disparity), "cam3d_disparity must match cam3d::Disparity");
+static_assert(offsetof(cam3d_disparity, dx) == offsetof(cam3d::Disparity, dx), "cam3d_disparity must match cam3d::Disparity");
+static_assert(offsetof(cam3d_disparity, flags) == offsetof(cam3d::Disparity, flags), "cam3d_disparity must match cam3d::Disparity");
+static_assert(offsetof(cam3d_disparity, sub_dx) == offsetof(cam3d::Disparity, subDx), "cam3d_disparity must match cam3d::Disparity");
+static_assert(offsetof(cam3d_disparity, cost) == offsetof(cam3d::Disparity, cost), "cam3d_disparity must match cam3d::Disparity");
+static_assert(offsetof(cam3d_disparity, confidence) == offsetof(cam3d::Disparity, confidence), "cam3d_disparity must match cam3d::Disparity");
+static_assert(sizeof(cam3d::Disparity::DisparityFlags) == sizeof(int32_t), "cam3d_disparity must match cam3d::Disparity");
+
+struct cam3d_session
+{
+	cam3d::ThreadPool pool;
+	// Temporaries of one match, reset after it so that next matches do not allocate
+	cam3d::memory::FrameArena arena;
+	// Used for views which caller does not want back
+	cam3d::DisparityMap scratchLeft;
+	cam3d::DisparityMap scratchRight;
+
+	std::atomic_bool matching;
+	std::mutex stateMutex;
+	cam3d::ISgmCostAggregator* current; // Guarded by stateMutex
+	bool cancelled;                     // Guarded by stateMutex
+	double lastProgress;                // Guarded by stateMutex
+	std::string lastState;              // Guarded by stateMutex
+	std::string lastError;              // Guarded by stateMutex
+
+	explicit cam3d_session(std::size_t threads) :
+		pool{ threads },
+		scratchLeft{ 0, 0 },
+		scratchRight{ 0, 0 },
+		matching{ false },
+		current{ nullptr },
+		cancelled{ false },
+		lastProgress{ 0.0 },
+		lastState{ "Idle" }
+	{ }
+};
+
+namespace
+{
+	void check(bool condition, const char* message)
+	{
+		if (!condition) { throw std::invalid_argument(message); }
+	}
+
+	// Stride in bytes to stride in elements
+	template<typename T>
+	int toPitch(int64_t stride, int cols, const char* message)
+	{
+		check(stride >= static_cast<int64_t>(cols) * static_cast<int64_t>(sizeof(T)), message);
+		check(stride % static_cast<int64_t>(sizeof(T)) == 0, message);
+		check(stride / static_cast<int64_t>(sizeof(T)) <= std::numeric_limits<int>::max(), message);
+		return static_cast<int>(stride / static_cast<int64_t>(sizeof(T)));
+	}
+
+	template<typename T>
+	T* rowOf(T* data, int64_t stride, int row)
+	{
+		return reinterpret_cast<T*>(reinterpret_cast<char*>(data) + stride * row);
+	}
+
+	// Maps exception being handled to status and stores its message in session
+	cam3d_status handleException(cam3d_session* session)
+	{
+		cam3d_status status = CAM3D_ERROR_INTERNAL;
+		std::string message = "Unknown error";
+		try
+		{
+			throw;
+		}
+		catch (const std::invalid_argument& e)
+		{
+			status = CAM3D_ERROR_INVALID_ARGUMENT;
+			message = e.what();
+		}
+		catch (const std::bad_alloc&)
+		{
+			status = CAM3D_ERROR_OUT_OF_MEMORY;
+			message = "Out of memory";
+		}
+		catch (const std::exception& e)
+		{
+			message = e.what();
+		}
+		catch (...)
+		{
+		}
+
+		if (session != nullptr)
+		{
+			std::lock_guard<std::mutex> lock(session->stateMutex);
+			try { session->lastError = message; }
+			catch (...) { }
+		}
+		return status;
+	}
+
+	// Truncated to 'size' bytes including terminating zero
+	void copyText(const std::string& text, char* destination, std::size_t size)
+	{
+		if (destination == nullptr || size == 0) { return; }
+		std::size_t length = std::min(text.size(), size - 1);
+		std::memcpy(destination, text.data(), length);
+		destination[length] = '\0';
+	}
+
+	// 'poolThreads' is used when caller leaves max_parallel_tasks at 0
+	cam3d::SgmParameters toSgmParameters(const cam3d_match_params& params, int rows, int cols, bool masked, std::size_t poolThreads)
+	{
+		check(params.max_disparity > 0, "max_disparity must be positive");
+		check(params.cost == CAM3D_COST_CENSUS || params.cost == CAM3D_COST_HMI, "Unknown cost");
+		check(params.mean_method == CAM3D_MEAN_SIMPLE || params.mean_method == CAM3D_MEAN_WEIGHTED_PATH_LENGTH, "Unknown mean_method");
+		check(params.cost_method == CAM3D_COST_DISTANCE_TO_MEAN || params.cost_method == CAM3D_COST_DISTANCE_SQUARED_TO_MEAN, "Unknown cost_method");
+		check(params.hmi_levels >= 0, "hmi_levels must not be negative");
+		check(params.max_parallel_tasks >= 0, "max_parallel_tasks must not be negative");
+
+		cam3d::SgmParameters sgm;
+		sgm.rows = rows;
+		sgm.cols = cols;
+		sgm.imageType = masked ? cam3d::ImageType::MaskedGrey : cam3d::ImageType::Grey;
+		sgm.isLeftImageBase = true;
+		sgm.maxParallelTasks = params.max_parallel_tasks > 0 ? params.max_parallel_tasks :
+			static_cast<int>(std::max<std::size_t>(poolThreads, 1));
+		sgm.maxDisparity = params.max_disparity;
+		sgm.lowPenaltyCoeff = params.low_penalty;
+		sgm.highPenaltyCoeff = params.high_penalty;
+		sgm.intensityThreshold = params.intensity_threshold;
+		sgm.censusMaskRadius = params.census_radius;
+		sgm.matchingCostType = params.cost == CAM3D_COST_HMI ?
+			cam3d::MatchingCostType::HierarchicalMutualInformation : cam3d::MatchingCostType::Census;
+		sgm.hmiLevels = params.hmi_levels;
+		sgm.disparityMeanMethod = params.mean_method == CAM3D_MEAN_WEIGHTED_PATH_LENGTH ?
+			cam3d::MeanMethod::WeightedAverageWithPathLength : cam3d::MeanMethod::SimpleAverage;
+		sgm.disparityCostMethod = params.cost_method == CAM3D_COST_DISTANCE_SQUARED_TO_MEAN ?
+			cam3d::CostMethod::DistanceSquredToMean : cam3d::CostMethod::DistanceToMean;
+		sgm.diparityPathLengthThreshold = params.path_length_threshold;
+		sgm.costMethodPower = params.cost_method_power;
+		return sgm;
+	}
+
+	// Input image borrowed from caller. Matcher only reads images, but their classes
+	// have no const views, hence const_cast
+	struct InputImage
+	{
+		cam3d::GreyScaleImage grey;
+		std::unique_ptr<cam3d::MaskedImage<cam3d::GreyScaleImage>> masked;
+
+		explicit InputImage(const cam3d_image& image) :
+			grey{ const_cast<double*>(image.data), image.rows, image.cols,
+				toPitch<double>(image.stride, image.cols, "Invalid image stride") }
+		{
+			if (image.mask != nullptr)
+			{
+				int maskPitch = toPitch<char>(image.mask_stride, image.cols, "Invalid mask stride");
+				char* mask = reinterpret_cast<char*>(const_cast<uint8_t*>(image.mask));
+				masked.reset(new cam3d::MaskedImage<cam3d::GreyScaleImage>{
+					grey, cam3d::Array2dView<char>{ mask, image.rows, image.cols, maskPitch } });
+			}
+		}
+
+		void* get() { return masked != nullptr ? static_cast<void*>(masked.get()) : static_cast<void*>(&grey); }
+	};
+
+	// Caller's records if given, otherwise session's scratch map
+	cam3d::DisparityMap outputMap(cam3d_disparity* records, int64_t stride, int rows, int cols, cam3d::DisparityMap& scratch)
+	{
+		if (records != nullptr)
+		{
+			int pitch = toPitch<cam3d_disparity>(stride, cols, "Invalid disparity stride");
+			return cam3d::DisparityMap{ cam3d::borrowed, reinterpret_cast<cam3d::Disparity*>(records), rows, cols, pitch };
+		}
+		if (scratch.getRowCount() != rows || scratch.getColumnCount() != cols)
+		{
+			scratch = cam3d::DisparityMap{ rows, cols, cam3d::uninitialized };
+		}
+		return cam3d::DisparityMap{ cam3d::borrowed, scratch.view() };
+	}
+
+	void writePlanes(const cam3d::DisparityMap& map, const cam3d_output& output)
+	{
+		const float nan = std::numeric_limits<float>::quiet_NaN();
+		for (int r = 0; r < map.getRowCount(); ++r)
+		{
+			const cam3d::Disparity* records = map.getRow(r);
+			float* disparity = output.disparity != nullptr ? rowOf(output.disparity, output.disparity_stride, r) : nullptr;
+			float* confidence = output.confidence != nullptr ? rowOf(output.confidence, output.confidence_stride, r) : nullptr;
+			for (int c = 0; c < map.getColumnCount(); ++c)
+			{
+				bool valid = records[c].flags == cam3d::Disparity::Valid;
+				if (disparity != nullptr) { disparity[c] = valid ? static_cast<float>(records[c].subDx) : nan; }
+				if (confidence != nullptr) { confidence[c] = valid ? static_cast<float>(records[c].confidence) : 0.0f; }
+			}
+		}
+	}
+
+	void match(cam3d_session& session, const cam3d_match_params& params,
+		const cam3d_image& left, const cam3d_image& right, const cam3d_output& output)
+	{
+		check(left.data != nullptr && right.data != nullptr, "Image data must not be null");
+		check(left.rows > 0 && left.cols > 0, "Image must not be empty");
+		check(left.rows == right.rows && left.cols == right.cols, "Images must have same size");
+		check((left.mask != nullptr) == (right.mask != nullptr), "Either both images or none must be masked");
+		int rows = left.rows;
+		int cols = left.cols;
+		if (output.disparity != nullptr) { toPitch<float>(output.disparity_stride, cols, "Invalid disparity plane stride"); }
+		if (output.confidence != nullptr) { toPitch<float>(output.confidence_stride, cols, "Invalid confidence plane stride"); }
+
+		cam3d::SgmParameters parameters = toSgmParameters(params, rows, cols, left.mask != nullptr, session.pool.getThreadsCount());
+		InputImage imageLeft{ left };
+		InputImage imageRight{ right };
+		cam3d::DisparityMap mapLeft = outputMap(output.left, output.left_stride, rows, cols, session.scratchLeft);
+		cam3d::DisparityMap mapRight = outputMap(output.right, output.right_stride, rows, cols, session.scratchRight);
+
+		std::unique_ptr<cam3d::ISgmCostAggregator> sgm{ cam3d::createSgm(parameters, mapLeft, mapRight,
+			imageLeft.get(), imageRight.get(), &session.pool, &session.arena) };
+		{
+			std::lock_guard<std::mutex> lock(session.stateMutex);
+			session.current = sgm.get();
+			if (session.cancelled) { sgm->terminate(); }
+		}
+
+		struct ClearCurrent
+		{
+			cam3d_session& session;
+			~ClearCurrent()
+			{
+				std::lock_guard<std::mutex> lock(session.stateMutex);
+				session.current = nullptr;
+			}
+		} clearCurrent{ session };
+
+		sgm->computeMatchingCosts();
+		writePlanes(mapLeft, output);
+	}
+}
+
+extern "C"
+{
+	int32_t cam3d_get_api_version(void)
+	{
+		return CAM3D_API_VERSION;
+	}
+
+	void cam3d_default_match_params(cam3d_match_params* params)
+	{
+		if (params == nullptr) { return; }
+		std::memset(params, 0, sizeof(*params));
+		params->max_disparity = 64;
+		params->cost = CAM3D_COST_CENSUS;
+		params->census_radius = 3;
+		params->hmi_levels = 3;
+		params->low_penalty = 0.02;
+		params->high_penalty = 0.04;
+		params->intensity_threshold = 0.1;
+		params->mean_method = CAM3D_MEAN_SIMPLE;
+		params->cost_method = CAM3D_COST_DISTANCE_TO_MEAN;
+		params->path_length_threshold = 3.0;
+		params->cost_method_power = 2.0;
+		params->max_parallel_tasks = 0;
+	}
+
+	cam3d_status cam3d_session_create(int32_t threads, cam3d_session** session)
+	{
+		if (session == nullptr || threads < 0) { return CAM3D_ERROR_INVALID_ARGUMENT; }
+		*session = nullptr;
+		try
+		{
+			*session = new cam3d_session{ static_cast<std::size_t>(threads) };
+			return CAM3D_OK;
+		}
+		catch (...)
+		{
+			return handleException(nullptr);
+		}
+	}
+
+	void cam3d_session_destroy(cam3d_session* session)
+	{
+		delete session;
+	}
+
+	cam3d_status cam3d_match(cam3d_session* session, const cam3d_match_params* params,
+		const cam3d_image* left, const cam3d_image* right, const cam3d_output* output)
+	{
+		if (session == nullptr) { return CAM3D_ERROR_INVALID_ARGUMENT; }
+		if (session->matching.exchange(true)) { return CAM3D_ERROR_BUSY; }
+
+		cam3d_status status = CAM3D_OK;
+		try
+		{
+			{
+				std::lock_guard<std::mutex> lock(session->stateMutex);
+				session->lastProgress = 0.0;
+				session->lastState = "Starting";
+				session->lastError.clear();
+			}
+			check(params != nullptr && left != nullptr && right != nullptr && output != nullptr,
+				"Parameters, images and output must not be null");
+			match(*session, *params, *left, *right, *output);
+		}
+		catch (...)
+		{
+			status = handleException(session);
+		}
+		session->arena.reset();
+
+		std::lock_guard<std::mutex> lock(session->stateMutex);
+		if (status == CAM3D_OK && session->cancelled)
+		{
+			status = CAM3D_ERROR_CANCELLED;
+			session->lastError = "Cancelled";
+		}
+		session->lastProgress = status == CAM3D_OK ? 1.0 : session->lastProgress;
+		session->lastState = status == CAM3D_OK ? "Done" : session->lastError;
+		// Cleared only here, so that cancel arriving before matcher is created is not lost
+		session->cancelled = false;
+		session->matching = false;
+		return status;
+	}
+
+	void cam3d_session_cancel(cam3d_session* session)
+	{
+		if (session == nullptr) { return; }
+		std::lock_guard<std::mutex> lock(session->stateMutex);
+		if (!session->matching) { return; }
+		session->cancelled = true;
+		if (session->current != nullptr) { session->current->terminate(); }
+	}
+
+	cam3d_status cam3d_session_get_progress(cam3d_session* session, double* fraction,
+		char* state, size_t state_size)
+	{
+		if (session == nullptr || fraction == nullptr) { return CAM3D_ERROR_INVALID_ARGUMENT; }
+		try
+		{
+			std::string text;
+			{
+				std::lock_guard<std::mutex> lock(session->stateMutex);
+				if (session->current != nullptr)
+				{
+					session->lastProgress = session->current->getProgress();
+					session->lastState = session->current->getState();
+				}
+				*fraction = session->lastProgress;
+				if (state != nullptr) { text = session->lastState; }
+			}
+			copyText(text, state, state_size);
+			return CAM3D_OK;
+		}
+		catch (...)
+		{
+			// Message is not stored - caller may be polling while other thread reads last error
+			return handleException(nullptr);
+		}
+	}
+
+	cam3d_status cam3d_session_get_last_error(cam3d_session* session, char* message, size_t message_size)
+	{
+		if (session == nullptr || message == nullptr || message_size == 0) { return CAM3D_ERROR_INVALID_ARGUMENT; }
+		try
+		{
+			std::string text;
+			{
+				std::lock_guard<std::mutex> lock(session->stateMutex);
+				text = session->lastError;
+			}
+			copyText(text, message, message_size);
+			return CAM3D_OK;
+		}
+		catch (...)
+		{
+			return handleException(nullptr);
+		}
+	}
+}
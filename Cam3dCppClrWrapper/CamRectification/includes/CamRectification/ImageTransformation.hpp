@@ -0,0 +1,88 @@
+#pragma once
+
+#include "RadialDistortionModel.hpp"
+#include <CamCommon/Vector2.hpp>
+
+namespace cam3d
+{
+	// Point mapping between source and transformed image, as managed IImageTransformation.
+	// Forwards maps source point to transformed image, backwards the other way.
+	class IImageTransformation
+	{
+	public:
+		virtual ~IImageTransformation() { }
+
+		virtual Vector2f transformPointForwards(Vector2f point) const = 0;
+		virtual Vector2f transformPointBackwards(Vector2f point) const = 0;
+
+		// Transforms backwards centres of pixels of transformed row 'r' - points
+		// (origin.x + c + 0.5, origin.y + r + 0.5) for c in [0, cols). Transformations
+		// which compute row incrementally override it
+		virtual void transformRowBackwards(int r, int cols, Vector2f origin, Vector2f* points) const;
+	};
+
+	// 3x3 projective transformation, row-major
+	struct Homography
+	{
+		double h[3][3] = { { 1.0, 0.0, 0.0 }, { 0.0, 1.0, 0.0 }, { 0.0, 0.0, 1.0 } };
+
+		Vector2f apply(Vector2f p) const
+		{
+			double w = h[2][0] * p.x + h[2][1] * p.y + h[2][2];
+			return Vector2f{ (h[0][0] * p.x + h[0][1] * p.y + h[0][2]) / w, (h[1][0] * p.x + h[1][1] * p.y + h[1][2]) / w };
+		}
+
+		Homography inverse() const; // Throws std::invalid_argument if matrix is singular
+	};
+
+	class RectificationTransformation : public IImageTransformation
+	{
+		Homography rectification;
+		Homography inverse;
+
+	public:
+		explicit RectificationTransformation(const Homography& rectification_) :
+			rectification{ rectification_ }, inverse{ rectification_.inverse() }
+		{ }
+
+		const Homography& getRectification() const { return rectification; }
+		const Homography& getInverse() const { return inverse; }
+
+		Vector2f transformPointForwards(Vector2f point) const override { return rectification.apply(point); }
+		Vector2f transformPointBackwards(Vector2f point) const override { return inverse.apply(point); }
+		void transformRowBackwards(int r, int cols, Vector2f origin, Vector2f* points) const override;
+	};
+
+	// Forwards undistorts point, backwards distorts it. Model must outlive transformation
+	class RadialDistortionTransformation : public IImageTransformation
+	{
+		const RadialDistortionModel* model;
+
+	public:
+		explicit RadialDistortionTransformation(const RadialDistortionModel& model_) : model{ &model_ } { }
+
+		const RadialDistortionModel& getModel() const { return *model; }
+
+		Vector2f transformPointForwards(Vector2f point) const override
+		{
+			return model->undistort(point * model->imageScale) / model->imageScale;
+		}
+
+		Vector2f transformPointBackwards(Vector2f point) const override
+		{
+			return model->distort(point * model->imageScale) / model->imageScale;
+		}
+	};
+
+	// Bounding box of transformed borders of image of 'rows' x 'cols', extended by 'margin' pixels,
+	// as managed ImageTransformer.FindTransformedImageSize. Transformed image which should contain
+	// whole source one has its size and 'origin' (position of its top-left corner in transformed space)
+	struct TransformedBounds
+	{
+		Vector2f origin;
+		int rows;
+		int cols;
+	};
+
+	TransformedBounds findTransformedBounds(const IImageTransformation& transformation, int rows, int cols, int margin = 1);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <CamCommon/Vector2.hpp>
+#include <string>
+#include <vector>
+
+namespace cam3d
+{
+	// Radial distortion models as managed CamCore ones, without derivatives used for
+	// their fitting. Points are in model space - image points scaled by 'imageScale'.
+	// Points which can not be transformed give NaN coordinates instead of exception.
+	class RadialDistortionModel
+	{
+	public:
+		double imageScale = 1.0;
+
+		virtual ~RadialDistortionModel() { }
+
+		virtual std::string getName() const = 0;
+		// Parameters in order of managed Coeffs, distortion centre last
+		virtual std::vector<double> getCoeffs() const = 0;
+		virtual Vector2f distort(Vector2f point) const = 0;
+		virtual Vector2f undistort(Vector2f point) const = 0;
+	};
+
+	// rd = ru * (1 + k1 * ru) / (1 + k2 * ru + k3 * ru^2), inverted by solving quadratic equation
+	class Rational3RDModel : public RadialDistortionModel
+	{
+	public:
+		double k1 = 0.0;
+		double k2 = 0.0;
+		double k3 = 0.0;
+		Vector2f center;
+
+		Rational3RDModel() { }
+		Rational3RDModel(double k1_, double k2_, double k3_, double cx, double cy) :
+			k1{ k1_ }, k2{ k2_ }, k3{ k3_ }, center{ cx, cy }
+		{ }
+
+		std::string getName() const override { return "Rational3"; }
+		std::vector<double> getCoeffs() const override { return { k1, k2, k3, center.x, center.y }; }
+		Vector2f distort(Vector2f point) const override;
+		Vector2f undistort(Vector2f point) const override;
+	};
+
+	// ru = rd * (1 + k1 * rd^(1/2) + k2 * rd^(1/3) + k3 * rd^(1/4) + k4 * rd^(1/5)).
+	// Distortion is not defined by model (managed one throws) - it is found by Newton's
+	// method on radius, so that undistortion may be composed with other transformations
+	class Taylor4Model : public RadialDistortionModel
+	{
+	public:
+		double k1 = 0.0;
+		double k2 = 0.0;
+		double k3 = 0.0;
+		double k4 = 0.0;
+		Vector2f center;
+
+		Taylor4Model() { }
+		Taylor4Model(double k1_, double k2_, double k3_, double k4_, double cx, double cy) :
+			k1{ k1_ }, k2{ k2_ }, k3{ k3_ }, k4{ k4_ }, center{ cx, cy }
+		{ }
+
+		std::string getName() const override { return "Taylor4"; }
+		std::vector<double> getCoeffs() const override { return { k1, k2, k3, k4, center.x, center.y }; }
+		Vector2f distort(Vector2f point) const override;
+		Vector2f undistort(Vector2f point) const override;
+
+	private:
+		double undistortRadius(double rd) const;
+	};
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "RemapTable.hpp"
+#include <CamCommon/PlaneFile.hpp>
+#include <cstdint>
+#include <string>
+
+namespace cam3d
+{
+	// Undistortion followed by rectification, which managed UndistortImagesLink and RectificationLink
+	// do in separate resampling passes. Backwards: point transformed by inverse rectification and
+	// distorted, so that table of this transformation resamples each frame once.
+	// Model must outlive transformation.
+	class UndistortRectifyTransformation : public IImageTransformation
+	{
+		RadialDistortionTransformation undistortion;
+		RectificationTransformation rectification;
+
+	public:
+		UndistortRectifyTransformation(const RadialDistortionModel& model, const Homography& rectification_) :
+			undistortion{ model }, rectification{ rectification_ }
+		{ }
+
+		Vector2f transformPointForwards(Vector2f point) const override
+		{
+			return rectification.transformPointForwards(undistortion.transformPointForwards(point));
+		}
+
+		Vector2f transformPointBackwards(Vector2f point) const override
+		{
+			return undistortion.transformPointBackwards(rectification.transformPointBackwards(point));
+		}
+
+		void transformRowBackwards(int r, int cols, Vector2f origin, Vector2f* points) const override;
+	};
+
+	// Increased when layout of cache file or computation of table changes
+	constexpr std::uint32_t remapCacheVersion = 1;
+
+	// Hash (64-bit FNV-1a) of everything table depends on: model name, coefficients and scale,
+	// rectification, sizes and origin of table
+	std::uint64_t getRemapCacheKey(const RadialDistortionModel& model, const Homography& rectification,
+		int rows, int cols, int sourceRows, int sourceCols, Vector2f origin);
+
+	// Writes table as plane file: header plane with version and key, then uncompressed arrays,
+	// which are mapped when file is read. File is written under temporary name and renamed, so that
+	// workers starting at once never read partial file. Throws std::runtime_error
+	void writeRemapTable(const std::string& path, const RemapTable& table, std::uint64_t key);
+
+	// Reads table written with current version and same key; it borrows pages mapped by 'result.file'.
+	// Returns false if file is missing, not valid or was written for other calibration
+	bool tryReadRemapTable(const std::string& path, std::uint64_t key, io::Loaded<RemapTable>& result);
+
+	// Table of UndistortRectifyTransformation read from 'cachePath' if cache is valid, else built and
+	// written there. Failure to write cache is ignored - table is still returned
+	io::Loaded<RemapTable> getUndistortRectifyTable(const std::string& cachePath, const RadialDistortionModel& model,
+		const Homography& rectification, int rows, int cols, int sourceRows, int sourceCols,
+		Vector2f origin = Vector2f{}, const ParallelForOptions& options = ParallelForOptions{});
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "ImageTransformation.hpp"
+#include <CamCommon/Array2d.hpp>
+#include <CamCommon/ColorImage.hpp>
+#include <CamCommon/GreyScaleImage.hpp>
+#include <CamCommon/MaskedImage.hpp>
+#include <CamCommon/ParallelFor.hpp>
+#include <cstdint>
+
+namespace cam3d
+{
+	// Backward map of transformed image, computed once for fixed rig instead of transforming
+	// points of every frame. Each pixel stores top-left pixel (x, y) of 2x2 source neighbourhood
+	// and bilinear weights of right column and bottom row in 1/32 units (0..32), 6 bytes per pixel.
+	// As managed ImageTransformer, pixel is mapped if its centre transformed backwards lies within
+	// source image; interpolation is clamped to border pixels. Source must be at least 2x2 and at
+	// most 32767 in each dimension.
+	class RemapTable
+	{
+	public:
+		static constexpr int fractionBits = 5;
+		static constexpr int fractionOne = 1 << fractionBits;
+		static constexpr std::int16_t unmapped = -1; // In sourceX of pixels mapped outside of source
+
+	private:
+		int sourceRows;
+		int sourceCols;
+		Array2d<std::int16_t> sourceX;
+		Array2d<std::int16_t> sourceY;
+		Array2d<std::uint8_t> fractionX;
+		Array2d<std::uint8_t> fractionY;
+
+	public:
+		// Empty table, e.g. to be assigned
+		RemapTable();
+		// All pixels unmapped. Throws std::invalid_argument if sizes are not supported
+		RemapTable(int rows, int cols, int sourceRows, int sourceCols);
+		// Takes arrays of table, e.g. borrowing pages of mapped cache file. Throws std::invalid_argument
+		// if their sizes differ or entries point outside of source
+		RemapTable(int sourceRows, int sourceCols, Array2d<std::int16_t> sourceX, Array2d<std::int16_t> sourceY,
+			Array2d<std::uint8_t> fractionX, Array2d<std::uint8_t> fractionY);
+		// Pixel (r, c) maps to transformation.transformPointBackwards((origin.x + c + 0.5, origin.y + r + 0.5)).
+		// Rows are computed in parallel, so transformation must be safe to use concurrently
+		RemapTable(const IImageTransformation& transformation, int rows, int cols, int sourceRows, int sourceCols,
+			Vector2f origin = Vector2f{}, const ParallelForOptions& options = ParallelForOptions{});
+
+		int getRowCount() const { return sourceX.getRowCount(); }
+		int getColumnCount() const { return sourceX.getColumnCount(); }
+		int getSourceRowCount() const { return sourceRows; }
+		int getSourceColumnCount() const { return sourceCols; }
+
+		// 'sourcePoint' in source image coordinates, with pixel centres at (x + 0.5, y + 0.5)
+		void setPoint(int r, int c, Vector2f sourcePoint);
+		void setUnmapped(int r, int c);
+		bool isMapped(int r, int c) const { return sourceX(r, c) != unmapped; }
+
+		const Array2d<std::int16_t>& getSourceX() const { return sourceX; }
+		const Array2d<std::int16_t>& getSourceY() const { return sourceY; }
+		const Array2d<std::uint8_t>& getFractionX() const { return fractionX; }
+		const Array2d<std::uint8_t>& getFractionY() const { return fractionY; }
+		Array2d<std::int16_t>& getSourceX() { return sourceX; }
+		Array2d<std::int16_t>& getSourceY() { return sourceY; }
+		Array2d<std::uint8_t>& getFractionX() { return fractionX; }
+		Array2d<std::uint8_t>& getFractionY() { return fractionY; }
+	};
+
+	// Warps 'source' (of table source size) into 'destination' (of table size) with bilinear
+	// interpolation, in parallel by bands of rows. Unmapped pixels are set to 0 and, if 'mask'
+	// is given (of table size), get 0 in it while mapped ones get 1. 8-bit planes are interpolated
+	// in fixed point, others in floating point. Throws std::invalid_argument if sizes do not match
+	void remap(const Array2d<std::uint8_t>& source, Array2d<std::uint8_t>& destination, Array2d<char>* mask,
+		const RemapTable& table, const ParallelForOptions& options = ParallelForOptions{});
+	void remap(const Array2d<float>& source, Array2d<float>& destination, Array2d<char>* mask,
+		const RemapTable& table, const ParallelForOptions& options = ParallelForOptions{});
+	void remap(const Array2d<double>& source, Array2d<double>& destination, Array2d<char>* mask,
+		const RemapTable& table, const ParallelForOptions& options = ParallelForOptions{});
+
+	// As managed ImageTransformer.TransfromImageBackwards, with mask of 'destination' set
+	void remap(const GreyScaleImage& source, MaskedImage<GreyScaleImage>& destination,
+		const RemapTable& table, const ParallelForOptions& options = ParallelForOptions{});
+	void remap(const ColorImage& source, MaskedImage<ColorImage>& destination,
+		const RemapTable& table, const ParallelForOptions& options = ParallelForOptions{});
+}
@@ -0,0 +1,87 @@
+#include "ImageTransformation.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace cam3d
+{
+	void IImageTransformation::transformRowBackwards(int r, int cols, Vector2f origin, Vector2f* points) const
+	{
+		for (int c = 0; c < cols; ++c)
+		{
+			points[c] = transformPointBackwards(Vector2f{ origin.x + c + 0.5, origin.y + r + 0.5 });
+		}
+	}
+
+	Homography Homography::inverse() const
+	{
+		const double(&m)[3][3] = h;
+		double c00 = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+		double c01 = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+		double c02 = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+		double det = m[0][0] * c00 + m[0][1] * c01 + m[0][2] * c02;
+		if (det == 0.0 || !std::isfinite(det))
+		{
+			throw std::invalid_argument("Homography is singular");
+		}
+
+		double s = 1.0 / det;
+		Homography result;
+		result.h[0][0] = c00 * s;
+		result.h[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * s;
+		result.h[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * s;
+		result.h[1][0] = c01 * s;
+		result.h[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * s;
+		result.h[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * s;
+		result.h[2][0] = c02 * s;
+		result.h[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * s;
+		result.h[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * s;
+		return result;
+	}
+
+	void RectificationTransformation::transformRowBackwards(int r, int cols, Vector2f origin, Vector2f* points) const
+	{
+		// Homogeneous coordinates are linear along row, only division is left per pixel
+		const double(&m)[3][3] = inverse.h;
+		double x0 = origin.x + 0.5;
+		double y = origin.y + r + 0.5;
+		double baseX = m[0][0] * x0 + m[0][1] * y + m[0][2];
+		double baseY = m[1][0] * x0 + m[1][1] * y + m[1][2];
+		double baseW = m[2][0] * x0 + m[2][1] * y + m[2][2];
+		for (int c = 0; c < cols; ++c)
+		{
+			double w = baseW + m[2][0] * c;
+			points[c] = Vector2f{ (baseX + m[0][0] * c) / w, (baseY + m[1][0] * c) / w };
+		}
+	}
+
+	TransformedBounds findTransformedBounds(const IImageTransformation& transformation, int rows, int cols, int margin)
+	{
+		double minX = cols, minY = rows, maxX = 0.0, maxY = 0.0;
+		auto extend = [&](double x, double y)
+		{
+			Vector2f p = transformation.transformPointForwards(Vector2f{ x, y });
+			if (!std::isfinite(p.x) || !std::isfinite(p.y)) { return; }
+			minX = std::min(minX, p.x);
+			minY = std::min(minY, p.y);
+			maxX = std::max(maxX, p.x);
+			maxY = std::max(maxY, p.y);
+		};
+		for (int c = 0; c <= cols; ++c)
+		{
+			extend(c, 0.0);
+			extend(c, rows);
+		}
+		for (int r = 0; r <= rows; ++r)
+		{
+			extend(0.0, r);
+			extend(cols, r);
+		}
+
+		TransformedBounds bounds;
+		bounds.origin = Vector2f{ std::floor(minX) - margin, std::floor(minY) - margin };
+		bounds.cols = static_cast<int>(std::ceil(maxX) - bounds.origin.x) + margin;
+		bounds.rows = static_cast<int>(std::ceil(maxY) - bounds.origin.y) + margin;
+		return bounds;
+	}
+}
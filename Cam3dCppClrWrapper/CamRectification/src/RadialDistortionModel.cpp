@@ -0,0 +1,83 @@
+#include "RadialDistortionModel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace cam3d
+{
+	namespace
+	{
+		const Vector2f notTransformed{ std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::quiet_NaN() };
+
+		// Moves point along its radius from 'center', so that its distance changes from 'from' to 'to'
+		Vector2f scaleRadius(Vector2f local, Vector2f center, double from, double to)
+		{
+			if (from == 0.0) { return local + center; }
+			return local * (to / from) + center;
+		}
+	}
+
+	Vector2f Rational3RDModel::distort(Vector2f point) const
+	{
+		Vector2f local = point - center;
+		double ru = local.length();
+		double rd = ru * (1.0 + k1 * ru) / (1.0 + k2 * ru + k3 * ru * ru);
+		return scaleRadius(local, center, ru, rd);
+	}
+
+	Vector2f Rational3RDModel::undistort(Vector2f point) const
+	{
+		//  ru = (-b + sqrt(b^2 - 4ac)) / 2a, where b = 1 - rd * k2, a = k1 - rd * k3, c = -rd
+		Vector2f local = point - center;
+		double rd = local.length();
+		double b = 1.0 - rd * k2;
+		double a = k1 - rd * k3;
+		double ru;
+		if (std::abs(a) < 1e-6 * rd)
+		{
+			if (rd * k2 >= 1.0 - 1e-6 * rd) { return notTransformed; }
+			ru = rd / b;
+		}
+		else
+		{
+			double delta = b * b + 4.0 * rd * a;
+			if (delta < 0.0) { return notTransformed; }
+			ru = (-b + std::sqrt(delta)) / (2.0 * a);
+		}
+		return scaleRadius(local, center, rd, ru);
+	}
+
+	double Taylor4Model::undistortRadius(double rd) const
+	{
+		return rd * (1.0 + k1 * std::sqrt(rd) + k2 * std::cbrt(rd) + k3 * std::pow(rd, 0.25) + k4 * std::pow(rd, 0.2));
+	}
+
+	Vector2f Taylor4Model::distort(Vector2f point) const
+	{
+		// Solves undistortRadius(rd) = ru, starting from rd = ru, with numeric derivative
+		Vector2f local = point - center;
+		double ru = local.length();
+		if (ru == 0.0) { return point; }
+
+		constexpr int maxIterations = 20;
+		double rd = ru;
+		for (int i = 0; i < maxIterations; ++i)
+		{
+			double error = undistortRadius(rd) - ru;
+			if (std::abs(error) <= 1e-9 * ru) { return scaleRadius(local, center, ru, rd); }
+
+			double step = 1e-6 * rd + 1e-9;
+			double derivative = (undistortRadius(rd + step) - undistortRadius(rd)) / step;
+			if (!(derivative > 0.0)) { break; }
+			rd = std::max(rd - error / derivative, 0.5 * rd);
+		}
+		return notTransformed;
+	}
+
+	Vector2f Taylor4Model::undistort(Vector2f point) const
+	{
+		Vector2f local = point - center;
+		double rd = local.length();
+		return scaleRadius(local, center, rd, undistortRadius(rd));
+	}
+}
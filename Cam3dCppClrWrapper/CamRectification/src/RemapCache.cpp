@@ -0,0 +1,202 @@
+#include "RemapCache.hpp"
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+
+namespace cam3d
+{
+	namespace
+	{
+		constexpr const char* headerPlaneName = "remap_header";
+		constexpr const char* sourceXPlaneName = "source_x";
+		constexpr const char* sourceYPlaneName = "source_y";
+		constexpr const char* fractionXPlaneName = "fraction_x";
+		constexpr const char* fractionYPlaneName = "fraction_y";
+
+		struct RemapCacheHeader
+		{
+			std::uint32_t version;
+			std::uint32_t fractionBits;
+			std::uint64_t key;
+			std::int32_t sourceRows;
+			std::int32_t sourceCols;
+		};
+
+		static_assert(sizeof(RemapCacheHeader) == 24, "RemapCacheHeader is stored as is");
+
+		class Fnv1a
+		{
+			std::uint64_t hash = 14695981039346656037ull;
+
+		public:
+			void add(const void* data, std::size_t size)
+			{
+				const unsigned char* bytes = static_cast<const unsigned char*>(data);
+				for (std::size_t i = 0; i < size; ++i)
+				{
+					hash = (hash ^ bytes[i]) * 1099511628211ull;
+				}
+			}
+
+			template<typename T>
+			void add(T value) { add(&value, sizeof(value)); }
+
+			std::uint64_t get() const { return hash; }
+		};
+
+		template<typename T>
+		void writeArray(io::PlaneFileWriter& writer, const char* name, io::ElementType type, const Array2d<T>& array)
+		{
+			writer.writePlane(name, type, array.getRowCount(), array.getColumnCount(), 1,
+				array.getData(), array.getPitch() * sizeof(T));
+		}
+
+		// Borrows mapped plane - tables are written uncompressed
+		template<typename T>
+		bool mapArray(const io::PlaneFileReader& reader, const char* name, io::ElementType type, Array2d<T>& array)
+		{
+			const io::PlaneInfo* plane = reader.findPlane(name);
+			if (plane == nullptr || plane->type != type || plane->channels != 1) { return false; }
+			void* mapped = reader.getMappedData(*plane);
+			if (mapped == nullptr) { return false; }
+			array = Array2d<T>{ borrowed, static_cast<T*>(mapped), plane->rows, plane->cols,
+				static_cast<int>(plane->pitchBytes / sizeof(T)) };
+			return true;
+		}
+	}
+
+	void UndistortRectifyTransformation::transformRowBackwards(int r, int cols, Vector2f origin, Vector2f* points) const
+	{
+		rectification.transformRowBackwards(r, cols, origin, points);
+		for (int c = 0; c < cols; ++c)
+		{
+			points[c] = undistortion.transformPointBackwards(points[c]);
+		}
+	}
+
+	std::uint64_t getRemapCacheKey(const RadialDistortionModel& model, const Homography& rectification,
+		int rows, int cols, int sourceRows, int sourceCols, Vector2f origin)
+	{
+		Fnv1a hash;
+		std::string name = model.getName();
+		hash.add(name.data(), name.size());
+		for (double coeff : model.getCoeffs())
+		{
+			hash.add(coeff);
+		}
+		hash.add(model.imageScale);
+		hash.add(rectification.h, sizeof(rectification.h));
+		hash.add(static_cast<std::int32_t>(rows));
+		hash.add(static_cast<std::int32_t>(cols));
+		hash.add(static_cast<std::int32_t>(sourceRows));
+		hash.add(static_cast<std::int32_t>(sourceCols));
+		hash.add(origin.x);
+		hash.add(origin.y);
+		return hash.get();
+	}
+
+	void writeRemapTable(const std::string& path, const RemapTable& table, std::uint64_t key)
+	{
+		std::random_device random;
+		std::string temporaryPath = path + "." + std::to_string(random()) + ".tmp";
+		try
+		{
+			RemapCacheHeader header;
+			std::memset(&header, 0, sizeof(header));
+			header.version = remapCacheVersion;
+			header.fractionBits = RemapTable::fractionBits;
+			header.key = key;
+			header.sourceRows = table.getSourceRowCount();
+			header.sourceCols = table.getSourceColumnCount();
+
+			io::PlaneFileWriter writer{ temporaryPath, 5 };
+			writer.writePlane(headerPlaneName, io::ElementType::UInt8, 1, static_cast<int>(sizeof(header)), 1, &header, sizeof(header));
+			writeArray(writer, sourceXPlaneName, io::ElementType::Int16, table.getSourceX());
+			writeArray(writer, sourceYPlaneName, io::ElementType::Int16, table.getSourceY());
+			writeArray(writer, fractionXPlaneName, io::ElementType::UInt8, table.getFractionX());
+			writeArray(writer, fractionYPlaneName, io::ElementType::UInt8, table.getFractionY());
+			writer.close();
+		}
+		catch (...)
+		{
+			std::remove(temporaryPath.c_str());
+			throw;
+		}
+
+		if (std::rename(temporaryPath.c_str(), path.c_str()) != 0)
+		{
+			// Rename does not replace existing file on Windows
+			std::remove(path.c_str());
+			if (std::rename(temporaryPath.c_str(), path.c_str()) != 0)
+			{
+				std::remove(temporaryPath.c_str());
+				throw std::runtime_error("Can not write remap table to " + path);
+			}
+		}
+	}
+
+	bool tryReadRemapTable(const std::string& path, std::uint64_t key, io::Loaded<RemapTable>& result)
+	{
+		try
+		{
+			io::PlaneFileReader reader{ path };
+			const io::PlaneInfo* headerPlane = reader.findPlane(headerPlaneName);
+			if (headerPlane == nullptr || headerPlane->type != io::ElementType::UInt8 ||
+				headerPlane->getRowBytes() != sizeof(RemapCacheHeader) || headerPlane->rows != 1)
+			{
+				return false;
+			}
+			RemapCacheHeader header;
+			reader.readPlane(*headerPlane, &header, sizeof(header));
+			if (header.version != remapCacheVersion || header.fractionBits != RemapTable::fractionBits || header.key != key)
+			{
+				return false;
+			}
+
+			Array2d<std::int16_t> sourceX{ 0, 0 }, sourceY{ 0, 0 };
+			Array2d<std::uint8_t> fractionX{ 0, 0 }, fractionY{ 0, 0 };
+			if (!mapArray(reader, sourceXPlaneName, io::ElementType::Int16, sourceX) ||
+				!mapArray(reader, sourceYPlaneName, io::ElementType::Int16, sourceY) ||
+				!mapArray(reader, fractionXPlaneName, io::ElementType::UInt8, fractionX) ||
+				!mapArray(reader, fractionYPlaneName, io::ElementType::UInt8, fractionY))
+			{
+				return false;
+			}
+
+			result.value = RemapTable{ header.sourceRows, header.sourceCols, std::move(sourceX), std::move(sourceY),
+				std::move(fractionX), std::move(fractionY) };
+			result.file = reader.getFile();
+			return true;
+		}
+		catch (const std::exception&)
+		{
+			// Missing, damaged or foreign file is rebuilt like stale one
+			return false;
+		}
+	}
+
+	io::Loaded<RemapTable> getUndistortRectifyTable(const std::string& cachePath, const RadialDistortionModel& model,
+		const Homography& rectification, int rows, int cols, int sourceRows, int sourceCols,
+		Vector2f origin, const ParallelForOptions& options)
+	{
+		std::uint64_t key = getRemapCacheKey(model, rectification, rows, cols, sourceRows, sourceCols, origin);
+		io::Loaded<RemapTable> cached;
+		if (tryReadRemapTable(cachePath, key, cached))
+		{
+			return cached;
+		}
+
+		UndistortRectifyTransformation transformation{ model, rectification };
+		io::Loaded<RemapTable> built{ nullptr, RemapTable{ transformation, rows, cols, sourceRows, sourceCols, origin, options } };
+		try
+		{
+			writeRemapTable(cachePath, built.value, key);
+		}
+		catch (const std::exception&)
+		{
+			// Cache location may be read-only - table is built on each start then
+		}
+		return built;
+	}
+}
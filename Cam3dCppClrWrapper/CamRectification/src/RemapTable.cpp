@@ -0,0 +1,301 @@
+#include "RemapTable.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace cam3d
+{
+	constexpr int RemapTable::fractionBits;
+	constexpr int RemapTable::fractionOne;
+	constexpr std::int16_t RemapTable::unmapped;
+
+	namespace
+	{
+		void checkSourceSize(int sourceRows, int sourceCols)
+		{
+			constexpr int maxSize = std::numeric_limits<std::int16_t>::max();
+			if (sourceRows < 2 || sourceCols < 2 || sourceRows > maxSize || sourceCols > maxSize)
+			{
+				throw std::invalid_argument("Remap table source must have between 2 and 32767 rows and columns");
+			}
+		}
+	}
+
+	RemapTable::RemapTable() :
+		sourceRows{ 0 },
+		sourceCols{ 0 },
+		sourceX{ 0, 0 },
+		sourceY{ 0, 0 },
+		fractionX{ 0, 0 },
+		fractionY{ 0, 0 }
+	{ }
+
+	RemapTable::RemapTable(int rows, int cols, int sourceRows_, int sourceCols_) :
+		sourceRows{ sourceRows_ },
+		sourceCols{ sourceCols_ },
+		sourceX{ std::max(rows, 0), std::max(cols, 0), uninitialized },
+		sourceY{ std::max(rows, 0), std::max(cols, 0), uninitialized },
+		fractionX{ std::max(rows, 0), std::max(cols, 0), uninitialized },
+		fractionY{ std::max(rows, 0), std::max(cols, 0), uninitialized }
+	{
+		if (rows < 0 || cols < 0) { throw std::invalid_argument("Remap table size must not be negative"); }
+		checkSourceSize(sourceRows, sourceCols);
+		sourceX.fill(unmapped);
+		sourceY.fill(0);
+		fractionX.fill(0);
+		fractionY.fill(0);
+	}
+
+	RemapTable::RemapTable(int sourceRows_, int sourceCols_, Array2d<std::int16_t> sourceX_, Array2d<std::int16_t> sourceY_,
+		Array2d<std::uint8_t> fractionX_, Array2d<std::uint8_t> fractionY_) :
+		sourceRows{ sourceRows_ },
+		sourceCols{ sourceCols_ },
+		sourceX{ std::move(sourceX_) },
+		sourceY{ std::move(sourceY_) },
+		fractionX{ std::move(fractionX_) },
+		fractionY{ std::move(fractionY_) }
+	{
+		checkSourceSize(sourceRows, sourceCols);
+		int rows = sourceX.getRowCount();
+		int cols = sourceX.getColumnCount();
+		if (sourceY.getRowCount() != rows || sourceY.getColumnCount() != cols ||
+			fractionX.getRowCount() != rows || fractionX.getColumnCount() != cols ||
+			fractionY.getRowCount() != rows || fractionY.getColumnCount() != cols)
+		{
+			throw std::invalid_argument("Remap table arrays must have same size");
+		}
+
+		// Entries are used as offsets, so each is checked once instead of on every remap
+		bool valid = true;
+		for (int r = 0; r < rows; ++r)
+		{
+			const std::int16_t* xs = sourceX.getRow(r);
+			const std::int16_t* ys = sourceY.getRow(r);
+			const std::uint8_t* fxs = fractionX.getRow(r);
+			const std::uint8_t* fys = fractionY.getRow(r);
+			for (int c = 0; c < cols; ++c)
+			{
+				bool mapped = xs[c] != unmapped;
+				bool inSource = xs[c] >= 0 && xs[c] <= sourceCols - 2 && ys[c] >= 0 && ys[c] <= sourceRows - 2;
+				bool inFractions = fxs[c] <= fractionOne && fys[c] <= fractionOne;
+				valid &= !mapped || (inSource && inFractions);
+			}
+		}
+		if (!valid) { throw std::invalid_argument("Remap table points outside of source"); }
+	}
+
+	RemapTable::RemapTable(const IImageTransformation& transformation, int rows, int cols, int sourceRows_, int sourceCols_,
+		Vector2f origin, const ParallelForOptions& options) :
+		RemapTable(rows, cols, sourceRows_, sourceCols_)
+	{
+		parallelForRows(0, rows, [&](int startRow, int endRow)
+		{
+			thread_local std::vector<Vector2f> points;
+			points.resize(cols);
+			for (int r = startRow; r < endRow; ++r)
+			{
+				transformation.transformRowBackwards(r, cols, origin, points.data());
+				for (int c = 0; c < cols; ++c)
+				{
+					setPoint(r, c, points[c]);
+				}
+			}
+		}, options);
+	}
+
+	void RemapTable::setPoint(int r, int c, Vector2f sourcePoint)
+	{
+		// Negated, so that NaN is unmapped too
+		if (!(sourcePoint.x >= 0.0 && sourcePoint.x < sourceCols && sourcePoint.y >= 0.0 && sourcePoint.y < sourceRows))
+		{
+			setUnmapped(r, c);
+			return;
+		}
+
+		// Interpolation between pixel centres, clamped at border ones
+		double u = std::min(std::max(sourcePoint.x - 0.5, 0.0), sourceCols - 1.0);
+		double v = std::min(std::max(sourcePoint.y - 0.5, 0.0), sourceRows - 1.0);
+		int fixedX = static_cast<int>(std::lround(u * fractionOne));
+		int fixedY = static_cast<int>(std::lround(v * fractionOne));
+		int x = fixedX >> fractionBits;
+		int y = fixedY >> fractionBits;
+		int fx = fixedX & (fractionOne - 1);
+		int fy = fixedY & (fractionOne - 1);
+		// Last column (row) is reached as full weight of right (bottom) neighbour, so that
+		// 2x2 neighbourhood stays in image
+		if (x >= sourceCols - 1) { x = sourceCols - 2; fx = fractionOne; }
+		if (y >= sourceRows - 1) { y = sourceRows - 2; fy = fractionOne; }
+
+		sourceX(r, c) = static_cast<std::int16_t>(x);
+		sourceY(r, c) = static_cast<std::int16_t>(y);
+		fractionX(r, c) = static_cast<std::uint8_t>(fx);
+		fractionY(r, c) = static_cast<std::uint8_t>(fy);
+	}
+
+	void RemapTable::setUnmapped(int r, int c)
+	{
+		sourceX(r, c) = unmapped;
+		sourceY(r, c) = 0;
+		fractionX(r, c) = 0;
+		fractionY(r, c) = 0;
+	}
+
+	namespace
+	{
+		// Floating point interpolation with weights in 1/32 units
+		template<typename T>
+		struct Bilinear
+		{
+			using Value = typename std::conditional<std::is_same<T, double>::value, double, float>::type;
+
+			static Value getWeight(int fraction) { return static_cast<Value>(fraction) * (Value(1) / RemapTable::fractionOne); }
+
+			static T interpolate(Value s00, Value s01, Value s10, Value s11, Value wx, Value wy, Value valid)
+			{
+				Value top = s00 + (s01 - s00) * wx;
+				Value bottom = s10 + (s11 - s10) * wx;
+				Value value = top + (bottom - top) * wy;
+				return static_cast<T>(value * valid);
+			}
+		};
+
+		// Fixed point: weights sum to 32 in each direction, so result is scaled by 1024
+		template<>
+		struct Bilinear<std::uint8_t>
+		{
+			using Value = int;
+
+			static Value getWeight(int fraction) { return fraction; }
+
+			static std::uint8_t interpolate(Value s00, Value s01, Value s10, Value s11, Value wx, Value wy, Value valid)
+			{
+				constexpr int one = RemapTable::fractionOne;
+				Value top = s00 * (one - wx) + s01 * wx;
+				Value bottom = s10 * (one - wx) + s11 * wx;
+				Value value = (top * (one - wy) + bottom * wy + one * one / 2) >> (2 * RemapTable::fractionBits);
+				return static_cast<std::uint8_t>(value * valid);
+			}
+		};
+
+		// Rows of table are processed in chunks: neighbourhoods are gathered to local arrays,
+		// then interpolation runs over contiguous values, so that it is vectorized
+		template<typename T, int channels>
+		void remapRow(const T* source, int sourcePitch, T* destination, char* mask, const RemapTable& table, int r)
+		{
+			using Value = typename Bilinear<T>::Value;
+			constexpr int chunkSize = 64;
+			constexpr int chunkValues = chunkSize * channels;
+			Value s00[chunkValues], s01[chunkValues], s10[chunkValues], s11[chunkValues];
+			Value wx[chunkValues], wy[chunkValues], valid[chunkValues];
+
+			int cols = table.getColumnCount();
+			const std::int16_t* xs = table.getSourceX().getRow(r);
+			const std::int16_t* ys = table.getSourceY().getRow(r);
+			const std::uint8_t* fxs = table.getFractionX().getRow(r);
+			const std::uint8_t* fys = table.getFractionY().getRow(r);
+			for (int start = 0; start < cols; start += chunkSize)
+			{
+				int count = std::min(chunkSize, cols - start);
+				for (int k = 0; k < count; ++k)
+				{
+					int x = xs[start + k];
+					bool isMapped = x != RemapTable::unmapped;
+					// Unmapped pixels read top-left neighbourhood, which always exists
+					x = isMapped ? x : 0;
+					int y = isMapped ? ys[start + k] : 0;
+					const T* top = source + static_cast<std::ptrdiff_t>(y) * sourcePitch + x * channels;
+					const T* bottom = top + sourcePitch;
+					Value weightX = Bilinear<T>::getWeight(fxs[start + k]);
+					Value weightY = Bilinear<T>::getWeight(fys[start + k]);
+					for (int ch = 0; ch < channels; ++ch)
+					{
+						int i = k * channels + ch;
+						s00[i] = top[ch];
+						s01[i] = top[channels + ch];
+						s10[i] = bottom[ch];
+						s11[i] = bottom[channels + ch];
+						wx[i] = weightX;
+						wy[i] = weightY;
+						valid[i] = isMapped ? Value(1) : Value(0);
+					}
+					if (mask != nullptr) { mask[start + k] = isMapped ? 1 : 0; }
+				}
+
+				T* output = destination + start * channels;
+				int values = count * channels;
+				for (int i = 0; i < values; ++i)
+				{
+					output[i] = Bilinear<T>::interpolate(s00[i], s01[i], s10[i], s11[i], wx[i], wy[i], valid[i]);
+				}
+			}
+		}
+
+		template<typename T, int channels>
+		void remapPlane(const T* source, int sourcePitch, T* destination, int destinationPitch,
+			Array2d<char>* mask, const RemapTable& table, const ParallelForOptions& options)
+		{
+			parallelForRows(0, table.getRowCount(), [&](int startRow, int endRow)
+			{
+				for (int r = startRow; r < endRow; ++r)
+				{
+					remapRow<T, channels>(source, sourcePitch, destination + static_cast<std::ptrdiff_t>(r) * destinationPitch,
+						mask != nullptr ? mask->getRow(r) : nullptr, table, r);
+				}
+			}, options);
+		}
+
+		void checkSizes(int sourceRows, int sourceCols, int rows, int cols, const Array2d<char>* mask, const RemapTable& table)
+		{
+			if (sourceRows != table.getSourceRowCount() || sourceCols != table.getSourceColumnCount() ||
+				rows != table.getRowCount() || cols != table.getColumnCount() ||
+				(mask != nullptr && (mask->getRowCount() != rows || mask->getColumnCount() != cols)))
+			{
+				throw std::invalid_argument("Image sizes do not match remap table");
+			}
+		}
+
+		template<typename T>
+		void remapArray(const Array2d<T>& source, Array2d<T>& destination, Array2d<char>* mask,
+			const RemapTable& table, const ParallelForOptions& options)
+		{
+			checkSizes(source.getRowCount(), source.getColumnCount(), destination.getRowCount(), destination.getColumnCount(), mask, table);
+			remapPlane<T, 1>(source.getRow(0), source.getPitch(), destination.getRow(0), destination.getPitch(), mask, table, options);
+		}
+	}
+
+	void remap(const Array2d<std::uint8_t>& source, Array2d<std::uint8_t>& destination, Array2d<char>* mask,
+		const RemapTable& table, const ParallelForOptions& options)
+	{
+		remapArray(source, destination, mask, table, options);
+	}
+
+	void remap(const Array2d<float>& source, Array2d<float>& destination, Array2d<char>* mask,
+		const RemapTable& table, const ParallelForOptions& options)
+	{
+		remapArray(source, destination, mask, table, options);
+	}
+
+	void remap(const Array2d<double>& source, Array2d<double>& destination, Array2d<char>* mask,
+		const RemapTable& table, const ParallelForOptions& options)
+	{
+		remapArray(source, destination, mask, table, options);
+	}
+
+	void remap(const GreyScaleImage& source, MaskedImage<GreyScaleImage>& destination,
+		const RemapTable& table, const ParallelForOptions& options)
+	{
+		remapArray(source.getMatrix(), destination.getMatrix(), &destination.getMask(), table, options);
+	}
+
+	void remap(const ColorImage& source, MaskedImage<ColorImage>& destination,
+		const RemapTable& table, const ParallelForOptions& options)
+	{
+		const ColorImage::Matrix& from = source.getMatrix();
+		ColorImage::Matrix& to = destination.getMatrix();
+		checkSizes(from.getRowCount(), from.getColumnCount(), to.getRowCount(), to.getColumnCount(), &destination.getMask(), table);
+		remapPlane<double, 3>(from.getRow(0), from.getPitch(), to.getRow(0), to.getPitch(), &destination.getMask(), table, options);
+	}
+}
@@ -0,0 +1,342 @@
+#include "Test.hpp"
+#include <CamCommon/FrameArena.hpp>
+#include <CamCommon/PlaneFile.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace cam3d
+{
+namespace tests
+{
+    namespace
+    {
+        struct Allocation
+        {
+            unsigned char* memory;
+            std::size_t bytes;
+            unsigned char fill;
+        };
+
+        // Threads allocate blocks of varying size and fill them with own byte; when all are done,
+        // allocations must not overlap and each must still hold its byte
+        void checkConcurrentAllocations(memory::FrameArena& arena, int threadsCount, int allocationsPerThread)
+        {
+            std::vector<std::vector<Allocation>> threadAllocations(threadsCount);
+            std::vector<std::thread> threads;
+            for(int t = 0; t < threadsCount; ++t)
+            {
+                threads.emplace_back([&arena, &threadAllocations, t, allocationsPerThread]()
+                {
+                    std::vector<Allocation>& allocations = threadAllocations[t];
+                    for(int i = 0; i < allocationsPerThread; ++i)
+                    {
+                        std::size_t bytes = 1 + static_cast<std::size_t>((i * 37 + t * 11) % 500);
+                        std::size_t align = std::size_t{ 1 } << (i % 7);
+                        auto memory = static_cast<unsigned char*>(arena.allocate(bytes, align));
+                        check(reinterpret_cast<std::uintptr_t>(memory) % align == 0, "Allocation is not aligned");
+                        unsigned char fill = static_cast<unsigned char>(t * 31 + i);
+                        std::fill(memory, memory + bytes, fill);
+                        allocations.push_back(Allocation{ memory, bytes, fill });
+                    }
+                });
+            }
+            for(std::thread& thread : threads)
+            {
+                thread.join();
+            }
+
+            std::vector<Allocation> all;
+            for(const std::vector<Allocation>& allocations : threadAllocations)
+            {
+                check(static_cast<int>(allocations.size()) == allocationsPerThread, "Thread did not finish its allocations");
+                all.insert(all.end(), allocations.begin(), allocations.end());
+            }
+            std::sort(all.begin(), all.end(), [](const Allocation& a, const Allocation& b)
+            {
+                return std::less<unsigned char*>{}(a.memory, b.memory);
+            });
+            for(std::size_t i = 0; i < all.size(); ++i)
+            {
+                if(i + 1 < all.size())
+                {
+                    check(!std::less<unsigned char*>{}(all[i + 1].memory, all[i].memory + all[i].bytes), "Allocations overlap");
+                }
+                check(std::all_of(all[i].memory, all[i].memory + all[i].bytes,
+                    [&all, i](unsigned char value) { return value == all[i].fill; }), "Allocation was overwritten");
+            }
+        }
+
+        void testFrameArena(TestRunner& runner)
+        {
+            runner.run("FrameArena.DisjointUnderThreads", []()
+            {
+                memory::FrameArena arena;
+                checkConcurrentAllocations(arena, 8, 2000);
+            });
+
+            // Small blocks make threads move to next block concurrently
+            runner.run("FrameArena.DisjointUnderThreadsOverBlocks", []()
+            {
+                memory::FrameArenaOptions options;
+                options.blockBytes = 4096;
+                memory::FrameArena arena{ options };
+                checkConcurrentAllocations(arena, 8, 2000);
+                check(arena.getReservedBytes() >= arena.getUsedBytes(), "Used bytes exceed reserved ones");
+            });
+
+            runner.run("FrameArena.ResetKeepsMergedBlock", []()
+            {
+                memory::FrameArenaOptions options;
+                options.blockBytes = 4096;
+                memory::FrameArena arena{ options };
+                checkConcurrentAllocations(arena, 4, 500);
+                std::size_t usedBytes = arena.getUsedBytes();
+                arena.reset();
+                check(arena.getUsedBytes() == 0, "Reset did not drop allocations");
+                std::size_t reservedBytes = arena.getReservedBytes();
+                check(reservedBytes >= usedBytes, "Merged block is smaller than last frame");
+
+                // Smaller frame fits in kept block whatever the order of allocations, so nothing more is reserved
+                checkConcurrentAllocations(arena, 4, 400);
+                check(arena.getReservedBytes() == reservedBytes, "Next frame reserved new blocks");
+            });
+        }
+
+        // Removes file when test ends, also when it fails
+        struct TemporaryFile
+        {
+            std::string path;
+
+            explicit TemporaryFile(const std::string& path_) : path{ path_ } { }
+            ~TemporaryFile() { std::remove(path.c_str()); }
+        };
+
+        std::vector<char> readBytes(const std::string& path)
+        {
+            std::ifstream file{ path, std::ios::binary };
+            return std::vector<char>{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+        }
+
+        void writeBytes(const std::string& path, const std::vector<char>& bytes)
+        {
+            std::ofstream file{ path, std::ios::binary | std::ios::trunc };
+            file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        }
+
+        // Offsets of fields in stored FileHeader and PlaneHeader of PlaneFile.cpp
+        constexpr std::size_t versionField = 8;
+        constexpr std::size_t planeCountField = 16;
+        constexpr std::size_t planeTableOffsetField = 24;
+        constexpr std::size_t planeTypeField = 32;
+        constexpr std::size_t planeOffsetField = 64;
+        constexpr std::size_t planeStoredBytesField = 72;
+
+        std::size_t getPlaneTableOffset(const std::vector<char>& bytes)
+        {
+            std::uint64_t offset;
+            std::memcpy(&offset, bytes.data() + planeTableOffsetField, sizeof(offset));
+            return static_cast<std::size_t>(offset);
+        }
+
+        template<typename T>
+        void storeAt(std::vector<char>& bytes, std::size_t offset, T value)
+        {
+            std::memcpy(bytes.data() + offset, &value, sizeof(value));
+        }
+
+        // Smooth disparities with invalid border and occluded stripe, as matcher writes them
+        DisparityMap createDisparityMap(int rows, int cols)
+        {
+            DisparityMap map{ rows, cols };
+            for(int r = 0; r < rows; ++r)
+            {
+                for(int c = 0; c < cols; ++c)
+                {
+                    if(c < 8) { map(r, c) = Disparity{ 0, Disparity::Invalid }; }
+                    else if(c % 17 == 0) { map(r, c) = Disparity{ 0, Disparity::Occluded }; }
+                    else { map(r, c) = Disparity{ -(4 + r / 8), Disparity::Valid, -(4.0 + r / 8) - 0.01 * c, 0.5 + r, 0.9 - 0.001 * c }; }
+                }
+            }
+            return map;
+        }
+
+        void checkSameMaps(const DisparityMap& expected, const DisparityMap& actual)
+        {
+            check(actual.getRowCount() == expected.getRowCount() && actual.getColumnCount() == expected.getColumnCount(), "Map size differs");
+            for(int r = 0; r < expected.getRowCount(); ++r)
+            {
+                for(int c = 0; c < expected.getColumnCount(); ++c)
+                {
+                    const Disparity& e = expected(r, c);
+                    const Disparity& a = actual(r, c);
+                    check(a.dx == e.dx && a.flags == e.flags && a.subDx == e.subDx && a.cost == e.cost && a.confidence == e.confidence,
+                        "Disparity differs at " + std::to_string(r) + ", " + std::to_string(c));
+                }
+            }
+        }
+
+        void testPlaneFile(TestRunner& runner)
+        {
+            const int rows = 37;
+            const int cols = 53;
+
+            for(io::Compression compression : { io::Compression::None, io::Compression::ShuffledRle })
+            {
+                bool compressed = compression != io::Compression::None;
+                std::string suffix = compressed ? "Compressed" : "Mapped";
+
+                runner.run("PlaneFile.DisparityMapRoundTrip" + suffix, [=]()
+                {
+                    TemporaryFile file{ "PlaneFile.disparity.test.tmp" };
+                    DisparityMap map = createDisparityMap(rows, cols);
+                    io::writeDisparityMap(file.path, map, compression, true);
+
+                    io::Loaded<DisparityMap> loaded = io::readDisparityMap(file.path);
+                    check((loaded.file != nullptr) == !compressed, "Map is mapped only if it is not compressed");
+                    checkSameMaps(map, loaded.value);
+
+                    io::Loaded<Array2d<float>> confidence = io::readConfidence(file.path);
+                    for(int r = 0; r < rows; ++r)
+                    {
+                        for(int c = 0; c < cols; ++c)
+                        {
+                            float expected = map(r, c).flags == Disparity::Valid ? static_cast<float>(map(r, c).confidence) : 0.0f;
+                            check(confidence.value(r, c) == expected, "Confidence differs");
+                        }
+                    }
+                });
+
+                runner.run("PlaneFile.ImageRoundTrip" + suffix, [=]()
+                {
+                    TemporaryFile file{ "PlaneFile.image.test.tmp" };
+                    GreyScaleImage grey{ rows, cols };
+                    ColorImage color{ rows, cols };
+                    for(int r = 0; r < rows; ++r)
+                    {
+                        for(int c = 0; c < cols; ++c)
+                        {
+                            grey(r, c) = (r * cols + c) / static_cast<double>(rows * cols);
+                            for(int channel = 0; channel < 3; ++channel)
+                            {
+                                color(r, c, channel) = c < cols / 2 ? 0.25 * channel : grey(r, c) / (channel + 1);
+                            }
+                        }
+                    }
+
+                    io::writeImage(file.path, grey, compression);
+                    io::Loaded<GreyScaleImage> loadedGrey = io::readGreyScaleImage(file.path);
+                    io::writeImage(file.path + "c", color, compression);
+                    TemporaryFile colorFile{ file.path + "c" };
+                    io::Loaded<ColorImage> loadedColor = io::readColorImage(colorFile.path);
+                    for(int r = 0; r < rows; ++r)
+                    {
+                        for(int c = 0; c < cols; ++c)
+                        {
+                            check(loadedGrey.value(r, c) == grey(r, c), "Grey image differs");
+                            for(int channel = 0; channel < 3; ++channel)
+                            {
+                                check(loadedColor.value(r, c, channel) == color(r, c, channel), "Color image differs");
+                            }
+                        }
+                    }
+                });
+            }
+
+            runner.run("PlaneFile.MappedPlanesAreAligned", [=]()
+            {
+                TemporaryFile file{ "PlaneFile.aligned.test.tmp" };
+                std::vector<std::int16_t> row(cols);
+                {
+                    io::PlaneFileWriter writer{ file.path, 2 };
+                    std::vector<unsigned char> mask(static_cast<std::size_t>(rows) * cols, 1);
+                    writer.writePlane("mask", io::ElementType::UInt8, rows, cols, 1, mask.data(), cols);
+                    writer.writePlane("levels", io::ElementType::Int16, rows, cols, 1, [&row](int r)
+                    {
+                        for(std::size_t c = 0; c < row.size(); ++c) { row[c] = static_cast<std::int16_t>(r * 100 - static_cast<int>(c)); }
+                        return static_cast<const void*>(row.data());
+                    });
+                    writer.close();
+                }
+
+                io::PlaneFileReader reader{ file.path };
+                check(reader.getPlanes().size() == 2, "Plane count differs");
+                check(reader.findPlane("missing") == nullptr, "Missing plane was found");
+                checkThrows<std::runtime_error>([&reader]() { reader.getPlane("missing"); }, "Missing plane");
+                for(const io::PlaneInfo& plane : reader.getPlanes())
+                {
+                    auto mapped = reinterpret_cast<std::uintptr_t>(reader.getMappedData(plane));
+                    check(mapped != 0 && mapped % memory::alignment == 0 && plane.pitchBytes % memory::alignment == 0,
+                        "Plane '" + plane.name + "' is not aligned");
+                }
+                const io::PlaneInfo& levels = reader.getPlane("levels");
+                auto data = static_cast<const char*>(reader.getMappedData(levels));
+                for(int r = 0; r < rows; ++r)
+                {
+                    auto levelsRow = reinterpret_cast<const std::int16_t*>(data + r * levels.pitchBytes);
+                    check(levelsRow[0] == r * 100 && levelsRow[cols - 1] == r * 100 - (cols - 1), "Streamed plane differs");
+                }
+            });
+
+            // Every damaged file must be refused with exception, before or while reading planes
+            runner.run("PlaneFile.CorruptFileRejected", [=]()
+            {
+                TemporaryFile file{ "PlaneFile.corrupt.test.tmp" };
+                TemporaryFile damaged{ "PlaneFile.damaged.test.tmp" };
+                DisparityMap map = createDisparityMap(rows, cols);
+                auto checkRejected = [&damaged](const std::vector<char>& bytes, const std::string& damage)
+                {
+                    writeBytes(damaged.path, bytes);
+                    checkThrows<std::runtime_error>([&damaged]() { io::readDisparityMap(damaged.path); }, damage);
+                };
+
+                io::writeDisparityMap(file.path, map);
+                const std::vector<char> original = readBytes(file.path);
+                io::PlaneFileReader reader{ file.path };
+                const io::PlaneInfo plane = reader.getPlanes()[0];
+                const std::size_t planeTable = getPlaneTableOffset(original);
+
+                checkRejected(std::vector<char>(original.begin(), original.begin() + 16), "File shorter than header");
+                std::vector<char> bytes = original;
+                bytes[0] = 'X';
+                checkRejected(bytes, "Wrong magic");
+                bytes = original;
+                storeAt<std::uint32_t>(bytes, versionField, 2);
+                checkRejected(bytes, "Unsupported version");
+                bytes = original;
+                storeAt<std::uint32_t>(bytes, planeCountField, 1000);
+                checkRejected(bytes, "Plane count beyond file");
+                checkRejected(std::vector<char>(original.begin(), original.begin() + plane.offset + plane.storedBytes / 2), "Truncated file");
+                bytes = original;
+                storeAt<std::uint64_t>(bytes, planeTable + planeOffsetField, original.size());
+                checkRejected(bytes, "Plane offset beyond file");
+                bytes = original;
+                storeAt<std::uint64_t>(bytes, planeTable + planeStoredBytesField, plane.storedBytes / 2);
+                checkRejected(bytes, "Plane shorter than its rows");
+                bytes = original;
+                storeAt<std::uint32_t>(bytes, planeTable + planeTypeField, 99);
+                checkRejected(bytes, "Unknown element type");
+
+                // Compressed plane is validated only when decoded
+                io::writeDisparityMap(file.path, map, io::Compression::ShuffledRle);
+                const std::vector<char> compressed = readBytes(file.path);
+                bytes = compressed;
+                storeAt<std::uint64_t>(bytes, getPlaneTableOffset(compressed) + planeStoredBytesField, 8);
+                checkRejected(bytes, "Compressed plane cut short");
+            });
+        }
+    }
+
+    void runCommonTests(TestRunner& runner)
+    {
+        testFrameArena(runner);
+        testPlaneFile(runner);
+    }
+}
+}
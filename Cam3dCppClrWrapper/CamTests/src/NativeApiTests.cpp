@@ -0,0 +1,233 @@
+#include "Test.hpp"
+#include <CamNativeApi/CamNativeApi.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cam3d
+{
+namespace tests
+{
+    namespace
+    {
+        // Random texture in [0, 1]; right view is left one shifted by 'shift' columns,
+        // so left pixel c matches right pixel c - shift
+        struct StereoPair
+        {
+            int rows;
+            int cols;
+            std::vector<double> left;
+            std::vector<double> right;
+
+            StereoPair(int rows_, int cols_, int shift) :
+                rows{ rows_ }, cols{ cols_ },
+                left(static_cast<std::size_t>(rows_) * cols_),
+                right(static_cast<std::size_t>(rows_) * cols_)
+            {
+                unsigned int state = 12345u;
+                for(double& value : left)
+                {
+                    state = state * 1664525u + 1013904223u;
+                    value = static_cast<double>(state >> 8) / static_cast<double>(1u << 24);
+                }
+                for(int r = 0; r < rows; ++r)
+                {
+                    for(int c = 0; c < cols; ++c)
+                    {
+                        int source = std::min(c + shift, cols - 1);
+                        right[r * cols + c] = left[r * cols + source];
+                    }
+                }
+            }
+
+            cam3d_image image(const std::vector<double>& data) const
+            {
+                return cam3d_image{ data.data(), rows, cols, static_cast<int64_t>(cols * sizeof(double)), nullptr, 0 };
+            }
+        };
+
+        struct Session
+        {
+            cam3d_session* session = nullptr;
+
+            explicit Session(int threads)
+            {
+                check(cam3d_session_create(threads, &session) == CAM3D_OK, "Session was not created");
+                check(session != nullptr, "Created session is null");
+            }
+            ~Session() { cam3d_session_destroy(session); }
+        };
+
+        std::string lastError(cam3d_session* session)
+        {
+            char message[256];
+            check(cam3d_session_get_last_error(session, message, sizeof(message)) == CAM3D_OK, "Last error was not read");
+            return message;
+        }
+
+        struct Output
+        {
+            std::vector<cam3d_disparity> left;
+            std::vector<float> disparity;
+            cam3d_output output;
+
+            Output(int rows, int cols) :
+                left(static_cast<std::size_t>(rows) * cols),
+                disparity(static_cast<std::size_t>(rows) * cols)
+            {
+                std::memset(&output, 0, sizeof(output));
+                output.left = left.data();
+                output.left_stride = static_cast<int64_t>(cols * sizeof(cam3d_disparity));
+                output.disparity = disparity.data();
+                output.disparity_stride = static_cast<int64_t>(cols * sizeof(float));
+            }
+        };
+
+        void testNativeApi(TestRunner& runner)
+        {
+            runner.run("NativeApi.Version", []()
+            {
+                check(cam3d_get_api_version() == CAM3D_API_VERSION, "Library and header versions differ");
+            });
+
+            runner.run("NativeApi.MatchFindsShift", []()
+            {
+                const int shift = 5;
+                StereoPair pair{ 40, 64, shift };
+                cam3d_match_params params;
+                cam3d_default_match_params(&params);
+                params.max_disparity = 16;
+                Output output{ pair.rows, pair.cols };
+                cam3d_image left = pair.image(pair.left);
+                cam3d_image right = pair.image(pair.right);
+
+                Session session{ 2 };
+                check(cam3d_match(session.session, &params, &left, &right, &output.output) == CAM3D_OK, "Match failed");
+                check(lastError(session.session).empty(), "Successful match left error");
+
+                double fraction = 0.0;
+                char state[64];
+                check(cam3d_session_get_progress(session.session, &fraction, state, sizeof(state)) == CAM3D_OK, "Progress was not read");
+                checkNear(fraction, 1.0, 0.0, "Progress after match");
+                check(std::string{ state } == "Done", "State after match is " + std::string{ state });
+
+                // Columns which have match in right view, away from borders of census window
+                int checkedCount = 0;
+                int correctCount = 0;
+                for(int r = 4; r < pair.rows - 4; ++r)
+                {
+                    for(int c = shift + 4; c < pair.cols - 4; ++c)
+                    {
+                        const cam3d_disparity& d = output.left[r * pair.cols + c];
+                        ++checkedCount;
+                        if(d.flags == CAM3D_DISPARITY_VALID && std::abs(d.sub_dx + shift) <= 1.0 &&
+                            std::abs(output.disparity[r * pair.cols + c] - d.sub_dx) < 1e-4)
+                        {
+                            ++correctCount;
+                        }
+                    }
+                }
+                check(correctCount >= checkedCount * 95 / 100,
+                    "Correct disparities: " + std::to_string(correctCount) + " of " + std::to_string(checkedCount));
+            });
+
+            runner.run("NativeApi.InvalidArgumentSetsLastError", []()
+            {
+                StereoPair pair{ 16, 32, 2 };
+                StereoPair otherPair{ 16, 24, 2 };
+                cam3d_match_params params;
+                cam3d_default_match_params(&params);
+                params.max_disparity = 8;
+                Output output{ pair.rows, pair.cols };
+                cam3d_image left = pair.image(pair.left);
+                cam3d_image right = otherPair.image(otherPair.right);
+
+                Session session{ 1 };
+                check(cam3d_match(session.session, &params, &left, &right, &output.output) == CAM3D_ERROR_INVALID_ARGUMENT,
+                    "Images of different sizes were accepted");
+                check(lastError(session.session) == "Images must have same size", "Unexpected error: " + lastError(session.session));
+
+                // Message is truncated to buffer
+                char shortMessage[7];
+                check(cam3d_session_get_last_error(session.session, shortMessage, sizeof(shortMessage)) == CAM3D_OK, "Last error was not read");
+                check(std::string{ shortMessage } == "Images", "Message was not truncated");
+
+                params.max_disparity = 0;
+                right = pair.image(pair.right);
+                check(cam3d_match(session.session, &params, &left, &right, &output.output) == CAM3D_ERROR_INVALID_ARGUMENT,
+                    "Zero max_disparity was accepted");
+                check(lastError(session.session) == "max_disparity must be positive", "Unexpected error: " + lastError(session.session));
+
+                // Next successful match clears error
+                params.max_disparity = 8;
+                check(cam3d_match(session.session, &params, &left, &right, &output.output) == CAM3D_OK, "Match failed");
+                check(lastError(session.session).empty(), "Error was not cleared");
+
+                char message[8];
+                check(cam3d_session_get_last_error(nullptr, message, sizeof(message)) == CAM3D_ERROR_INVALID_ARGUMENT, "Null session was accepted");
+                check(cam3d_session_get_last_error(session.session, message, 0) == CAM3D_ERROR_INVALID_ARGUMENT, "Empty buffer was accepted");
+                check(cam3d_match(session.session, nullptr, &left, &right, &output.output) == CAM3D_ERROR_INVALID_ARGUMENT, "Null parameters were accepted");
+                cam3d_session* created = nullptr;
+                check(cam3d_session_create(-1, &created) == CAM3D_ERROR_INVALID_ARGUMENT && created == nullptr, "Negative threads were accepted");
+            });
+
+            // Second match of busy session is refused, cancel stops running one and session stays usable
+            runner.run("NativeApi.BusyAndCancel", []()
+            {
+                StereoPair pair{ 240, 320, 8 };
+                cam3d_match_params params;
+                cam3d_default_match_params(&params);
+                Output output{ pair.rows, pair.cols };
+                cam3d_image left = pair.image(pair.left);
+                cam3d_image right = pair.image(pair.right);
+
+                Session session{ 2 };
+                std::atomic<int> status{ -1 };
+                std::thread matching{ [&]()
+                {
+                    status = cam3d_match(session.session, &params, &left, &right, &output.output);
+                } };
+
+                char state[64] = "Idle";
+                double fraction = 0.0;
+                while(std::string{ state } == "Idle" && status == -1)
+                {
+                    std::this_thread::yield();
+                    cam3d_session_get_progress(session.session, &fraction, state, sizeof(state));
+                }
+                cam3d_status busyStatus = cam3d_match(session.session, &params, &left, &right, &output.output);
+                while(status == -1)
+                {
+                    cam3d_session_cancel(session.session);
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+                matching.join();
+
+                check(busyStatus == CAM3D_ERROR_BUSY, "Second match of session was not refused");
+                check(status == CAM3D_ERROR_CANCELLED, "Match was not cancelled, status " + std::to_string(status));
+                check(lastError(session.session) == "Cancelled", "Unexpected error: " + lastError(session.session));
+
+                // Cancel of idle session does not affect next match
+                cam3d_session_cancel(session.session);
+                params.max_disparity = 16;
+                StereoPair smallPair{ 32, 48, 4 };
+                left = smallPair.image(smallPair.left);
+                right = smallPair.image(smallPair.right);
+                Output smallOutput{ smallPair.rows, smallPair.cols };
+                check(cam3d_match(session.session, &params, &left, &right, &smallOutput.output) == CAM3D_OK, "Match after cancel failed");
+                check(lastError(session.session).empty(), "Error was not cleared");
+            });
+        }
+    }
+
+    void runNativeApiTests(TestRunner& runner)
+    {
+        testNativeApi(runner);
+    }
+}
+}
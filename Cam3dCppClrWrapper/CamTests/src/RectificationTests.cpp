@@ -0,0 +1,323 @@
+#include "Test.hpp"
+#include <CamRectification/RemapCache.hpp>
+#include <CamRectification/RemapTable.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace cam3d
+{
+namespace tests
+{
+    namespace
+    {
+        Homography createRectification()
+        {
+            Homography h;
+            h.h[0][0] = 0.998; h.h[0][1] = 0.012; h.h[0][2] = -6.5;
+            h.h[1][0] = -0.011; h.h[1][1] = 1.003; h.h[1][2] = 4.25;
+            h.h[2][0] = 1.5e-4; h.h[2][1] = -2.0e-4; h.h[2][2] = 1.0;
+            return h;
+        }
+
+        // Exact bilinear sample of point in source coordinates, with pixel centres at (x + 0.5, y + 0.5),
+        // clamped at border pixels as RemapTable does
+        template<typename T>
+        double sampleBilinear(const Array2d<T>& source, Vector2f point)
+        {
+            int rows = source.getRowCount();
+            int cols = source.getColumnCount();
+            double u = std::min(std::max(point.x - 0.5, 0.0), cols - 1.0);
+            double v = std::min(std::max(point.y - 0.5, 0.0), rows - 1.0);
+            int x = std::min(static_cast<int>(u), cols - 2);
+            int y = std::min(static_cast<int>(v), rows - 2);
+            double fx = u - x;
+            double fy = v - y;
+            double top = source(y, x) + (static_cast<double>(source(y, x + 1)) - source(y, x)) * fx;
+            double bottom = source(y + 1, x) + (static_cast<double>(source(y + 1, x + 1)) - source(y + 1, x)) * fx;
+            return top + (bottom - top) * fy;
+        }
+
+        // Largest difference of horizontal (x) or vertical (y) neighbours, which bounds derivative of bilinear surface
+        template<typename T>
+        Vector2f findMaxSteps(const Array2d<T>& source)
+        {
+            Vector2f steps{ 0.0, 0.0 };
+            for(int r = 0; r < source.getRowCount(); ++r)
+            {
+                for(int c = 0; c < source.getColumnCount(); ++c)
+                {
+                    if(c > 0) { steps.x = std::max(steps.x, std::abs(static_cast<double>(source(r, c)) - source(r, c - 1))); }
+                    if(r > 0) { steps.y = std::max(steps.y, std::abs(static_cast<double>(source(r, c)) - source(r - 1, c))); }
+                }
+            }
+            return steps;
+        }
+
+        // Remapped value may differ from exact sample only by quantization of source point to 1/32 pixel
+        // (at most 1/64 in each direction), plus 'roundingError' of destination type
+        template<typename T>
+        void checkRemapError(const IImageTransformation& transformation, const Array2d<T>& source, double roundingError,
+            const std::string& name)
+        {
+            TransformedBounds bounds = findTransformedBounds(transformation, source.getRowCount(), source.getColumnCount());
+            RemapTable table{ transformation, bounds.rows, bounds.cols, source.getRowCount(), source.getColumnCount(), bounds.origin };
+            Array2d<T> destination{ bounds.rows, bounds.cols };
+            Array2d<char> mask{ bounds.rows, bounds.cols };
+            remap(source, destination, &mask, table);
+
+            Vector2f steps = findMaxSteps(source);
+            double maxError = (steps.x + steps.y) / (2.0 * RemapTable::fractionOne) + roundingError;
+            int mappedCount = 0;
+            for(int r = 0; r < bounds.rows; ++r)
+            {
+                for(int c = 0; c < bounds.cols; ++c)
+                {
+                    std::string pixel = name + ", pixel " + std::to_string(r) + ", " + std::to_string(c);
+                    Vector2f point = transformation.transformPointBackwards(bounds.origin + Vector2f{ c + 0.5, r + 0.5 });
+                    // Points at source border may be classified either way, as row of table is transformed incrementally
+                    double inside = std::min(std::min(point.x, source.getColumnCount() - point.x),
+                        std::min(point.y, source.getRowCount() - point.y));
+                    if(std::abs(inside) < 1e-6) { continue; }
+
+                    bool mapped = inside > 0.0;
+                    check(table.isMapped(r, c) == mapped && (mask(r, c) != 0) == mapped, "Wrong mapping of " + pixel);
+                    if(!mapped)
+                    {
+                        check(destination(r, c) == T(0), "Unmapped " + pixel + " is not 0");
+                        continue;
+                    }
+                    ++mappedCount;
+                    checkNear(static_cast<double>(destination(r, c)), sampleBilinear(source, point), maxError, pixel);
+                }
+            }
+            check(mappedCount > bounds.rows * bounds.cols / 2, name + ": most of transformed image should be mapped");
+        }
+
+        void testRemapTable(TestRunner& runner)
+        {
+            const int rows = 48;
+            const int cols = 64;
+            Array2d<double> grey{ rows, cols };
+            Array2d<float> greyFloat{ rows, cols };
+            Array2d<std::uint8_t> bytes{ rows, cols };
+            for(int r = 0; r < rows; ++r)
+            {
+                for(int c = 0; c < cols; ++c)
+                {
+                    double value = 0.5 + 0.25 * std::sin(r * 0.35) + 0.25 * std::cos(c * 0.27 + r * 0.1);
+                    grey(r, c) = value;
+                    greyFloat(r, c) = static_cast<float>(value);
+                    bytes(r, c) = static_cast<std::uint8_t>(std::lround(value * 255.0));
+                }
+            }
+
+            runner.run("RemapTable.BilinearErrorBound", [=]()
+            {
+                RectificationTransformation rectification{ createRectification() };
+                Rational3RDModel model{ 2e-3, 2.5e-3, 1e-7, cols * 0.5, rows * 0.5 };
+                RadialDistortionTransformation distortion{ model };
+                struct Mapping { const char* name; const IImageTransformation* transformation; };
+                for(Mapping mapping : { Mapping{ "homography", &rectification }, Mapping{ "distortion", &distortion } })
+                {
+                    std::string name = mapping.name;
+                    checkRemapError(*mapping.transformation, grey, 1e-12, name + " double");
+                    checkRemapError(*mapping.transformation, greyFloat, 1e-6, name + " float");
+                    // Fixed point result is rounded to integer
+                    checkRemapError(*mapping.transformation, bytes, 0.5 + 1e-9, name + " uint8");
+                }
+            });
+
+            runner.run("RemapTable.SetPoint", []()
+            {
+                RemapTable table{ 1, 4, 10, 20 };
+                table.setPoint(0, 0, Vector2f{ 3.5 + 17.0 / 32.0, 2.5 + 5.0 / 32.0 });
+                check(table.getSourceX()(0, 0) == 3 && table.getSourceY()(0, 0) == 2 &&
+                    table.getFractionX()(0, 0) == 17 && table.getFractionY()(0, 0) == 5, "Point is not split to pixel and fractions");
+                // Last pixel centre and beyond it: full weight of last column and row
+                table.setPoint(0, 1, Vector2f{ 19.9, 9.9 });
+                check(table.getSourceX()(0, 1) == 18 && table.getFractionX()(0, 1) == RemapTable::fractionOne &&
+                    table.getSourceY()(0, 1) == 8 && table.getFractionY()(0, 1) == RemapTable::fractionOne, "Border is not clamped");
+                table.setPoint(0, 2, Vector2f{ 20.0, 5.0 });
+                table.setPoint(0, 3, Vector2f{ std::nan(""), 5.0 });
+                check(table.isMapped(0, 0) && table.isMapped(0, 1) && !table.isMapped(0, 2) && !table.isMapped(0, 3),
+                    "Points outside of source must be unmapped");
+            });
+
+            runner.run("RemapTable.RejectsInvalidSizes", [=]()
+            {
+                checkThrows<std::invalid_argument>([]() { RemapTable table(4, 4, 1, 10); }, "Source of one row");
+                checkThrows<std::invalid_argument>([]() { RemapTable table(4, 4, 10, 40000); }, "Source too wide");
+                RemapTable table{ rows, cols, rows, cols };
+                Array2d<double> destination{ rows, cols + 1 };
+                checkThrows<std::invalid_argument>([&]() { remap(grey, destination, nullptr, table); }, "Destination of other size");
+                Array2d<double> fitting{ rows, cols };
+                Array2d<char> mask{ rows - 1, cols };
+                checkThrows<std::invalid_argument>([&]() { remap(grey, fitting, &mask, table); }, "Mask of other size");
+            });
+        }
+
+        struct TemporaryFile
+        {
+            std::string path;
+
+            explicit TemporaryFile(const std::string& path_) : path{ path_ } { std::remove(path.c_str()); }
+            ~TemporaryFile() { std::remove(path.c_str()); }
+        };
+
+        template<typename T>
+        bool areEqual(const Array2d<T>& a, const Array2d<T>& b)
+        {
+            if(a.getRowCount() != b.getRowCount() || a.getColumnCount() != b.getColumnCount()) { return false; }
+            for(int r = 0; r < a.getRowCount(); ++r)
+            {
+                if(!std::equal(a.getRow(r), a.getRow(r) + a.getColumnCount(), b.getRow(r))) { return false; }
+            }
+            return true;
+        }
+
+        bool areEqual(const RemapTable& a, const RemapTable& b)
+        {
+            return a.getSourceRowCount() == b.getSourceRowCount() && a.getSourceColumnCount() == b.getSourceColumnCount() &&
+                areEqual(a.getSourceX(), b.getSourceX()) && areEqual(a.getSourceY(), b.getSourceY()) &&
+                areEqual(a.getFractionX(), b.getFractionX()) && areEqual(a.getFractionY(), b.getFractionY());
+        }
+
+        // Calibration of table and sizes, each changed by tests below
+        struct CacheInputs
+        {
+            Rational3RDModel model{ 2e-3, 2.5e-3, 1e-7, 32.0, 24.0 };
+            Homography rectification = createRectification();
+            int rows = 50;
+            int cols = 70;
+            int sourceRows = 48;
+            int sourceCols = 64;
+            Vector2f origin{ -3.0, -1.0 };
+
+            std::uint64_t getKey() const
+            {
+                return getRemapCacheKey(model, rectification, rows, cols, sourceRows, sourceCols, origin);
+            }
+
+            io::Loaded<RemapTable> getTable(const std::string& path) const
+            {
+                return getUndistortRectifyTable(path, model, rectification, rows, cols, sourceRows, sourceCols, origin);
+            }
+        };
+
+        void testRemapCache(TestRunner& runner)
+        {
+            runner.run("RemapCache.KeyCoversAllInputs", []()
+            {
+                const CacheInputs base;
+                check(base.getKey() == CacheInputs{}.getKey(), "Key of same inputs differs");
+
+                std::vector<CacheInputs> changed(14, base);
+                changed[0].model.k1 *= 1.0 + 1e-12;
+                changed[1].model.k2 = 0.0;
+                changed[2].model.k3 = -1e-7;
+                changed[3].model.center.x += 0.5;
+                changed[4].model.center.y -= 0.5;
+                changed[5].model.imageScale = 0.5;
+                changed[6].rectification.h[0][2] += 1e-9;
+                changed[7].rectification.h[2][1] = 0.0;
+                changed[8].rows += 1;
+                changed[9].cols -= 1;
+                changed[10].sourceRows += 2;
+                changed[11].sourceCols += 2;
+                changed[12].origin.x += 0.25;
+                changed[13].origin.y += 0.25;
+                for(std::size_t i = 0; i < changed.size(); ++i)
+                {
+                    check(changed[i].getKey() != base.getKey(), "Key does not depend on input " + std::to_string(i));
+                }
+
+                // Other model with same coefficients
+                Taylor4Model taylor{ 2e-3, 2.5e-3, 1e-7, 0.0, 32.0, 24.0 };
+                Taylor4Model taylorChanged = taylor;
+                taylorChanged.k4 = 1e-9;
+                check(getRemapCacheKey(taylor, base.rectification, base.rows, base.cols, base.sourceRows, base.sourceCols, base.origin) !=
+                    getRemapCacheKey(taylorChanged, base.rectification, base.rows, base.cols, base.sourceRows, base.sourceCols, base.origin),
+                    "Key does not depend on last coefficient of Taylor4");
+                check(getRemapCacheKey(taylor, base.rectification, base.rows, base.cols, base.sourceRows, base.sourceCols, base.origin) !=
+                    base.getKey(), "Key does not depend on model name");
+            });
+
+            runner.run("RemapCache.ReadsOnlyMatchingKey", []()
+            {
+                TemporaryFile file{ "RemapCache.key.test.tmp" };
+                CacheInputs inputs;
+                UndistortRectifyTransformation transformation{ inputs.model, inputs.rectification };
+                RemapTable table{ transformation, inputs.rows, inputs.cols, inputs.sourceRows, inputs.sourceCols, inputs.origin };
+                writeRemapTable(file.path, table, inputs.getKey());
+
+                io::Loaded<RemapTable> loaded;
+                check(tryReadRemapTable(file.path, inputs.getKey(), loaded), "Table of same key was not read");
+                check(loaded.file != nullptr, "Cached table is not mapped");
+                check(areEqual(loaded.value, table), "Cached table differs");
+
+                io::Loaded<RemapTable> stale;
+                check(!tryReadRemapTable(file.path, inputs.getKey() + 1, stale), "Table of other key was read");
+                check(!tryReadRemapTable(file.path + ".missing", inputs.getKey(), stale), "Missing file was read");
+                {
+                    std::ofstream garbage{ file.path, std::ios::binary | std::ios::trunc };
+                    garbage << "not a remap table";
+                }
+                check(!tryReadRemapTable(file.path, inputs.getKey(), stale), "Damaged file was read");
+
+                // Header as written by writeRemapTable(), of other version
+                struct Header
+                {
+                    std::uint32_t version;
+                    std::uint32_t fractionBits;
+                    std::uint64_t key;
+                    std::int32_t sourceRows;
+                    std::int32_t sourceCols;
+                } header;
+                std::memset(&header, 0, sizeof(header));
+                header.version = remapCacheVersion + 1;
+                header.fractionBits = RemapTable::fractionBits;
+                header.key = inputs.getKey();
+                header.sourceRows = inputs.sourceRows;
+                header.sourceCols = inputs.sourceCols;
+                io::PlaneFileWriter writer{ file.path, 1 };
+                writer.writePlane("remap_header", io::ElementType::UInt8, 1, static_cast<int>(sizeof(header)), 1, &header, sizeof(header));
+                writer.close();
+                check(!tryReadRemapTable(file.path, inputs.getKey(), stale), "Table of other version was read");
+            });
+
+            runner.run("RemapCache.RebuildsOnCalibrationChange", []()
+            {
+                TemporaryFile file{ "RemapCache.rebuild.test.tmp" };
+                CacheInputs inputs;
+                io::Loaded<RemapTable> built = inputs.getTable(file.path);
+                check(built.file == nullptr, "First table was not built");
+                io::Loaded<RemapTable> cached = inputs.getTable(file.path);
+                check(cached.file != nullptr, "Second table was not read from cache");
+                check(areEqual(cached.value, built.value), "Cached table differs from built one");
+
+                inputs.model.k1 *= 1.5;
+                io::Loaded<RemapTable> rebuilt = inputs.getTable(file.path);
+                check(rebuilt.file == nullptr, "Table of changed calibration was read from cache");
+                check(!areEqual(rebuilt.value, built.value), "Table of changed calibration did not change");
+                UndistortRectifyTransformation transformation{ inputs.model, inputs.rectification };
+                RemapTable expected{ transformation, inputs.rows, inputs.cols, inputs.sourceRows, inputs.sourceCols, inputs.origin };
+                check(areEqual(rebuilt.value, expected), "Rebuilt table differs from new one");
+                check(inputs.getTable(file.path).file != nullptr, "Rebuilt table was not cached");
+            });
+        }
+    }
+
+    void runRectificationTests(TestRunner& runner)
+    {
+        testRemapTable(runner);
+        testRemapCache(runner);
+    }
+}
+}
@@ -0,0 +1,184 @@
+#include "Test.hpp"
+#include <CamCommon/ThreadPool.hpp>
+#include <CamDisparityRefinement/PeakRemovalRefiner.hpp>
+#include <CamDisparityRefinement/SegmentLabels.hpp>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace cam3d
+{
+namespace tests
+{
+    namespace
+    {
+        // Patches of close disparities with jumps between them, noise and invalid pixels,
+        // so that segments have irregular shapes and cross strip boundaries
+        DisparityMap createPatchyMap(int rows, int cols, unsigned int seed)
+        {
+            std::mt19937 random{ seed };
+            std::uniform_real_distribution<double> noise{ -0.6, 0.6 };
+            std::uniform_int_distribution<int> percent{ 0, 99 };
+            DisparityMap map{ rows, cols };
+            for(int r = 0; r < rows; ++r)
+            {
+                for(int c = 0; c < cols; ++c)
+                {
+                    double base = -10.0 - 5.0 * (((r / 7) * 3 + (c / 9)) % 4);
+                    double subDx = base + noise(random);
+                    map(r, c) = percent(random) < 15 ?
+                        Disparity{ 0, Disparity::Invalid } :
+                        Disparity{ static_cast<int>(std::lround(subDx)), Disparity::Valid, subDx, 0.0, 1.0 };
+                }
+            }
+            return map;
+        }
+
+        // Flood fill from pixels in raster order, so that label is first pixel of segment
+        SegmentLabels labelByFloodFill(const DisparityMap& map, double maxDiff)
+        {
+            int rows = map.getRowCount();
+            int cols = map.getColumnCount();
+            SegmentLabels segments;
+            segments.labels.assign(static_cast<std::size_t>(rows) * cols, noSegment);
+            segments.sizes.assign(static_cast<std::size_t>(rows) * cols, 0);
+            std::vector<int> stack;
+            for(int start = 0; start < rows * cols; ++start)
+            {
+                if(segments.labels[start] != noSegment || !isValid(map(start / cols, start % cols))) { continue; }
+                segments.labels[start] = start;
+                stack.push_back(start);
+                while(!stack.empty())
+                {
+                    int i = stack.back();
+                    stack.pop_back();
+                    ++segments.sizes[start];
+                    int r = i / cols;
+                    int c = i % cols;
+                    const int neighbours[4][2] = { { r - 1, c }, { r + 1, c }, { r, c - 1 }, { r, c + 1 } };
+                    for(const auto& n : neighbours)
+                    {
+                        if(n[0] < 0 || n[0] >= rows || n[1] < 0 || n[1] >= cols) { continue; }
+                        int j = n[0] * cols + n[1];
+                        const Disparity& d = map(n[0], n[1]);
+                        if(segments.labels[j] == noSegment && isValid(d) && std::abs(d.subDx - map(r, c).subDx) <= maxDiff)
+                        {
+                            segments.labels[j] = start;
+                            stack.push_back(j);
+                        }
+                    }
+                }
+            }
+            return segments;
+        }
+
+        // Fills 'height' x 'width' rectangle at ('row', 'col') with valid disparity 'subDx'
+        void addPatch(DisparityMap& map, int row, int col, int height, int width, double subDx)
+        {
+            for(int r = row; r < row + height; ++r)
+            {
+                for(int c = col; c < col + width; ++c)
+                {
+                    map(r, c) = Disparity{ static_cast<int>(std::lround(subDx)), Disparity::Valid, subDx, 0.0, 1.0 };
+                }
+            }
+        }
+
+        void testSegmentLabels(TestRunner& runner)
+        {
+            // Labels must not depend on how rows are split into strips
+            runner.run("SegmentLabels.MatchFloodFill", []()
+            {
+                const double maxDiff = 1.0;
+                ThreadPool pool{ 3 };
+                for(unsigned int seed : { 1u, 2u, 3u })
+                {
+                    DisparityMap map = createPatchyMap(61, 47, seed);
+                    SegmentLabels expected = labelByFloodFill(map, maxDiff);
+                    for(int grainRows : { 1, 2, 5, 61, 0 })
+                    {
+                        ParallelForOptions options;
+                        options.pool = &pool;
+                        options.maxTasks = 4;
+                        options.grainRows = grainRows;
+                        SegmentLabels segments;
+                        labelSegments(map, maxDiff, segments, options);
+
+                        std::string context = "seed " + std::to_string(seed) + ", grain " + std::to_string(grainRows);
+                        check(segments.labels == expected.labels, "Labels differ, " + context);
+                        for(std::size_t i = 0; i < expected.labels.size(); ++i)
+                        {
+                            check(segments.getSize(static_cast<int>(i)) == expected.getSize(static_cast<int>(i)),
+                                "Size differs at " + std::to_string(i) + ", " + context);
+                        }
+                    }
+                }
+            });
+
+            runner.run("SegmentLabels.ReusedBuffers", []()
+            {
+                SegmentLabels segments;
+                labelSegments(createPatchyMap(30, 40, 4), 1.0, segments);
+                DisparityMap map = createPatchyMap(20, 25, 5);
+                labelSegments(map, 1.0, segments);
+                check(segments.labels == labelByFloodFill(map, 1.0).labels, "Labels differ after reuse");
+            });
+        }
+
+        void testPeakRemoval(TestRunner& runner)
+        {
+            runner.run("PeakRemoval.RemovesSmallSegments", []()
+            {
+                DisparityMap map{ 20, 30 };
+                addPatch(map, 0, 0, 20, 30, -10.0);
+                addPatch(map, 2, 2, 1, 5, -20.0);  // 5 pixels, removed
+                addPatch(map, 6, 2, 2, 3, -20.0);  // 6 pixels, kept
+                addPatch(map, 12, 12, 1, 1, -4.0); // 1 pixel, removed
+                addPatch(map, 15, 20, 1, 2, -9.0); // Connected to background, kept
+
+                PeakRemovalRefiner refiner;
+                refiner.minSegmentSize = 6;
+                refiner.maxDisparityDiff = 2.0;
+                refiner.refineMap(map, ParallelForOptions{});
+
+                for(int r = 0; r < 20; ++r)
+                {
+                    for(int c = 0; c < 30; ++c)
+                    {
+                        bool removed = (r == 2 && c >= 2 && c < 7) || (r == 12 && c == 12);
+                        check(isValid(map(r, c)) == !removed, "Pixel " + std::to_string(r) + ", " + std::to_string(c) +
+                            (removed ? " was not removed" : " was removed"));
+                    }
+                }
+                checkNear(map(6, 2).subDx, -20.0, 0.0, "Kept segment");
+                checkNear(map(15, 21).subDx, -9.0, 0.0, "Kept pixel connected to background");
+            });
+
+            runner.run("PeakRemoval.InterpolatesRemoved", []()
+            {
+                DisparityMap map{ 10, 10 };
+                addPatch(map, 0, 0, 10, 5, -10.0);
+                addPatch(map, 0, 5, 10, 5, -11.0);
+                addPatch(map, 4, 2, 1, 1, -30.0); // Inside one surface
+                addPatch(map, 0, 0, 1, 1, -30.0); // On border - not interpolated
+
+                PeakRemovalRefiner refiner;
+                refiner.interpolateInvalidated = true;
+                refiner.refineMap(map, ParallelForOptions{});
+
+                check(isValid(map(4, 2)), "Removed pixel was not interpolated");
+                checkNear(map(4, 2).subDx, -10.0, 1e-12, "Interpolated disparity");
+                check(map(4, 2).dx == -10, "Integer disparity is not rounded interpolated one");
+                check(!isValid(map(0, 0)), "Border pixel was interpolated");
+            });
+        }
+    }
+
+    void runRefinementTests(TestRunner& runner)
+    {
+        testSegmentLabels(runner);
+        testPeakRemoval(runner);
+    }
+}
+}
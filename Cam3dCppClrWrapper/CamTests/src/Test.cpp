@@ -0,0 +1,37 @@
+#include "Test.hpp"
+#include <iostream>
+
+namespace cam3d
+{
+namespace tests
+{
+    void TestRunner::run(const std::string& name, std::function<void()> fun)
+    {
+        if(!isEnabled(name))
+        {
+            return;
+        }
+        try
+        {
+            fun();
+            ++passedCount;
+            std::cerr << "[ OK ] " << name << "\n";
+        }
+        catch(const std::exception& e)
+        {
+            ++failedCount;
+            std::cerr << "[FAIL] " << name << ": " << e.what() << "\n";
+        }
+        catch(...)
+        {
+            ++failedCount;
+            std::cerr << "[FAIL] " << name << ": unknown exception\n";
+        }
+    }
+
+    void TestRunner::writeSummary(std::ostream& stream) const
+    {
+        stream << passedCount << " passed, " << failedCount << " failed\n";
+    }
+}
+}
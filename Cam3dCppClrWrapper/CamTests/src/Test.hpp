@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cmath>
+#include <functional>
+#include <iosfwd>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace cam3d
+{
+namespace tests
+{
+    struct TestConfig
+    {
+        std::string filter;
+    };
+
+    class TestFailure : public std::runtime_error
+    {
+    public:
+        TestFailure(const std::string& message) : std::runtime_error{ message } { }
+    };
+
+    // Throws TestFailure with 'message' if 'condition' is false
+    inline void check(bool condition, const std::string& message)
+    {
+        if(!condition)
+        {
+            throw TestFailure(message);
+        }
+    }
+
+    inline void checkNear(double actual, double expected, double tolerance, const std::string& message)
+    {
+        if(!(std::abs(actual - expected) <= tolerance))
+        {
+            std::ostringstream text;
+            text << message << ": expected " << expected << " +- " << tolerance << ", got " << actual;
+            throw TestFailure(text.str());
+        }
+    }
+
+    // Calls 'fun' and fails if it does not throw 'Exception'
+    template<typename Exception, typename Function>
+    void checkThrows(Function fun, const std::string& message)
+    {
+        try
+        {
+            fun();
+        }
+        catch(const Exception&)
+        {
+            return;
+        }
+        throw TestFailure(message + ": expected exception was not thrown");
+    }
+
+    class TestRunner
+    {
+        const TestConfig& config;
+        int passedCount = 0;
+        int failedCount = 0;
+
+    public:
+        TestRunner(const TestConfig& config_) : config{ config_ } { }
+
+        bool isEnabled(const std::string& name) const
+        {
+            return config.filter.empty() || name.find(config.filter) != std::string::npos;
+        }
+
+        // Runs 'fun' if 'name' matches filter; test fails if it throws anything
+        void run(const std::string& name, std::function<void()> fun);
+
+        int getPassedCount() const { return passedCount; }
+        int getFailedCount() const { return failedCount; }
+        void writeSummary(std::ostream& stream) const;
+    };
+
+    void runCommonTests(TestRunner& runner);
+    void runNativeApiTests(TestRunner& runner);
+    void runRefinementTests(TestRunner& runner);
+    void runRectificationTests(TestRunner& runner);
+    void runTriangulationTests(TestRunner& runner);
+}
+}
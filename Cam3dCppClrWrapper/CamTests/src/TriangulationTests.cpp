@@ -0,0 +1,342 @@
+#include "Test.hpp"
+#include <CamCommon/ThreadPool.hpp>
+#include <CamTriangulation/DenseTriangulation.hpp>
+#include <CamTriangulation/OptimalTriangulation.hpp>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace cam3d
+{
+namespace tests
+{
+    namespace
+    {
+        struct Point
+        {
+            double x, y, z;
+        };
+
+        // Rectified rig: right camera is moved by baseline along x, both look along z, y is up
+        struct RectifiedRig
+        {
+            RectifiedStereoParameters parameters{ 800.0, 0.2, 40.5, 30.25, 32.0 };
+
+            Vector2f projectLeft(const Point& p) const
+            {
+                return Vector2f{ parameters.principalX + parameters.focalLength * p.x / p.z,
+                    parameters.principalY - parameters.focalLength * p.y / p.z };
+            }
+
+            Vector2f projectRight(const Point& p) const
+            {
+                return Vector2f{ parameters.principalXRight + parameters.focalLength * (p.x - parameters.baseline) / p.z,
+                    parameters.principalY - parameters.focalLength * p.y / p.z };
+            }
+
+            // Point seen at left pixel (c, r) at depth 'z'
+            Point getPoint(int r, int c, double z) const
+            {
+                return Point{ z * (c - parameters.principalX) / parameters.focalLength,
+                    -z * (r - parameters.principalY) / parameters.focalLength, z };
+            }
+        };
+
+        // Slanted surface; with 'integerDisparities' depth is moved so that disparity is integer
+        DisparityMap createSceneMap(const RectifiedRig& rig, int rows, int cols, bool integerDisparities)
+        {
+            DisparityMap map{ rows, cols };
+            for(int r = 0; r < rows; ++r)
+            {
+                for(int c = 0; c < cols; ++c)
+                {
+                    Point p = rig.getPoint(r, c, 4.0 + 0.05 * r + 0.02 * c);
+                    double subDx = rig.projectRight(p).x - c;
+                    if(integerDisparities) { subDx = std::round(subDx); }
+                    map(r, c) = Disparity{ static_cast<int>(std::lround(subDx)), Disparity::Valid, subDx, 0.1, 0.5 + 0.001 * c };
+                }
+            }
+            return map;
+        }
+
+        // Pixel (r, c) of cloud must be triangulated point of its disparity: reprojected into left camera
+        // it falls on (c, r), into right one on (c + subDx, r)
+        void checkReprojection(const RectifiedRig& rig, const DisparityMap& map, const DensePointCloud& cloud, double maxError)
+        {
+            for(int r = 0; r < map.getRowCount(); ++r)
+            {
+                for(int c = 0; c < map.getColumnCount(); ++c)
+                {
+                    std::string pixel = "pixel " + std::to_string(r) + ", " + std::to_string(c);
+                    check(cloud.mask(r, c) != 0, "No point at " + pixel);
+                    Point p{ cloud.x(r, c), cloud.y(r, c), cloud.z(r, c) };
+                    Vector2f left = rig.projectLeft(p);
+                    Vector2f right = rig.projectRight(p);
+                    checkNear(left.x, c, maxError, "Left x of " + pixel);
+                    checkNear(left.y, r, maxError, "Left y of " + pixel);
+                    checkNear(right.x, c + map(r, c).subDx, maxError, "Right x of " + pixel);
+                    checkNear(right.y, r, maxError, "Right y of " + pixel);
+                }
+            }
+        }
+
+        void testDenseTriangulation(TestRunner& runner)
+        {
+            const int rows = 45;
+            const int cols = 70;
+            const RectifiedRig rig;
+
+            runner.run("DenseTriangulation.ReprojectsOntoMatches", [=]()
+            {
+                DisparityMap map = createSceneMap(rig, rows, cols, false);
+                DenseTriangulator triangulator{ rig.parameters, 256 };
+                DensePointCloud cloud;
+                triangulator.triangulate(map, nullptr, cloud);
+                check(cloud.pointCount == rows * cols && !cloud.hasColor(), "Wrong point count or colour");
+                // Cloud is stored in floats: 1e-3 pixel is ~1e-7 relative error of coordinates
+                checkReprojection(rig, map, cloud, 1e-3);
+
+                Point expected = rig.getPoint(10, 20, 4.0 + 0.05 * 10 + 0.02 * 20);
+                checkNear(cloud.z(10, 20), expected.z, 1e-5, "Depth of known point");
+                checkNear(cloud.x(10, 20), expected.x, 1e-5, "X of known point");
+                checkNear(cloud.y(10, 20), expected.y, 1e-5, "Y of known point");
+            });
+
+            runner.run("DenseTriangulation.TabulatedIntegerDisparities", [=]()
+            {
+                DisparityMap map = createSceneMap(rig, rows, cols, true);
+                DenseTriangulator triangulator{ rig.parameters, 256 };
+                triangulator.useSubpixel = false;
+                DensePointCloud cloud;
+                triangulator.triangulate(map, nullptr, cloud);
+                checkReprojection(rig, map, cloud, 1e-3);
+            });
+
+            runner.run("DenseTriangulation.SkipsPixelsWithoutPoint", [=]()
+            {
+                DisparityMap map = createSceneMap(rig, rows, cols, false);
+                map(1, 2).flags = Disparity::Invalid;
+                map(3, 4).flags = Disparity::Occluded;
+                // Disparity pointing away from right camera - point behind cameras
+                double behind = rig.parameters.principalXRight - rig.parameters.principalX + 5.0;
+                map(5, 6) = Disparity{ static_cast<int>(behind), Disparity::Valid, behind, 0.1, 0.5 };
+                // Point at depth 100, beyond maxDepth
+                Point far = rig.getPoint(7, 8, 100.0);
+                double farDx = rig.projectRight(far).x - 8;
+                map(7, 8) = Disparity{ static_cast<int>(std::lround(farDx)), Disparity::Valid, farDx, 0.1, 0.5 };
+
+                ColorImage color{ rows, cols };
+                for(int r = 0; r < rows; ++r)
+                {
+                    for(int c = 0; c < cols; ++c)
+                    {
+                        color(r, c, 0) = 0.1;
+                        color(r, c, 1) = 0.2;
+                        color(r, c, 2) = 0.3 + 0.001 * c;
+                    }
+                }
+
+                DenseTriangulator triangulator{ rig.parameters, 256 };
+                triangulator.maxDepth = 50.0f;
+                DensePointCloud cloud;
+                triangulator.triangulate(map, &color, cloud);
+
+                check(cloud.pointCount == rows * cols - 4, "Wrong point count " + std::to_string(cloud.pointCount));
+                int rowSum = 0;
+                for(int r = 0; r < rows; ++r) { rowSum += cloud.rowPointCounts[r]; }
+                check(rowSum == cloud.pointCount && cloud.rowPointCounts[1] == cols - 1, "Wrong row point counts");
+                const int skipped[4][2] = { { 1, 2 }, { 3, 4 }, { 5, 6 }, { 7, 8 } };
+                for(const auto& pixel : skipped)
+                {
+                    std::string name = "pixel " + std::to_string(pixel[0]) + ", " + std::to_string(pixel[1]);
+                    check(cloud.mask(pixel[0], pixel[1]) == 0, "Point at " + name);
+                    check(std::isnan(cloud.x(pixel[0], pixel[1])) && std::isnan(cloud.z(pixel[0], pixel[1])), "Coordinates of " + name + " are not NaN");
+                }
+                check(cloud.hasColor(), "Colour planes are missing");
+                checkNear(cloud.red(10, 10), 0.1, 1e-6, "Red");
+                checkNear(cloud.green(10, 10), 0.2, 1e-6, "Green");
+                checkNear(cloud.blue(10, 10), 0.31, 1e-6, "Blue");
+                checkNear(cloud.confidence(10, 10), 0.51, 1e-6, "Confidence");
+
+                DisparityMap smaller{ rows - 1, cols };
+                checkThrows<std::invalid_argument>([&]() { triangulator.triangulate(smaller, &color, cloud); }, "Image of other size");
+            });
+
+            runner.run("DenseTriangulation.RejectsInvalidRig", [=]()
+            {
+                RectifiedStereoParameters noBaseline = rig.parameters;
+                noBaseline.baseline = 0.0;
+                checkThrows<std::invalid_argument>([&]() { DenseTriangulator triangulator(noBaseline, 64); }, "Zero baseline");
+                RectifiedStereoParameters noFocal = rig.parameters;
+                noFocal.focalLength = -1.0;
+                checkThrows<std::invalid_argument>([&]() { DenseTriangulator triangulator(noFocal, 64); }, "Negative focal length");
+            });
+        }
+
+        // P = K[R|t] with R rotating by 'yaw' about y axis
+        CameraMatrix createCamera(double focalLength, double principalX, double principalY, double yaw, double tx, double tz)
+        {
+            double c = std::cos(yaw), s = std::sin(yaw);
+            double rt[3][4] = { { c, 0.0, s, tx }, { 0.0, 1.0, 0.0, 0.0 }, { -s, 0.0, c, tz } };
+            double k[3][3] = { { focalLength, 0.0, principalX }, { 0.0, focalLength, principalY }, { 0.0, 0.0, 1.0 } };
+            CameraMatrix camera;
+            for(int i = 0; i < 3; ++i)
+            {
+                for(int j = 0; j < 4; ++j)
+                {
+                    camera.p[i][j] = k[i][0] * rt[0][j] + k[i][1] * rt[1][j] + k[i][2] * rt[2][j];
+                }
+            }
+            return camera;
+        }
+
+        Vector2f project(const CameraMatrix& camera, const Point& point)
+        {
+            const double (&p)[3][4] = camera.p;
+            double w = p[2][0] * point.x + p[2][1] * point.y + p[2][2] * point.z + p[2][3];
+            return Vector2f{ (p[0][0] * point.x + p[0][1] * point.y + p[0][2] * point.z + p[0][3]) / w,
+                (p[1][0] * point.x + p[1][1] * point.y + p[1][2] * point.z + p[1][3]) / w };
+        }
+
+        double distance(Vector2f a, Vector2f b)
+        {
+            return std::sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y));
+        }
+
+        // Distance of 'right' from epipolar line of 'left', in pixels
+        double getEpipolarDistance(const OptimalTriangulator& triangulator, Vector2f left, Vector2f right)
+        {
+            double line[3];
+            for(int i = 0; i < 3; ++i)
+            {
+                line[i] = triangulator.getFundamental(i, 0) * left.x + triangulator.getFundamental(i, 1) * left.y + triangulator.getFundamental(i, 2);
+            }
+            return std::abs(line[0] * right.x + line[1] * right.y + line[2]) / std::sqrt(line[0] * line[0] + line[1] * line[1]);
+        }
+
+        // Scene in front of both cameras of general (not rectified) rig
+        struct GeneralRig
+        {
+            CameraMatrix left = createCamera(900.0, 320.0, 240.0, 0.0, 0.0, 0.0);
+            CameraMatrix right = createCamera(920.0, 310.0, 250.0, -0.08, -0.3, 0.03);
+            std::vector<Point> points;
+            std::vector<Vector2f> leftPoints;
+            std::vector<Vector2f> rightPoints;
+
+            // Projections of points with normal noise of 'noise' pixels
+            GeneralRig(int count, double noise)
+            {
+                std::mt19937 generator{ 29 };
+                std::uniform_real_distribution<double> uniform{ -1.0, 1.0 };
+                std::normal_distribution<double> normal{ 0.0, 1.0 };
+                for(int i = 0; i < count; ++i)
+                {
+                    double z = 3.0 + 1.5 * uniform(generator);
+                    Point p{ 0.4 * z * uniform(generator), 0.3 * z * uniform(generator), z };
+                    Vector2f l = project(left, p);
+                    Vector2f r = project(right, p);
+                    points.push_back(p);
+                    leftPoints.push_back(Vector2f{ l.x + noise * normal(generator), l.y + noise * normal(generator) });
+                    rightPoints.push_back(Vector2f{ r.x + noise * normal(generator), r.y + noise * normal(generator) });
+                }
+            }
+
+            std::vector<TriangulatedPoint> triangulate(const OptimalTriangulator& triangulator, const ParallelForOptions& options) const
+            {
+                std::vector<TriangulatedPoint> result(points.size());
+                triangulator.triangulate(leftPoints.data(), rightPoints.data(), static_cast<int>(points.size()), result.data(), options);
+                return result;
+            }
+        };
+
+        void testOptimalTriangulation(TestRunner& runner)
+        {
+            // Count is not multiple of lanes, so that last group is partial
+            const int count = 203;
+
+            runner.run("OptimalTriangulation.ExactMatchesGiveKnownPoints", [=]()
+            {
+                GeneralRig rig{ count, 0.0 };
+                OptimalTriangulator triangulator{ rig.left, rig.right };
+                std::vector<TriangulatedPoint> result = rig.triangulate(triangulator, ParallelForOptions{});
+                for(int i = 0; i < count; ++i)
+                {
+                    std::string name = "point " + std::to_string(i);
+                    const TriangulatedPoint& t = result[i];
+                    const Point& p = rig.points[i];
+                    double tolerance = 1e-6 * p.z;
+                    checkNear(t.x, p.x, tolerance, "X of " + name);
+                    checkNear(t.y, p.y, tolerance, "Y of " + name);
+                    checkNear(t.z, p.z, tolerance, "Z of " + name);
+                    checkNear(t.error, 0.0, 1e-5, "Error of " + name);
+                    checkNear(distance(project(rig.left, Point{ t.x, t.y, t.z }), rig.leftPoints[i]), 0.0, 1e-5, "Left reprojection of " + name);
+                    checkNear(distance(project(rig.right, Point{ t.x, t.y, t.z }), rig.rightPoints[i]), 0.0, 1e-5, "Right reprojection of " + name);
+                }
+            });
+
+            // Corrected points lie on corresponding epipolar lines, triangulated point projects onto them and they
+            // are not farther from measured ones than true projections, which satisfy epipolar constraint too
+            runner.run("OptimalTriangulation.NoisyMatchesAreCorrectedOptimally", [=]()
+            {
+                GeneralRig rig{ count, 0.5 };
+                OptimalTriangulator triangulator{ rig.left, rig.right };
+                ThreadPool pool{ 3 };
+                ParallelForOptions options;
+                options.pool = &pool;
+                options.maxTasks = 4;
+                options.grainRows = 1;
+                std::vector<TriangulatedPoint> result = rig.triangulate(triangulator, options);
+
+                double meanDepthError = 0.0;
+                for(int i = 0; i < count; ++i)
+                {
+                    std::string name = "point " + std::to_string(i);
+                    const TriangulatedPoint& t = result[i];
+                    check(!std::isnan(t.x) && !std::isnan(t.y) && !std::isnan(t.z), "No point for " + name);
+
+                    checkNear(getEpipolarDistance(triangulator, t.left, t.right), 0.0, 1e-6, "Epipolar distance of " + name);
+                    Point triangulated{ t.x, t.y, t.z };
+                    checkNear(distance(project(rig.left, triangulated), t.left), 0.0, 1e-6, "Left reprojection of " + name);
+                    checkNear(distance(project(rig.right, triangulated), t.right), 0.0, 1e-6, "Right reprojection of " + name);
+
+                    double leftError = distance(t.left, rig.leftPoints[i]);
+                    double rightError = distance(t.right, rig.rightPoints[i]);
+                    checkNear(t.error, std::sqrt(leftError * leftError + rightError * rightError), 1e-9, "Error of " + name);
+                    Vector2f trueLeft = project(rig.left, rig.points[i]);
+                    Vector2f trueRight = project(rig.right, rig.points[i]);
+                    double trueLeftError = distance(trueLeft, rig.leftPoints[i]);
+                    double trueRightError = distance(trueRight, rig.rightPoints[i]);
+                    check(t.error <= std::sqrt(trueLeftError * trueLeftError + trueRightError * trueRightError) + 1e-9,
+                        "Correction of " + name + " is not optimal");
+                    meanDepthError += std::abs(t.z - rig.points[i].z) / count;
+                }
+                // Disparity is 270 / z pixels, so half pixel noise in each view moves depth by ~2 cm on average
+                check(meanDepthError < 0.04, "Mean depth error " + std::to_string(meanDepthError));
+
+                // Parallel groups give same points as one thread
+                std::vector<TriangulatedPoint> sequential = rig.triangulate(triangulator, ParallelForOptions{ nullptr, 1 });
+                for(int i = 0; i < count; ++i)
+                {
+                    check(sequential[i].x == result[i].x && sequential[i].y == result[i].y && sequential[i].z == result[i].z,
+                        "Point " + std::to_string(i) + " depends on split");
+                }
+            });
+
+            runner.run("OptimalTriangulation.RejectsSharedCentre", []()
+            {
+                CameraMatrix left = createCamera(900.0, 320.0, 240.0, 0.0, 0.0, 0.0);
+                CameraMatrix rotated = createCamera(900.0, 320.0, 240.0, 0.1, 0.0, 0.0);
+                checkThrows<std::invalid_argument>([&]() { OptimalTriangulator triangulator(left, rotated); }, "Cameras of same centre");
+            });
+        }
+    }
+
+    void runTriangulationTests(TestRunner& runner)
+    {
+        testDenseTriangulation(runner);
+        testOptimalTriangulation(runner);
+    }
+}
+}
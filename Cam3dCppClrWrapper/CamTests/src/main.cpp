@@ -0,0 +1,68 @@
+#include "Test.hpp"
+#include <cstdlib>
+#include <iostream>
+
+using namespace cam3d::tests;
+
+namespace
+{
+    void printUsage()
+    {
+        std::cerr <<
+            "Usage: CamTests [options]\n"
+            "  --filter TEXT        run only tests which name contains TEXT\n";
+    }
+
+    TestConfig parseArguments(int argc, char** argv)
+    {
+        TestConfig config;
+        for(int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            if(arg == "--help" || arg == "-h")
+            {
+                printUsage();
+                std::exit(0);
+            }
+            if(i + 1 >= argc)
+            {
+                throw std::invalid_argument("Missing value for " + arg);
+            }
+            std::string value = argv[++i];
+
+            if(arg == "--filter") { config.filter = value; }
+            else { throw std::invalid_argument("Unknown option " + arg); }
+        }
+        return config;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    TestConfig config;
+    try
+    {
+        config = parseArguments(argc, argv);
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << e.what() << "\n";
+        printUsage();
+        return 1;
+    }
+
+    TestRunner runner{ config };
+    runCommonTests(runner);
+    runNativeApiTests(runner);
+    runRefinementTests(runner);
+    runRectificationTests(runner);
+    runTriangulationTests(runner);
+
+    runner.writeSummary(std::cerr);
+    if(runner.getPassedCount() + runner.getFailedCount() == 0)
+    {
+        std::cerr << "No test matches filter " << config.filter << "\n";
+        return 1;
+    }
+    return runner.getFailedCount() == 0 ? 0 : 1;
+}
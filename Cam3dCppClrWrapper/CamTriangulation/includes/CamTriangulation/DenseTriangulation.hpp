@@ -0,0 +1,76 @@
+#pragma once
+
+#include <CamCommon/Array2d.hpp>
+#include <CamCommon/ColorImage.hpp>
+#include <CamCommon/DisparityMap.hpp>
+#include <CamCommon/ParallelFor.hpp>
+#include <vector>
+
+namespace cam3d
+{
+	// Reprojection of rectified pair, as used by managed TwoPointsTriangulation in Rectified mode:
+	// focalLength = Left.InternalMatrix[0, 0], baseline = |Left.Center - Right.Center|,
+	// principalX/Y = Left.InternalMatrix[0, 2] / [1, 2], principalXRight = Right.InternalMatrix[0, 2]
+	struct RectifiedStereoParameters
+	{
+		double focalLength;
+		double baseline;
+		double principalX;
+		double principalY;
+		double principalXRight;
+	};
+
+	// Dense cloud of disparity map, as planes of map size: point of pixel (r, c) is at (r, c)
+	// of each plane. Pixels without point have 0 in 'mask' and NaN in other planes.
+	// Colour planes are empty if cloud was triangulated without image.
+	struct DensePointCloud
+	{
+		Array2d<float> x{ 0, 0 };
+		Array2d<float> y{ 0, 0 };
+		Array2d<float> z{ 0, 0 };
+		Array2d<float> red{ 0, 0 };
+		Array2d<float> green{ 0, 0 };
+		Array2d<float> blue{ 0, 0 };
+		Array2d<float> confidence{ 0, 0 };
+		Array2d<char> mask{ 0, 0 };
+		std::vector<int> rowPointCounts; // Points in each row
+		int pointCount = 0;
+
+		int getRowCount() const { return mask.getRowCount(); }
+		int getColumnCount() const { return mask.getColumnCount(); }
+		bool hasColor() const { return red.getRowCount() > 0; }
+	};
+
+	// Triangulates whole left disparity map of rectified pair, instead of one pair of points at a time
+	// as managed TriangulationLink does. Pixel (c, r) matched with (c + subDx, r) gives, as managed
+	// Estimate3DPointRectified: Z = -f * B / (subDx + principalX - principalXRight),
+	// X = Z * (c - principalX) / f, Y = -Z * (r - principalY) / f.
+	// Only Valid pixels with point in front of camera and not farther than 'maxDepth' get point.
+	// Depth and Z / f of integer disparities within 'maxDisparity' are tabulated on construction;
+	// with 'useSubpixel' they are computed per pixel from subDx instead.
+	class DenseTriangulator
+	{
+	public:
+		bool useSubpixel = true;
+		float maxDepth = 1e30f;
+
+	private:
+		RectifiedStereoParameters parameters;
+		int maxDisparity;
+		std::vector<float> depthTable;           // Of dx + maxDisparity, NaN if point is behind camera
+		std::vector<float> depthPerFocalTable;
+
+	public:
+		// Throws std::invalid_argument if focal length or baseline is not positive
+		DenseTriangulator(const RectifiedStereoParameters& parameters, int maxDisparity);
+
+		const RectifiedStereoParameters& getParameters() const { return parameters; }
+		int getMaxDisparity() const { return maxDisparity; }
+
+		// Writes cloud of 'map' into 'cloud', reallocating its planes only if size changed.
+		// With 'color' (of map size, channels in red, green, blue order) colour planes are written.
+		// Rows are triangulated in parallel. Throws std::invalid_argument if sizes do not match
+		void triangulate(const DisparityMap& map, const ColorImage* color, DensePointCloud& cloud,
+			const ParallelForOptions& options = ParallelForOptions{}) const;
+	};
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <CamCommon/ParallelFor.hpp>
+#include <CamCommon/Vector2.hpp>
+
+namespace cam3d
+{
+	// 3x4 projection matrix P = K[R|t] of calibrated camera, as managed Camera.Matrix
+	struct CameraMatrix
+	{
+		double p[3][4];
+	};
+
+	struct TriangulatedPoint
+	{
+		double x;       // Point in world coordinates, NaN if it could not be triangulated,
+		double y;       // e.g. if it lies at infinity
+		double z;
+		Vector2f left;  // Corrected image points, which satisfy epipolar constraint exactly
+		Vector2f right;
+		double error;   // sqrt(d(left, measured)^2 + d(right, measured)^2), in pixels
+	};
+
+	// Optimal triangulation of matched points (Hartley and Sturm, as managed TwoPointsTriangulation
+	// when not rectified): each pair is moved to closest pair of corresponding epipolar lines, then
+	// triangulated linearly. Lines are found from real roots of 6th-degree polynomial, found with
+	// fixed-size Durand-Kerner iteration instead of managed PolynomialRootFinder, so that nothing is
+	// allocated per point and points are solved in groups of lanes which are vectorized.
+	class OptimalTriangulator
+	{
+		CameraMatrix left;
+		CameraMatrix right;
+		double fundamental[3][3];  // Scaled to unit Frobenius norm
+		double leftEpipole[3];     // F * leftEpipole = 0
+		double rightEpipole[3];    // rightEpipole^T * F = 0
+
+	public:
+		// Throws std::invalid_argument if cameras are degenerate or share centre
+		OptimalTriangulator(const CameraMatrix& left, const CameraMatrix& right);
+
+		const CameraMatrix& getLeftCamera() const { return left; }
+		const CameraMatrix& getRightCamera() const { return right; }
+		double getFundamental(int r, int c) const { return fundamental[r][c]; }
+
+		// Triangulates 'count' pairs (leftPoints[i], rightPoints[i]) into 'points', groups of
+		// points in parallel
+		void triangulate(const Vector2f* leftPoints, const Vector2f* rightPoints, int count,
+			TriangulatedPoint* points, const ParallelForOptions& options = ParallelForOptions{}) const;
+	};
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "DenseTriangulation.hpp"
+#include <CamCommon/PlaneFile.hpp>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cam3d
+{
+	enum class PointCloudFormat
+	{
+		// Binary little-endian PLY with vertex element of points of cloud only (mask != 0), row by row:
+		// float x, y, z, then uchar red, green, blue if cloud has colour, then float confidence if chosen
+		Ply,
+		// Plane file of whole cloud planes (io::PlaneFileWriter), which are mapped in place by
+		// readPointCloud(); pixels without point stay in it, marked by mask
+		Planes,
+	};
+
+	struct PointCloudWriteOptions
+	{
+		bool withConfidence = false;                       // PLY only, planes always have it
+		io::Compression compression = io::Compression::None; // Planes only, compressed planes are not mapped
+	};
+
+	// Points are packed into large buffer, which is written at once when full, so that file is
+	// written in few sequential writes. Throws std::runtime_error if file can not be written
+	void writePointCloudPly(const std::string& path, const DensePointCloud& cloud,
+		const PointCloudWriteOptions& options = PointCloudWriteOptions{});
+	void writePointCloudPlanes(const std::string& path, const DensePointCloud& cloud,
+		const PointCloudWriteOptions& options = PointCloudWriteOptions{});
+	void writePointCloud(const std::string& path, const DensePointCloud& cloud, PointCloudFormat format,
+		const PointCloudWriteOptions& options = PointCloudWriteOptions{});
+
+	// Cloud of file written by writePointCloudPlanes(); planes borrow mapped pages unless compressed
+	io::Loaded<DensePointCloud> readPointCloud(const std::string& path);
+
+	// Writes clouds on own thread, so that writing of frame overlaps with matching and triangulation
+	// of next ones. Submitted cloud is moved in; once written it is kept for acquire(), so that its
+	// planes are reused by next frame instead of reallocated. Up to 'maxQueued' clouds wait
+	// for writing, submit() blocks while queue is full.
+	class PointCloudWriter
+	{
+		struct Job
+		{
+			DensePointCloud cloud;
+			std::string path;
+			PointCloudFormat format;
+			PointCloudWriteOptions options;
+			std::promise<void> done;
+		};
+
+		std::size_t maxQueued;
+		std::mutex mutex;
+		std::condition_variable changed;
+		std::deque<Job> queue;
+		std::vector<DensePointCloud> written;
+		bool writing;
+		bool stopping;
+		std::thread thread;
+
+	public:
+		explicit PointCloudWriter(std::size_t maxQueued = 2);
+		// Writes all queued clouds, then stops
+		~PointCloudWriter();
+
+		PointCloudWriter(const PointCloudWriter&) = delete;
+		PointCloudWriter& operator=(const PointCloudWriter&) = delete;
+
+		// Future is ready once file is written, get() rethrows error of writing
+		std::future<void> submit(DensePointCloud&& cloud, const std::string& path, PointCloudFormat format,
+			const PointCloudWriteOptions& options = PointCloudWriteOptions{});
+
+		// Cloud already written, or empty one if there is none
+		DensePointCloud acquire();
+
+		// Blocks until all submitted clouds are written
+		void flush();
+
+	private:
+		void run();
+	};
+}
@@ -0,0 +1,274 @@
+#include "DenseTriangulation.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+namespace cam3d
+{
+	namespace
+	{
+		// Records are gathered into contiguous chunks, so that arithmetic on them is vectorized
+		constexpr int chunkSize = 64;
+		constexpr float noValue = std::numeric_limits<float>::quiet_NaN();
+
+		struct RowOutput
+		{
+			float* x;
+			float* y;
+			float* z;
+			float* red;
+			float* green;
+			float* blue;
+			float* confidence;
+			char* mask;
+		};
+
+		void fillEmpty(const RowOutput& out, int start, int count, bool withColor)
+		{
+			std::fill(out.x + start, out.x + start + count, noValue);
+			std::fill(out.y + start, out.y + start + count, noValue);
+			std::fill(out.z + start, out.z + start + count, noValue);
+			std::fill(out.confidence + start, out.confidence + start + count, noValue);
+			std::fill(out.mask + start, out.mask + start + count, 0);
+			if (withColor)
+			{
+				std::fill(out.red + start, out.red + start + count, noValue);
+				std::fill(out.green + start, out.green + start + count, noValue);
+				std::fill(out.blue + start, out.blue + start + count, noValue);
+			}
+		}
+
+		struct RowConstants
+		{
+			float focalBaseline;
+			float inverseFocal;
+			float principalX;
+			float principalXDiff;
+			float rowOffset;   // -(r - principalY)
+			float maxDepth;
+		};
+
+		// Returns points written. Depth comes from subDx or, without 'subpixel', from tables of dx
+		template<bool subpixel, bool withColor>
+		int triangulateRow(const Disparity* row, const double* colorRow, int cols, const RowConstants& k,
+			const float* depthTable, const float* depthPerFocalTable, int maxDisparity, const RowOutput& out)
+		{
+			int points = 0;
+			for (int start = 0; start < cols; start += chunkSize)
+			{
+				int count = std::min(chunkSize, cols - start);
+
+				float disparity[chunkSize];
+				float confidence[chunkSize];
+				float valid[chunkSize];
+				int tableIndex[chunkSize];
+				int validCount = 0;
+				for (int i = 0; i < count; ++i)
+				{
+					const Disparity& d = row[start + i];
+					bool isValid = (d.flags & Disparity::Valid) != 0;
+					if (subpixel)
+					{
+						disparity[i] = static_cast<float>(d.subDx);
+					}
+					else
+					{
+						// Out of range disparities take invalid entry 0 and are dropped
+						int index = d.dx + maxDisparity;
+						bool inRange = index >= 0 && index <= 2 * maxDisparity;
+						isValid = isValid && inRange;
+						tableIndex[i] = inRange ? index : 0;
+					}
+					confidence[i] = static_cast<float>(d.confidence);
+					valid[i] = isValid ? 1.0f : 0.0f;
+					validCount += isValid ? 1 : 0;
+				}
+
+				// Flags of whole chunk are checked first, as invalid regions are usually wide
+				if (validCount == 0)
+				{
+					fillEmpty(out, start, count, withColor);
+					continue;
+				}
+
+				float depth[chunkSize];
+				float depthPerFocal[chunkSize];
+				if (subpixel)
+				{
+					for (int i = 0; i < count; ++i)
+					{
+						float denominator = -(disparity[i] + k.principalXDiff);
+						float z = k.focalBaseline / denominator;
+						depth[i] = z;
+						depthPerFocal[i] = z * k.inverseFocal;
+					}
+				}
+				else
+				{
+					for (int i = 0; i < count; ++i)
+					{
+						depth[i] = depthTable[tableIndex[i]];
+						depthPerFocal[i] = depthPerFocalTable[tableIndex[i]];
+					}
+				}
+
+				// Missing points get NaN added. Each plane is written by own loop, as loops writing
+				// several planes need more alias checks than vectorizer does
+				float missing[chunkSize];
+				float hasPoint[chunkSize];
+				float principalX = k.principalX;
+				float rowOffset = k.rowOffset;
+				float maxDepth = k.maxDepth;
+				for (int i = 0; i < count; ++i)
+				{
+					float z = depth[i];
+					// NaN depth of table fails both comparisons
+					float inFront = z > 0.0f ? valid[i] : 0.0f;
+					float inRange = z <= maxDepth ? inFront : 0.0f;
+					hasPoint[i] = inRange;
+					missing[i] = inRange != 0.0f ? 0.0f : noValue;
+				}
+
+				char* maskOut = out.mask + start;
+				for (int i = 0; i < count; ++i)
+				{
+					int point = static_cast<int>(hasPoint[i]);
+					maskOut[i] = static_cast<char>(point);
+					points += point;
+				}
+
+				float* xOut = out.x + start;
+				for (int i = 0; i < count; ++i)
+				{
+					xOut[i] = (static_cast<float>(start + i) - principalX) * depthPerFocal[i] + missing[i];
+				}
+				float* yOut = out.y + start;
+				for (int i = 0; i < count; ++i)
+				{
+					yOut[i] = rowOffset * depthPerFocal[i] + missing[i];
+				}
+				float* zOut = out.z + start;
+				for (int i = 0; i < count; ++i)
+				{
+					zOut[i] = depth[i] + missing[i];
+				}
+				float* confidenceOut = out.confidence + start;
+				for (int i = 0; i < count; ++i)
+				{
+					confidenceOut[i] = confidence[i] + missing[i];
+				}
+
+				if (withColor)
+				{
+					const double* pixel = colorRow + 3 * start;
+					float* channelsOut[3] = { out.red + start, out.green + start, out.blue + start };
+					for (int channel = 0; channel < 3; ++channel)
+					{
+						float* channelOut = channelsOut[channel];
+						for (int i = 0; i < count; ++i)
+						{
+							channelOut[i] = static_cast<float>(pixel[3 * i + channel]) + missing[i];
+						}
+					}
+				}
+			}
+			return points;
+		}
+
+		void resizePlane(Array2d<float>& plane, int rows, int cols)
+		{
+			if (plane.getRowCount() != rows || plane.getColumnCount() != cols)
+			{
+				plane = Array2d<float>{ rows, cols, uninitialized };
+			}
+		}
+	}
+
+	DenseTriangulator::DenseTriangulator(const RectifiedStereoParameters& parameters_, int maxDisparity_) :
+		parameters(parameters_),
+		maxDisparity{ std::max(maxDisparity_, 0) },
+		depthTable(2 * maxDisparity + 1),
+		depthPerFocalTable(2 * maxDisparity + 1)
+	{
+		if (!(parameters.focalLength > 0.0) || !(parameters.baseline > 0.0))
+		{
+			throw std::invalid_argument("Triangulation needs positive focal length and baseline");
+		}
+
+		double principalXDiff = parameters.principalX - parameters.principalXRight;
+		for (int dx = -maxDisparity; dx <= maxDisparity; ++dx)
+		{
+			double denominator = -(dx + principalXDiff);
+			double z = denominator > 0.0 ? parameters.focalLength * parameters.baseline / denominator : std::nan("");
+			depthTable[dx + maxDisparity] = static_cast<float>(z);
+			depthPerFocalTable[dx + maxDisparity] = static_cast<float>(z / parameters.focalLength);
+		}
+	}
+
+	void DenseTriangulator::triangulate(const DisparityMap& map, const ColorImage* color, DensePointCloud& cloud,
+		const ParallelForOptions& options) const
+	{
+		int rows = map.getRowCount();
+		int cols = map.getColumnCount();
+		bool withColor = color != nullptr;
+		if (withColor && (color->getRowCount() != rows || color->getColumnCount() != cols))
+		{
+			throw std::invalid_argument("Colour image must have size of disparity map");
+		}
+
+		resizePlane(cloud.x, rows, cols);
+		resizePlane(cloud.y, rows, cols);
+		resizePlane(cloud.z, rows, cols);
+		resizePlane(cloud.confidence, rows, cols);
+		resizePlane(cloud.red, withColor ? rows : 0, withColor ? cols : 0);
+		resizePlane(cloud.green, withColor ? rows : 0, withColor ? cols : 0);
+		resizePlane(cloud.blue, withColor ? rows : 0, withColor ? cols : 0);
+		if (cloud.mask.getRowCount() != rows || cloud.mask.getColumnCount() != cols)
+		{
+			cloud.mask = Array2d<char>{ rows, cols, uninitialized };
+		}
+		cloud.rowPointCounts.assign(rows, 0);
+
+		RowConstants constants;
+		constants.focalBaseline = static_cast<float>(parameters.focalLength * parameters.baseline);
+		constants.inverseFocal = static_cast<float>(1.0 / parameters.focalLength);
+		constants.principalX = static_cast<float>(parameters.principalX);
+		constants.principalXDiff = static_cast<float>(parameters.principalX - parameters.principalXRight);
+		constants.maxDepth = maxDepth;
+
+		parallelForRows(0, rows, [&](int startRow, int endRow)
+		{
+			RowConstants k = constants;
+			for (int r = startRow; r < endRow; ++r)
+			{
+				k.rowOffset = static_cast<float>(parameters.principalY - r);
+				RowOutput out{ cloud.x.getRow(r), cloud.y.getRow(r), cloud.z.getRow(r),
+					withColor ? cloud.red.getRow(r) : nullptr, withColor ? cloud.green.getRow(r) : nullptr,
+					withColor ? cloud.blue.getRow(r) : nullptr, cloud.confidence.getRow(r), cloud.mask.getRow(r) };
+				const Disparity* row = map.getRow(r);
+				const double* colorRow = withColor ? color->getMatrix().getRow(r) : nullptr;
+				const float* depths = depthTable.data();
+				const float* depthsPerFocal = depthPerFocalTable.data();
+
+				int points;
+				if (useSubpixel)
+				{
+					points = withColor ?
+						triangulateRow<true, true>(row, colorRow, cols, k, depths, depthsPerFocal, maxDisparity, out) :
+						triangulateRow<true, false>(row, colorRow, cols, k, depths, depthsPerFocal, maxDisparity, out);
+				}
+				else
+				{
+					points = withColor ?
+						triangulateRow<false, true>(row, colorRow, cols, k, depths, depthsPerFocal, maxDisparity, out) :
+						triangulateRow<false, false>(row, colorRow, cols, k, depths, depthsPerFocal, maxDisparity, out);
+				}
+				cloud.rowPointCounts[r] = points;
+			}
+		}, options);
+
+		cloud.pointCount = std::accumulate(cloud.rowPointCounts.begin(), cloud.rowPointCounts.end(), 0);
+	}
+}
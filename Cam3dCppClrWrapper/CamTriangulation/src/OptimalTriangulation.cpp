@@ -0,0 +1,484 @@
+#include "OptimalTriangulation.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace cam3d
+{
+	namespace
+	{
+		// Points solved at once. Each step loops over lanes innermost, so that it is vectorized
+		constexpr int lanes = 8;
+		constexpr int maxDegree = 6;
+		constexpr int maxIterations = 100;
+		// Coefficients smaller than this, relative to largest one, are treated as 0 - e.g. t^6 one
+		// is 0 for rectified cameras, as their epipoles lie at infinity
+		constexpr double negligibleCoefficient = 1e-12;
+		constexpr double convergedStepSquared = 1e-26; // Relative to |root|^2
+		constexpr double noValue = std::numeric_limits<double>::quiet_NaN();
+
+		// Initial roots lie on circle, rotated off real axis so that iteration does not stay real
+		struct InitialRoots
+		{
+			double cosine[maxDegree + 1][maxDegree];
+			double sine[maxDegree + 1][maxDegree];
+
+			InitialRoots()
+			{
+				const double pi = std::acos(-1.0);
+				for (int degree = 0; degree <= maxDegree; ++degree)
+				{
+					for (int r = 0; r < maxDegree; ++r)
+					{
+						double angle = degree > 0 ? 2.0 * pi * r / degree + 0.4 : 0.0;
+						cosine[degree][r] = std::cos(angle);
+						sine[degree][r] = std::sin(angle);
+					}
+				}
+			}
+		};
+
+		double determinant3(const double m[3][3])
+		{
+			return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+				- m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+				+ m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+		}
+
+		// Null vector of P: C[i] = (-1)^i * det(P without column i)
+		void findCentre(const CameraMatrix& camera, double centre[4])
+		{
+			for (int skipped = 0; skipped < 4; ++skipped)
+			{
+				double minor[3][3];
+				for (int r = 0; r < 3; ++r)
+				{
+					for (int c = 0, k = 0; c < 4; ++c)
+					{
+						if (c != skipped) { minor[r][k++] = camera.p[r][c]; }
+					}
+				}
+				centre[skipped] = (skipped % 2 == 0 ? 1.0 : -1.0) * determinant3(minor);
+			}
+		}
+
+		void project(const CameraMatrix& camera, const double point[4], double result[3])
+		{
+			for (int r = 0; r < 3; ++r)
+			{
+				result[r] = camera.p[r][0] * point[0] + camera.p[r][1] * point[1] + camera.p[r][2] * point[2] + camera.p[r][3] * point[3];
+			}
+		}
+
+		double cost(double t, double a, double b, double c, double d, double leftF, double rightF)
+		{
+			double ctd = c * t + d;
+			double atb = a * t + b;
+			return t * t / (1.0 + leftF * leftF * t * t) + ctd * ctd / (atb * atb + rightF * rightF * ctd * ctd);
+		}
+
+		// Monic polynomial with zero coefficients above its degree
+		double evaluate(const double monic[maxDegree + 1][lanes], int i, double t, double& derivative)
+		{
+			double value = monic[maxDegree][i];
+			derivative = 0.0;
+			for (int k = maxDegree - 1; k >= 0; --k)
+			{
+				derivative = derivative * t + value;
+				value = value * t + monic[k][i];
+			}
+			return value;
+		}
+
+		struct Geometry
+		{
+			const double (*fundamental)[3];
+			const double* leftEpipole;
+			const double* rightEpipole;
+			const CameraMatrix* left;
+			const CameraMatrix* right;
+		};
+
+		// Solves up to 'lanes' points; missing lanes repeat last point
+		void triangulateGroup(const Geometry& geometry, const Vector2f* leftPoints, const Vector2f* rightPoints,
+			int count, TriangulatedPoint* points)
+		{
+			static const InitialRoots initialRoots;
+			const double (*f)[3] = geometry.fundamental;
+			const double* el = geometry.leftEpipole;
+			const double* er = geometry.rightEpipole;
+
+			double x[lanes], y[lanes], xr[lanes], yr[lanes];
+			for (int i = 0; i < lanes; ++i)
+			{
+				int k = std::min(i, count - 1);
+				x[i] = leftPoints[k].x;
+				y[i] = leftPoints[k].y;
+				xr[i] = rightPoints[k].x;
+				yr[i] = rightPoints[k].y;
+			}
+
+			// Points are moved to origin (T, T') and epipoles rotated onto x axis (R, R'), so that
+			// they are (1, 0, f) and (1, 0, f'); then F' = R' * T'^-T * F * T^-1 * R^T has form
+			// | f*f'*d -f'*c -f'*d |
+			// |   -f*b     a     b |
+			// |   -f*d     c     d |
+			// std::sqrt may set errno, which keeps loop from being vectorized - so it has own loop
+			double leftScale[lanes], rightScale[lanes];
+			for (int i = 0; i < lanes; ++i)
+			{
+				double lx = el[0] - x[i] * el[2], ly = el[1] - y[i] * el[2];
+				double rx = er[0] - xr[i] * er[2], ry = er[1] - yr[i] * er[2];
+				leftScale[i] = 1.0 / std::sqrt(lx * lx + ly * ly);
+				rightScale[i] = 1.0 / std::sqrt(rx * rx + ry * ry);
+			}
+
+			double le0[lanes], le1[lanes], lf[lanes], re0[lanes], re1[lanes], rf[lanes];
+			double a[lanes], b[lanes], c[lanes], d[lanes];
+			for (int i = 0; i < lanes; ++i)
+			{
+				double lx = el[0] - x[i] * el[2], ly = el[1] - y[i] * el[2];
+				double ls = leftScale[i];
+				le0[i] = lx * ls;
+				le1[i] = ly * ls;
+				lf[i] = el[2] * ls;
+				double rx = er[0] - xr[i] * er[2], ry = er[1] - yr[i] * er[2];
+				double rs = rightScale[i];
+				re0[i] = rx * rs;
+				re1[i] = ry * rs;
+				rf[i] = er[2] * rs;
+
+				// G = T'^-T * F * T^-1 differs from F in last column and row
+				double g02 = f[0][0] * x[i] + f[0][1] * y[i] + f[0][2];
+				double g12 = f[1][0] * x[i] + f[1][1] * y[i] + f[1][2];
+				double g20 = xr[i] * f[0][0] + yr[i] * f[1][0] + f[2][0];
+				double g21 = xr[i] * f[0][1] + yr[i] * f[1][1] + f[2][1];
+				double g22 = xr[i] * g02 + yr[i] * g12 + f[2][0] * x[i] + f[2][1] * y[i] + f[2][2];
+				double u0 = f[0][1] * le0[i] - f[0][0] * le1[i];
+				double u1 = f[1][1] * le0[i] - f[1][0] * le1[i];
+				a[i] = re0[i] * u1 - re1[i] * u0;
+				b[i] = re0[i] * g12 - re1[i] * g02;
+				c[i] = g21 * le0[i] - g20 * le1[i];
+				d[i] = g22;
+			}
+
+			// Epipolar lines through (0, t, 1) are at squared distance s(t) from points. Stationary
+			// points of s(t) are roots of g(t) = t * ((at+b)^2 + f'^2(ct+d)^2)^2 - (ad-bc)(1+f^2t^2)^2(at+b)(ct+d)
+			double coefficients[maxDegree + 1][lanes];
+			for (int i = 0; i < lanes; ++i)
+			{
+				double lf2 = lf[i] * lf[i], lf4 = lf2 * lf2, rf2 = rf[i] * rf[i];
+				double ac = a[i] * c[i], bd = b[i] * d[i], adbc = a[i] * d[i] + b[i] * c[i];
+				double q0 = b[i] * b[i] + rf2 * d[i] * d[i];
+				double q1 = 2.0 * (a[i] * b[i] + rf2 * c[i] * d[i]);
+				double q2 = a[i] * a[i] + rf2 * c[i] * c[i];
+				double det = a[i] * d[i] - b[i] * c[i];
+				coefficients[0][i] = -det * bd;
+				coefficients[1][i] = q0 * q0 - det * adbc;
+				coefficients[2][i] = 2.0 * q0 * q1 - det * (ac + 2.0 * lf2 * bd);
+				coefficients[3][i] = q1 * q1 + 2.0 * q0 * q2 - det * 2.0 * lf2 * adbc;
+				coefficients[4][i] = 2.0 * q1 * q2 - det * (2.0 * lf2 * ac + lf4 * bd);
+				coefficients[5][i] = q2 * q2 - det * lf4 * adbc;
+				coefficients[6][i] = -det * lf4 * ac;
+			}
+
+			// Degree of each lane, monic coefficients and initial roots within Fujiwara bound
+			double monic[maxDegree + 1][lanes];
+			double active[maxDegree][lanes];
+			double rootRe[maxDegree][lanes], rootIm[maxDegree][lanes];
+			for (int i = 0; i < lanes; ++i)
+			{
+				double largest = 0.0;
+				for (int k = 0; k <= maxDegree; ++k) { largest = std::max(largest, std::abs(coefficients[k][i])); }
+				int degree = 0;
+				for (int k = 0; k <= maxDegree; ++k)
+				{
+					if (std::abs(coefficients[k][i]) > negligibleCoefficient * largest) { degree = k; }
+				}
+				double lead = coefficients[degree][i];
+				for (int k = 0; k <= maxDegree; ++k)
+				{
+					monic[k][i] = k < degree ? coefficients[k][i] / lead : (k == degree ? 1.0 : 0.0);
+				}
+
+				double bound = 0.0;
+				for (int k = 1; k <= degree; ++k)
+				{
+					double m = std::abs(monic[degree - k][i]) * (k == degree ? 0.5 : 1.0);
+					bound = std::max(bound, std::pow(m, 1.0 / k));
+				}
+				double radius = bound > 0.0 ? 2.0 * bound : 1.0;
+				for (int r = 0; r < maxDegree; ++r)
+				{
+					active[r][i] = r < degree ? 1.0 : 0.0;
+					rootRe[r][i] = radius * initialRoots.cosine[degree][r];
+					rootIm[r][i] = radius * initialRoots.sine[degree][r];
+				}
+			}
+
+			// Durand-Kerner: z_r -= p(z_r) / prod(z_r - z_j), with updated roots used at once
+			for (int iteration = 0; iteration < maxIterations; ++iteration)
+			{
+				double largestStep[lanes] = {};
+				for (int r = 0; r < maxDegree; ++r)
+				{
+					const double* zr = rootRe[r];
+					const double* zi = rootIm[r];
+					double pr[lanes], pi[lanes], dr[lanes], di[lanes];
+					for (int i = 0; i < lanes; ++i)
+					{
+						pr[i] = monic[maxDegree][i];
+						pi[i] = 0.0;
+						dr[i] = 1.0;
+						di[i] = 0.0;
+					}
+					for (int k = maxDegree - 1; k >= 0; --k)
+					{
+						for (int i = 0; i < lanes; ++i)
+						{
+							double nr = pr[i] * zr[i] - pi[i] * zi[i] + monic[k][i];
+							pi[i] = pr[i] * zi[i] + pi[i] * zr[i];
+							pr[i] = nr;
+						}
+					}
+					for (int j = 0; j < maxDegree; ++j)
+					{
+						if (j == r) { continue; }
+						for (int i = 0; i < lanes; ++i)
+						{
+							// Active roots give factor z_r - z_j, others 1. Blended instead of selected,
+							// as selected subtraction would be moved into branch
+							double other = active[j][i];
+							double ur = other * (zr[i] - rootRe[j][i]) + (1.0 - other);
+							double ui = other * (zi[i] - rootIm[j][i]);
+							double nr = dr[i] * ur - di[i] * ui;
+							di[i] = dr[i] * ui + di[i] * ur;
+							dr[i] = nr;
+						}
+					}
+					for (int i = 0; i < lanes; ++i)
+					{
+						// Coincident roots make no step instead of NaN
+						double norm = dr[i] * dr[i] + di[i] * di[i];
+						double scale = active[r][i] / (norm > 0.0 ? norm : 1.0);
+						double stepRe = (pr[i] * dr[i] + pi[i] * di[i]) * scale;
+						double stepIm = (pi[i] * dr[i] - pr[i] * di[i]) * scale;
+						double relative = (stepRe * stepRe + stepIm * stepIm) / (zr[i] * zr[i] + zi[i] * zi[i] + 1e-300);
+						rootRe[r][i] -= stepRe;
+						rootIm[r][i] -= stepIm;
+						largestStep[i] = std::max(largestStep[i], relative);
+					}
+				}
+				bool converged = true;
+				for (int i = 0; i < lanes; ++i) { converged = converged && !(largestStep[i] > convergedStepSquared); }
+				if (converged) { break; }
+			}
+
+			// s(t) is smallest at real root or at t = inf. Real parts of all roots are tried, also
+			// polished by Newton step, so that roots are not classified as real by threshold
+			double bestT[lanes], bestCost[lanes], atInfinity[lanes];
+			for (int i = 0; i < lanes; ++i)
+			{
+				bestT[i] = 0.0;
+				bestCost[i] = cost(0.0, a[i], b[i], c[i], d[i], lf[i], rf[i]);
+			}
+			for (int r = 0; r < maxDegree; ++r)
+			{
+				for (int i = 0; i < lanes; ++i)
+				{
+					double t = rootRe[r][i];
+					double derivative;
+					double value = evaluate(monic, i, t, derivative);
+					double polished = t - value / derivative;
+					polished = std::abs(polished) <= 1e300 ? polished : t;
+					double rootCost = cost(t, a[i], b[i], c[i], d[i], lf[i], rf[i]);
+					double polishedCost = cost(polished, a[i], b[i], c[i], d[i], lf[i], rf[i]);
+					bool isActive = active[r][i] != 0.0;
+					bool rootBetter = isActive & (rootCost < bestCost[i]);
+					bestT[i] = rootBetter ? t : bestT[i];
+					bestCost[i] = rootBetter ? rootCost : bestCost[i];
+					bool polishedBetter = isActive & (polishedCost < bestCost[i]);
+					bestT[i] = polishedBetter ? polished : bestT[i];
+					bestCost[i] = polishedBetter ? polishedCost : bestCost[i];
+				}
+			}
+			for (int i = 0; i < lanes; ++i)
+			{
+				double infinityCost = 1.0 / (lf[i] * lf[i]) + c[i] * c[i] / (a[i] * a[i] + rf[i] * rf[i] * c[i] * c[i]);
+				bool better = infinityCost < bestCost[i];
+				atInfinity[i] = better ? 1.0 : 0.0;
+				bestCost[i] = better ? infinityCost : bestCost[i];
+			}
+
+			// Points on lines closest to origin, moved back: x = T^-1 * R^T * x^. Points of finite t
+			// and of t = inf are blended, both are finite
+			double leftX[lanes], leftY[lanes], rightX[lanes], rightY[lanes];
+			for (int i = 0; i < lanes; ++i)
+			{
+				double infinite = atInfinity[i], finite = 1.0 - infinite;
+				double t = bestT[i];
+				double ctd = c[i] * t + d[i], atb = a[i] * t + b[i];
+				double h0 = infinite * lf[i] + finite * t * t * lf[i];
+				double h1 = finite * t;
+				double h2 = infinite * lf[i] * lf[i] + finite * (1.0 + lf[i] * lf[i] * t * t);
+				leftX[i] = x[i] + (le0[i] * h0 - le1[i] * h1) / h2;
+				leftY[i] = y[i] + (le1[i] * h0 + le0[i] * h1) / h2;
+
+				double g0 = infinite * rf[i] * c[i] * c[i] + finite * rf[i] * ctd * ctd;
+				double g1 = -infinite * a[i] * c[i] - finite * atb * ctd;
+				double g2 = infinite * (a[i] * a[i] + rf[i] * rf[i] * c[i] * c[i]) + finite * (atb * atb + rf[i] * rf[i] * ctd * ctd);
+				rightX[i] = xr[i] + (re0[i] * g0 - re1[i] * g1) / g2;
+				rightY[i] = yr[i] + (re1[i] * g0 + re0[i] * g1) / g2;
+			}
+
+			// Linear triangulation: rows x * p3 - p1, y * p3 - p2 of both cameras, normalised,
+			// solved for (X, Y, Z, 1) with normal equations
+			const CameraMatrix& pl = *geometry.left;
+			const CameraMatrix& pr = *geometry.right;
+			double pointX[lanes], pointY[lanes], pointZ[lanes];
+			for (int i = 0; i < lanes; ++i)
+			{
+				double rows[4][4];
+				for (int k = 0; k < 4; ++k)
+				{
+					rows[0][k] = leftX[i] * pl.p[2][k] - pl.p[0][k];
+					rows[1][k] = leftY[i] * pl.p[2][k] - pl.p[1][k];
+					rows[2][k] = rightX[i] * pr.p[2][k] - pr.p[0][k];
+					rows[3][k] = rightY[i] * pr.p[2][k] - pr.p[1][k];
+				}
+				double m[3][3] = {};
+				double v[3] = {};
+				for (int row = 0; row < 4; ++row)
+				{
+					double* ar = rows[row];
+					double inverseNorm = 1.0 / (ar[0] * ar[0] + ar[1] * ar[1] + ar[2] * ar[2] + ar[3] * ar[3]);
+					for (int j = 0; j < 3; ++j)
+					{
+						for (int k = 0; k < 3; ++k) { m[j][k] += ar[j] * ar[k] * inverseNorm; }
+						v[j] -= ar[j] * ar[3] * inverseNorm;
+					}
+				}
+				double det = determinant3(m);
+				double trace = m[0][0] + m[1][1] + m[2][2];
+				// Singular system, e.g. point at infinity, gets NaN added
+				double missing = std::abs(det) > 1e-14 * trace * trace * trace ? 0.0 : noValue;
+				double inverseDet = 1.0 / det + missing;
+				// Cramer's rule
+				pointX[i] = (v[0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) - m[0][1] * (v[1] * m[2][2] - m[1][2] * v[2])
+					+ m[0][2] * (v[1] * m[2][1] - m[1][1] * v[2])) * inverseDet;
+				pointY[i] = (m[0][0] * (v[1] * m[2][2] - m[1][2] * v[2]) - v[0] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+					+ m[0][2] * (m[1][0] * v[2] - v[1] * m[2][0])) * inverseDet;
+				pointZ[i] = (m[0][0] * (m[1][1] * v[2] - v[1] * m[2][1]) - m[0][1] * (m[1][0] * v[2] - v[1] * m[2][0])
+					+ v[0] * (m[1][0] * m[2][1] - m[1][1] * m[2][0])) * inverseDet;
+			}
+
+			for (int i = 0; i < count; ++i)
+			{
+				points[i] = TriangulatedPoint{ pointX[i], pointY[i], pointZ[i],
+					Vector2f{ leftX[i], leftY[i] }, Vector2f{ rightX[i], rightY[i] }, std::sqrt(bestCost[i]) };
+			}
+		}
+	}
+
+	OptimalTriangulator::OptimalTriangulator(const CameraMatrix& left_, const CameraMatrix& right_) :
+		left(left_),
+		right(right_)
+	{
+		double leftCentre[4], rightCentre[4];
+		findCentre(left, leftCentre);
+		findCentre(right, rightCentre);
+		project(left, rightCentre, leftEpipole);
+		project(right, leftCentre, rightEpipole);
+		double leftNorm = std::sqrt(leftEpipole[0] * leftEpipole[0] + leftEpipole[1] * leftEpipole[1] + leftEpipole[2] * leftEpipole[2]);
+		double rightNorm = std::sqrt(rightEpipole[0] * rightEpipole[0] + rightEpipole[1] * rightEpipole[1] + rightEpipole[2] * rightEpipole[2]);
+		if (!(leftNorm > 0.0) || !(rightNorm > 0.0))
+		{
+			throw std::invalid_argument("Cameras must have separate centres");
+		}
+		for (int k = 0; k < 3; ++k)
+		{
+			leftEpipole[k] /= leftNorm;
+			rightEpipole[k] /= rightNorm;
+		}
+
+		// F = [e']x * P' * P+, where P+ = P^T * (P * P^T)^-1
+		double ppt[3][3];
+		for (int r = 0; r < 3; ++r)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				ppt[r][c] = 0.0;
+				for (int k = 0; k < 4; ++k) { ppt[r][c] += left.p[r][k] * left.p[c][k]; }
+			}
+		}
+		double det = determinant3(ppt);
+		if (!(std::abs(det) > 0.0))
+		{
+			throw std::invalid_argument("Camera matrix must have rank 3");
+		}
+		double pptInverse[3][3];
+		for (int r = 0; r < 3; ++r)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				int r1 = (c + 1) % 3, r2 = (c + 2) % 3, c1 = (r + 1) % 3, c2 = (r + 2) % 3;
+				pptInverse[r][c] = (ppt[r1][c1] * ppt[r2][c2] - ppt[r1][c2] * ppt[r2][c1]) / det;
+			}
+		}
+		double pseudoInverse[4][3];
+		for (int r = 0; r < 4; ++r)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				pseudoInverse[r][c] = left.p[0][r] * pptInverse[0][c] + left.p[1][r] * pptInverse[1][c] + left.p[2][r] * pptInverse[2][c];
+			}
+		}
+		double rightByInverse[3][3];
+		for (int r = 0; r < 3; ++r)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				rightByInverse[r][c] = 0.0;
+				for (int k = 0; k < 4; ++k) { rightByInverse[r][c] += right.p[r][k] * pseudoInverse[k][c]; }
+			}
+		}
+		const double* e = rightEpipole;
+		double cross[3][3] = { { 0.0, -e[2], e[1] }, { e[2], 0.0, -e[0] }, { -e[1], e[0], 0.0 } };
+		double norm = 0.0;
+		for (int r = 0; r < 3; ++r)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				fundamental[r][c] = cross[r][0] * rightByInverse[0][c] + cross[r][1] * rightByInverse[1][c] + cross[r][2] * rightByInverse[2][c];
+				norm += fundamental[r][c] * fundamental[r][c];
+			}
+		}
+		norm = std::sqrt(norm);
+		if (!(norm > 0.0))
+		{
+			throw std::invalid_argument("Cameras do not define fundamental matrix");
+		}
+		for (int r = 0; r < 3; ++r)
+		{
+			for (int c = 0; c < 3; ++c) { fundamental[r][c] /= norm; }
+		}
+	}
+
+	void OptimalTriangulator::triangulate(const Vector2f* leftPoints, const Vector2f* rightPoints, int count,
+		TriangulatedPoint* points, const ParallelForOptions& options) const
+	{
+		if (count <= 0) { return; }
+
+		Geometry geometry{ fundamental, leftEpipole, rightEpipole, &left, &right };
+		int groups = (count + lanes - 1) / lanes;
+		parallelForRows(0, groups, [&](int startGroup, int endGroup)
+		{
+			for (int group = startGroup; group < endGroup; ++group)
+			{
+				int start = group * lanes;
+				triangulateGroup(geometry, leftPoints + start, rightPoints + start, std::min(lanes, count - start), points + start);
+			}
+		}, options);
+	}
+}
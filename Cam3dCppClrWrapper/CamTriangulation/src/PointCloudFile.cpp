@@ -0,0 +1,366 @@
+#include "PointCloudFile.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <numeric>
+#include <stdexcept>
+
+namespace cam3d
+{
+	namespace
+	{
+		// Buffer of packed points, written with single call when full
+		constexpr std::size_t writeBufferBytes = std::size_t{ 4 } << 20;
+
+		constexpr const char* xPlaneName = "cloud_x";
+		constexpr const char* yPlaneName = "cloud_y";
+		constexpr const char* zPlaneName = "cloud_z";
+		constexpr const char* redPlaneName = "cloud_red";
+		constexpr const char* greenPlaneName = "cloud_green";
+		constexpr const char* bluePlaneName = "cloud_blue";
+		constexpr const char* confidencePlaneName = "cloud_confidence";
+		constexpr const char* maskPlaneName = "cloud_mask";
+
+		std::runtime_error fileError(const std::string& path, const std::string& message)
+		{
+			return std::runtime_error("Point cloud file '" + path + "': " + message);
+		}
+
+		// Not buffered by stdio, as caller writes large blocks only
+		class SequentialFile
+		{
+			std::FILE* file;
+			std::string path;
+
+		public:
+			explicit SequentialFile(const std::string& path_) :
+				file{ std::fopen(path_.c_str(), "wb") },
+				path{ path_ }
+			{
+				if (file == nullptr)
+				{
+					throw fileError(path, "can not create");
+				}
+				std::setvbuf(file, nullptr, _IONBF, 0);
+			}
+
+			~SequentialFile()
+			{
+				if (file != nullptr) { std::fclose(file); }
+			}
+
+			SequentialFile(const SequentialFile&) = delete;
+			SequentialFile& operator=(const SequentialFile&) = delete;
+
+			void write(const void* bytes, std::size_t count)
+			{
+				if (count > 0 && std::fwrite(bytes, 1, count, file) != count)
+				{
+					throw fileError(path, "write failed");
+				}
+			}
+
+			void close()
+			{
+				bool ok = std::fclose(file) == 0;
+				file = nullptr;
+				if (!ok)
+				{
+					throw fileError(path, "write failed");
+				}
+			}
+		};
+
+		// Byte order of PLY regardless of host; compilers make single store of it on little-endian ones
+		void storeFloat(char* destination, float value)
+		{
+			std::uint32_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			destination[0] = static_cast<char>(bits & 0xFF);
+			destination[1] = static_cast<char>((bits >> 8) & 0xFF);
+			destination[2] = static_cast<char>((bits >> 16) & 0xFF);
+			destination[3] = static_cast<char>(bits >> 24);
+		}
+
+		// Colour of cloud is in [0, 1] as of ColorImage
+		char toColorByte(float value)
+		{
+			float scaled = std::min(std::max(value * 255.0f + 0.5f, 0.0f), 255.0f);
+			return static_cast<char>(static_cast<unsigned char>(scaled));
+		}
+
+		int countPoints(const DensePointCloud& cloud, int r)
+		{
+			const char* mask = cloud.mask.getRow(r);
+			return static_cast<int>(cloud.getColumnCount() - std::count(mask, mask + cloud.getColumnCount(), 0));
+		}
+
+		template<typename T>
+		void writeArray(io::PlaneFileWriter& writer, const char* name, io::ElementType type, const Array2d<T>& array,
+			io::Compression compression)
+		{
+			writer.writePlane(name, type, array.getRowCount(), array.getColumnCount(), 1,
+				array.getData(), array.getPitch() * sizeof(T), compression);
+		}
+
+		// Borrows mapped plane if it is not compressed, else reads it into own array.
+		// Returns true if plane is mapped
+		template<typename T>
+		bool loadArray(const io::PlaneFileReader& reader, const char* name, io::ElementType type, int rows, int cols,
+			Array2d<T>& array)
+		{
+			const io::PlaneInfo& plane = reader.getPlane(name);
+			if (plane.type != type || plane.channels != 1 || plane.rows != rows || plane.cols != cols)
+			{
+				throw std::runtime_error("Plane '" + plane.name + "' does not match point cloud");
+			}
+			if (void* mapped = reader.getMappedData(plane))
+			{
+				array = Array2d<T>{ borrowed, static_cast<T*>(mapped), plane.rows, plane.cols,
+					static_cast<int>(plane.pitchBytes / sizeof(T)) };
+				return true;
+			}
+			array = Array2d<T>{ plane.rows, plane.cols, uninitialized };
+			reader.readPlane(plane, array.getData(), array.getPitch() * sizeof(T));
+			return false;
+		}
+	}
+
+	void writePointCloudPly(const std::string& path, const DensePointCloud& cloud, const PointCloudWriteOptions& options)
+	{
+		int rows = cloud.getRowCount();
+		int cols = cloud.getColumnCount();
+		bool withColor = cloud.hasColor();
+		bool withConfidence = options.withConfidence;
+
+		// Mask is counted again, as count in header must match points written even if mask was changed
+		std::vector<int> rowCounts(rows);
+		for (int r = 0; r < rows; ++r)
+		{
+			rowCounts[r] = countPoints(cloud, r);
+		}
+		long long pointCount = std::accumulate(rowCounts.begin(), rowCounts.end(), 0ll);
+
+		std::string header = "ply\nformat binary_little_endian 1.0\nelement vertex " + std::to_string(pointCount) +
+			"\nproperty float x\nproperty float y\nproperty float z\n";
+		if (withColor)
+		{
+			header += "property uchar red\nproperty uchar green\nproperty uchar blue\n";
+		}
+		if (withConfidence)
+		{
+			header += "property float confidence\n";
+		}
+		header += "end_header\n";
+
+		std::size_t colorOffset = 3 * sizeof(float);
+		std::size_t confidenceOffset = colorOffset + (withColor ? 3 : 0);
+		std::size_t recordBytes = confidenceOffset + (withConfidence ? sizeof(float) : 0);
+
+		// Whole row fits in buffer, so that space is checked once per row
+		std::vector<char> buffer(std::max(writeBufferBytes, static_cast<std::size_t>(cols) * recordBytes));
+		SequentialFile file{ path };
+		file.write(header.data(), header.size());
+
+		std::size_t used = 0;
+		for (int r = 0; r < rows; ++r)
+		{
+			if (rowCounts[r] == 0) { continue; }
+			if (used + rowCounts[r] * recordBytes > buffer.size())
+			{
+				file.write(buffer.data(), used);
+				used = 0;
+			}
+
+			const char* mask = cloud.mask.getRow(r);
+			const float* x = cloud.x.getRow(r);
+			const float* y = cloud.y.getRow(r);
+			const float* z = cloud.z.getRow(r);
+			const float* confidence = cloud.confidence.getRow(r);
+			const float* red = withColor ? cloud.red.getRow(r) : nullptr;
+			const float* green = withColor ? cloud.green.getRow(r) : nullptr;
+			const float* blue = withColor ? cloud.blue.getRow(r) : nullptr;
+			char* record = buffer.data() + used;
+			for (int c = 0; c < cols; ++c)
+			{
+				if (mask[c] == 0) { continue; }
+				storeFloat(record, x[c]);
+				storeFloat(record + sizeof(float), y[c]);
+				storeFloat(record + 2 * sizeof(float), z[c]);
+				if (withColor)
+				{
+					record[colorOffset] = toColorByte(red[c]);
+					record[colorOffset + 1] = toColorByte(green[c]);
+					record[colorOffset + 2] = toColorByte(blue[c]);
+				}
+				if (withConfidence)
+				{
+					storeFloat(record + confidenceOffset, confidence[c]);
+				}
+				record += recordBytes;
+			}
+			used += rowCounts[r] * recordBytes;
+		}
+		file.write(buffer.data(), used);
+		file.close();
+	}
+
+	void writePointCloudPlanes(const std::string& path, const DensePointCloud& cloud, const PointCloudWriteOptions& options)
+	{
+		bool withColor = cloud.hasColor();
+		io::PlaneFileWriter writer{ path, withColor ? 8u : 5u };
+		writeArray(writer, maskPlaneName, io::ElementType::UInt8, cloud.mask, options.compression);
+		writeArray(writer, xPlaneName, io::ElementType::Float, cloud.x, options.compression);
+		writeArray(writer, yPlaneName, io::ElementType::Float, cloud.y, options.compression);
+		writeArray(writer, zPlaneName, io::ElementType::Float, cloud.z, options.compression);
+		writeArray(writer, confidencePlaneName, io::ElementType::Float, cloud.confidence, options.compression);
+		if (withColor)
+		{
+			writeArray(writer, redPlaneName, io::ElementType::Float, cloud.red, options.compression);
+			writeArray(writer, greenPlaneName, io::ElementType::Float, cloud.green, options.compression);
+			writeArray(writer, bluePlaneName, io::ElementType::Float, cloud.blue, options.compression);
+		}
+		writer.close();
+	}
+
+	void writePointCloud(const std::string& path, const DensePointCloud& cloud, PointCloudFormat format,
+		const PointCloudWriteOptions& options)
+	{
+		if (format == PointCloudFormat::Ply)
+		{
+			writePointCloudPly(path, cloud, options);
+		}
+		else
+		{
+			writePointCloudPlanes(path, cloud, options);
+		}
+	}
+
+	io::Loaded<DensePointCloud> readPointCloud(const std::string& path)
+	{
+		io::PlaneFileReader reader{ path };
+		const io::PlaneInfo& maskPlane = reader.getPlane(maskPlaneName);
+		int rows = maskPlane.rows;
+		int cols = maskPlane.cols;
+
+		// Planes which were read own their elements, mapped ones need file kept
+		DensePointCloud cloud;
+		bool mapped = loadArray(reader, maskPlaneName, io::ElementType::UInt8, rows, cols, cloud.mask);
+		mapped = loadArray(reader, xPlaneName, io::ElementType::Float, rows, cols, cloud.x) || mapped;
+		mapped = loadArray(reader, yPlaneName, io::ElementType::Float, rows, cols, cloud.y) || mapped;
+		mapped = loadArray(reader, zPlaneName, io::ElementType::Float, rows, cols, cloud.z) || mapped;
+		mapped = loadArray(reader, confidencePlaneName, io::ElementType::Float, rows, cols, cloud.confidence) || mapped;
+		if (reader.findPlane(redPlaneName) != nullptr)
+		{
+			mapped = loadArray(reader, redPlaneName, io::ElementType::Float, rows, cols, cloud.red) || mapped;
+			mapped = loadArray(reader, greenPlaneName, io::ElementType::Float, rows, cols, cloud.green) || mapped;
+			mapped = loadArray(reader, bluePlaneName, io::ElementType::Float, rows, cols, cloud.blue) || mapped;
+		}
+
+		cloud.rowPointCounts.resize(rows);
+		for (int r = 0; r < rows; ++r)
+		{
+			cloud.rowPointCounts[r] = countPoints(cloud, r);
+		}
+		cloud.pointCount = std::accumulate(cloud.rowPointCounts.begin(), cloud.rowPointCounts.end(), 0);
+
+		return { mapped ? reader.getFile() : nullptr, std::move(cloud) };
+	}
+
+	PointCloudWriter::PointCloudWriter(std::size_t maxQueued_) :
+		maxQueued{ std::max<std::size_t>(maxQueued_, 1) },
+		writing{ false },
+		stopping{ false }
+	{
+		thread = std::thread{ [this]() { run(); } };
+	}
+
+	PointCloudWriter::~PointCloudWriter()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		changed.notify_all();
+		thread.join();
+	}
+
+	std::future<void> PointCloudWriter::submit(DensePointCloud&& cloud, const std::string& path, PointCloudFormat format,
+		const PointCloudWriteOptions& options)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock, [this]() { return queue.size() < maxQueued; });
+		queue.push_back(Job{ std::move(cloud), path, format, options, std::promise<void>{} });
+		std::future<void> future = queue.back().done.get_future();
+		lock.unlock();
+		changed.notify_all();
+		return future;
+	}
+
+	DensePointCloud PointCloudWriter::acquire()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (written.empty())
+		{
+			return DensePointCloud{};
+		}
+		DensePointCloud cloud = std::move(written.back());
+		written.pop_back();
+		return cloud;
+	}
+
+	void PointCloudWriter::flush()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock, [this]() { return queue.empty() && !writing; });
+	}
+
+	void PointCloudWriter::run()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true)
+		{
+			changed.wait(lock, [this]() { return stopping || !queue.empty(); });
+			if (queue.empty())
+			{
+				return;
+			}
+			Job job = std::move(queue.front());
+			queue.pop_front();
+			writing = true;
+			lock.unlock();
+			changed.notify_all();
+
+			std::exception_ptr error;
+			try
+			{
+				writePointCloud(job.path, job.cloud, job.format, job.options);
+			}
+			catch (...)
+			{
+				error = std::current_exception();
+			}
+
+			lock.lock();
+			// Clouds not taken back are dropped, so that at most queue of them is kept
+			if (written.size() < maxQueued)
+			{
+				written.push_back(std::move(job.cloud));
+			}
+			writing = false;
+			lock.unlock();
+			if (error)
+			{
+				job.done.set_exception(error);
+			}
+			else
+			{
+				job.done.set_value();
+			}
+			changed.notify_all();
+			lock.lock();
+		}
+	}
+}